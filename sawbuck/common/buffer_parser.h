@@ -16,6 +16,8 @@
 #ifndef SAWBUCK_COMMON_BUFFER_PARSER_H_
 #define SAWBUCK_COMMON_BUFFER_PARSER_H_
 
+#include <string.h>
+#include <wchar.h>
 #include "base/basictypes.h"
 
 // A binary buffer parser
@@ -141,4 +143,112 @@ class BinaryBufferReader {
   size_t pos_;
 };
 
+// A binary record decoder reads the fields of a record of a known layout in
+// one pass. Each field is checked against the rest of the record as it's
+// read: a struct of fixed-size fields or an array takes a single comparison,
+// and a string a bounded memchr/wmemchr scan. The event records it decodes
+// carry no string lengths, and their strings end at their first zero, so
+// every string is scanned, including the one that ends the record.
+// @note The decoder is inline throughout, as it's used once per event.
+class BinaryRecordDecoder {
+ public:
+  BinaryRecordDecoder(const void* data, size_t data_len)
+      : data_(reinterpret_cast<const int8*>(data)),
+        data_len_(data_len),
+        pos_(0) {
+  }
+
+  // Accessors.
+  size_t pos() const { return pos_; }
+
+  // @returns the number of bytes remaining in the record.
+  size_t RemainingBytes() const { return data_len_ - pos_; }
+
+  // Reads the first @p len bytes of a @p Layout, for layouts that end in
+  // variable length fields.
+  // @param len the byte length of the fixed-size fields.
+  // @param layout on success points to the fields in the record.
+  // @returns true iff the record holds @p len more bytes.
+  // @note Does not check the read position for appropriate alignment.
+  template <class Layout>
+  bool ReadFixed(size_t len, const Layout** layout) {
+    if (len > RemainingBytes())
+      return false;
+
+    *layout = reinterpret_cast<const Layout*>(data_ + pos_);
+    pos_ += len;
+    return true;
+  }
+
+  // Reads all of a @p Layout.
+  template <class Layout>
+  bool ReadFixed(const Layout** layout) {
+    return ReadFixed(sizeof(**layout), layout);
+  }
+
+  // Reads an array of @p count elements.
+  // @returns true iff the record holds the array.
+  template <class ElementType>
+  bool ReadArray(size_t count, const ElementType** array) {
+    // Divide rather than multiply, as a corrupt count may overflow.
+    if (count > RemainingBytes() / sizeof(**array))
+      return false;
+
+    return ReadFixed(count * sizeof(**array), array);
+  }
+
+  // Reads a zero-terminated string.
+  // @param str on success points to the string in the record.
+  // @param str_len on success returns the string character length.
+  // @returns true iff there's a zero terminator in the record.
+  template <class CharType>
+  bool ReadString(const CharType** str, size_t* str_len) {
+    const CharType* start = reinterpret_cast<const CharType*>(data_ + pos_);
+    size_t max_len = RemainingBytes() / sizeof(*start);
+    size_t len = StringLength(start, max_len);
+    if (len == max_len)
+      return false;
+
+    *str = start;
+    *str_len = len;
+    pos_ += (len + 1) * sizeof(*start);
+    return true;
+  }
+
+  // Reads the zero-terminated string that ends the record, and skips any
+  // padding that follows it. As with ReadString, the string ends at its first
+  // zero, so embedded zeros truncate it whether or not the record is padded.
+  // @param str on success points to the string in the record.
+  // @param str_len on success returns the string character length.
+  // @returns true iff there's a zero terminator in the record.
+  template <class CharType>
+  bool ReadTrailingString(const CharType** str, size_t* str_len) {
+    if (!ReadString(str, str_len))
+      return false;
+
+    pos_ = data_len_;
+    return true;
+  }
+
+ private:
+  // @returns the length of the string at @p str, or @p max_len if it isn't
+  //     terminated within @p max_len characters.
+  static size_t StringLength(const char* str, size_t max_len) {
+    const void* end = memchr(str, 0, max_len);
+    return end == NULL ? max_len : static_cast<const char*>(end) - str;
+  }
+  static size_t StringLength(const wchar_t* str, size_t max_len) {
+    const wchar_t* end = wmemchr(str, 0, max_len);
+    return end == NULL ? max_len : end - str;
+  }
+
+  // The record we decode.
+  const int8* data_;
+  size_t data_len_;
+  // Current position.
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryRecordDecoder);
+};
+
 #endif  // SAWBUCK_COMMON_BUFFER_PARSER_H_
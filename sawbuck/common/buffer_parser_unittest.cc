@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "sawbuck/common/buffer_parser.h"
+
+#include <string>
 #include "gtest/gtest.h"
 
 namespace {
@@ -218,4 +220,153 @@ TEST(BinaryBufferReader, ReadWideString) {
   ASSERT_FALSE(reader.ReadString(&str, &str_len));
 }
 
+TEST(BinaryRecordDecoder, ReadFixed) {
+  struct Foo { char a; char b; };
+  BinaryRecordDecoder decoder(kDataBuffer, kDataBufferSize);
+
+  const Foo* foo = NULL;
+  ASSERT_TRUE(decoder.ReadFixed(&foo));
+  EXPECT_EQ(0, foo->a);
+  EXPECT_EQ(1, foo->b);
+  ASSERT_TRUE(decoder.ReadFixed(1, &foo));
+  EXPECT_EQ(2, foo->a);
+  EXPECT_EQ(3, decoder.pos());
+
+  EXPECT_FALSE(decoder.ReadFixed(kDataBufferSize, &foo));
+  EXPECT_EQ(3, decoder.pos());
+  ASSERT_TRUE(decoder.ReadFixed(kDataBufferSize - 3, &foo));
+  EXPECT_EQ(0, decoder.RemainingBytes());
+  EXPECT_FALSE(decoder.ReadFixed(&foo));
+}
+
+TEST(BinaryRecordDecoder, ReadArray) {
+  BinaryRecordDecoder decoder(kDataBuffer, kDataBufferSize);
+
+  const int16* array = NULL;
+  ASSERT_TRUE(decoder.ReadArray(2, &array));
+  EXPECT_EQ(4, decoder.pos());
+  EXPECT_FALSE(decoder.ReadArray(kDataBufferSize, &array));
+
+  // Counts that overflow when scaled to bytes fail.
+  EXPECT_FALSE(decoder.ReadArray(static_cast<size_t>(-1) / 2 + 1, &array));
+  EXPECT_EQ(4, decoder.pos());
+}
+
+TEST(BinaryRecordDecoder, ReadString) {
+  static const wchar_t kBuf[] = {
+    L'a', L'b', L'c', L'd', L'\0', L'e', L'f', L'g', L'\0', L'h', L'i'
+  };
+  BinaryRecordDecoder decoder(kBuf, sizeof(kBuf));
+
+  const wchar_t* str = NULL;
+  size_t str_len = 0;
+  ASSERT_TRUE(decoder.ReadString(&str, &str_len));
+  EXPECT_EQ(std::wstring(L"abcd"), std::wstring(str, str_len));
+  ASSERT_TRUE(decoder.ReadString(&str, &str_len));
+  EXPECT_EQ(std::wstring(L"efg"), std::wstring(str, str_len));
+  ASSERT_FALSE(decoder.ReadString(&str, &str_len));
+  ASSERT_FALSE(decoder.ReadTrailingString(&str, &str_len));
+}
+
+TEST(BinaryRecordDecoder, ReadTrailingString) {
+  const char* str = NULL;
+  size_t str_len = 0;
+
+  static const char kBuf[] = "abcd\0efg";
+  BinaryRecordDecoder decoder(kBuf, sizeof(kBuf));
+  ASSERT_TRUE(decoder.ReadString(&str, &str_len));
+  ASSERT_TRUE(decoder.ReadTrailingString(&str, &str_len));
+  EXPECT_EQ("efg", std::string(str, str_len));
+  EXPECT_EQ(0, decoder.RemainingBytes());
+
+  // Records padded past the terminator are scanned.
+  static const char kPadded[] = "abc\0\0";
+  BinaryRecordDecoder padded(kPadded, sizeof(kPadded));
+  ASSERT_TRUE(padded.ReadTrailingString(&str, &str_len));
+  EXPECT_EQ("abc", std::string(str, str_len));
+  EXPECT_EQ(0, padded.RemainingBytes());
+
+  // An embedded zero ends the string, whether or not the record is padded.
+  static const char kEmbedded[] = "ab\0cd";
+  BinaryRecordDecoder embedded(kEmbedded, sizeof(kEmbedded));
+  ASSERT_TRUE(embedded.ReadTrailingString(&str, &str_len));
+  EXPECT_EQ("ab", std::string(str, str_len));
+  EXPECT_EQ(0, embedded.RemainingBytes());
+
+  static const char kEmbeddedPadded[] = "ab\0cd\0\0";
+  BinaryRecordDecoder embedded_padded(kEmbeddedPadded,
+                                      sizeof(kEmbeddedPadded));
+  ASSERT_TRUE(embedded_padded.ReadTrailingString(&str, &str_len));
+  EXPECT_EQ("ab", std::string(str, str_len));
+  EXPECT_EQ(0, embedded_padded.RemainingBytes());
+
+  // Records that don't hold a whole number of characters are scanned too.
+  static const wchar_t kWide[] = { L'a', L'b', L'\0', L'c' };
+  const wchar_t* wide_str = NULL;
+  BinaryRecordDecoder wide(kWide, sizeof(kWide) - 1);
+  ASSERT_TRUE(wide.ReadTrailingString(&wide_str, &str_len));
+  EXPECT_EQ(std::wstring(L"ab"), std::wstring(wide_str, str_len));
+
+  BinaryRecordDecoder empty(kBuf, 1);
+  ASSERT_FALSE(empty.ReadTrailingString(&str, &str_len));
+  BinaryRecordDecoder none(kBuf, 0);
+  ASSERT_FALSE(none.ReadTrailingString(&str, &str_len));
+}
+
+// Compares the reader to the decoder on a record laid out as a log message
+// with a stack trace and file information.
+// The decoder reads a full log message record as BinaryBufferReader does.
+TEST(BinaryRecordDecoder, ReadsLogMessageAsReader) {
+  const uint32 kDepth = 8;
+  const uint32 kLine = 42;
+  const char kFile[] = "c:\\src\\sawbuck\\viewer\\viewer_window.cc";
+  const char kMessage[] = "message";
+  std::string record(reinterpret_cast<const char*>(&kDepth), sizeof(kDepth));
+  record.append(kDepth * sizeof(void*), '\1');
+  record.append(reinterpret_cast<const char*>(&kLine), sizeof(kLine));
+  record.append(kFile, sizeof(kFile));
+  record.append(kMessage, sizeof(kMessage));
+
+  BinaryBufferReader reader(record.data(), record.size());
+  const uint32* depth = NULL;
+  const void* traces = NULL;
+  const uint32* line = NULL;
+  const char* file = NULL;
+  size_t file_len = 0;
+  const char* msg = NULL;
+  size_t msg_len = 0;
+  ASSERT_TRUE(reader.Read(&depth) &&
+              reader.Read(*depth * sizeof(void*), &traces) &&
+              reader.Read(&line) &&
+              reader.ReadString(&file, &file_len) &&
+              reader.ReadString(&msg, &msg_len));
+
+  BinaryRecordDecoder decoder(record.data(), record.size());
+  const uint32* decoded_depth = NULL;
+  void* const* decoded_traces = NULL;
+  const uint32* decoded_line = NULL;
+  const char* decoded_file = NULL;
+  size_t decoded_file_len = 0;
+  const char* decoded_msg = NULL;
+  size_t decoded_msg_len = 0;
+  ASSERT_TRUE(decoder.ReadFixed(&decoded_depth) &&
+              decoder.ReadArray(*decoded_depth, &decoded_traces) &&
+              decoder.ReadFixed(&decoded_line) &&
+              decoder.ReadString(&decoded_file, &decoded_file_len) &&
+              decoder.ReadTrailingString(&decoded_msg, &decoded_msg_len));
+
+  EXPECT_EQ(depth, decoded_depth);
+  EXPECT_EQ(kDepth, *decoded_depth);
+  EXPECT_EQ(traces, decoded_traces);
+  EXPECT_EQ(line, decoded_line);
+  EXPECT_EQ(kLine, *decoded_line);
+  EXPECT_EQ(file, decoded_file);
+  EXPECT_EQ(file_len, decoded_file_len);
+  EXPECT_EQ(kFile, std::string(decoded_file, decoded_file_len));
+  EXPECT_EQ(msg, decoded_msg);
+  EXPECT_EQ(msg_len, decoded_msg_len);
+  EXPECT_EQ(kMessage, std::string(decoded_msg, decoded_msg_len));
+  EXPECT_EQ(reader.pos(), decoder.pos());
+}
+
 }  // namespace
@@ -168,35 +168,38 @@ class ProcessInfoTypeTraits<ProcessInfo64V1> {
 template <class ProcessInfoType>
 bool ParseProcessEvent(const void* data, size_t data_len,
     KernelProcessEvents::ProcessInfo* process_info, DWORD* exit_status) {
-  BinaryBufferReader reader(data, data_len);
+  BinaryRecordDecoder decoder(data, data_len);
   const ProcessInfoType* info = NULL;
-  // Probe the info struct header and a get a pointer to it.
-  if (!reader.Read(FIELD_OFFSET(ProcessInfoType, UserSID), &info))
+  // Get the fixed fields of the info struct, up to its SID.
+  if (!decoder.ReadFixed(FIELD_OFFSET(ProcessInfoType, UserSID), &info))
     return false;
 
-  // Probe the front of the SID structure.
+  // Get the front of the SID structure, then its sub authorities.
   const SID* sid = NULL;
-  if (!reader.Peek(FIELD_OFFSET(SID, SubAuthority), &sid) ||
-      !::IsValidSid(const_cast<SID*>(sid)))
+  const DWORD* sub_authorities = NULL;
+  if (!decoder.ReadFixed(FIELD_OFFSET(SID, SubAuthority), &sid) ||
+      !::IsValidSid(const_cast<SID*>(sid)) ||
+      !decoder.ReadArray(sid->SubAuthorityCount, &sub_authorities))
     return false;
 
-  // Calculate the SID length and walk past it.
   DCHECK_EQ(&info->UserSID, sid);
   DWORD sid_len = ::GetLengthSid(const_cast<SID*>(sid));
-  if (!reader.Consume(sid_len))
-    return false;
+  DCHECK_EQ(reinterpret_cast<const uint8*>(sub_authorities) +
+                sid->SubAuthorityCount * sizeof(*sub_authorities),
+            reinterpret_cast<const uint8*>(sid) + sid_len);
 
   // Retrieve the trailing image name.
   const char* image_name = NULL;
   size_t image_name_len = 0;
-  if (!reader.ReadString(&image_name, &image_name_len))
+  if (!decoder.ReadString(&image_name, &image_name_len))
     return false;
 
-  // And then the command line for the variants that have it.
+  // And then the command line for the variants that have it. It may not end
+  // the record, so it's scanned for like the image name.
   const wchar_t* image_path = NULL;
   size_t image_path_len = 0;
   if (ProcessInfoTypeTraits<ProcessInfoType>::has_command_line &&
-      !reader.ReadString(&image_path, &image_path_len))
+      !decoder.ReadString(&image_path, &image_path_len))
     return false;
 
   process_info->process_id = info->ProcessId;
@@ -306,11 +309,11 @@ bool KernelLogParser::ProcessPageFaultEvent(EVENT_TRACE* event) {
   DWORD process_id = event->Header.ProcessId;
   DWORD thread_id = event->Header.ThreadId;
 
-  BinaryBufferReader reader(event->MofData, event->MofLength);
+  BinaryRecordDecoder decoder(event->MofData, event->MofLength);
   if (event->Header.Class.Type == kHardPageFaultEvent) {
     if (is_64_bit_log()) {
       const HardPageFault64V2* data = NULL;
-      if (!reader.Read(&data)) {
+      if (!decoder.ReadFixed(&data)) {
         LOG(ERROR) << "Short hard fault event";
         return false;
       }
@@ -324,7 +327,7 @@ bool KernelLogParser::ProcessPageFaultEvent(EVENT_TRACE* event) {
           data->VirtualAddress, data->FileObject, data->ByteCount);
     } else {
       const HardPageFault32V2* data = NULL;
-      if (!reader.Read(&data)) {
+      if (!decoder.ReadFixed(&data)) {
         LOG(ERROR) << "Short hard fault event";
         return false;
       }
@@ -360,7 +363,7 @@ bool KernelLogParser::ProcessPageFaultEvent(EVENT_TRACE* event) {
     sym_util::Address program_counter = 0;
     if (is_64_bit_log()) {
       const PageFault64V2* data = NULL;
-      if (!reader.Read(&data)) {
+      if (!decoder.ReadFixed(&data)) {
         LOG(ERROR) << "Short page fault event";
         return false;
       }
@@ -369,7 +372,7 @@ bool KernelLogParser::ProcessPageFaultEvent(EVENT_TRACE* event) {
       program_counter = data->ProgramCounter;
     } else {
       const PageFault32V2* data = NULL;
-      if (!reader.Read(&data)) {
+      if (!decoder.ReadFixed(&data)) {
         LOG(ERROR) << "Short page fault event";
         return false;
       }
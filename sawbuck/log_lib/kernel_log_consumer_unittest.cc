@@ -13,10 +13,13 @@
 // limitations under the License.
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 
+#include <string>
 #include <vector>
 #include <tlhelp32.h>
 #include "base/file_path.h"
+#include "base/logging.h"
 #include "base/path_service.h"
+#include "base/time.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "sawbuck/log_lib/kernel_log_unittest_data.h"
@@ -53,6 +56,94 @@ class MockKernelProcessEvents: public KernelProcessEvents{
                                      ULONG exit_status));
 };
 
+// Counts the events it's handed, for benchmarking the parser alone.
+class CountingKernelEvents
+    : public KernelModuleEvents,
+      public KernelProcessEvents {
+ public:
+  CountingKernelEvents() : num_events_(0) {
+  }
+
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+    ++num_events_;
+  }
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info) {
+    ++num_events_;
+  }
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info) {
+    ++num_events_;
+  }
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info) {
+    ++num_events_;
+  }
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info) {
+    ++num_events_;
+  }
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status) {
+    ++num_events_;
+  }
+
+  size_t num_events() const { return num_events_; }
+
+ private:
+  size_t num_events_;
+};
+
+// Records the events of a log, so that they can be replayed to a parser.
+class RecordingConsumer
+    : public base::win::EtwTraceConsumerBase<RecordingConsumer> {
+ public:
+  RecordingConsumer() {
+    DCHECK(current_ == NULL);
+    current_ = this;
+  }
+  ~RecordingConsumer() {
+    DCHECK(current_ == this);
+    current_ = NULL;
+  }
+
+  static void ProcessEvent(EVENT_TRACE* event) {
+    DCHECK(current_ != NULL);
+    current_->headers_.push_back(event->Header);
+    current_->payloads_.push_back(
+        std::string(reinterpret_cast<const char*>(event->MofData),
+                    event->MofLength));
+  }
+
+  // Replays the recorded events to @p parser.
+  // @returns the number of events parsed.
+  size_t Replay(KernelLogParser* parser) {
+    size_t num_parsed = 0;
+    for (size_t i = 0; i < headers_.size(); ++i) {
+      EVENT_TRACE event = {};
+      event.Header = headers_[i];
+      event.MofData = const_cast<char*>(payloads_[i].data());
+      event.MofLength = payloads_[i].size();
+      if (parser->ProcessOneEvent(&event))
+        ++num_parsed;
+    }
+    return num_parsed;
+  }
+
+ private:
+  static RecordingConsumer* current_;
+
+  std::vector<EVENT_TRACE_HEADER> headers_;
+  std::vector<std::string> payloads_;
+};
+
+RecordingConsumer* RecordingConsumer::current_ = NULL;
+
 class KernelLogConsumerTest: public testing::Test {
  public:
   KernelLogConsumerTest() {
@@ -220,4 +311,40 @@ TEST_F(KernelLogConsumerTest, ProcessEventsLog64Version3) {
   Consume(L"process_data_64_v3.etl");
 }
 
+// Times the parsing of recorded module and process events, apart from the
+// cost of reading them from the logs.
+TEST_F(KernelLogConsumerTest, ParseRecordedEventsBenchmark) {
+  const wchar_t* kLogs[] = {
+    L"image_data_32_v2.etl",
+    L"process_data_32_v3.etl",
+  };
+  RecordingConsumer recorder;
+  for (size_t i = 0; i < arraysize(kLogs); ++i) {
+    FilePath file_path = image_data_dir_.Append(kLogs[i]);
+    ASSERT_HRESULT_SUCCEEDED(
+        recorder.OpenFileSession(file_path.value().c_str()));
+  }
+  ASSERT_HRESULT_SUCCEEDED(recorder.Consume());
+  ASSERT_HRESULT_SUCCEEDED(recorder.Close());
+
+  CountingKernelEvents events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_is_64_bit_log(false);
+  parser.set_module_event_sink(&events);
+  parser.set_process_event_sink(&events);
+
+  const int kIterations = 1000;
+  size_t num_parsed = 0;
+  base::Time start = base::Time::Now();
+  for (int i = 0; i < kIterations; ++i)
+    num_parsed += recorder.Replay(&parser);
+  base::TimeDelta parse_time = base::Time::Now() - start;
+
+  EXPECT_LT(0U, num_parsed);
+  EXPECT_EQ(num_parsed, events.num_events());
+  LOG(INFO) << num_parsed << " events took " << parse_time.InMilliseconds()
+            << " ms to parse.";
+}
+
 }  // namespace
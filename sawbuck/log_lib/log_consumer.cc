@@ -47,7 +47,7 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
   if (log_event_sink_ == NULL)
     return false;
 
-  BinaryBufferReader reader(event->MofData, event->MofLength);
+  BinaryRecordDecoder decoder(event->MofData, event->MofLength);
   LogEvents::LogMessage msg;
 
   msg.time = base::Time::FromFileTime(
@@ -58,7 +58,7 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
 
   if (event->Header.Class.Type == logging::LOG_MESSAGE &&
       event->Header.Class.Version == 0) {
-    if (reader.ReadString(&msg.message, &msg.message_len)) {
+    if (decoder.ReadTrailingString(&msg.message, &msg.message_len)) {
       log_event_sink_->OnLogMessage(msg);
     } else {
       DLOG(ERROR) << "Failed to read message from event";
@@ -73,9 +73,9 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
     // 2. The trace, "depth" in number.
     // 3. The log message as a zero-terminated string.
     const DWORD* depth = NULL;
-    if (reader.Read(&depth) &&
-        reader.Read(*depth * sizeof(void*), &msg.traces) &&
-        reader.ReadString(&msg.message, &msg.message_len)) {
+    if (decoder.ReadFixed(&depth) &&
+        decoder.ReadArray(*depth, &msg.traces) &&
+        decoder.ReadTrailingString(&msg.message, &msg.message_len)) {
       msg.trace_depth = *depth;
       log_event_sink_->OnLogMessage(msg);
     } else {
@@ -94,11 +94,11 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
     // 5. The log message as a zero-terminated string.
     const DWORD* depth = NULL;
     const DWORD* line = NULL;
-    if (reader.Read(&depth) &&
-        reader.Read(*depth * sizeof(void*), &msg.traces) &&
-        reader.Read(&line) &&
-        reader.ReadString(&msg.file, &msg.file_len) &&
-        reader.ReadString(&msg.message, &msg.message_len)) {
+    if (decoder.ReadFixed(&depth) &&
+        decoder.ReadArray(*depth, &msg.traces) &&
+        decoder.ReadFixed(&line) &&
+        decoder.ReadString(&msg.file, &msg.file_len) &&
+        decoder.ReadTrailingString(&msg.message, &msg.message_len)) {
       msg.trace_depth = *depth;
       msg.line = *line;
 
@@ -145,12 +145,12 @@ bool LogParser::ParseTraceEvent(EVENT_TRACE* event) {
   trace.level = event->Header.Class.Level;
   trace.process_id = event->Header.ProcessId;
   trace.thread_id = event->Header.ThreadId;
-  BinaryBufferReader reader(event->MofData, event->MofLength);
+  BinaryRecordDecoder decoder(event->MofData, event->MofLength);
 
-  void* const* id;
-  if (reader.ReadString(&trace.name, &trace.name_len) &&
-      reader.Read(&id),
-      reader.ReadString(&trace.extra, &trace.extra_len)) {
+  void* const* id = NULL;
+  if (decoder.ReadString(&trace.name, &trace.name_len) &&
+      decoder.ReadFixed(&id) &&
+      decoder.ReadTrailingString(&trace.extra, &trace.extra_len)) {
     trace.id = *id;
 
     switch (event->Header.Class.Type) {
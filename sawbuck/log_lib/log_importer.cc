@@ -0,0 +1,624 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log importer implementation.
+#include "sawbuck/log_lib/log_importer.h"
+
+#include <algorithm>
+#include <string>
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/stl_util.h"
+#include "base/threading/thread.h"
+#include "base/threading/thread_local.h"
+
+namespace {
+
+// The number of events issued between progress reports.
+const int kProgressInterval = 4096;
+
+// Decodes an event trace file into a LogDecoder.
+class LogFileConsumer
+    : public base::win::EtwTraceConsumerBase<LogFileConsumer> {
+ public:
+  // Decodes the opened file into @p decoder, on the current thread.
+  void Decode(LogDecoder* decoder);
+
+  // Called by the consumer base for each event of the file.
+  static void ProcessEvent(EVENT_TRACE* event);
+  // Called by the consumer base for each buffer of the file.
+  static bool ProcessBuffer(EVENT_TRACE_LOGFILE* buffer);
+
+ private:
+  // The decoder of the file being decoded on each decoding thread, as the
+  // consumer callbacks carry no context.
+  static base::LazyInstance<base::ThreadLocalPointer<LogDecoder> > current_;
+};
+
+base::LazyInstance<base::ThreadLocalPointer<LogDecoder> >
+    LogFileConsumer::current_ = LAZY_INSTANCE_INITIALIZER;
+
+void LogFileConsumer::Decode(LogDecoder* decoder) {
+  DCHECK(decoder != NULL);
+
+  current_.Get().Set(decoder);
+  HRESULT hr = Consume();
+  current_.Get().Set(NULL);
+
+  Close();
+  decoder->Finish(hr);
+}
+
+void LogFileConsumer::ProcessEvent(EVENT_TRACE* event) {
+  LogDecoder* decoder = current_.Get().Get();
+  DCHECK(decoder != NULL);
+
+  decoder->ProcessEvent(event);
+}
+
+bool LogFileConsumer::ProcessBuffer(EVENT_TRACE_LOGFILE* buffer) {
+  LogDecoder* decoder = current_.Get().Get();
+  DCHECK(decoder != NULL);
+
+  decoder->SetProgress(buffer->BuffersRead,
+                       buffer->LogfileHeader.BuffersWritten);
+  return true;
+}
+
+}  // namespace
+
+// The events of a batch are in the order of their log.
+struct LogDecoder::EventBatch {
+  struct Event {
+    enum Type {
+      LOG_MESSAGE,
+      TRACE_BEGIN,
+      TRACE_END,
+      TRACE_INSTANT,
+      MODULE_IS_LOADED,
+      MODULE_LOAD,
+      MODULE_UNLOAD,
+      PROCESS_IS_RUNNING,
+      PROCESS_STARTED,
+      PROCESS_ENDED,
+    };
+
+    Type type;
+    base::Time time;
+
+    // The fields of log messages and trace events. Their strings are kept in
+    // text, and their stack traces in traces.
+    UCHAR level;
+    DWORD process_id;
+    DWORD thread_id;
+    size_t trace_offset;
+    size_t trace_depth;
+    // The offset of the event's two zero-terminated strings in text. For log
+    // messages these are the file and message, for trace events the name and
+    // extra data.
+    size_t text_offset;
+    size_t first_len;
+    size_t second_len;
+    int line;
+    void* id;
+
+    // The fields of kernel events. The process id above is also used for
+    // module events.
+    // The index of the event's module in modules, or process in processes.
+    size_t info_index;
+    ULONG exit_status;
+  };
+
+  std::vector<Event> events;
+  std::string text;
+  std::vector<void*> traces;
+  std::vector<ModuleInformation> modules;
+  std::vector<KernelProcessEvents::ProcessInfo> processes;
+};
+
+namespace {
+
+typedef LogDecoder::EventBatch::Event Event;
+
+// Initializes an event of @p type at @p time.
+Event* AddEvent(Event::Type type,
+                const base::Time& time,
+                std::vector<Event>* events) {
+  DCHECK(events != NULL);
+
+  Event event = {};
+  event.type = type;
+  event.time = time;
+  events->push_back(event);
+  return &events->back();
+}
+
+}  // namespace
+
+LogDecoder::LogDecoder(size_t batch_size, size_t max_queued_batches)
+    : batch_size_(batch_size),
+      max_queued_batches_(max_queued_batches),
+      current_batch_(new EventBatch()),
+      batch_queued_(&lock_),
+      batch_taken_(&lock_),
+      finished_(false),
+      hr_(S_OK),
+      buffers_read_(0),
+      total_buffers_(0) {
+  DCHECK_LT(0U, batch_size);
+  DCHECK_LT(0U, max_queued_batches);
+
+  LogParser::set_event_sink(this);
+  LogParser::set_trace_sink(this);
+  KernelLogParser::set_module_event_sink(this);
+  KernelLogParser::set_process_event_sink(this);
+}
+
+LogDecoder::~LogDecoder() {
+  STLDeleteElements(&queue_);
+}
+
+void LogDecoder::ProcessEvent(EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+
+  if (!LogParser::ProcessOneEvent(event))
+    KernelLogParser::ProcessOneEvent(event);
+
+  if (current_batch_->events.size() >= batch_size_)
+    QueueBatch();
+}
+
+void LogDecoder::SetProgress(ULONG buffers_read, ULONG total_buffers) {
+  base::AutoLock lock(lock_);
+  buffers_read_ = buffers_read;
+  total_buffers_ = total_buffers;
+}
+
+void LogDecoder::Finish(HRESULT hr) {
+  if (!current_batch_->events.empty())
+    QueueBatch();
+
+  base::AutoLock lock(lock_);
+  DCHECK(!finished_);
+  finished_ = true;
+  hr_ = hr;
+  buffers_read_ = total_buffers_;
+  batch_queued_.Signal();
+}
+
+LogDecoder::EventBatch* LogDecoder::TakeBatch() {
+  base::AutoLock lock(lock_);
+  while (queue_.empty() && !finished_)
+    batch_queued_.Wait();
+
+  if (queue_.empty())
+    return NULL;
+
+  EventBatch* batch = queue_.front();
+  queue_.pop_front();
+  batch_taken_.Signal();
+  return batch;
+}
+
+void LogDecoder::GetProgress(ULONG* buffers_read, ULONG* total_buffers) {
+  DCHECK(buffers_read != NULL);
+  DCHECK(total_buffers != NULL);
+
+  base::AutoLock lock(lock_);
+  *buffers_read = buffers_read_;
+  *total_buffers = total_buffers_;
+}
+
+HRESULT LogDecoder::hr() {
+  base::AutoLock lock(lock_);
+  return hr_;
+}
+
+void LogDecoder::QueueBatch() {
+  scoped_ptr<EventBatch> batch(current_batch_.release());
+  current_batch_.reset(new EventBatch());
+
+  base::AutoLock lock(lock_);
+  while (queue_.size() >= max_queued_batches_)
+    batch_taken_.Wait();
+
+  queue_.push_back(batch.release());
+  batch_queued_.Signal();
+}
+
+void LogDecoder::OnLogMessage(const LogMessage& log_message) {
+  EventBatch* batch = current_batch_.get();
+  Event* event = AddEvent(Event::LOG_MESSAGE, log_message.time,
+                          &batch->events);
+  event->level = log_message.level;
+  event->process_id = log_message.process_id;
+  event->thread_id = log_message.thread_id;
+  event->line = log_message.line;
+
+  event->trace_offset = batch->traces.size();
+  event->trace_depth = log_message.trace_depth;
+  batch->traces.insert(batch->traces.end(),
+                       log_message.traces,
+                       log_message.traces + log_message.trace_depth);
+
+  // Keep the strings zero-terminated, as the parser hands them out.
+  event->text_offset = batch->text.size();
+  event->first_len = log_message.file_len;
+  event->second_len = log_message.message_len;
+  batch->text.append(log_message.file, log_message.file_len);
+  batch->text.push_back('\0');
+  batch->text.append(log_message.message, log_message.message_len);
+  batch->text.push_back('\0');
+}
+
+void LogDecoder::OnTraceEventBegin(const TraceMessage& trace_message) {
+  AddTraceEvent(Event::TRACE_BEGIN, trace_message);
+}
+
+void LogDecoder::OnTraceEventEnd(const TraceMessage& trace_message) {
+  AddTraceEvent(Event::TRACE_END, trace_message);
+}
+
+void LogDecoder::OnTraceEventInstant(const TraceMessage& trace_message) {
+  AddTraceEvent(Event::TRACE_INSTANT, trace_message);
+}
+
+void LogDecoder::OnModuleIsLoaded(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info) {
+  AddModuleEvent(Event::MODULE_IS_LOADED, process_id, time, module_info);
+}
+
+void LogDecoder::OnModuleUnload(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+  AddModuleEvent(Event::MODULE_UNLOAD, process_id, time, module_info);
+}
+
+void LogDecoder::OnModuleLoad(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info) {
+  AddModuleEvent(Event::MODULE_LOAD, process_id, time, module_info);
+}
+
+void LogDecoder::OnProcessIsRunning(const base::Time& time,
+                                    const ProcessInfo& process_info) {
+  AddProcessEvent(Event::PROCESS_IS_RUNNING, time, process_info, 0);
+}
+
+void LogDecoder::OnProcessStarted(const base::Time& time,
+                                  const ProcessInfo& process_info) {
+  AddProcessEvent(Event::PROCESS_STARTED, time, process_info, 0);
+}
+
+void LogDecoder::OnProcessEnded(const base::Time& time,
+                                const ProcessInfo& process_info,
+                                ULONG exit_status) {
+  AddProcessEvent(Event::PROCESS_ENDED, time, process_info, exit_status);
+}
+
+void LogDecoder::AddTraceEvent(int type, const TraceMessage& trace_message) {
+  EventBatch* batch = current_batch_.get();
+  Event* event = AddEvent(static_cast<Event::Type>(type), trace_message.time,
+                          &batch->events);
+  event->level = trace_message.level;
+  event->process_id = trace_message.process_id;
+  event->thread_id = trace_message.thread_id;
+  event->id = trace_message.id;
+
+  event->trace_offset = batch->traces.size();
+  event->trace_depth = trace_message.trace_depth;
+  batch->traces.insert(batch->traces.end(),
+                       trace_message.traces,
+                       trace_message.traces + trace_message.trace_depth);
+
+  event->text_offset = batch->text.size();
+  event->first_len = trace_message.name_len;
+  event->second_len = trace_message.extra_len;
+  batch->text.append(trace_message.name, trace_message.name_len);
+  batch->text.push_back('\0');
+  batch->text.append(trace_message.extra, trace_message.extra_len);
+  batch->text.push_back('\0');
+}
+
+void LogDecoder::AddModuleEvent(int type,
+                                DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+  EventBatch* batch = current_batch_.get();
+  Event* event = AddEvent(static_cast<Event::Type>(type), time,
+                          &batch->events);
+  event->process_id = process_id;
+  event->info_index = batch->modules.size();
+  batch->modules.push_back(module_info);
+}
+
+void LogDecoder::AddProcessEvent(int type,
+                                 const base::Time& time,
+                                 const ProcessInfo& process_info,
+                                 ULONG exit_status) {
+  EventBatch* batch = current_batch_.get();
+  Event* event = AddEvent(static_cast<Event::Type>(type), time,
+                          &batch->events);
+  event->exit_status = exit_status;
+  event->info_index = batch->processes.size();
+  batch->processes.push_back(process_info);
+}
+
+LogImporter::LogImporter()
+    : log_event_sink_(NULL),
+      trace_event_sink_(NULL),
+      module_event_sink_(NULL),
+      process_event_sink_(NULL),
+      issued_events_(0),
+      infer_bitness_from_log_(true),
+      is_64_bit_log_(false) {
+}
+
+LogImporter::~LogImporter() {
+}
+
+HRESULT LogImporter::Import(const std::vector<FilePath>& paths) {
+  failed_path_.clear();
+
+  // Open all the files up front, so that a missing file fails the import
+  // before any work is done.
+  ScopedVector<LogFileConsumer> consumers;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    LogFileConsumer* consumer = new LogFileConsumer();
+    consumers.push_back(consumer);
+
+    HRESULT hr = consumer->OpenFileSession(paths[i].value().c_str());
+    if (FAILED(hr)) {
+      failed_path_ = paths[i];
+      return hr;
+    }
+  }
+
+  // Decode each file on a thread of its own. The merge needs the next event
+  // of every file, so a file can't wait for another one to be decoded.
+  ScopedVector<LogDecoder> decoders;
+  ScopedVector<base::Thread> threads;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    LogDecoder* decoder = new LogDecoder(LogDecoder::kDefaultBatchSize,
+                                         LogDecoder::kDefaultMaxQueuedBatches);
+    decoders.push_back(decoder);
+    decoder->set_infer_bitness_from_log(infer_bitness_from_log_);
+    decoder->set_is_64_bit_log(is_64_bit_log_);
+
+    base::Thread* thread = new base::Thread("Log Decoding Worker");
+    threads.push_back(thread);
+    CHECK(thread->Start());
+    thread->message_loop()->PostTask(FROM_HERE,
+        base::Bind(&LogFileConsumer::Decode,
+                   base::Unretained(consumers[i]),
+                   base::Unretained(decoder)));
+  }
+
+  HRESULT hr = IssueEvents(decoders.get());
+
+  // All the files have been decoded by now, so this doesn't wait on them.
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Stop();
+
+  if (FAILED(hr)) {
+    for (size_t i = 0; i < decoders.size(); ++i) {
+      if (FAILED(decoders[i]->hr())) {
+        failed_path_ = paths[i];
+        break;
+      }
+    }
+  }
+
+  return hr;
+}
+
+namespace {
+
+// The next event of a decoder in the merge.
+struct Cursor {
+  LogDecoder::EventBatch* batch;
+  size_t next;
+  size_t decoder;
+};
+
+// Orders cursors so that the top of the heap is the earliest event. Ties go
+// to the first decoder.
+struct LaterCursor {
+  bool operator()(const Cursor& a, const Cursor& b) const {
+    const base::Time& a_time = a.batch->events[a.next].time;
+    const base::Time& b_time = b.batch->events[b.next].time;
+    if (a_time != b_time)
+      return a_time > b_time;
+    return a.decoder > b.decoder;
+  }
+};
+
+}  // namespace
+
+HRESULT LogImporter::IssueEvents(const std::vector<LogDecoder*>& decoders) {
+  issued_events_ = 0;
+
+  // Start with the first batch of each decoder. The events of each log are
+  // in time order, which is how event tracing delivers the events of a file.
+  std::vector<Cursor> heap;
+  for (size_t i = 0; i < decoders.size(); ++i) {
+    Cursor cursor = { decoders[i]->TakeBatch(), 0, i };
+    if (cursor.batch != NULL)
+      heap.push_back(cursor);
+  }
+  std::make_heap(heap.begin(), heap.end(), LaterCursor());
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), LaterCursor());
+    Cursor& cursor = heap.back();
+    IssueEvent(*cursor.batch, cursor.next);
+
+    // Move on to the next batch of the decoder once done with this one,
+    // waiting for it if need be.
+    if (++cursor.next == cursor.batch->events.size()) {
+      delete cursor.batch;
+      cursor.batch = decoders[cursor.decoder]->TakeBatch();
+      cursor.next = 0;
+    }
+    if (cursor.batch != NULL)
+      std::push_heap(heap.begin(), heap.end(), LaterCursor());
+    else
+      heap.pop_back();
+
+    if (++issued_events_ % kProgressInterval == 0)
+      ReportProgress(decoders);
+  }
+
+  ReportProgress(decoders);
+
+  for (size_t i = 0; i < decoders.size(); ++i) {
+    HRESULT hr = decoders[i]->hr();
+    if (FAILED(hr))
+      return hr;
+  }
+
+  return S_OK;
+}
+
+void LogImporter::IssueEvent(const LogDecoder::EventBatch& batch,
+                             size_t index) {
+  const Event& event = batch.events[index];
+  switch (event.type) {
+    case Event::LOG_MESSAGE:
+    case Event::TRACE_BEGIN:
+    case Event::TRACE_END:
+    case Event::TRACE_INSTANT:
+      break;
+
+    case Event::MODULE_IS_LOADED:
+    case Event::MODULE_LOAD:
+    case Event::MODULE_UNLOAD: {
+      if (module_event_sink_ == NULL)
+        return;
+
+      const KernelModuleEvents::ModuleInformation& module_info =
+          batch.modules[event.info_index];
+      if (event.type == Event::MODULE_IS_LOADED) {
+        module_event_sink_->OnModuleIsLoaded(event.process_id, event.time,
+                                             module_info);
+      } else if (event.type == Event::MODULE_LOAD) {
+        module_event_sink_->OnModuleLoad(event.process_id, event.time,
+                                         module_info);
+      } else {
+        module_event_sink_->OnModuleUnload(event.process_id, event.time,
+                                           module_info);
+      }
+      return;
+    }
+
+    case Event::PROCESS_IS_RUNNING:
+    case Event::PROCESS_STARTED:
+    case Event::PROCESS_ENDED: {
+      if (process_event_sink_ == NULL)
+        return;
+
+      const KernelProcessEvents::ProcessInfo& process_info =
+          batch.processes[event.info_index];
+      if (event.type == Event::PROCESS_IS_RUNNING) {
+        process_event_sink_->OnProcessIsRunning(event.time, process_info);
+      } else if (event.type == Event::PROCESS_STARTED) {
+        process_event_sink_->OnProcessStarted(event.time, process_info);
+      } else {
+        process_event_sink_->OnProcessEnded(event.time, process_info,
+                                            event.exit_status);
+      }
+      return;
+    }
+
+    default:
+      NOTREACHED();
+      return;
+  }
+
+  const char* first = batch.text.data() + event.text_offset;
+  const char* second = first + event.first_len + 1;
+  void* const* traces =
+      event.trace_depth == 0 ? NULL : &batch.traces[event.trace_offset];
+
+  if (event.type == Event::LOG_MESSAGE) {
+    if (log_event_sink_ == NULL)
+      return;
+
+    LogEvents::LogMessage msg;
+    msg.time = event.time;
+    msg.level = event.level;
+    msg.process_id = event.process_id;
+    msg.thread_id = event.thread_id;
+    msg.trace_depth = event.trace_depth;
+    msg.traces = traces;
+    if (event.first_len != 0) {
+      msg.file = first;
+      msg.file_len = event.first_len;
+      msg.line = event.line;
+    }
+    msg.message = second;
+    msg.message_len = event.second_len;
+
+    log_event_sink_->OnLogMessage(msg);
+    return;
+  }
+
+  if (trace_event_sink_ == NULL)
+    return;
+
+  TraceEvents::TraceMessage trace;
+  trace.time = event.time;
+  trace.level = event.level;
+  trace.process_id = event.process_id;
+  trace.thread_id = event.thread_id;
+  trace.trace_depth = event.trace_depth;
+  trace.traces = traces;
+  trace.name = first;
+  trace.name_len = event.first_len;
+  trace.extra = second;
+  trace.extra_len = event.second_len;
+  trace.id = event.id;
+
+  if (event.type == Event::TRACE_BEGIN)
+    trace_event_sink_->OnTraceEventBegin(trace);
+  else if (event.type == Event::TRACE_END)
+    trace_event_sink_->OnTraceEventEnd(trace);
+  else
+    trace_event_sink_->OnTraceEventInstant(trace);
+}
+
+void LogImporter::ReportProgress(const std::vector<LogDecoder*>& decoders) {
+  if (progress_callback_.is_null())
+    return;
+
+  // Weigh the files by their number of buffers.
+  uint64 buffers_read = 0;
+  uint64 total_buffers = 0;
+  for (size_t i = 0; i < decoders.size(); ++i) {
+    ULONG read = 0;
+    ULONG total = 0;
+    decoders[i]->GetProgress(&read, &total);
+    buffers_read += read;
+    total_buffers += total;
+  }
+
+  int percent_decoded = 100;
+  if (total_buffers != 0)
+    percent_decoded = static_cast<int>(buffers_read * 100 / total_buffers);
+
+  progress_callback_.Run(percent_decoded, issued_events_);
+}
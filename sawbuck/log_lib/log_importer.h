@@ -0,0 +1,233 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log importer declaration.
+#ifndef SAWBUCK_LOG_LIB_LOG_IMPORTER_H_
+#define SAWBUCK_LOG_LIB_LOG_IMPORTER_H_
+
+#include <deque>
+#include <vector>
+#include "base/callback.h"
+#include "base/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Decodes the events of a log, and queues them in batches for a LogImporter
+// to merge with the events of other logs. The events are fed in on a decoding
+// thread, while the importer takes the batches on the importing thread. The
+// queue is bounded, so the decoding thread waits whenever it gets ahead of
+// the importer.
+class LogDecoder
+    : public LogParser,
+      public KernelLogParser,
+      public LogEvents,
+      public TraceEvents,
+      public KernelModuleEvents,
+      public KernelProcessEvents {
+ public:
+  // The defaults for the constructor arguments.
+  static const size_t kDefaultBatchSize = 1024;
+  static const size_t kDefaultMaxQueuedBatches = 16;
+
+  // @param batch_size the number of events in each queued batch.
+  // @param max_queued_batches the number of batches that can be queued
+  //     before the decoding thread waits for the importer.
+  LogDecoder(size_t batch_size, size_t max_queued_batches);
+  ~LogDecoder();
+
+  // @name Called on the decoding thread.
+  // @{
+  // Decodes @p event, and queues it if it's a log, trace, module or process
+  // event. This waits while the queue is full.
+  void ProcessEvent(EVENT_TRACE* event);
+
+  // Records the progress of decoding.
+  // @param buffers_read the number of buffers of the log decoded so far.
+  // @param total_buffers the number of buffers in the log.
+  void SetProgress(ULONG buffers_read, ULONG total_buffers);
+
+  // Queues the last events, and marks the end of the log.
+  // @param hr the result of decoding the log.
+  void Finish(HRESULT hr);
+  // @}
+
+  // A batch of decoded events, opaque to all but the importer.
+  struct EventBatch;
+
+ private:
+  friend class LogImporter;
+
+  // @name Called on the importing thread.
+  // @{
+  // Takes the next batch of events, waiting for it to be decoded.
+  // @returns the batch, which the caller then owns, or NULL at the end of
+  //     the log.
+  EventBatch* TakeBatch();
+
+  // Gets the progress of decoding, as set by SetProgress.
+  void GetProgress(ULONG* buffers_read, ULONG* total_buffers);
+
+  // @returns the result of decoding the log, once TakeBatch has returned
+  //     NULL.
+  HRESULT hr();
+  // @}
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+  // @name Add an event of type @p type to the current batch.
+  // @{
+  void AddTraceEvent(int type, const TraceMessage& trace_message);
+  void AddModuleEvent(int type,
+                      DWORD process_id,
+                      const base::Time& time,
+                      const ModuleInformation& module_info);
+  void AddProcessEvent(int type,
+                       const base::Time& time,
+                       const ProcessInfo& process_info,
+                       ULONG exit_status);
+  // @}
+
+  // Queues the current batch, waiting while the queue is full.
+  void QueueBatch();
+
+  const size_t batch_size_;
+  const size_t max_queued_batches_;
+
+  // The batch being filled on the decoding thread.
+  scoped_ptr<EventBatch> current_batch_;
+
+  base::Lock lock_;
+  // Signaled when a batch is queued, or the log is finished.
+  base::ConditionVariable batch_queued_;  // Under lock_.
+  // Signaled when a batch is taken.
+  base::ConditionVariable batch_taken_;  // Under lock_.
+  std::deque<EventBatch*> queue_;  // Under lock_.
+  bool finished_;  // Under lock_.
+  HRESULT hr_;  // Under lock_.
+  ULONG buffers_read_;  // Under lock_.
+  ULONG total_buffers_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(LogDecoder);
+};
+
+// Imports a set of event trace files. Each file is decoded on a thread of its
+// own, while the importing thread merges the decoded events of all files by
+// time, and issues them to the event sinks as they come.
+class LogImporter {
+ public:
+  // Invoked on the importing thread as the events are issued, with the
+  // percentage of the files decoded so far and the number of events issued.
+  typedef base::Callback<void(int percent_decoded, int issued_events)>
+      ProgressCallback;
+
+  LogImporter();
+  ~LogImporter();
+
+  void set_event_sink(LogEvents* log_event_sink) {
+    log_event_sink_ = log_event_sink;
+  }
+  void set_trace_sink(TraceEvents* trace_event_sink) {
+    trace_event_sink_ = trace_event_sink;
+  }
+  void set_module_event_sink(KernelModuleEvents* module_event_sink) {
+    module_event_sink_ = module_event_sink;
+  }
+  void set_process_event_sink(KernelProcessEvents* process_event_sink) {
+    process_event_sink_ = process_event_sink;
+  }
+  void set_progress_callback(const ProgressCallback& progress_callback) {
+    progress_callback_ = progress_callback;
+  }
+
+  // @name Passed on to the kernel log parser of each file.
+  // @{
+  void set_infer_bitness_from_log(bool infer_bitness_from_log) {
+    infer_bitness_from_log_ = infer_bitness_from_log;
+  }
+  void set_is_64_bit_log(bool is_64_bit_log) {
+    is_64_bit_log_ = is_64_bit_log;
+  }
+  // @}
+
+  // Imports the event trace files at @p paths.
+  // @returns S_OK on success. If a file fails to open, returns its error
+  //     without issuing any events. If a file fails to decode, returns its
+  //     error after issuing the events decoded from all files.
+  HRESULT Import(const std::vector<FilePath>& paths);
+
+  // Issues the events of @p decoders, merged by time, as they're decoded on
+  // other threads. Import does this with a decoder for each file.
+  // @param decoders the decoders, each of which must be fed to its Finish on
+  //     its decoding thread.
+  // @returns S_OK on success, or the error of the first decoder to fail.
+  HRESULT IssueEvents(const std::vector<LogDecoder*>& decoders);
+
+  // @returns the path of the file that failed to import, if any.
+  const FilePath& failed_path() const { return failed_path_; }
+
+ private:
+  // Issues an event of @p batch to the sinks, if we have a sink for it.
+  void IssueEvent(const LogDecoder::EventBatch& batch, size_t index);
+
+  // Reports progress to the progress callback.
+  void ReportProgress(const std::vector<LogDecoder*>& decoders);
+
+  // Our event sinks.
+  LogEvents* log_event_sink_;
+  TraceEvents* trace_event_sink_;
+  KernelModuleEvents* module_event_sink_;
+  KernelProcessEvents* process_event_sink_;
+
+  ProgressCallback progress_callback_;
+  // The number of events issued by the current import.
+  int issued_events_;
+
+  bool infer_bitness_from_log_;
+  bool is_64_bit_log_;
+
+  FilePath failed_path_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogImporter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_LOG_IMPORTER_H_
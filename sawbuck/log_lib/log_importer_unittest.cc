@@ -0,0 +1,314 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log importer unittests.
+#include "sawbuck/log_lib/log_importer.h"
+
+#include <string>
+#include <vector>
+#include "base/bind.h"
+#include "base/file_path.h"
+#include "base/logging_win.h"
+#include "base/path_service.h"
+#include "base/debug/trace_event_win.h"
+#include "base/memory/scoped_vector.h"
+#include "base/threading/thread.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/kernel_log_unittest_data.h"
+
+namespace {
+
+class EventTrace: public EVENT_TRACE {
+ public:
+  EventTrace(const GUID& provider_name, UCHAR type, const base::Time& time,
+      size_t data_len, const void* data) {
+    memset(this, 0, sizeof(*this));
+
+    Header.Size = sizeof(*this);
+    Header.Class.Type = type;
+    Header.Class.Level = TRACE_LEVEL_INFORMATION;
+    Header.ThreadId = ::GetCurrentThreadId();
+    Header.ProcessId = ::GetCurrentProcessId();
+    reinterpret_cast<FILETIME&>(Header.TimeStamp) = time.ToFileTime();
+    Header.Guid = provider_name;
+    MofData = const_cast<void*>(data);
+    MofLength = data_len;
+  }
+};
+
+// Records the log messages and trace events it's handed, in order.
+class RecordingEvents : public LogEvents, public TraceEvents {
+ public:
+  virtual void OnLogMessage(const LogMessage& log_message) {
+    Record(log_message.time, std::string(log_message.message,
+                                         log_message.message_len));
+  }
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message) {
+    Record(trace_message.time, "begin " + TraceText(trace_message));
+  }
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message) {
+    Record(trace_message.time, "end " + TraceText(trace_message));
+  }
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message) {
+    Record(trace_message.time, "instant " + TraceText(trace_message));
+  }
+
+  std::vector<base::Time> times_;
+  std::vector<std::string> texts_;
+
+ private:
+  static std::string TraceText(const TraceMessage& trace_message) {
+    return std::string(trace_message.name, trace_message.name_len) + " " +
+        std::string(trace_message.extra, trace_message.extra_len);
+  }
+
+  void Record(const base::Time& time, const std::string& text) {
+    times_.push_back(time);
+    texts_.push_back(text);
+  }
+};
+
+// Feeds @p events to @p decoder, then finishes it with @p hr.
+void FeedEvents(LogDecoder* decoder,
+                const std::vector<EventTrace>* events,
+                HRESULT hr) {
+  for (size_t i = 0; i < events->size(); ++i) {
+    EVENT_TRACE event = (*events)[i];
+    decoder->ProcessEvent(&event);
+  }
+  decoder->Finish(hr);
+}
+
+// Records the times of the kernel events it's handed.
+class TimeRecordingKernelEvents
+    : public KernelModuleEvents,
+      public KernelProcessEvents {
+ public:
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+    module_times_.push_back(time);
+  }
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info) {
+    module_times_.push_back(time);
+  }
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info) {
+    module_times_.push_back(time);
+  }
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info) {
+    process_times_.push_back(time);
+  }
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info) {
+    process_times_.push_back(time);
+  }
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status) {
+    process_times_.push_back(time);
+  }
+
+  std::vector<base::Time> module_times_;
+  std::vector<base::Time> process_times_;
+};
+
+class LogImporterTest: public testing::Test {
+ public:
+  LogImporterTest() : percent_decoded_(0), issued_events_(0) {
+  }
+
+  virtual void SetUp() {
+    FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    test_data_dir_ = src_root.AppendASCII("sawbuck\\log_lib\\test_data");
+
+    // We don't want to sniff the artificially created test logs for their
+    // bitness, as that restricts where we can create those logs.
+    importer_.set_infer_bitness_from_log(false);
+    importer_.set_is_64_bit_log(false);
+    importer_.set_module_event_sink(&events_);
+    importer_.set_process_event_sink(&events_);
+    importer_.set_progress_callback(
+        base::Bind(&LogImporterTest::OnProgress, base::Unretained(this)));
+  }
+
+  void OnProgress(int percent_decoded, int issued_events) {
+    // The decoded percentage can drop as the sizes of the files come in.
+    EXPECT_LE(0, percent_decoded);
+    EXPECT_GE(100, percent_decoded);
+    EXPECT_LE(issued_events_, issued_events);
+    percent_decoded_ = percent_decoded;
+    issued_events_ = issued_events;
+  }
+
+  // Issues the events of @p logs through decoders that are fed on threads of
+  // their own, with batches small enough that the decoders wait on the
+  // importer.
+  // @param hrs the result to finish each decoder with.
+  HRESULT IssueEvents(const std::vector<std::vector<EventTrace> >& logs,
+                      const std::vector<HRESULT>& hrs) {
+    ScopedVector<LogDecoder> decoders;
+    ScopedVector<base::Thread> threads;
+    for (size_t i = 0; i < logs.size(); ++i) {
+      LogDecoder* decoder = new LogDecoder(2, 1);
+      decoders.push_back(decoder);
+
+      base::Thread* thread = new base::Thread("Log Decoding Test");
+      threads.push_back(thread);
+      EXPECT_TRUE(thread->Start());
+      thread->message_loop()->PostTask(FROM_HERE,
+          base::Bind(&FeedEvents, base::Unretained(decoder), &logs[i],
+                     hrs[i]));
+    }
+
+    HRESULT hr = importer_.IssueEvents(decoders.get());
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i]->Stop();
+
+    return hr;
+  }
+
+  static bool IsSorted(const std::vector<base::Time>& times) {
+    for (size_t i = 1; i < times.size(); ++i) {
+      if (times[i] < times[i - 1])
+        return false;
+    }
+    return true;
+  }
+
+ protected:
+  LogImporter importer_;
+  TimeRecordingKernelEvents events_;
+  FilePath test_data_dir_;
+  int percent_decoded_;
+  int issued_events_;
+};
+
+}  // namespace
+
+TEST_F(LogImporterTest, ImportsModuleEvents) {
+  std::vector<FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+  ASSERT_HRESULT_SUCCEEDED(importer_.Import(paths));
+
+  // The logs hold the loaded modules, then an unload and a load.
+  EXPECT_EQ(testing::kNumModules + 2, events_.module_times_.size());
+  EXPECT_TRUE(events_.process_times_.empty());
+  EXPECT_TRUE(IsSorted(events_.module_times_));
+
+  EXPECT_EQ(static_cast<int>(events_.module_times_.size()), issued_events_);
+  EXPECT_EQ(100, percent_decoded_);
+}
+
+TEST_F(LogImporterTest, MergesLogs) {
+  std::vector<FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+  paths.push_back(test_data_dir_.Append(L"process_data_32_v3.etl"));
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v1.etl"));
+  ASSERT_HRESULT_SUCCEEDED(importer_.Import(paths));
+
+  // The processes running, then a start and an end.
+  EXPECT_EQ(testing::kNumProcesses + 1, events_.process_times_.size());
+  EXPECT_EQ(2 * (testing::kNumModules + 2), events_.module_times_.size());
+  EXPECT_TRUE(IsSorted(events_.module_times_));
+  EXPECT_TRUE(IsSorted(events_.process_times_));
+
+  EXPECT_EQ(static_cast<int>(events_.module_times_.size() +
+                             events_.process_times_.size()),
+            issued_events_);
+  EXPECT_EQ(100, percent_decoded_);
+}
+
+TEST_F(LogImporterTest, FailsOnMissingFile) {
+  std::vector<FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+  paths.push_back(test_data_dir_.Append(L"nonexistent.etl"));
+  EXPECT_HRESULT_FAILED(importer_.Import(paths));
+  EXPECT_EQ(paths[1].value(), importer_.failed_path().value());
+
+  // Nothing is issued when a file fails to open.
+  EXPECT_TRUE(events_.module_times_.empty());
+  EXPECT_EQ(0, issued_events_);
+}
+
+char kMsgText[] = "Nothing to see here, please move on";
+
+TEST_F(LogImporterTest, MergesLogAndTraceEvents) {
+  RecordingEvents events;
+  importer_.set_event_sink(&events);
+  importer_.set_trace_sink(&events);
+
+  // A trace event is its name, its id and its extra data.
+  std::string trace_data("Trace", sizeof("Trace"));
+  void* id = &events;
+  trace_data.append(reinterpret_cast<const char*>(&id), sizeof(id));
+  trace_data.append("Extra", sizeof("Extra"));
+
+  // Interleave log messages in one log with trace events in the other, with
+  // more events than fit in the decoders' queues.
+  const size_t kNumEvents = 10;
+  const base::Time start = base::Time::Now();
+  std::vector<std::vector<EventTrace> > logs(2);
+  const UCHAR kTraceTypes[] = { base::debug::kTraceEventTypeBegin,
+                                base::debug::kTraceEventTypeInstant,
+                                base::debug::kTraceEventTypeEnd };
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    base::Time time = start + base::TimeDelta::FromMilliseconds(2 * i);
+    logs[0].push_back(EventTrace(logging::kLogEventId, logging::LOG_MESSAGE,
+                                 time, sizeof(kMsgText), kMsgText));
+    logs[1].push_back(EventTrace(base::debug::kTraceEventClass32,
+                                 kTraceTypes[i % arraysize(kTraceTypes)],
+                                 time + base::TimeDelta::FromMilliseconds(1),
+                                 trace_data.size(), trace_data.data()));
+  }
+
+  std::vector<HRESULT> hrs(2, S_OK);
+  ASSERT_HRESULT_SUCCEEDED(IssueEvents(logs, hrs));
+
+  ASSERT_EQ(2 * kNumEvents, events.texts_.size());
+  EXPECT_TRUE(IsSorted(events.times_));
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    EXPECT_EQ(kMsgText, events.texts_[2 * i]);
+  }
+  EXPECT_EQ("begin Trace Extra", events.texts_[1]);
+  EXPECT_EQ("instant Trace Extra", events.texts_[3]);
+  EXPECT_EQ("end Trace Extra", events.texts_[5]);
+
+  EXPECT_EQ(static_cast<int>(2 * kNumEvents), issued_events_);
+  EXPECT_EQ(100, percent_decoded_);
+}
+
+TEST_F(LogImporterTest, IssueEventsReturnsDecodingError) {
+  RecordingEvents events;
+  importer_.set_event_sink(&events);
+
+  const base::Time start = base::Time::Now();
+  std::vector<std::vector<EventTrace> > logs(2);
+  for (size_t i = 0; i < logs.size(); ++i) {
+    logs[i].push_back(EventTrace(logging::kLogEventId, logging::LOG_MESSAGE,
+                                 start, sizeof(kMsgText), kMsgText));
+  }
+
+  // The events decoded before the failure are still issued.
+  std::vector<HRESULT> hrs;
+  hrs.push_back(S_OK);
+  hrs.push_back(E_FAIL);
+  EXPECT_EQ(E_FAIL, IssueEvents(logs, hrs));
+  EXPECT_EQ(2U, events.texts_.size());
+}
@@ -31,6 +31,8 @@
         'kernel_log_consumer.h',
         'log_consumer.cc',
         'log_consumer.h',
+        'log_importer.cc',
+        'log_importer.h',
         'process_info_service.cc',
         'process_info_service.h',
         'symbol_lookup_service.cc',
@@ -68,6 +70,7 @@
       'sources': [
         'kernel_log_consumer_unittest.cc',
         'log_consumer_unittest.cc',
+        'log_importer_unittest.cc',
         'log_lib_unittest_main.cc',
         'process_info_service_unittest.cc',
         'symbol_lookup_service_unittest.cc',
@@ -19,16 +19,29 @@
 
 #include "base/bind.h"
 #include "base/message_loop.h"
+#include "base/stl_util.h"
 
-SymbolLookupService::SymbolLookupService() : background_thread_(NULL),
-    foreground_thread_(MessageLoop::current()), next_request_id_(0),
-    unprocessed_id_(0) {
+SymbolLookupService::SymbolLookupService()
+    : next_request_id_(0), symbol_cache_file_(NULL),
+      foreground_thread_(MessageLoop::current()) {
 }
 
 SymbolLookupService::~SymbolLookupService() {
   // Make sure there aren't any tasks pending for this object.
-  DCHECK(resolve_task_.is_null());
+  for (size_t i = 0; i < workers_.size(); ++i)
+    DCHECK(workers_[i]->resolve_task.is_null());
   DCHECK(callback_task_.is_null());
+
+  STLDeleteElements(&workers_);
+}
+
+void SymbolLookupService::AddWorkerThread(MessageLoop* worker_thread) {
+  DCHECK(worker_thread != NULL);
+  DCHECK(requests_.empty());
+
+  Worker* worker = new Worker();
+  worker->thread = worker_thread;
+  workers_.push_back(worker);
 }
 
 SymbolLookupService::Handle SymbolLookupService::ResolveAddress(
@@ -36,6 +49,13 @@ SymbolLookupService::Handle SymbolLookupService::ResolveAddress(
     sym_util::Address address, const SymbolResolvedCallback& callback) {
   DCHECK_EQ(foreground_thread_, MessageLoop::current());
   DCHECK(!callback.is_null());
+  DCHECK(!workers_.empty());
+
+  ModuleLoadStateId id;
+  {
+    base::AutoLock lock(module_lock_);
+    id = module_cache_.GetStateId(process_id, time);
+  }
 
   base::AutoLock lock(resolution_lock_);
   Handle request_id = next_request_id_++;
@@ -46,32 +66,65 @@ SymbolLookupService::Handle SymbolLookupService::ResolveAddress(
   request.address_ = address;
   request.callback_ = callback;
 
+  // Shard the lookup on the module load state, so that each of the symbol
+  // caches for that state lives on a single worker. New load states go to
+  // the workers in turn.
+  std::pair<WorkerMap::iterator, bool> state_worker(
+      state_workers_.insert(std::make_pair(id, static_cast<Worker*>(NULL))));
+  if (state_worker.second) {
+    state_worker.first->second =
+        workers_[(state_workers_.size() - 1) % workers_.size()];
+  }
+  Worker* worker = state_worker.first->second;
+
+  // Join any pending lookup for the same address, or queue a new one.
+  LookupKey key(id, address);
+  HandleVector& handles = worker->lookups[key];
+  if (handles.empty())
+    worker->queue.push_back(key);
+  handles.push_back(request_id);
+
   // Post a task to do the symbol resolution unless one is already pending,
   // or currently executing. The task will NULL this field as it exits
   // on an empty queue.
-  if (resolve_task_.is_null()) {
-    resolve_task_ = base::Bind(&SymbolLookupService::ResolveCallback,
-                               base::Unretained(this));
-    background_thread_->PostTask(FROM_HERE, resolve_task_);
+  if (worker->resolve_task.is_null()) {
+    worker->resolve_task = base::Bind(&SymbolLookupService::ResolveCallback,
+                                      base::Unretained(this),
+                                      worker);
+    worker->thread->PostTask(FROM_HERE, worker->resolve_task);
   }
 
   return request_id;
 }
 
+void SymbolLookupService::GetNumLookups(std::vector<size_t>* num_lookups) {
+  DCHECK(num_lookups != NULL);
+
+  base::AutoLock lock(resolution_lock_);
+  num_lookups->clear();
+  for (size_t i = 0; i < workers_.size(); ++i)
+    num_lookups->push_back(workers_[i]->num_lookups);
+}
+
 void SymbolLookupService::CancelRequest(Handle request_handle) {
   DCHECK_EQ(foreground_thread_, MessageLoop::current());
   base::AutoLock lock(resolution_lock_);
 
+  // The lookup the request is waiting on is left alone, the worker skips
+  // it if no request is left waiting on it.
   RequestMap::iterator it = requests_.find(request_handle);
   DCHECK(it != requests_.end());
   requests_.erase(it);
 }
 
 void SymbolLookupService::SetSymbolPath(const wchar_t* symbol_path) {
-  background_thread_->PostTask(FROM_HERE,
-      base::Bind(&SymbolLookupService::SetSymbolPathCallback,
-                 base::Unretained(this),
-                 symbol_path));
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->thread->PostTask(FROM_HERE,
+        base::Bind(&SymbolLookupService::SetSymbolPathCallback,
+                   base::Unretained(this),
+                   workers_[i],
+                   std::wstring(symbol_path)));
+  }
 }
 
 void SymbolLookupService::OnModuleIsLoaded(
@@ -123,62 +176,72 @@ void SymbolLookupService::OnModuleLoad(
   module_cache_.ModuleLoaded(process_id, time, module_info);
 }
 
-bool SymbolLookupService::ResolveAddressImpl(sym_util::ProcessId pid,
+bool SymbolLookupService::ResolveAddressImpl(Worker* worker,
+                                             ModuleLoadStateId id,
+                                             sym_util::ProcessId pid,
                                              const base::Time& time,
                                              sym_util::Address address,
                                              sym_util::Symbol* symbol) {
-  DCHECK_EQ(background_thread_, MessageLoop::current());
-  using sym_util::ModuleCache;
+  DCHECK_EQ(worker->thread, MessageLoop::current());
   using sym_util::SymbolCache;
 
-  ModuleCache::ModuleLoadStateId id;
-  SymbolCacheMap::iterator it;
-
-  {
-    // Hold the module lock only while accessing the module cache.
-    base::AutoLock lock(module_lock_);
-
-    id = module_cache_.GetStateId(pid, time);
-    it = symbol_caches_.find(id);
-    if (it == symbol_caches_.end()) {
-      // We have a miss, initialize a cache for this module id.
-      if (symbol_caches_.size() == kMaxCacheSize) {
-        // Evict the least recently used element.
-        ModuleCache::ModuleLoadStateId to_evict = lru_module_id_.front();
-        lru_module_id_.erase(lru_module_id_.begin());
-        symbol_caches_.erase(to_evict);
-      }
+  SymbolCacheMap::iterator it = worker->symbol_caches.find(id);
+  if (it == worker->symbol_caches.end()) {
+    // We have a miss, initialize a cache for this module id.
+    if (worker->symbol_caches.size() == kMaxCacheSize) {
+      // Evict the least recently used element.
+      ModuleLoadStateId to_evict = worker->lru_module_id.front();
+      worker->lru_module_id.erase(worker->lru_module_id.begin());
+      worker->symbol_caches.erase(to_evict);
+    }
 
-      std::pair<SymbolCacheMap::iterator, bool> inserted =
-          symbol_caches_.insert(std::make_pair(id, SymbolCache()));
+    std::pair<SymbolCacheMap::iterator, bool> inserted =
+        worker->symbol_caches.insert(std::make_pair(id, SymbolCache()));
 
-      DCHECK_EQ(inserted.second, true);
-      SymbolCache& cache = inserted.first->second;
-      cache.set_status_callback(status_callback_);
+    DCHECK_EQ(inserted.second, true);
+    SymbolCache& cache = inserted.first->second;
+    cache.set_status_callback(status_callback_);
+    cache.set_symbol_cache_file(symbol_cache_file_);
 
-      std::vector<ModuleInformation> modules;
+    std::vector<ModuleInformation> modules;
+    {
+      // Hold the module lock only while accessing the module cache.
+      base::AutoLock lock(module_lock_);
       module_cache_.GetProcessModuleState(pid, time, &modules);
-      cache.SetSymbolPath(symbol_path_.c_str());
-      cache.Initialize(modules.size(), modules.size() ? &modules[0] : NULL);
-
-      it = inserted.first;
-    } else {
-      // We have a hit, manage the LRU by removing our ID.
-      // It will be pushed to the back of the LRU just below.
-      lru_module_id_.erase(
-          std::find(lru_module_id_.begin(), lru_module_id_.end(), id));
     }
+    cache.SetSymbolPath(worker->symbol_path.c_str());
+    cache.Initialize(modules.size(), modules.size() ? &modules[0] : NULL);
+
+    it = inserted.first;
+  } else {
+    // We have a hit, manage the LRU by removing our ID.
+    // It will be pushed to the back of the LRU just below.
+    worker->lru_module_id.erase(
+        std::find(worker->lru_module_id.begin(),
+                  worker->lru_module_id.end(),
+                  id));
   }
 
   // Push our id to the back of the lru list.
-  lru_module_id_.push_back(id);
+  worker->lru_module_id.push_back(id);
 
-  DCHECK(it != symbol_caches_.end());
+  DCHECK(it != worker->symbol_caches.end());
   SymbolCache& cache = it->second;
 
+  // Find the module containing the address in the load state, which takes
+  // logarithmic time in the number of modules loaded.
+  ModuleInformation module_info;
+  bool found_module = false;
+  {
+    base::AutoLock lock(module_lock_);
+    found_module =
+        module_cache_.GetModuleForAddress(pid, time, address, &module_info);
+  }
+
   // This can take a long time, so it's important not to
   // hold the module lock over this operation.
-  bool ret = cache.GetSymbolForAddress(address, symbol);
+  bool ret = cache.GetSymbolForAddress(
+      address, found_module ? &module_info : NULL, symbol);
 
   // Clear the last status we posted.
   if (!status_callback_.is_null())
@@ -187,91 +250,131 @@ bool SymbolLookupService::ResolveAddressImpl(sym_util::ProcessId pid,
   return ret;
 }
 
-void SymbolLookupService::ResolveCallback() {
-  DCHECK_EQ(background_thread_, MessageLoop::current());
+void SymbolLookupService::ResolveCallback(Worker* worker) {
+  DCHECK_EQ(worker->thread, MessageLoop::current());
 
   while (true) {
-    Handle request_id;
-    Request request;
+    LookupKey key;
+    sym_util::ProcessId process_id = 0;
+    base::Time time;
 
-    // Find the next unresolved request.
+    // Find the next lookup that some request is still waiting on.
     {
       base::AutoLock lock(resolution_lock_);
 
-      RequestMap::iterator it = requests_.lower_bound(unprocessed_id_);
-      if (it == requests_.end()) {
+      while (!worker->queue.empty()) {
+        key = worker->queue.front();
+        LookupMap::iterator it = worker->lookups.find(key);
+        DCHECK(it != worker->lookups.end());
+
+        const HandleVector& handles = it->second;
+        HandleVector::const_iterator handle_it = handles.begin();
+        for (; handle_it != handles.end(); ++handle_it) {
+          RequestMap::const_iterator request_it = requests_.find(*handle_it);
+          if (request_it != requests_.end()) {
+            // All the requests of a lookup share the module load state, so
+            // any of them will do to initialize the symbol cache.
+            process_id = request_it->second.process_id_;
+            time = request_it->second.time_;
+            break;
+          }
+        }
+        if (handle_it != handles.end())
+          break;
+
+        // All of the requests for this lookup have been cancelled.
+        worker->lookups.erase(it);
+        worker->queue.pop_front();
+      }
+
+      if (worker->queue.empty()) {
         // Null the task to signal we're exiting.
-        resolve_task_ = ProcessingCallback();
+        worker->resolve_task = ProcessingCallback();
         return;
       }
-
-      request_id = it->first;
-      request = it->second;
     }
 
     // Don't hold the lock over the symbol resolution proper.
     sym_util::Symbol symbol;
-    ResolveAddressImpl(request.process_id_,
-                       request.time_,
-                       request.address_,
+    ResolveAddressImpl(worker, key.first, process_id, time, key.second,
                        &symbol);
 
-    // Store the result, mindfully of the fact that the request
-    // might have been cancelled while we did the resolution.
+    // Store the result for all of the requests waiting on this lookup,
+    // mindfully of the fact that they might have been cancelled while we
+    // did the resolution.
     {
       base::AutoLock lock(resolution_lock_);
 
-      RequestMap::iterator it = requests_.find(request_id);
-      if (it != requests_.end()) {
-        it->second.resolved_ = symbol;
+      LookupMap::iterator it = worker->lookups.find(key);
+      DCHECK(it != worker->lookups.end());
+      const HandleVector& handles = it->second;
+      for (size_t i = 0; i < handles.size(); ++i) {
+        RequestMap::iterator request_it = requests_.find(handles[i]);
+        if (request_it == requests_.end())
+          continue;
 
-        if (callback_task_.is_null()) {
-          callback_task_ = base::Bind(&SymbolLookupService::IssueCallbacks,
-                                      base::Unretained(this));
-          foreground_thread_->PostTask(FROM_HERE, callback_task_);
-        }
+        request_it->second.resolved_ = symbol;
+        completed_.push_back(handles[i]);
+      }
+      worker->lookups.erase(it);
+      DCHECK(worker->queue.front() == key);
+      worker->queue.pop_front();
+      ++worker->num_lookups;
+
+      if (!completed_.empty() && callback_task_.is_null()) {
+        callback_task_ = base::Bind(&SymbolLookupService::IssueCallbacks,
+                                    base::Unretained(this));
+        foreground_thread_->PostTask(FROM_HERE, callback_task_);
       }
-
-      unprocessed_id_ = request_id + 1;
     }
   }
 }
 
-void SymbolLookupService::SetSymbolPathCallback(const std::wstring& path) {
-  DCHECK_EQ(background_thread_, MessageLoop::current());
+void SymbolLookupService::SetSymbolPathCallback(Worker* worker,
+                                                const std::wstring& path) {
+  DCHECK_EQ(worker->thread, MessageLoop::current());
 
-  symbol_path_ = path;
-  SymbolCacheMap::iterator it(symbol_caches_.begin());
-  for (; it != symbol_caches_.end(); ++it)
-    it->second.SetSymbolPath(symbol_path_.c_str());
+  worker->symbol_path = path;
+  SymbolCacheMap::iterator it(worker->symbol_caches.begin());
+  for (; it != worker->symbol_caches.end(); ++it)
+    it->second.SetSymbolPath(worker->symbol_path.c_str());
 }
 
 void SymbolLookupService::IssueCallbacks() {
-  while (true) {
+  DCHECK_EQ(foreground_thread_, MessageLoop::current());
+
+  // Grab the batch of requests completed so far. Any request completed from
+  // here on will be delivered by a new task.
+  HandleVector completed;
+  {
+    base::AutoLock lock(resolution_lock_);
+
+    completed.swap(completed_);
+    // Null the callback to signal we're exiting.
+    callback_task_ = ProcessingCallback();
+  }
+
+  // Deliver the batch in request order.
+  std::sort(completed.begin(), completed.end());
+  for (size_t i = 0; i < completed.size(); ++i) {
     Request request;
-    Handle request_id;
 
-    // Find the lowest request that has been processed.
+    // The request may have been cancelled by a previous callback.
     {
       base::AutoLock lock(resolution_lock_);
 
-      RequestMap::iterator it = requests_.begin();
-      if (it == requests_.end() || it->first >= unprocessed_id_) {
-        // Null the callback to signal we're exiting.
-        callback_task_ = ProcessingCallback();
-        return;
-      }
+      RequestMap::iterator it = requests_.find(completed[i]);
+      if (it == requests_.end())
+        continue;
 
-      request_id = it->first;
       request = it->second;
-
       requests_.erase(it);
     }
 
     request.callback_.Run(request.process_id_,
                           request.time_,
                           request.address_,
-                          request_id,
+                          completed[i],
                           request.resolved_);
   }
 }
@@ -16,7 +16,10 @@
 #ifndef SAWBUCK_LOG_LIB_SYMBOL_LOOKUP_SERVICE_H_
 #define SAWBUCK_LOG_LIB_SYMBOL_LOOKUP_SERVICE_H_
 
+#include <deque>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 #include "base/callback.h"
 #include "base/synchronization/lock.h"
@@ -24,6 +27,7 @@
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 #include "sawbuck/sym_util/module_cache.h"
 #include "sawbuck/sym_util/symbol_cache.h"
+#include "sawbuck/sym_util/symbol_cache_file.h"
 
 class ISymbolLookupService {
  public:
@@ -67,6 +71,12 @@ class MessageLoop;
 // The symbol lookup service class knows how to sink the NT kernel log's
 // module events, and to subsequently service {pid,time,address}->symbol
 // queries on the processes it's heard of.
+// Queries are sharded by module load state across a pool of worker threads,
+// each of which keeps its own symbol caches. Load states are assigned to the
+// workers round-robin as they're first seen. Queries for the same address in
+// the same module load state are coalesced, each worker resolves its lookups
+// in the order they were first requested, and the results are delivered to
+// the foreground thread in batches.
 class SymbolLookupService
     : public ISymbolLookupService,
       public KernelModuleEvents {
@@ -79,13 +89,26 @@ class SymbolLookupService
     status_callback_ = status_callback;
   }
 
-  // Accessors for our background thread message loop.
-  // Note: This object must outlive the background thread.
-  MessageLoop* background_thread() const { return background_thread_; }
-  void set_background_thread(MessageLoop* background_thread) {
-    background_thread_ = background_thread;
+  // Sets the file that persists resolved symbols across sessions, which is
+  // shared by the symbol caches of all workers. Must be set before the first
+  // call to ResolveAddress.
+  // Note: @p symbol_cache_file must outlive the worker threads.
+  void set_symbol_cache_file(sym_util::SymbolCacheFile* symbol_cache_file) {
+    symbol_cache_file_ = symbol_cache_file;
   }
 
+  // Adds a worker thread to the pool where symbols are resolved. All worker
+  // threads must be added before the first call to ResolveAddress.
+  // Note: This object must outlive the worker thread.
+  void AddWorkerThread(MessageLoop* worker_thread);
+
+  // @returns the number of worker threads in the pool.
+  size_t num_worker_threads() const { return workers_.size(); }
+
+  // Gets the number of lookups each worker has resolved so far, in the order
+  // the workers were added. Coalesced requests count as a single lookup.
+  void GetNumLookups(std::vector<size_t>* num_lookups);
+
   // ISymboLookupService implementation.
   virtual Handle ResolveAddress(sym_util::ProcessId process_id,
                                 const base::Time& time,
@@ -106,29 +129,63 @@ class SymbolLookupService
                             const ModuleInformation& module_info);
 
  private:
-  virtual bool ResolveAddressImpl(sym_util::ProcessId process_id,
-                                  const base::Time& time,
-                                  sym_util::Address address,
-                                  sym_util::Symbol* symbol);
+  typedef sym_util::ModuleCache::ModuleLoadStateId ModuleLoadStateId;
+  typedef base::Callback<void()> ProcessingCallback;
 
-  void SetSymbolPathCallback(const std::wstring& path);
-  void ResolveCallback();
+  // Each worker keeps a cache of symbol cache instances keyed on module
+  // load state id with an lru replacement policy.
+  typedef std::map<ModuleLoadStateId, sym_util::SymbolCache> SymbolCacheMap;
+  static const size_t kMaxCacheSize = 10;
+  typedef std::vector<ModuleLoadStateId> LoadStateVector;
+
+  // Requests for the same address in the same module load state resolve to
+  // the same symbol, so they share a single lookup.
+  typedef std::pair<ModuleLoadStateId, sym_util::Address> LookupKey;
+  typedef std::vector<Handle> HandleVector;
+  typedef std::map<LookupKey, HandleVector> LookupMap;
+  typedef std::deque<LookupKey> LookupQueue;
+
+  struct Worker {
+    Worker() : thread(NULL), num_lookups(0) {
+    }
+
+    // The thread where this worker does its processing.
+    MessageLoop* thread;
+
+    // Stores any enqueued or processing task.
+    ProcessingCallback resolve_task;  // Under resolution_lock_.
+
+    // The pending lookups sharded to this worker, along with the requests
+    // waiting on each of them. A lookup stays here while it's being resolved,
+    // so that identical requests issued meanwhile share its result.
+    LookupMap lookups;  // Under resolution_lock_.
+    // The pending lookups in the order they were first requested.
+    LookupQueue queue;  // Under resolution_lock_.
+    // The number of lookups resolved.
+    size_t num_lookups;  // Under resolution_lock_.
+
+    // These are only accessed on thread.
+    LoadStateVector lru_module_id;
+    SymbolCacheMap symbol_caches;
+    std::wstring symbol_path;
+  };
+  typedef std::vector<Worker*> WorkerVector;
+  typedef std::map<ModuleLoadStateId, Worker*> WorkerMap;
+
+  bool ResolveAddressImpl(Worker* worker,
+                          ModuleLoadStateId id,
+                          sym_util::ProcessId process_id,
+                          const base::Time& time,
+                          sym_util::Address address,
+                          sym_util::Symbol* symbol);
+
+  void SetSymbolPathCallback(Worker* worker, const std::wstring& path);
+  void ResolveCallback(Worker* worker);
   void IssueCallbacks();
 
   base::Lock module_lock_;
   sym_util::ModuleCache module_cache_;  // Under module_lock_.
 
-  // We keep a cache of symbol cache instances keyed on module
-  // load state id with an lru replacement policy.
-  typedef std::map<sym_util::ModuleCache::ModuleLoadStateId,
-      sym_util::SymbolCache> SymbolCacheMap;
-  static const size_t kMaxCacheSize = 10;
-  typedef std::vector<sym_util::ModuleCache::ModuleLoadStateId>
-      LoadStateVector;
-  LoadStateVector lru_module_id_;
-  SymbolCacheMap symbol_caches_;
-  std::wstring symbol_path_;
-
   base::Lock resolution_lock_;
   struct Request {
     sym_util::ProcessId process_id_;
@@ -144,20 +201,23 @@ class SymbolLookupService
   RequestMap requests_;
   // Next request id issued.
   Handle next_request_id_;  // Under resolution_lock_.
-  // The id of the largest-id unprocessed request.
-  Handle unprocessed_id_;  // Under resolution_lock_.
+  // The completed requests whose callbacks are yet to be issued.
+  HandleVector completed_;  // Under resolution_lock_.
+  // The worker of each module load state looked up so far.
+  WorkerMap state_workers_;  // Under resolution_lock_.
 
-  // Invoked on the worker thread on status changes.
+  // Invoked on the worker threads on status changes.
   StatusCallback status_callback_;
 
-  typedef base::Callback<void()> ProcessingCallback;
+  // The persistent symbol cache, if any. Not owned.
+  sym_util::SymbolCacheFile* symbol_cache_file_;
 
-  // These two store any enqueued or processing task.
-  ProcessingCallback resolve_task_;  // Under resolution_lock_.
+  // Stores any enqueued or processing callback task.
   ProcessingCallback callback_task_;  // Under resolution_lock_.
 
-  // The background thread where we do our processing.
-  MessageLoop* background_thread_;
+  // The worker pool where we do our processing. We own the workers, but not
+  // their threads.
+  WorkerVector workers_;
 
   // The foreground thread where we deliver result callbacks.
   MessageLoop* foreground_thread_;
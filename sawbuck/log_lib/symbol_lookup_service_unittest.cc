@@ -19,6 +19,7 @@
 #include <tlhelp32.h>
 #include "base/bind.h"
 #include "base/message_loop.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/threading/thread.h"
 #include "base/win/pe_image.h"
 #include "base/win/scoped_handle.h"
@@ -34,20 +35,32 @@ void QuitMessageLoop(MessageLoop* loop) {
   loop->PostTask(FROM_HERE, MessageLoop::QuitClosure());
 }
 
+void WaitForEvent(base::WaitableEvent* event) {
+  event->Wait();
+}
+
 class SymbolLookupServiceTest: public testing::Test {
  public:
-  SymbolLookupServiceTest() : background_thread_("Background Thread") {
+  SymbolLookupServiceTest()
+      : background_thread_("Background Thread"),
+        second_background_thread_("Second Background Thread") {
   }
 
   virtual void SetUp() {
     ASSERT_TRUE(background_thread_.Start());
-    service_.set_background_thread(background_thread_.message_loop());
+    service_.AddWorkerThread(background_thread_.message_loop());
   }
 
   virtual void TearDown() {
+    second_background_thread_.Stop();
     background_thread_.Stop();
   }
 
+  void AddSecondWorkerThread() {
+    ASSERT_TRUE(second_background_thread_.Start());
+    service_.AddWorkerThread(second_background_thread_.message_loop());
+  }
+
   void LoadModules() {
     base::win::ScopedHandle snap(
         ::CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, ::GetCurrentProcessId()));
@@ -76,9 +89,15 @@ class SymbolLookupServiceTest: public testing::Test {
   }
 
   void ResolveAll() {
+    ResolveAllOn(&background_thread_);
+    if (second_background_thread_.IsRunning())
+      ResolveAllOn(&second_background_thread_);
+  }
+
+  void ResolveAllOn(base::Thread* thread) {
     // Chase the symbol lookups on the background thread
     // by posting a quit message to this message loop.
-    background_thread_.message_loop()->PostTask(FROM_HERE,
+    thread->message_loop()->PostTask(FROM_HERE,
         base::Bind(QuitMessageLoop, MessageLoop::current()));
 
     // And run our loop.
@@ -107,6 +126,7 @@ class SymbolLookupServiceTest: public testing::Test {
 
   MessageLoop message_loop_;
   base::Thread background_thread_;
+  base::Thread second_background_thread_;
   SymbolLookupService service_;
 };
 
@@ -168,4 +188,51 @@ TEST_F(SymbolLookupServiceTest, LookupFooCancel) {
   ASSERT_EQ(5, resolved_.size());
 }
 
+TEST_F(SymbolLookupServiceTest, LookupFooWorkerPool) {
+  AddSecondWorkerThread();
+  ASSERT_EQ(2, service_.num_worker_threads());
+  LoadModules();
+
+  // Hold the workers until all the requests are in, so that none of the
+  // lookups completes before its identical requests can join it.
+  base::WaitableEvent release_workers(true, false);
+  background_thread_.message_loop()->PostTask(
+      FROM_HERE, base::Bind(&WaitForEvent, &release_workers));
+  second_background_thread_.message_loop()->PostTask(
+      FROM_HERE, base::Bind(&WaitForEvent, &release_workers));
+
+  // The requests for the current process and for an unknown process are
+  // in different module load states, and are coalesced within each of them.
+  for (int i = 0; i < 10; ++i) {
+    SymbolLookupService::Handle h =
+        service_.ResolveAddress(
+            ::GetCurrentProcessId(), base::Time::Now(),
+            reinterpret_cast<sym_util::Address>(&Foo),
+            base::Bind(&SymbolLookupServiceTest::FooResolved,
+                       base::Unretained(this)));
+    EXPECT_NE(SymbolLookupService::kInvalidHandle, h);
+
+    h = service_.ResolveAddress(
+            0, base::Time::Now(),
+            reinterpret_cast<sym_util::Address>(&Foo),
+            base::Bind(&SymbolLookupServiceTest::FooNotResolved,
+                       base::Unretained(this)));
+    EXPECT_NE(SymbolLookupService::kInvalidHandle, h);
+  }
+
+  std::vector<size_t> num_lookups;
+  service_.GetNumLookups(&num_lookups);
+  EXPECT_THAT(num_lookups, testing::ElementsAre(0, 0));
+
+  release_workers.Signal();
+  ResolveAll();
+
+  ASSERT_EQ(20, resolved_.size());
+
+  // Each load state went to a worker of its own, which did a single lookup
+  // for all of its requests.
+  service_.GetNumLookups(&num_lookups);
+  EXPECT_THAT(num_lookups, testing::ElementsAre(1, 1));
+}
+
 }  // namespace
@@ -43,6 +43,7 @@
           '<(DEPTH)/sawbuck/common/common.gyp:common_unittests',
           '<(DEPTH)/sawbuck/log_lib/log_lib.gyp:log_lib_unittests',
           '<(DEPTH)/sawbuck/sym_util/sym_util.gyp:sym_util_unittests',
+          '<(DEPTH)/sawbuck/viewer/viewer.gyp:log_snapshot_unittests',
           '<(DEPTH)/sawbuck/viewer/viewer.gyp:viewer_unittests',
         ],
       },
@@ -59,6 +60,7 @@
             '<(PRODUCT_DIR)/common_unittests.exe',
             '<(PRODUCT_DIR)/log_lib_unittests.exe',
             '<(PRODUCT_DIR)/sym_util_unittests.exe',
+            '<(PRODUCT_DIR)/log_snapshot_unittests.exe',
             '<(PRODUCT_DIR)/viewer_unittests.exe',
           ],
           'outputs': [
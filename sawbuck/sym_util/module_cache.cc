@@ -15,13 +15,15 @@
 // Module cache implementation.
 #include "sawbuck/sym_util/module_cache.h"
 
-namespace sym_util {
-
-// The empty module load state.
-ModuleCache::ModuleLoadState ModuleCache::empty_;
+#include <algorithm>
+#include "base/logging.h"
 
+namespace sym_util {
 
-ModuleCache::ModuleCache() : next_module_load_state_id_(0) {
+ModuleCache::ModuleCache() {
+  // The empty tree is its own child, and holds no module.
+  Node empty = { static_cast<ModuleId>(-1), kEmptyNode, kEmptyNode, 0 };
+  nodes_.push_back(empty);
 }
 
 void ModuleCache::ModuleLoaded(ProcessId pid,
@@ -29,14 +31,11 @@ void ModuleCache::ModuleLoaded(ProcessId pid,
                                const ModuleInformation& module) {
   ModuleStateKey key(pid, time);
 
-  // Find the state we have for this process.
-  ModuleLoadState state(GetStateForProcess(key));
-
-  // Add the new module.
-  state.insert(GetModuleId(module));
+  // Find the state we have for this process, and add the new module.
+  NodeId state = InsertModule(GetStateForProcess(key), GetModuleId(module));
 
   // And store it.
-  SetProcessState(key, GetModuleLoadStateId(state));
+  SetProcessState(key, state);
 }
 
 void ModuleCache::ModuleUnloaded(ProcessId pid,
@@ -44,14 +43,11 @@ void ModuleCache::ModuleUnloaded(ProcessId pid,
                                  const ModuleInformation& module) {
   ModuleStateKey key(pid, time);
 
-  // Find the state we have for this process.
-  ModuleLoadState state(GetStateForProcess(key));
-
-  // Remove the module.
-  state.erase(GetModuleId(module));
+  // Find the state we have for this process, and remove the module.
+  NodeId state = EraseModule(GetStateForProcess(key), GetModuleId(module));
 
   // And store it.
-  SetProcessState(key, GetModuleLoadStateId(state));
+  SetProcessState(key, state);
 }
 
 bool ModuleCache::GetProcessModuleState(
@@ -61,15 +57,26 @@ bool ModuleCache::GetProcessModuleState(
 
   ModuleStateKey key(pid, time);
   // Find the state we have for this process.
-  const ModuleLoadState& state(GetStateForProcess(key));
-  if (state.empty())
+  NodeId state = GetStateForProcess(key);
+  if (state == kEmptyNode)
     return false;
 
-  ModuleLoadState::const_iterator it(state.begin());
-  ModuleLoadState::const_iterator end(state.end());
-  for (; it != end; ++it)
-    modules->push_back(GetModule(*it));
+  GetModules(state, modules);
+  return true;
+}
+
+bool ModuleCache::GetModuleForAddress(ProcessId pid,
+                                      const base::Time& time,
+                                      Address address,
+                                      ModuleInformation* module) {
+  DCHECK(module != NULL);
+
+  const ModuleInformation* found =
+      FindModule(GetStateForProcess(ModuleStateKey(pid, time)), address);
+  if (found == NULL)
+    return false;
 
+  *module = *found;
   return true;
 }
 
@@ -96,23 +103,150 @@ const ModuleInformation& ModuleCache::GetModule(ModuleId id) {
   return modules_[id];
 }
 
-ModuleCache::ModuleLoadStateId ModuleCache::GetModuleLoadStateId(
-    const ModuleLoadState& state) {
-  ModuleLoadStateMap::iterator it(module_load_state_ids_.find(state));
+ModuleCache::NodeId ModuleCache::GetNodeId(ModuleId module,
+                                           NodeId left,
+                                           NodeId right) {
+  const ModuleInformation& info = GetModule(module);
+  Node node = { module, left, right, info.base_address + info.module_size };
+  NodeMap::iterator it(node_ids_.find(node));
 
-  if (it != module_load_state_ids_.end())
+  if (it != node_ids_.end())
     return it->second;
 
-  ModuleLoadStateId id = next_module_load_state_id_++;
-  module_load_state_ids_.insert(std::make_pair(state, id));
-  module_load_states_.push_back(state);
+  node.max_end = std::max(node.max_end,
+                          std::max(nodes_[left].max_end,
+                                   nodes_[right].max_end));
+
+  NodeId id = nodes_.size();
+  node_ids_.insert(std::make_pair(node, id));
+  nodes_.push_back(node);
 
   return id;
 }
 
-const ModuleCache::ModuleLoadState& ModuleCache::GetModuleLoadState(
-    ModuleLoadStateId id) {
-  return module_load_states_[id];
+ModuleCache::NodeId ModuleCache::InsertModule(NodeId root, ModuleId module) {
+  if (root == kEmptyNode)
+    return GetNodeId(module, kEmptyNode, kEmptyNode);
+
+  // Copy the node, as interning new nodes may move it.
+  Node node = nodes_[root];
+  if (node.module == module)
+    return root;
+
+  if (IsBefore(module, node.module)) {
+    NodeId left = InsertModule(node.left, module);
+    Node child = nodes_[left];
+    // Rotate the new module up if it takes priority.
+    if (GetPriority(child.module) > GetPriority(node.module)) {
+      return GetNodeId(child.module,
+                       child.left,
+                       GetNodeId(node.module, child.right, node.right));
+    }
+    return GetNodeId(node.module, left, node.right);
+  } else {
+    NodeId right = InsertModule(node.right, module);
+    Node child = nodes_[right];
+    if (GetPriority(child.module) > GetPriority(node.module)) {
+      return GetNodeId(child.module,
+                       GetNodeId(node.module, node.left, child.left),
+                       child.right);
+    }
+    return GetNodeId(node.module, node.left, right);
+  }
+}
+
+ModuleCache::NodeId ModuleCache::EraseModule(NodeId root, ModuleId module) {
+  if (root == kEmptyNode)
+    return root;
+
+  Node node = nodes_[root];
+  if (node.module == module)
+    return MergeNodes(node.left, node.right);
+
+  if (IsBefore(module, node.module)) {
+    NodeId left = EraseModule(node.left, module);
+    if (left == node.left)
+      return root;
+    return GetNodeId(node.module, left, node.right);
+  } else {
+    NodeId right = EraseModule(node.right, module);
+    if (right == node.right)
+      return root;
+    return GetNodeId(node.module, node.left, right);
+  }
+}
+
+ModuleCache::NodeId ModuleCache::MergeNodes(NodeId left, NodeId right) {
+  if (left == kEmptyNode)
+    return right;
+  if (right == kEmptyNode)
+    return left;
+
+  // The root of the merged tree is whichever root takes priority.
+  Node left_node = nodes_[left];
+  Node right_node = nodes_[right];
+  if (GetPriority(left_node.module) > GetPriority(right_node.module)) {
+    return GetNodeId(left_node.module,
+                     left_node.left,
+                     MergeNodes(left_node.right, right));
+  } else {
+    return GetNodeId(right_node.module,
+                     MergeNodes(left, right_node.left),
+                     right_node.right);
+  }
+}
+
+void ModuleCache::GetModules(NodeId root,
+                             std::vector<ModuleInformation>* modules) {
+  if (root == kEmptyNode)
+    return;
+
+  const Node& node = nodes_[root];
+  GetModules(node.left, modules);
+  modules->push_back(GetModule(node.module));
+  GetModules(node.right, modules);
+}
+
+const ModuleInformation* ModuleCache::FindModule(NodeId root,
+                                                 Address address) {
+  while (root != kEmptyNode) {
+    const Node& node = nodes_[root];
+    const ModuleInformation& module = GetModule(node.module);
+    if (address >= module.base_address &&
+        address < module.base_address + module.module_size) {
+      return &module;
+    }
+
+    // If a module on the left ends past the address but doesn't contain it,
+    // it starts past the address, as do all the modules on the right.
+    if (nodes_[node.left].max_end > address)
+      root = node.left;
+    else
+      root = node.right;
+  }
+
+  return NULL;
+}
+
+bool ModuleCache::IsBefore(ModuleId a, ModuleId b) {
+  Address a_base = GetModule(a).base_address;
+  Address b_base = GetModule(b).base_address;
+  if (a_base != b_base)
+    return a_base < b_base;
+  return a < b;
+}
+
+// static
+uint32 ModuleCache::GetPriority(ModuleId module) {
+  // A bijective mix of the id, so that priorities are distinct and
+  // uncorrelated with module order.
+  uint32 hash = static_cast<uint32>(module);
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6B;
+  hash ^= hash >> 13;
+  hash *= 0xC2B2AE35;
+  hash ^= hash >> 16;
+  return hash;
 }
 
 ModuleCache::ModuleLoadStateId ModuleCache::GetStateIdForProcess(
@@ -129,14 +263,14 @@ ModuleCache::ModuleLoadStateId ModuleCache::GetStateIdForProcess(
   return kInvalidModuleLoadState;
 }
 
-const ModuleCache::ModuleLoadState& ModuleCache::GetStateForProcess(
+ModuleCache::NodeId ModuleCache::GetStateForProcess(
     const ModuleStateKey& key) {
   ModuleLoadStateId id = GetStateIdForProcess(key);
 
   if (id == kInvalidModuleLoadState)
-    return empty_;
+    return kEmptyNode;
 
-  return GetModuleLoadState(id);
+  return id;
 }
 
 void ModuleCache::SetProcessState(const ModuleStateKey& key,
@@ -16,9 +16,9 @@
 #ifndef SAWBUCK_SYM_UTIL_MODULE_CACHE_H_
 #define SAWBUCK_SYM_UTIL_MODULE_CACHE_H_
 
+#include "base/basictypes.h"
 #include "base/time.h"
 #include <map>
-#include <set>
 #include <string>
 #include <vector>
 #include "sawbuck/sym_util/types.h"
@@ -29,6 +29,10 @@ namespace sym_util {
 // Allows looking up and enumerating the module state of a process at a given
 // point in time, as well as inexpensively check whether the module load
 // state of a process has changed from one time point to another.
+// Module load states are persistent search trees that share structure with
+// the states they derive from, so that loading or unloading a module, and
+// finding the module containing an address, take logarithmic time in the
+// number of modules loaded.
 class ModuleCache {
  public:
   ModuleCache();
@@ -42,11 +46,20 @@ class ModuleCache {
                       const base::Time& time,
                       const ModuleInformation& module);
 
-  // Retrieve the module state for process @p pid at @p time.
+  // Retrieve the module state for process @p pid at @p time, in order of
+  // base address.
   bool GetProcessModuleState(ProcessId pid,
                              const base::Time& time,
                              std::vector<ModuleInformation>* modules);
 
+  // Retrieves the module loaded in process @p pid at @p time that contains
+  // @p address.
+  // @returns true if there is such a module.
+  bool GetModuleForAddress(ProcessId pid,
+                           const base::Time& time,
+                           Address address,
+                           ModuleInformation* module);
+
   // Returns an arbitrary ID that's guaranteed to be different for any
   // two process load states - e.g. if GetProcessModuleState(pid, time, ...)
   // were to return different sets of modules for two values of {pid, time},
@@ -72,21 +85,58 @@ class ModuleCache {
   ModuleId GetModuleId(const ModuleInformation& module_info);
   const ModuleInformation& GetModule(ModuleId id);
 
-  // The module load state of any process at any given time is
-  // encoded as a set of module ids. And since we tend to have
-  // multiple occurrences of the same module load state, e.g. when
-  // you have multiple instances of the same executable running, we
-  // encode entire module load states into an integer as well.
-  typedef std::set<ModuleId> ModuleLoadState;
-  typedef std::map<ModuleLoadState, ModuleLoadStateId> ModuleLoadStateMap;
-  // Maps from module load state to id.
-  ModuleLoadStateMap module_load_state_ids_;
-  // Maps from id to module load state.
-  std::vector<ModuleLoadState> module_load_states_;
-  ModuleId next_module_load_state_id_;
-
-  ModuleLoadStateId GetModuleLoadStateId(const ModuleLoadState& state);
-  const ModuleLoadState& GetModuleLoadState(ModuleLoadStateId id);
+  // The module load state of any process at any given time is encoded as a
+  // treap of module ids, ordered on module base address, whose priorities
+  // are a hash of the module ids. The shape of such a treap depends only on
+  // the modules it holds. Its nodes are immutable and interned, so updates
+  // copy the path to the module they change and share the rest, and equal
+  // load states share their root node. The id of a load state is the id of
+  // its root node.
+  typedef size_t NodeId;
+  struct Node {
+    // Nodes are interned on their module and children.
+    bool operator < (const Node& o) const {
+      if (module != o.module)
+        return module < o.module;
+      if (left != o.left)
+        return left < o.left;
+      return right < o.right;
+    }
+
+    ModuleId module;
+    NodeId left;
+    NodeId right;
+    // The end address of the module in this subtree that ends highest.
+    Address max_end;
+  };
+  typedef std::map<Node, NodeId> NodeMap;
+  // Maps from node to its id.
+  NodeMap node_ids_;
+  // Maps from an id to the node. The empty tree is the node at kEmptyNode.
+  std::vector<Node> nodes_;
+
+  // @returns the interned node for @p module with children @p left and
+  //     @p right.
+  NodeId GetNodeId(ModuleId module, NodeId left, NodeId right);
+
+  // @returns the load state @p root with @p module added.
+  NodeId InsertModule(NodeId root, ModuleId module);
+  // @returns the load state @p root with @p module removed.
+  NodeId EraseModule(NodeId root, ModuleId module);
+  // @returns the load state with the modules of @p left and @p right,
+  //     where the modules of @p left all precede those of @p right.
+  NodeId MergeNodes(NodeId left, NodeId right);
+
+  // Appends the modules of the load state @p root to @p modules, in order.
+  void GetModules(NodeId root, std::vector<ModuleInformation>* modules);
+  // @returns the module of the load state @p root containing @p address,
+  //     or NULL if there is none.
+  const ModuleInformation* FindModule(NodeId root, Address address);
+
+  // @returns true if module @p a orders before module @p b in load states.
+  bool IsBefore(ModuleId a, ModuleId b);
+  // @returns the priority of @p module in load states.
+  static uint32 GetPriority(ModuleId module);
 
   struct ModuleStateKey {
     ModuleStateKey(ProcessId pid, const base::Time& time)
@@ -119,14 +169,14 @@ class ModuleCache {
   void SetProcessState(const ModuleStateKey& key, ModuleLoadStateId id);
 
   // Retrieves the module load state for a process at a time.
-  const ModuleLoadState& GetStateForProcess(const ModuleStateKey& key);
+  NodeId GetStateForProcess(const ModuleStateKey& key);
 
   // Maps from {pid, time} -> load state id.
   typedef std::map<ModuleStateKey, ModuleLoadStateId> ProcessLoadStateMap;
   ProcessLoadStateMap process_states_;
 
   static const ModuleLoadStateId kInvalidModuleLoadState = -1;
-  static ModuleLoadState empty_;
+  static const NodeId kEmptyNode = 0;
 };
 
 }  // namespace sym_util
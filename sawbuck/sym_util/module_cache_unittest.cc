@@ -14,13 +14,48 @@
 //
 // Module cache unittests.
 #include "sawbuck/sym_util/module_cache.h"
+
+#include <set>
 #include "base/at_exit.h"
 #include "base/command_line.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
 #include "gtest/gtest.h"
 
 namespace sym_util {
 
 const ProcessId kPid1 = 42;
+const ProcessId kPid2 = 43;
+
+namespace {
+
+ModuleInformation CreateModule(int index, ModuleBase base, ModuleSize size) {
+  ModuleInformation module = { 0 };
+  module.base_address = base;
+  module.module_size = size;
+  module.image_checksum = index;
+  module.time_date_stamp = index;
+  module.image_file_name = StringPrintf(L"module%d.dll", index);
+  return module;
+}
+
+// A linear congruential generator, for reproducible traces.
+class TraceRandom {
+ public:
+  TraceRandom() : state_(12345) {
+  }
+
+  // @returns a number in [0, range).
+  uint32 Next(uint32 range) {
+    state_ = state_ * 1103515245 + 12345;
+    return (state_ >> 8) % range;
+  }
+
+ private:
+  uint32 state_;
+};
+
+}  // namespace
 
 TEST(ModuleCacheTest, Insert) {
   ModuleCache cache;
@@ -70,6 +105,202 @@ TEST(ModuleCacheTest, Insert) {
             cache.GetStateId(kPid1, t2 + base::TimeDelta::FromMilliseconds(1)));
 }
 
+TEST(ModuleCacheTest, GetModuleForAddress) {
+  ModuleCache cache;
+
+  ModuleInformation mod1 = CreateModule(1, 0x10000000, 0x10000);
+  ModuleInformation mod2 = CreateModule(2, 0x20000000, 0x20000);
+  ModuleInformation mod3 = CreateModule(3, 0x30000000, 0x1000);
+  base::Time t0(base::Time::Now());
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  cache.ModuleLoaded(kPid1, t0, mod1);
+  cache.ModuleLoaded(kPid1, t0, mod2);
+  cache.ModuleLoaded(kPid1, t0, mod3);
+  cache.ModuleUnloaded(kPid1, t1, mod2);
+
+  ModuleInformation module;
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid2, t0, 0x10000000, &module));
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x0FFFFFFF, &module));
+
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x10000000, &module));
+  EXPECT_TRUE(module == mod1);
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x1000FFFF, &module));
+  EXPECT_TRUE(module == mod1);
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x10010000, &module));
+
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x20001234, &module));
+  EXPECT_TRUE(module == mod2);
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x30000FFF, &module));
+  EXPECT_TRUE(module == mod3);
+
+  // The unloaded module is gone at t1.
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t1, 0x20001234, &module));
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t1, 0x30000000, &module));
+  EXPECT_TRUE(module == mod3);
+}
+
+TEST(ModuleCacheTest, EqualStatesShareIds) {
+  ModuleCache cache;
+
+  ModuleInformation mod1 = CreateModule(1, 0x10000000, 0x10000);
+  ModuleInformation mod2 = CreateModule(2, 0x20000000, 0x20000);
+  ModuleInformation mod3 = CreateModule(3, 0x30000000, 0x1000);
+  base::Time t0(base::Time::Now());
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  base::Time t2(t1 + base::TimeDelta::FromMilliseconds(10));
+  base::Time t3(t2 + base::TimeDelta::FromMilliseconds(10));
+
+  // Load the same modules in different orders.
+  cache.ModuleLoaded(kPid1, t0, mod1);
+  cache.ModuleLoaded(kPid1, t1, mod2);
+  cache.ModuleLoaded(kPid1, t2, mod3);
+  cache.ModuleLoaded(kPid2, t0, mod3);
+  cache.ModuleLoaded(kPid2, t1, mod2);
+  cache.ModuleLoaded(kPid2, t2, mod1);
+  EXPECT_EQ(cache.GetStateId(kPid1, t2), cache.GetStateId(kPid2, t2));
+  EXPECT_NE(cache.GetStateId(kPid1, t1), cache.GetStateId(kPid2, t1));
+
+  // Unloading a module returns to an earlier state.
+  cache.ModuleUnloaded(kPid1, t3, mod3);
+  EXPECT_EQ(cache.GetStateId(kPid1, t1), cache.GetStateId(kPid1, t3));
+
+  // Unloading a module that isn't loaded leaves the state alone.
+  cache.ModuleUnloaded(kPid2, t3, CreateModule(4, 0x40000000, 0x1000));
+  EXPECT_EQ(cache.GetStateId(kPid2, t2), cache.GetStateId(kPid2, t3));
+
+  // The modules are listed in order of base address.
+  std::vector<ModuleInformation> modules;
+  ASSERT_TRUE(cache.GetProcessModuleState(kPid2, t3, &modules));
+  ASSERT_EQ(3, modules.size());
+  EXPECT_TRUE(modules[0] == mod1);
+  EXPECT_TRUE(modules[1] == mod2);
+  EXPECT_TRUE(modules[2] == mod3);
+}
+
+TEST(ModuleCacheTest, MatchesReferenceStates) {
+  ModuleCache cache;
+  TraceRandom random;
+
+  const int kNumModules = 64;
+  std::vector<ModuleInformation> all_modules;
+  for (int i = 0; i < kNumModules; ++i) {
+    all_modules.push_back(
+        CreateModule(i, 0x10000000 + random.Next(1024) * 0x10000, 0x10000));
+  }
+
+  typedef std::set<ModuleInformation> ModuleSet;
+  ModuleSet loaded;
+  std::vector<ModuleSet> states;
+  base::Time t0(base::Time::Now());
+  const int kNumEvents = 2000;
+  for (int i = 0; i < kNumEvents; ++i) {
+    base::Time time(t0 + base::TimeDelta::FromMilliseconds(i));
+    const ModuleInformation& module = all_modules[random.Next(kNumModules)];
+    if (loaded.count(module) != 0) {
+      cache.ModuleUnloaded(kPid1, time, module);
+      loaded.erase(module);
+    } else {
+      cache.ModuleLoaded(kPid1, time, module);
+      loaded.insert(module);
+    }
+    states.push_back(loaded);
+  }
+
+  for (int i = 0; i < kNumEvents; ++i) {
+    base::Time time(t0 + base::TimeDelta::FromMilliseconds(i));
+    std::vector<ModuleInformation> modules;
+    cache.GetProcessModuleState(kPid1, time, &modules);
+    ASSERT_EQ(states[i].size(), modules.size());
+    ASSERT_TRUE(ModuleSet(modules.begin(), modules.end()) == states[i]);
+    for (size_t k = 1; k < modules.size(); ++k)
+      ASSERT_LE(modules[k - 1].base_address, modules[k].base_address);
+
+    // Equal states have equal ids, and different states different ids.
+    int j = random.Next(kNumEvents);
+    base::Time other_time(t0 + base::TimeDelta::FromMilliseconds(j));
+    EXPECT_EQ(states[i] == states[j],
+              cache.GetStateId(kPid1, time) ==
+                  cache.GetStateId(kPid1, other_time));
+
+    // Modules may overlap, so any module containing the address will do.
+    Address address = 0x10000000 + random.Next(1024 * 0x10000);
+    ModuleInformation found;
+    bool expect_found = false;
+    ModuleSet::const_iterator it(states[i].begin());
+    for (; it != states[i].end(); ++it) {
+      if (address >= it->base_address &&
+          address < it->base_address + it->module_size) {
+        expect_found = true;
+      }
+    }
+    ASSERT_EQ(expect_found,
+              cache.GetModuleForAddress(kPid1, time, address, &found));
+    if (expect_found) {
+      EXPECT_EQ(1, states[i].count(found));
+      EXPECT_GE(address, found.base_address);
+      EXPECT_LT(address, found.base_address + found.module_size);
+    }
+  }
+}
+
+// Replays a trace where processes load a large set of modules, and then
+// churn through loading and unloading transient modules, as plugin hosts
+// and test runners do.
+TEST(ModuleCacheTest, ModuleChurnBenchmark) {
+  ModuleCache cache;
+  TraceRandom random;
+
+  const int kNumProcesses = 8;
+  const int kNumResidentModules = 300;
+  const int kNumTransientModules = 100;
+  const int kNumChurnEvents = 20000;
+  const int kNumQueries = 100000;
+
+  base::Time t0(base::Time::Now());
+  base::Time start = base::Time::Now();
+  int event = 0;
+  for (int pid = 0; pid < kNumProcesses; ++pid) {
+    for (int i = 0; i < kNumResidentModules; ++i) {
+      base::Time time(t0 + base::TimeDelta::FromMilliseconds(event++));
+      cache.ModuleLoaded(pid, time,
+                         CreateModule(i, 0x10000000 + i * 0x100000, 0x80000));
+    }
+  }
+
+  std::vector<std::set<int> > transients(kNumProcesses);
+  for (int i = 0; i < kNumChurnEvents; ++i) {
+    base::Time time(t0 + base::TimeDelta::FromMilliseconds(event++));
+    int pid = random.Next(kNumProcesses);
+    int index = random.Next(kNumTransientModules);
+    ModuleInformation module = CreateModule(
+        kNumResidentModules + index, 0x50000000 + index * 0x100000, 0x80000);
+    if (transients[pid].erase(index) != 0) {
+      cache.ModuleUnloaded(pid, time, module);
+    } else {
+      cache.ModuleLoaded(pid, time, module);
+      transients[pid].insert(index);
+    }
+  }
+  base::TimeDelta replay_time = base::Time::Now() - start;
+
+  start = base::Time::Now();
+  int found = 0;
+  for (int i = 0; i < kNumQueries; ++i) {
+    int pid = random.Next(kNumProcesses);
+    base::Time time(t0 + base::TimeDelta::FromMilliseconds(random.Next(event)));
+    Address address = 0x10000000 + random.Next(0x50000000);
+    ModuleInformation module;
+    if (cache.GetModuleForAddress(pid, time, address, &module))
+      ++found;
+  }
+  base::TimeDelta query_time = base::Time::Now() - start;
+
+  EXPECT_LT(0, found);
+  LOG(INFO) << event << " module events took " << replay_time.InMilliseconds()
+            << " ms to replay, and " << kNumQueries << " address lookups took "
+            << query_time.InMilliseconds() << " ms.";
+}
+
 }  //  namespace sym_util
 
 
@@ -35,6 +35,8 @@
         'module_cache.h',
         'symbol_cache.cc',
         'symbol_cache.h',
+        'symbol_cache_file.cc',
+        'symbol_cache_file.h',
         'types.cc',
         'types.h',
       ],
@@ -47,6 +49,7 @@
       'type': 'executable',
       'sources': [
         'module_cache_unittest.cc',
+        'symbol_cache_file_unittest.cc',
       ],
       'dependencies': [
         'sym_util',
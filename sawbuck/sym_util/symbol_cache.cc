@@ -13,11 +13,52 @@
 // limitations under the License.
 #include "sawbuck/sym_util/symbol_cache.h"
 
+#include "base/lazy_instance.h"
 #include "base/string_util.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/sym_util/symbol_cache_file.h"
 #include <dbghelp.h>
 
 namespace {
 
+// The tag of public symbols, SymTagPublicSymbol in cvconst.h.
+const ULONG kSymTagPublicSymbol = 10;
+
+// DbgHelp is single-threaded for all process handles alike. This serializes
+// all of our calls into it across the symbol caches and their threads.
+base::LazyInstance<base::Lock> dbghelp_lock = LAZY_INSTANCE_INITIALIZER;
+
+// The DbgHelp options are process-wide, so they're set once and never
+// changed. Public symbols keep their decorated names, which
+// GetSymbolForAddress undecorates as needed.
+class DbgHelpOptions {
+ public:
+  DbgHelpOptions() {
+    base::AutoLock lock(dbghelp_lock.Get());
+    DWORD options = ::SymGetOptions();
+
+    // Defer loading symbols until they're needed.
+    options |= SYMOPT_DEFERRED_LOADS | SYMOPT_EXACT_SYMBOLS | SYMOPT_DEBUG;
+    options &= ~SYMOPT_UNDNAME;
+    ::SymSetOptions(options);
+  }
+};
+
+base::LazyInstance<DbgHelpOptions> dbghelp_options =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Receives the decorated name of the first public symbol enumerated.
+BOOL CALLBACK GetPublicSymbolName(PSYMBOL_INFO symbol_info,
+                                  ULONG symbol_size,
+                                  PVOID context) {
+  if (symbol_info->Tag != kSymTagPublicSymbol)
+    return TRUE;
+
+  std::wstring* name = reinterpret_cast<std::wstring*>(context);
+  name->assign(symbol_info->Name, symbol_info->NameLen);
+  return FALSE;
+}
+
 template <size_t name_len>
 class SymbolInfo {
  public:
@@ -41,15 +82,9 @@ class SymbolInfo {
 
 namespace sym_util {
 
-SymbolCache::SymbolCache() : initialized_(false) {
-  // We use our own this pointer as process handle to ensure uniqueness
-  // of handles passed to SymInitialize within our process.
-  process_handle_ = reinterpret_cast<HANDLE>(this);
-  DWORD options = ::SymGetOptions();
-
-  // Defer loading symbols until they're needed.
-  options |= SYMOPT_DEFERRED_LOADS | SYMOPT_EXACT_SYMBOLS | SYMOPT_DEBUG;
-  ::SymSetOptions(options);
+SymbolCache::SymbolCache()
+    : process_handle_(NULL), initialized_(false), symbol_cache_file_(NULL) {
+  dbghelp_options.Get();
 }
 
 SymbolCache::~SymbolCache() {
@@ -62,6 +97,12 @@ bool SymbolCache::Initialize(size_t num_modules,
   if (!symbol_path_.empty())
     symbol_path = symbol_path_.c_str();
 
+  // We use our own this pointer as process handle to ensure uniqueness
+  // of handles passed to SymInitialize within our process. This is done
+  // here rather than on construction, as instances are copied into place.
+  process_handle_ = reinterpret_cast<HANDLE>(this);
+
+  base::AutoLock lock(dbghelp_lock.Get());
   if (!::SymInitialize(process_handle_, symbol_path, FALSE))
     return false;
 
@@ -88,7 +129,9 @@ bool SymbolCache::Initialize(size_t num_modules,
   return true;
 }
 
-bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
+bool SymbolCache::GetSymbolForAddress(Address address,
+                                      const ModuleInformation* module_info,
+                                      Symbol *symbol) {
   // Try the local cache first.
   SymbolMap::const_iterator it(cache_.find(address));
   if (it != cache_.end()) {
@@ -96,6 +139,41 @@ bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
     return true;
   }
 
+  // Then the symbol cache file, which spares loading the module's symbols.
+  if (symbol_cache_file_ != NULL && module_info != NULL) {
+    uint32 rva = static_cast<uint32>(address - module_info->base_address);
+    if (symbol_cache_file_->Lookup(*module_info, rva, symbol)) {
+      symbol->module = module_info->image_file_name;
+      symbol->module_base = module_info->base_address;
+      cache_.insert(std::make_pair(address, *symbol));
+      return true;
+    }
+  }
+
+  // Only the lookups that need DbgHelp take its lock.
+  bool from_pdb = false;
+  if (!GetSymbolFromDbgHelp(address, symbol, &from_pdb))
+    return false;
+
+  cache_.insert(std::make_pair(address, *symbol));
+
+  // Only persist symbols from PDBs, as export symbols improve once the PDB
+  // is found.
+  if (symbol_cache_file_ != NULL && module_info != NULL && from_pdb) {
+    uint32 rva = static_cast<uint32>(address - module_info->base_address);
+    symbol_cache_file_->Add(*module_info, rva, *symbol);
+  }
+
+  return true;
+}
+
+bool SymbolCache::GetSymbolFromDbgHelp(Address address,
+                                       Symbol* symbol,
+                                       bool* from_pdb) {
+  DCHECK(symbol != NULL);
+  DCHECK(from_pdb != NULL);
+
+  base::AutoLock lock(dbghelp_lock.Get());
   IMAGEHLP_MODULE64 module = { sizeof(module) };
   if (::SymGetModuleInfo64(process_handle_, address, &module)) {
     symbol->module = module.ImageName;
@@ -111,12 +189,23 @@ bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
   symbol->offset = static_cast<size_t>(offset);
   symbol->size = sym_info.get()->Size;
 
-  // Lookup the unmagled name.
-  DWORD options = ::SymGetOptions();
-  ::SymSetOptions((options | SYMOPT_PUBLICS_ONLY) & ~SYMOPT_UNDNAME);
-  if (::SymFromAddr(process_handle_, address, &offset, sym_info.get()))
-    symbol->mangled_name = sym_info.get()->Name;
-  ::SymSetOptions(options);
+  // Public symbols come with their decorated names. Otherwise, look up the
+  // public symbol at the start of the private one for the decorated name.
+  if (sym_info.get()->Tag == kSymTagPublicSymbol) {
+    symbol->mangled_name = symbol->name;
+    wchar_t undecorated[1024] = {};
+    if (::UnDecorateSymbolName(symbol->mangled_name.c_str(),
+                               undecorated,
+                               arraysize(undecorated),
+                               UNDNAME_NAME_ONLY) != 0) {
+      symbol->name = undecorated;
+    }
+  } else {
+    ::SymEnumSymbolsForAddr(process_handle_,
+                            address - offset,
+                            GetPublicSymbolName,
+                            &symbol->mangled_name);
+  }
 
   IMAGEHLP_LINE64 line_info = { sizeof(line_info) };
   DWORD line_displacement = 0;
@@ -128,13 +217,18 @@ bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
     symbol->line = line_info.LineNumber;
   }
 
-  cache_.insert(std::make_pair(address, *symbol));
+  // The module's symbols are loaded by now, so query it again.
+  *from_pdb = ::SymGetModuleInfo64(process_handle_, address, &module) &&
+      module.SymType == SymPdb;
+
   return true;
 }
 
 void SymbolCache::Cleanup() {
-  if (initialized_)
+  if (initialized_) {
+    base::AutoLock lock(dbghelp_lock.Get());
     ::SymCleanup(process_handle_);
+  }
 
   initialized_ = false;
 }
@@ -147,7 +241,10 @@ void SymbolCache::SetSymbolPath(const wchar_t* symbol_path) {
 
   if (initialized_) {
     // Switch the symbol path to the newly supplied one.
-    ::SymSetSearchPath(process_handle_, symbol_path);
+    {
+      base::AutoLock lock(dbghelp_lock.Get());
+      ::SymSetSearchPath(process_handle_, symbol_path);
+    }
 
     // And flush the cache.
     cache_.clear();
@@ -26,6 +26,8 @@
 
 namespace sym_util {
 
+class SymbolCacheFile;
+
 // A simple wrapper around the Symbol APIs.
 class SymbolCache {
  public:
@@ -37,7 +39,23 @@ class SymbolCache {
     status_callback_ = status_callback;
   }
 
-  bool GetSymbolForAddress(Address address, Symbol *symbol);
+  // Sets the file that persists symbols across sessions. Symbols are looked
+  // up in @p symbol_cache_file before resorting to dbghelp, and the symbols
+  // resolved from PDBs are added to it.
+  void set_symbol_cache_file(SymbolCacheFile* symbol_cache_file) {
+    symbol_cache_file_ = symbol_cache_file;
+  }
+
+  // Resolves the symbol at @p address.
+  // @param address the address to resolve.
+  // @param module_info the module containing @p address, or NULL if it
+  //     isn't known. Callers find it in their ModuleCache, which does so in
+  //     logarithmic time.
+  // @param symbol on success returns the symbol.
+  // @returns true on success.
+  bool GetSymbolForAddress(Address address,
+                           const ModuleInformation* module_info,
+                           Symbol *symbol);
 
   // Initialize to the set of modules provided.
   bool Initialize(size_t num_modules, ModuleInformation* modules);
@@ -47,6 +65,11 @@ class SymbolCache {
   void SetSymbolPath(const wchar_t* symbol_path);
 
  private:
+  // Looks up the symbol at @p address through DbgHelp, under its lock.
+  // @param from_pdb returns true iff the symbol comes from the module's PDB.
+  // @returns true on success.
+  bool GetSymbolFromDbgHelp(Address address, Symbol* symbol, bool* from_pdb);
+
   // We handle symbol callbacks to provide more information about images,
   // such as checksums and timestamps.
   static BOOL CALLBACK SymbolCallback(HANDLE process,
@@ -74,6 +97,9 @@ class SymbolCache {
   typedef std::map<Address, Symbol> SymbolMap;
   SymbolMap cache_;
 
+  // The persistent cache of symbols, if any. Not owned.
+  SymbolCacheFile* symbol_cache_file_;
+
   typedef std::vector<ModuleInformation> ModuleList;
   ModuleList modules_;
 
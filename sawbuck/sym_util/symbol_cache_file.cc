@@ -0,0 +1,463 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol cache file implementation.
+#include "sawbuck/sym_util/symbol_cache_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/utf_string_conversions.h"
+
+namespace sym_util {
+
+struct SymbolCacheFile::FileHeader {
+  char magic[8];
+  uint32 version;
+  // Incremented on each save. Entries record the generation they were last
+  // used in.
+  uint32 generation;
+  // A power of two greater than the number of entries.
+  uint32 num_buckets;
+  uint32 num_entries;
+  // The size of the string table, in bytes.
+  uint32 strings_size;
+  uint32 reserved;
+};
+
+struct SymbolCacheFile::FileEntry {
+  uint64 module_key;
+  uint32 rva;
+  uint32 last_used;
+  // Offsets of strings in the string table.
+  uint32 name;
+  uint32 mangled_name;
+  uint32 file;
+  uint32 line;
+  uint32 offset;
+  uint32 size;
+};
+
+namespace {
+
+const char kMagic[8] = "SAWSYMC";
+const uint32 kVersion = 1;
+const uint32 kMinBuckets = 16;
+
+// Copies the fields of @p from that the cache keeps into @p to.
+void CopyCachedFields(const Symbol& from, Symbol* to) {
+  to->name = from.name;
+  to->mangled_name = from.mangled_name;
+  to->offset = from.offset;
+  to->size = from.size;
+  to->file = from.file;
+  to->line = from.line;
+}
+
+// Interns strings into a string table, which starts with the empty string.
+class StringTableBuilder {
+ public:
+  StringTableBuilder() : table_(1, '\0') {
+    offsets_[std::string()] = 0;
+  }
+
+  // @returns the offset of @p str in the table.
+  uint32 Add(const std::wstring& str) {
+    std::pair<OffsetMap::iterator, bool> inserted =
+        offsets_.insert(std::make_pair(WideToUTF8(str), 0));
+    if (inserted.second) {
+      inserted.first->second = table_.size();
+      table_.append(inserted.first->first);
+      table_.push_back('\0');
+    }
+    return inserted.first->second;
+  }
+
+  const std::string& table() const { return table_; }
+
+ private:
+  typedef std::map<std::string, uint32> OffsetMap;
+  OffsetMap offsets_;
+  std::string table_;
+};
+
+}  // namespace
+
+SymbolCacheFile::SymbolCacheFile()
+    : max_entries_(kDefaultMaxEntries), header_(NULL), buckets_(NULL),
+      entries_(NULL), strings_(NULL) {
+  COMPILE_ASSERT(sizeof(FileHeader) == 32, file_header_size_is_wrong);
+  COMPILE_ASSERT(sizeof(FileEntry) == 40, file_entry_size_is_wrong);
+}
+
+SymbolCacheFile::~SymbolCacheFile() {
+}
+
+bool SymbolCacheFile::Open(const FilePath& path) {
+  base::AutoLock lock(lock_);
+
+  path_ = path;
+  added_.clear();
+  Unmap();
+  return Map();
+}
+
+bool SymbolCacheFile::Save() {
+  base::AutoLock lock(lock_);
+  if (path_.empty())
+    return false;
+
+  uint32 generation = header_ != NULL ? header_->generation + 1 : 1;
+
+  // Gather the entries of the file that weren't added again, and the entries
+  // added this session.
+  std::vector<Record> records;
+  size_t num_entries = header_ != NULL ? header_->num_entries : 0;
+  records.reserve(num_entries + added_.size());
+  for (size_t i = 0; i < num_entries; ++i) {
+    const FileEntry& entry = entries_[i];
+    if (added_.find(Key(entry.module_key, entry.rva)) != added_.end())
+      continue;
+
+    records.push_back(Record());
+    Record& record = records.back();
+    record.module_key = entry.module_key;
+    record.rva = entry.rva;
+    record.last_used = used_[i] ? generation : entry.last_used;
+    ReadEntry(i, &record.symbol);
+  }
+
+  SymbolMap::const_iterator it(added_.begin());
+  for (; it != added_.end(); ++it) {
+    records.push_back(Record());
+    Record& record = records.back();
+    record.module_key = it->first.first;
+    record.rva = it->first.second;
+    record.last_used = generation;
+    record.symbol = it->second;
+  }
+
+  // Keep the most recently used entries.
+  std::vector<const Record*> kept(records.size());
+  for (size_t i = 0; i < records.size(); ++i)
+    kept[i] = &records[i];
+  if (kept.size() > max_entries_) {
+    std::nth_element(kept.begin(), kept.begin() + max_entries_, kept.end(),
+                     IsMoreRecentlyUsed);
+    kept.resize(max_entries_);
+  }
+
+  // Write the new file next to the old one, which the mapping keeps from
+  // being replaced until it's gone.
+  FilePath temp_path(path_.AddExtension(FILE_PATH_LITERAL("tmp")));
+  if (!WriteFile(temp_path, generation, kept)) {
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+
+  Unmap();
+  bool replaced = file_util::ReplaceFile(temp_path, path_);
+  if (replaced) {
+    added_.clear();
+  } else {
+    LOG(ERROR) << "Unable to replace symbol cache \"" << path_.value()
+               << "\".";
+    file_util::Delete(temp_path, false);
+  }
+
+  Map();
+  return replaced;
+}
+
+bool SymbolCacheFile::Lookup(const ModuleInformation& module,
+                             uint32 rva,
+                             Symbol* symbol) {
+  DCHECK(symbol != NULL);
+
+  uint64 module_key = GetModuleKey(module);
+  base::AutoLock lock(lock_);
+
+  SymbolMap::const_iterator it(added_.find(Key(module_key, rva)));
+  if (it != added_.end()) {
+    CopyCachedFields(it->second, symbol);
+    return true;
+  }
+
+  int index = FindEntry(module_key, rva);
+  if (index < 0)
+    return false;
+
+  used_[index] = true;
+  ReadEntry(index, symbol);
+  return true;
+}
+
+void SymbolCacheFile::Add(const ModuleInformation& module,
+                          uint32 rva,
+                          const Symbol& symbol) {
+  uint64 module_key = GetModuleKey(module);
+  base::AutoLock lock(lock_);
+
+  CopyCachedFields(symbol, &added_[Key(module_key, rva)]);
+}
+
+size_t SymbolCacheFile::size() const {
+  base::AutoLock lock(lock_);
+
+  size_t size = added_.size();
+  if (header_ != NULL) {
+    for (size_t i = 0; i < header_->num_entries; ++i) {
+      if (added_.find(Key(entries_[i].module_key, entries_[i].rva)) ==
+          added_.end()) {
+        ++size;
+      }
+    }
+  }
+
+  return size;
+}
+
+// static
+uint64 SymbolCacheFile::GetModuleKey(const ModuleInformation& module) {
+  // The base name identifies the module wherever it's loaded from.
+  std::wstring name(StringToLowerASCII(
+      FilePath(module.image_file_name).BaseName().value()));
+
+  // 64 bit FNV-1a over the name and the signature of the image.
+  uint64 hash = 14695981039346656037ULL;
+  const uint64 kPrime = 1099511628211ULL;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash = (hash ^ static_cast<uint16>(name[i])) * kPrime;
+  }
+
+  uint32 signature[] = {
+    module.module_size, module.image_checksum, module.time_date_stamp
+  };
+  const uint8* bytes = reinterpret_cast<const uint8*>(signature);
+  for (size_t i = 0; i < sizeof(signature); ++i)
+    hash = (hash ^ bytes[i]) * kPrime;
+
+  return hash;
+}
+
+bool SymbolCacheFile::Map() {
+  lock_.AssertAcquired();
+  DCHECK(file_.get() == NULL);
+
+  if (!file_util::PathExists(path_))
+    return false;
+
+  file_.reset(new file_util::MemoryMappedFile());
+  if (!file_->Initialize(path_)) {
+    LOG(ERROR) << "Unable to map symbol cache \"" << path_.value() << "\".";
+    Unmap();
+    return false;
+  }
+
+  if (!Parse()) {
+    LOG(ERROR) << "\"" << path_.value() << "\" is not a valid symbol cache.";
+    Unmap();
+    return false;
+  }
+
+  used_.resize(header_->num_entries);
+  return true;
+}
+
+void SymbolCacheFile::Unmap() {
+  lock_.AssertAcquired();
+
+  file_.reset();
+  header_ = NULL;
+  buckets_ = NULL;
+  entries_ = NULL;
+  strings_ = NULL;
+  used_.clear();
+}
+
+bool SymbolCacheFile::Parse() {
+  DCHECK(file_.get() != NULL);
+
+  const uint8* data = file_->data();
+  uint64 length = file_->length();
+  if (length < sizeof(FileHeader))
+    return false;
+
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion) {
+    return false;
+  }
+
+  uint32 num_buckets = header->num_buckets;
+  if (num_buckets < kMinBuckets || (num_buckets & (num_buckets - 1)) != 0 ||
+      header->num_entries >= num_buckets) {
+    return false;
+  }
+
+  uint64 buckets_offset = sizeof(FileHeader);
+  uint64 entries_offset =
+      buckets_offset + static_cast<uint64>(num_buckets) * sizeof(uint32);
+  uint64 strings_offset = entries_offset +
+      static_cast<uint64>(header->num_entries) * sizeof(FileEntry);
+  if (strings_offset + header->strings_size != length ||
+      header->strings_size == 0 || data[length - 1] != '\0') {
+    return false;
+  }
+
+  // There must be an empty bucket for lookups to stop at. As there are more
+  // buckets than entries, there is one if no more buckets than entries are
+  // used.
+  const uint32* buckets =
+      reinterpret_cast<const uint32*>(data + buckets_offset);
+  uint32 num_used_buckets = 0;
+  for (uint32 i = 0; i < num_buckets; ++i) {
+    if (buckets[i] > header->num_entries)
+      return false;
+    if (buckets[i] != 0)
+      ++num_used_buckets;
+  }
+  if (num_used_buckets > header->num_entries)
+    return false;
+
+  // The string table ends with a terminator, so any offset in it reads a
+  // terminated string.
+  const FileEntry* entries =
+      reinterpret_cast<const FileEntry*>(data + entries_offset);
+  for (uint32 i = 0; i < header->num_entries; ++i) {
+    const FileEntry& entry = entries[i];
+    if (entry.name >= header->strings_size ||
+        entry.mangled_name >= header->strings_size ||
+        entry.file >= header->strings_size) {
+      return false;
+    }
+  }
+
+  header_ = header;
+  buckets_ = buckets;
+  entries_ = entries;
+  strings_ = reinterpret_cast<const char*>(data + strings_offset);
+  return true;
+}
+
+int SymbolCacheFile::FindEntry(uint64 module_key, uint32 rva) const {
+  if (header_ == NULL)
+    return -1;
+
+  // Probe until an empty bucket, which there is at least one of.
+  uint32 mask = header_->num_buckets - 1;
+  uint32 bucket = GetBucket(module_key, rva, header_->num_buckets);
+  for (; buckets_[bucket] != 0; bucket = (bucket + 1) & mask) {
+    const FileEntry& entry = entries_[buckets_[bucket] - 1];
+    if (entry.module_key == module_key && entry.rva == rva)
+      return buckets_[bucket] - 1;
+  }
+
+  return -1;
+}
+
+void SymbolCacheFile::ReadEntry(size_t index, Symbol* symbol) const {
+  DCHECK(header_ != NULL);
+  DCHECK_LT(index, header_->num_entries);
+  DCHECK(symbol != NULL);
+
+  const FileEntry& entry = entries_[index];
+  symbol->name = UTF8ToWide(strings_ + entry.name);
+  symbol->mangled_name = UTF8ToWide(strings_ + entry.mangled_name);
+  symbol->file = UTF8ToWide(strings_ + entry.file);
+  symbol->line = entry.line;
+  symbol->offset = entry.offset;
+  symbol->size = entry.size;
+}
+
+// static
+bool SymbolCacheFile::WriteFile(const FilePath& path,
+                                uint32 generation,
+                                const std::vector<const Record*>& records) {
+  uint32 num_buckets = kMinBuckets;
+  while (num_buckets < 2 * records.size())
+    num_buckets *= 2;
+
+  // Lay the entries out in the order of the records, and hash them into the
+  // buckets with linear probing.
+  std::vector<uint32> buckets(num_buckets, 0);
+  std::vector<FileEntry> entries(records.size());
+  StringTableBuilder strings;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const Record& record = *records[i];
+    FileEntry& entry = entries[i];
+    entry.module_key = record.module_key;
+    entry.rva = record.rva;
+    entry.last_used = record.last_used;
+    entry.name = strings.Add(record.symbol.name);
+    entry.mangled_name = strings.Add(record.symbol.mangled_name);
+    entry.file = strings.Add(record.symbol.file);
+    entry.line = record.symbol.line;
+    entry.offset = record.symbol.offset;
+    entry.size = record.symbol.size;
+
+    uint32 bucket = GetBucket(record.module_key, record.rva, num_buckets);
+    while (buckets[bucket] != 0)
+      bucket = (bucket + 1) & (num_buckets - 1);
+    buckets[bucket] = i + 1;
+  }
+
+  FileHeader header = {};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.generation = generation;
+  header.num_buckets = num_buckets;
+  header.num_entries = entries.size();
+  header.strings_size = strings.table().size();
+
+  file_util::ScopedFILE file(file_util::OpenFile(path, "wb"));
+  if (file.get() == NULL) {
+    LOG(ERROR) << "Unable to create symbol cache \"" << path.value() << "\".";
+    return false;
+  }
+
+  if (::fwrite(&header, sizeof(header), 1, file.get()) != 1 ||
+      ::fwrite(&buckets[0], sizeof(buckets[0]), buckets.size(),
+               file.get()) != buckets.size() ||
+      (!entries.empty() &&
+       ::fwrite(&entries[0], sizeof(entries[0]), entries.size(),
+                file.get()) != entries.size()) ||
+      ::fwrite(strings.table().data(), 1, strings.table().size(),
+               file.get()) != strings.table().size() ||
+      ::fclose(file.release()) != 0) {
+    LOG(ERROR) << "Unable to write symbol cache \"" << path.value() << "\".";
+    return false;
+  }
+
+  return true;
+}
+
+// static
+bool SymbolCacheFile::IsMoreRecentlyUsed(const Record* a, const Record* b) {
+  return a->last_used > b->last_used;
+}
+
+// static
+uint32 SymbolCacheFile::GetBucket(uint64 module_key,
+                                  uint32 rva,
+                                  uint32 num_buckets) {
+  // The addresses of a module are clustered, so mix them in thoroughly.
+  uint64 hash = (module_key ^ rva) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<uint32>(hash >> 32) & (num_buckets - 1);
+}
+
+}  // namespace sym_util
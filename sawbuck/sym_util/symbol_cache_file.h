@@ -0,0 +1,151 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol cache file declaration.
+//
+// A symbol cache file persists resolved symbols across sessions, so that the
+// hot addresses of stack traces don't need resolving through dbghelp every
+// time. Symbols are keyed on the signature of their module, which is its
+// base name, size, checksum and time stamp, and on their relative address in
+// the module.
+//
+// The file is laid out to be memory mapped and read in place:
+//   - a header;
+//   - an open-addressed hash table of buckets, each of which holds the index
+//     of an entry plus one, or zero if the bucket is empty;
+//   - the entries, each with the key and the fields of a symbol, and the
+//     generation of the file it was last used in;
+//   - the zero-terminated UTF-8 strings the entries refer to by offset.
+// All integers are little-endian.
+#ifndef SAWBUCK_SYM_UTIL_SYMBOL_CACHE_FILE_H_
+#define SAWBUCK_SYM_UTIL_SYMBOL_CACHE_FILE_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// Reads a symbol cache file, and rewrites it with the symbols added since.
+// Lookups read the mapped file in place. Saving keeps the most recently used
+// entries, up to a maximum number of entries.
+// Note: This class is thread-safe.
+class SymbolCacheFile {
+ public:
+  // The default maximum number of entries kept on saving.
+  static const size_t kDefaultMaxEntries = 256 * 1024;
+
+  SymbolCacheFile();
+  ~SymbolCacheFile();
+
+  // Opens the cache file at @p path. A missing or invalid file leaves the
+  // cache empty, to be created on saving.
+  // @returns true if the file was read.
+  bool Open(const FilePath& path);
+
+  // Writes the cache back to the file it was opened from, and reopens it.
+  // @returns true on success, false on failure or if Open wasn't called.
+  bool Save();
+
+  // Looks up the symbol at @p rva in @p module.
+  // @param symbol returns the symbol on success. Its module name and base
+  //     are left alone.
+  // @returns true if the symbol is cached.
+  bool Lookup(const ModuleInformation& module, uint32 rva, Symbol* symbol);
+
+  // Adds the symbol at @p rva in @p module.
+  void Add(const ModuleInformation& module, uint32 rva, const Symbol& symbol);
+
+  // @returns the number of symbols cached, in the file and added since.
+  size_t size() const;
+
+  // Sets the maximum number of entries kept on saving.
+  void set_max_entries(size_t max_entries) { max_entries_ = max_entries; }
+
+  // @returns the signature @p module is keyed on.
+  static uint64 GetModuleKey(const ModuleInformation& module);
+
+ private:
+  struct FileHeader;
+  struct FileEntry;
+
+  // A symbol and its key, as kept for writing.
+  struct Record {
+    uint64 module_key;
+    uint32 rva;
+    uint32 last_used;
+    Symbol symbol;
+  };
+
+  // Maps and validates the file at path_.
+  // @returns true on success.
+  bool Map();
+  // Unmaps the file, if any.
+  void Unmap();
+  // Validates the mapped file_.
+  // @returns true on success.
+  bool Parse();
+
+  // Finds the entry of @p module_key and @p rva in the mapped file.
+  // @returns the index of the entry, or -1 if none.
+  int FindEntry(uint64 module_key, uint32 rva) const;
+
+  // Reads the entry at @p index of the mapped file into @p symbol.
+  void ReadEntry(size_t index, Symbol* symbol) const;
+
+  // Writes @p records to @p path.
+  // @returns true on success.
+  static bool WriteFile(const FilePath& path,
+                        uint32 generation,
+                        const std::vector<const Record*>& records);
+
+  // Orders records most recently used first.
+  static bool IsMoreRecentlyUsed(const Record* a, const Record* b);
+
+  // @returns the bucket @p module_key and @p rva hash to, of @p num_buckets.
+  static uint32 GetBucket(uint64 module_key, uint32 rva, uint32 num_buckets);
+
+  size_t max_entries_;
+
+  // Protects all of the members below.
+  mutable base::Lock lock_;
+
+  FilePath path_;
+
+  // The mapped file and its sections, if any.
+  scoped_ptr<file_util::MemoryMappedFile> file_;
+  const FileHeader* header_;
+  const uint32* buckets_;
+  const FileEntry* entries_;
+  const char* strings_;
+  // Whether each entry of the file has been looked up this session.
+  std::vector<bool> used_;
+
+  // The symbols added this session.
+  typedef std::pair<uint64, uint32> Key;
+  typedef std::map<Key, Symbol> SymbolMap;
+  SymbolMap added_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolCacheFile);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_SYMBOL_CACHE_FILE_H_
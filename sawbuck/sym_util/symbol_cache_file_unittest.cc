@@ -0,0 +1,215 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol cache file unittests.
+#include "sawbuck/sym_util/symbol_cache_file.h"
+
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+class SymbolCacheFileTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().Append(L"symbols.bin");
+
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x20000;
+    module_.image_checksum = 0xCAFEBABE;
+    module_.time_date_stamp = 0x4F000000;
+    module_.image_file_name = L"C:\\foo\\foo.dll";
+  }
+
+  Symbol CreateSymbol(const wchar_t* name, size_t line) {
+    Symbol symbol;
+    symbol.name = name;
+    symbol.mangled_name = std::wstring(L"?") + name;
+    symbol.offset = 4;
+    symbol.size = 32;
+    symbol.file = L"c:\\src\\foo.cc";
+    symbol.line = line;
+    return symbol;
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  ModuleInformation module_;
+};
+
+}  // namespace
+
+TEST_F(SymbolCacheFileTest, RoundTrip) {
+  SymbolCacheFile cache;
+  EXPECT_FALSE(cache.Open(path_));
+  EXPECT_EQ(0U, cache.size());
+
+  cache.Add(module_, 0x1000, CreateSymbol(L"Foo", 10));
+  cache.Add(module_, 0x2000, CreateSymbol(L"Bar", 20));
+  EXPECT_EQ(2U, cache.size());
+  ASSERT_TRUE(cache.Save());
+  EXPECT_EQ(2U, cache.size());
+
+  SymbolCacheFile reopened;
+  ASSERT_TRUE(reopened.Open(path_));
+  EXPECT_EQ(2U, reopened.size());
+
+  Symbol symbol;
+  ASSERT_TRUE(reopened.Lookup(module_, 0x1000, &symbol));
+  EXPECT_EQ(L"Foo", symbol.name);
+  EXPECT_EQ(L"?Foo", symbol.mangled_name);
+  EXPECT_EQ(L"c:\\src\\foo.cc", symbol.file);
+  EXPECT_EQ(10U, symbol.line);
+  EXPECT_EQ(4U, symbol.offset);
+  EXPECT_EQ(32U, symbol.size);
+
+  ASSERT_TRUE(reopened.Lookup(module_, 0x2000, &symbol));
+  EXPECT_EQ(L"Bar", symbol.name);
+  EXPECT_EQ(20U, symbol.line);
+
+  EXPECT_FALSE(reopened.Lookup(module_, 0x3000, &symbol));
+
+  // A rebuilt module doesn't hit the symbols of the old one.
+  ModuleInformation rebuilt = module_;
+  rebuilt.time_date_stamp++;
+  EXPECT_FALSE(reopened.Lookup(rebuilt, 0x1000, &symbol));
+
+  // Added symbols override those of the file.
+  reopened.Add(module_, 0x1000, CreateSymbol(L"Baz", 30));
+  EXPECT_EQ(2U, reopened.size());
+  ASSERT_TRUE(reopened.Lookup(module_, 0x1000, &symbol));
+  EXPECT_EQ(L"Baz", symbol.name);
+
+  ASSERT_TRUE(reopened.Save());
+  ASSERT_TRUE(reopened.Lookup(module_, 0x1000, &symbol));
+  EXPECT_EQ(L"Baz", symbol.name);
+  ASSERT_TRUE(reopened.Lookup(module_, 0x2000, &symbol));
+  EXPECT_EQ(L"Bar", symbol.name);
+}
+
+TEST_F(SymbolCacheFileTest, KeysOnModuleSignature) {
+  ModuleInformation moved = module_;
+  moved.base_address = 0x20000000;
+  moved.image_file_name = L"D:\\bar\\FOO.DLL";
+  EXPECT_EQ(SymbolCacheFile::GetModuleKey(module_),
+            SymbolCacheFile::GetModuleKey(moved));
+
+  ModuleInformation other = module_;
+  other.image_checksum++;
+  EXPECT_NE(SymbolCacheFile::GetModuleKey(module_),
+            SymbolCacheFile::GetModuleKey(other));
+
+  other = module_;
+  other.image_file_name = L"C:\\foo\\bar.dll";
+  EXPECT_NE(SymbolCacheFile::GetModuleKey(module_),
+            SymbolCacheFile::GetModuleKey(other));
+}
+
+TEST_F(SymbolCacheFileTest, RejectsInvalidFiles) {
+  SymbolCacheFile cache;
+  EXPECT_FALSE(cache.Open(path_));
+  cache.Add(module_, 0x1000, CreateSymbol(L"Foo", 10));
+  ASSERT_TRUE(cache.Save());
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+
+  // Truncated.
+  std::string truncated(contents, 0, contents.size() - 1);
+  ASSERT_EQ(static_cast<int>(truncated.size()),
+            file_util::WriteFile(path_, truncated.data(), truncated.size()));
+  SymbolCacheFile reopened;
+  EXPECT_FALSE(reopened.Open(path_));
+  EXPECT_EQ(0U, reopened.size());
+
+  // Bad magic.
+  std::string bad_magic(contents);
+  bad_magic[0] = 'X';
+  ASSERT_EQ(static_cast<int>(bad_magic.size()),
+            file_util::WriteFile(path_, bad_magic.data(), bad_magic.size()));
+  EXPECT_FALSE(reopened.Open(path_));
+
+  // Every bucket used, so that lookups would never find an empty one. The
+  // header is 32 bytes, and is followed by the buckets.
+  std::string full_buckets(contents);
+  uint32 num_buckets = 0;
+  memcpy(&num_buckets, &full_buckets[16], sizeof(num_buckets));
+  ASSERT_LT(32 + num_buckets * sizeof(uint32), full_buckets.size());
+  for (uint32 i = 0; i < num_buckets; ++i) {
+    uint32 bucket = 1;
+    memcpy(&full_buckets[32 + i * sizeof(bucket)], &bucket, sizeof(bucket));
+  }
+  ASSERT_EQ(static_cast<int>(full_buckets.size()),
+            file_util::WriteFile(path_, full_buckets.data(),
+                                 full_buckets.size()));
+  EXPECT_FALSE(reopened.Open(path_));
+  Symbol symbol;
+  EXPECT_FALSE(reopened.Lookup(module_, 0x3000, &symbol));
+
+  // An invalid file is replaced on saving.
+  reopened.Add(module_, 0x2000, CreateSymbol(L"Bar", 20));
+  ASSERT_TRUE(reopened.Save());
+  EXPECT_TRUE(reopened.Open(path_));
+  EXPECT_EQ(1U, reopened.size());
+}
+
+TEST_F(SymbolCacheFileTest, KeepsMostRecentlyUsed) {
+  SymbolCacheFile cache;
+  EXPECT_FALSE(cache.Open(path_));
+  cache.Add(module_, 0x1000, CreateSymbol(L"Foo", 10));
+  cache.Add(module_, 0x2000, CreateSymbol(L"Bar", 20));
+  cache.Add(module_, 0x3000, CreateSymbol(L"Baz", 30));
+  ASSERT_TRUE(cache.Save());
+
+  // Use one of the saved symbols, and add another.
+  SymbolCacheFile reopened;
+  ASSERT_TRUE(reopened.Open(path_));
+  Symbol symbol;
+  ASSERT_TRUE(reopened.Lookup(module_, 0x2000, &symbol));
+  reopened.Add(module_, 0x4000, CreateSymbol(L"Qux", 40));
+
+  reopened.set_max_entries(2);
+  ASSERT_TRUE(reopened.Save());
+  EXPECT_EQ(2U, reopened.size());
+
+  EXPECT_FALSE(reopened.Lookup(module_, 0x1000, &symbol));
+  EXPECT_TRUE(reopened.Lookup(module_, 0x2000, &symbol));
+  EXPECT_FALSE(reopened.Lookup(module_, 0x3000, &symbol));
+  EXPECT_TRUE(reopened.Lookup(module_, 0x4000, &symbol));
+}
+
+TEST_F(SymbolCacheFileTest, ManyEntries) {
+  SymbolCacheFile cache;
+  EXPECT_FALSE(cache.Open(path_));
+  const uint32 kNumSymbols = 1000;
+  for (uint32 i = 0; i < kNumSymbols; ++i)
+    cache.Add(module_, i * 16, CreateSymbol(L"Foo", i));
+  ASSERT_TRUE(cache.Save());
+
+  SymbolCacheFile reopened;
+  ASSERT_TRUE(reopened.Open(path_));
+  EXPECT_EQ(kNumSymbols, reopened.size());
+  for (uint32 i = 0; i < kNumSymbols; ++i) {
+    Symbol symbol;
+    ASSERT_TRUE(reopened.Lookup(module_, i * 16, &symbol));
+    EXPECT_EQ(i, symbol.line);
+  }
+}
+
+}  // namespace sym_util
@@ -0,0 +1,618 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Filter program implementation.
+#include "sawbuck/viewer/filter_program.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/string_number_conversions.h"
+#include "base/string_piece.h"
+#include "base/string_util.h"
+#include "pcre.h"  // NOLINT
+
+namespace {
+
+// The options Filter compiles its regular expressions with.
+const int kRegExpOptions =
+    PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8 | PCRE_CASELESS;
+
+// The number of severity levels, which are the values of a UCHAR.
+const int kNumSeverityLevels = 256;
+
+// The relative costs of testing the columns, which order the instructions.
+// Testing a string costs twice its column cost, plus one if it runs a regular
+// expression.
+int GetColumnCost(Filter::Column column) {
+  switch (column) {
+    case Filter::SEVERITY:
+      return 0;
+    case Filter::PROCESS_ID:
+    case Filter::THREAD_ID:
+    case Filter::LINE:
+      return 1;
+    case Filter::FILE:
+      return 2;
+    case Filter::MESSAGE:
+      return 3;
+    case Filter::TIME:
+      // The time is formatted before it's tested.
+      return 4;
+  }
+
+  NOTREACHED() << "Invalid column type in filter!";
+  return 0;
+}
+
+bool EqualsLowerASCII(char text_char, char lower_char) {
+  return base::ToLowerASCII(text_char) == lower_char;
+}
+
+// Returns true if |text| contains |lower_literal|, ignoring ASCII case.
+bool ContainsLiteral(const base::StringPiece& text,
+                     const std::string& lower_literal) {
+  return std::search(text.begin(), text.end(),
+                     lower_literal.begin(), lower_literal.end(),
+                     EqualsLowerASCII) != text.end();
+}
+
+// Returns the position past the character class starting at |pos|, just
+// past its opening bracket, in |pattern|.
+size_t SkipCharacterClass(const std::string& pattern, size_t pos) {
+  if (pos < pattern.size() && pattern[pos] == '^')
+    ++pos;
+  // A leading closing bracket is part of the class.
+  if (pos < pattern.size() && pattern[pos] == ']')
+    ++pos;
+
+  while (pos < pattern.size() && pattern[pos] != ']') {
+    if (pattern[pos] == '\\')
+      ++pos;
+    ++pos;
+  }
+
+  return std::min(pos + 1, pattern.size());
+}
+
+// Returns the position past the counted repeat, as in {2,3}, starting at
+// |pos|, just past its opening brace, in |pattern|. Returns std::string::npos
+// if there's none, in which case PCRE reads the brace as a literal.
+size_t SkipCountedRepeat(const std::string& pattern, size_t pos) {
+  size_t end = pos;
+  while (end < pattern.size() && IsAsciiDigit(pattern[end]))
+    ++end;
+  if (end == pos)
+    return std::string::npos;
+
+  if (end < pattern.size() && pattern[end] == ',') {
+    ++end;
+    while (end < pattern.size() && IsAsciiDigit(pattern[end]))
+      ++end;
+  }
+
+  if (end == pattern.size() || pattern[end] != '}')
+    return std::string::npos;
+
+  return end + 1;
+}
+
+// Returns the position past the group starting at |pos|, just past its
+// opening parenthesis, in |pattern|, or std::string::npos if the group isn't
+// closed.
+size_t SkipGroup(const std::string& pattern, size_t pos) {
+  int depth = 1;
+  while (pos < pattern.size()) {
+    char c = pattern[pos++];
+    if (c == '\\') {
+      ++pos;
+    } else if (c == '[') {
+      pos = SkipCharacterClass(pattern, pos);
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')' && --depth == 0) {
+      return pos;
+    }
+  }
+
+  return std::string::npos;
+}
+
+}  // namespace
+
+// Fetches the columns of a row as they're needed, at most once each.
+class FilterProgram::RowValues {
+ public:
+  RowValues(ILogView* log_view, int row)
+      : log_view_(log_view), row_(row), fetched_(0) {
+  }
+
+  // @returns the value of the integer @p column.
+  int GetInt(Filter::Column column);
+  // @returns the value of the string @p column, which remains valid as long
+  //     as this instance.
+  base::StringPiece GetString(Filter::Column column);
+
+ private:
+  // @returns true if @p column is fetched, and marks it fetched.
+  bool IsFetched(Filter::Column column) {
+    uint32 bit = 1 << column;
+    bool fetched = (fetched_ & bit) != 0;
+    fetched_ |= bit;
+    return fetched;
+  }
+
+  ILogView* log_view_;
+  int row_;
+  // A bit per column, set once the column is fetched.
+  uint32 fetched_;
+
+  int ints_[Filter::NUM_COLUMNS];
+  base::StringPiece strings_[Filter::NUM_COLUMNS];
+  // Back the string columns that ILogView returns by value, or copies.
+  std::string file_name_;
+  std::string time_;
+  std::string message_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowValues);
+};
+
+int FilterProgram::RowValues::GetInt(Filter::Column column) {
+  if (!IsFetched(column)) {
+    switch (column) {
+      case Filter::SEVERITY:
+        ints_[column] = log_view_->GetSeverity(row_);
+        break;
+      case Filter::PROCESS_ID:
+        ints_[column] = log_view_->GetProcessId(row_);
+        break;
+      case Filter::THREAD_ID:
+        ints_[column] = log_view_->GetThreadId(row_);
+        break;
+      case Filter::LINE:
+        ints_[column] = log_view_->GetLine(row_);
+        break;
+      default:
+        NOTREACHED() << "Not an integer column.";
+        ints_[column] = 0;
+    }
+  }
+
+  return ints_[column];
+}
+
+base::StringPiece FilterProgram::RowValues::GetString(Filter::Column column) {
+  if (!IsFetched(column)) {
+    switch (column) {
+      case Filter::TIME: {
+        LogViewFormatter formatter;
+        formatter.FormatColumn(log_view_, row_, LogViewFormatter::TIME,
+                               &time_);
+        strings_[column] = time_;
+        break;
+      }
+      case Filter::FILE:
+        file_name_ = log_view_->GetFileName(row_);
+        strings_[column] = file_name_;
+        break;
+      case Filter::MESSAGE:
+        strings_[column] = log_view_->GetMessagePiece(row_, &message_);
+        break;
+      default:
+        NOTREACHED() << "Not a string column.";
+    }
+  }
+
+  return strings_[column];
+}
+
+// A compiled filter.
+class FilterProgram::Instruction {
+ public:
+  explicit Instruction(const Filter& filter);
+  ~Instruction();
+
+  bool exclude() const { return exclude_; }
+
+  // @returns true if the filter matches the row of @p values.
+  bool Matches(RowValues* values) const;
+
+  // @returns false if the filter matches none of the rows summarized by
+  //     @p summary, true if it may match some.
+  bool MayMatchRows(const LogRowSummary& summary) const;
+  // @returns true if the filter matches all of the rows summarized by
+  //     @p summary, false if it may not.
+  bool MatchesAllRows(const LogRowSummary& summary) const;
+
+  // @returns true if MayMatchRows can return false.
+  bool CanRuleOutRows() const;
+  // @returns true if MatchesAllRows can return true.
+  bool CanRuleInRows() const { return column_ == Filter::SEVERITY; }
+
+  // Orders instructions cheapest first.
+  static bool IsCheaper(const Instruction* a, const Instruction* b) {
+    return a->cost_ < b->cost_;
+  }
+
+ private:
+  // These match like Filter::ValueMatchesInt and Filter::ValueMatchesString.
+  bool MatchesInt(int value) const;
+  bool MatchesString(const base::StringPiece& text) const;
+
+  // Compiles and studies the regular expression of the filter.
+  void CompileRegExp();
+
+  Filter::Column column_;
+  Filter::Relation relation_;
+  bool exclude_;
+  int cost_;
+
+  // The value of the filter, and its value as an integer for integer
+  // columns.
+  std::string value_;
+  int int_value_;
+
+  // For severity filters, whether the filter matches each severity level,
+  // and the bits of the LogRowSummary severity mask with some severities
+  // matched and with some severities unmatched.
+  std::vector<bool> severity_matches_;
+  uint32 matched_severity_bits_;
+  uint32 unmatched_severity_bits_;
+
+  // The lower-cased literal that values must contain to match, and whether
+  // the filter is that literal alone.
+  std::string literal_;
+  bool literal_only_;
+
+  // The compiled regular expression, if needed, and its study data.
+  pcre* re_;
+  pcre_extra* extra_;
+
+  DISALLOW_COPY_AND_ASSIGN(Instruction);
+};
+
+FilterProgram::Instruction::Instruction(const Filter& filter)
+    : column_(filter.column()), relation_(filter.relation()),
+      exclude_(filter.action() == Filter::EXCLUDE), cost_(0),
+      value_(filter.value()), int_value_(0), matched_severity_bits_(0),
+      unmatched_severity_bits_(0), literal_only_(false), re_(NULL),
+      extra_(NULL) {
+  DCHECK(filter.action() == Filter::INCLUDE ||
+         filter.action() == Filter::EXCLUDE);
+
+  cost_ = 2 * GetColumnCost(column_);
+  switch (column_) {
+    case Filter::PROCESS_ID:
+    case Filter::THREAD_ID:
+    case Filter::LINE:
+      // Like Filter, compare against what parses of the value.
+      base::StringToInt(value_, &int_value_);
+      if (relation_ != Filter::IS)
+        ++cost_;
+      break;
+
+    case Filter::SEVERITY:
+      CompileRegExp();
+      severity_matches_.resize(kNumSeverityLevels);
+      for (int i = 0; i < kNumSeverityLevels; ++i) {
+        severity_matches_[i] = MatchesString(
+            LogViewFormatter::GetSeverityText(static_cast<UCHAR>(i)));
+        if (severity_matches_[i])
+          matched_severity_bits_ |= LogRowSummary::GetSeverityBit(i);
+        else
+          unmatched_severity_bits_ |= LogRowSummary::GetSeverityBit(i);
+      }
+      break;
+
+    default:
+      literal_ = GetRequiredLiteral(value_, &literal_only_);
+      if (!literal_only_) {
+        CompileRegExp();
+        ++cost_;
+      }
+      break;
+  }
+}
+
+FilterProgram::Instruction::~Instruction() {
+  if (extra_ != NULL)
+    pcre_free(extra_);
+  if (re_ != NULL)
+    pcre_free(re_);
+}
+
+bool FilterProgram::Instruction::Matches(RowValues* values) const {
+  DCHECK(values != NULL);
+
+  switch (column_) {
+    case Filter::SEVERITY:
+      // The severity is formatted as a UCHAR.
+      return severity_matches_[static_cast<UCHAR>(values->GetInt(column_))];
+
+    case Filter::PROCESS_ID:
+    case Filter::THREAD_ID:
+    case Filter::LINE:
+      return MatchesInt(values->GetInt(column_));
+
+    default:
+      return MatchesString(values->GetString(column_));
+  }
+}
+
+bool FilterProgram::Instruction::MayMatchRows(
+    const LogRowSummary& summary) const {
+  switch (column_) {
+    case Filter::SEVERITY:
+      return (summary.severity_mask & matched_severity_bits_) != 0;
+
+    case Filter::PROCESS_ID:
+      return relation_ != Filter::IS ||
+          summary.MayHaveProcessId(static_cast<DWORD>(int_value_));
+
+    case Filter::THREAD_ID:
+      return relation_ != Filter::IS ||
+          summary.MayHaveThreadId(static_cast<DWORD>(int_value_));
+
+    default:
+      return true;
+  }
+}
+
+bool FilterProgram::Instruction::MatchesAllRows(
+    const LogRowSummary& summary) const {
+  if (column_ != Filter::SEVERITY)
+    return false;
+
+  return (summary.severity_mask & unmatched_severity_bits_) == 0;
+}
+
+bool FilterProgram::Instruction::CanRuleOutRows() const {
+  switch (column_) {
+    case Filter::SEVERITY:
+      return true;
+
+    case Filter::PROCESS_ID:
+    case Filter::THREAD_ID:
+      return relation_ == Filter::IS;
+
+    default:
+      return false;
+  }
+}
+
+bool FilterProgram::Instruction::MatchesInt(int value) const {
+  if (relation_ == Filter::IS)
+    return value == int_value_;
+
+  return base::IntToString(value).find(value_) != std::string::npos;
+}
+
+bool FilterProgram::Instruction::MatchesString(
+    const base::StringPiece& text) const {
+  // Without Unicode property support, PCRE only ignores the case of ASCII
+  // characters, so the literal search agrees with it.
+  if (!literal_.empty() && !ContainsLiteral(text, literal_))
+    return false;
+
+  if (literal_only_) {
+    return relation_ == Filter::CONTAINS ||
+        text.size() == literal_.size();
+  }
+
+  if (re_ == NULL)
+    return false;
+
+  // IS filters are compiled anchored at the end, and match anchored at the
+  // start.
+  int options = relation_ == Filter::IS ? PCRE_ANCHORED : 0;
+  return pcre_exec(re_, extra_, text.data(), text.size(), 0, options,
+                   NULL, 0) >= 0;
+}
+
+void FilterProgram::Instruction::CompileRegExp() {
+  DCHECK(re_ == NULL);
+
+  // Anchor IS filters at the end, as pcrecpp::RE::FullMatch does.
+  std::string pattern(value_);
+  if (relation_ == Filter::IS)
+    pattern = "(?:" + value_ + ")\\z";
+
+  const char* error = NULL;
+  int error_offset = 0;
+  re_ = pcre_compile(pattern.c_str(), kRegExpOptions, &error, &error_offset,
+                     NULL);
+  if (re_ == NULL) {
+    LOG(ERROR) << "Invalid filter expression \"" << value_ << "\": "
+               << error;
+    return;
+  }
+
+  // Studying returns NULL without an error if it finds nothing to speed up.
+  extra_ = pcre_study(re_, 0, &error);
+  if (error != NULL) {
+    LOG(WARNING) << "Unable to study filter expression \"" << value_
+                 << "\": " << error;
+  }
+}
+
+FilterProgram::FilterProgram(const std::vector<Filter>& filters)
+    : has_inclusions_(false), can_skip_rows_(false) {
+  // Rows can be ruled out by an exclusion filter matching all of them, or by
+  // all of the inclusion filters matching none of them.
+  bool can_rule_out_inclusions = true;
+  std::vector<Filter>::const_iterator iter(filters.begin());
+  for (; iter != filters.end(); ++iter) {
+    Instruction* instruction = new Instruction(*iter);
+    instructions_.push_back(instruction);
+    if (instruction->exclude()) {
+      if (instruction->CanRuleInRows())
+        can_skip_rows_ = true;
+    } else {
+      has_inclusions_ = true;
+      if (!instruction->CanRuleOutRows())
+        can_rule_out_inclusions = false;
+    }
+  }
+  if (has_inclusions_ && can_rule_out_inclusions)
+    can_skip_rows_ = true;
+
+  std::stable_sort(instructions_.begin(), instructions_.end(),
+                   Instruction::IsCheaper);
+}
+
+FilterProgram::~FilterProgram() {
+  STLDeleteElements(&instructions_);
+}
+
+bool FilterProgram::IsIncluded(ILogView* log_view, int row) const {
+  DCHECK(log_view != NULL);
+
+  RowValues values(log_view, row);
+  bool included = !has_inclusions_;
+  std::vector<Instruction*>::const_iterator iter(instructions_.begin());
+  for (; iter != instructions_.end(); ++iter) {
+    const Instruction* instruction = *iter;
+    if (instruction->exclude()) {
+      if (instruction->Matches(&values))
+        return false;
+    } else if (!included) {
+      included = instruction->Matches(&values);
+    }
+  }
+
+  return included;
+}
+
+bool FilterProgram::MayIncludeRows(const LogRowSummary& summary) const {
+  bool may_include = !has_inclusions_;
+  std::vector<Instruction*>::const_iterator iter(instructions_.begin());
+  for (; iter != instructions_.end(); ++iter) {
+    const Instruction* instruction = *iter;
+    if (instruction->exclude()) {
+      if (instruction->MatchesAllRows(summary))
+        return false;
+    } else if (!may_include) {
+      may_include = instruction->MayMatchRows(summary);
+    }
+  }
+
+  return may_include;
+}
+
+// static
+std::string FilterProgram::GetRequiredLiteral(const std::string& pattern,
+                                              bool* is_literal) {
+  DCHECK(is_literal != NULL);
+  *is_literal = false;
+
+  // Inline options may change how the rest of the pattern reads, and POSIX
+  // classes nest brackets.
+  if (pattern.find("(?") != std::string::npos ||
+      pattern.find("[:") != std::string::npos) {
+    return std::string();
+  }
+
+  std::string longest;
+  std::string run;
+  bool literal = true;
+  size_t pos = 0;
+  while (pos < pattern.size()) {
+    char c = pattern[pos++];
+    switch (c) {
+      case '|':
+        // The alternatives needn't have anything in common.
+        return std::string();
+
+      case ')':
+        // The pattern is invalid.
+        return std::string();
+
+      case '?':
+      case '*':
+        // The preceding character is optional.
+        if (!run.empty())
+          run.resize(run.size() - 1);
+        break;
+
+      case '{': {
+        size_t end = SkipCountedRepeat(pattern, pos);
+        if (end == std::string::npos) {
+          run.push_back(c);
+          continue;
+        }
+
+        // The preceding character may be optional.
+        if (!run.empty())
+          run.resize(run.size() - 1);
+        pos = end;
+        break;
+      }
+
+      case '+':
+        // The preceding character is required, but may repeat.
+        break;
+
+      case '\\':
+        // Escapes made of letters and digits run on, as in \x41 or \012.
+        if (pos < pattern.size() && IsAsciiAlpha(pattern[pos])) {
+          while (pos < pattern.size() &&
+                 (IsAsciiAlpha(pattern[pos]) || IsAsciiDigit(pattern[pos]))) {
+            ++pos;
+          }
+        } else if (pos < pattern.size() && IsAsciiDigit(pattern[pos])) {
+          while (pos < pattern.size() && IsAsciiDigit(pattern[pos]))
+            ++pos;
+        } else {
+          ++pos;
+        }
+        break;
+
+      case '[':
+        pos = SkipCharacterClass(pattern, pos);
+        break;
+
+      case '(':
+        // The group may be optional, or hold alternatives.
+        pos = SkipGroup(pattern, pos);
+        if (pos == std::string::npos)
+          return std::string();
+        break;
+
+      case '.':
+      case '^':
+      case '$':
+        break;
+
+      default:
+        if ((c & 0x80) == 0) {
+          run.push_back(base::ToLowerASCII(c));
+          continue;
+        }
+        break;
+    }
+
+    // Anything but a literal character ends the run.
+    literal = false;
+    if (run.size() > longest.size())
+      longest = run;
+    run.clear();
+  }
+
+  if (run.size() > longest.size())
+    longest = run;
+
+  *is_literal = literal;
+  return longest;
+}
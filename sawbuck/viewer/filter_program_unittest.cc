@@ -0,0 +1,275 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Filter program unittests.
+#include "sawbuck/viewer/filter_program.h"
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+
+namespace {
+
+using testing::_;
+using testing::Return;
+using testing::StrictMock;
+
+// A log view with synthetic contents, which vary with the row.
+class SyntheticLogView : public ILogView {
+ public:
+  explicit SyntheticLogView(int num_rows) {
+    for (int i = 0; i < num_rows; ++i) {
+      messages_.push_back(base::StringPrintf(
+          "Message %d from thread %d", i, GetThreadId(i)));
+    }
+  }
+
+  virtual int GetNumRows() { return messages_.size(); }
+  virtual void ClearAll() { messages_.clear(); }
+  virtual int GetSeverity(int row) { return row % 6; }
+  virtual DWORD GetProcessId(int row) { return 1000 + row % 7; }
+  virtual DWORD GetThreadId(int row) { return row % 13; }
+  virtual base::Time GetTime(int row) {
+    return base::Time::FromInternalValue(
+        base::Time::kMicrosecondsPerSecond * row);
+  }
+  virtual std::string GetFileName(int row) {
+    const char* kFiles[] = { "foo.cc", "bar.cc", "foo_bar.h" };
+    return kFiles[row % arraysize(kFiles)];
+  }
+  virtual int GetLine(int row) { return row % 500; }
+  virtual std::string GetMessage(int row) { return messages_[row]; }
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) {
+    return messages_[row];
+  }
+  virtual void GetStackTrace(int row, std::vector<void*>* trace) {
+    trace->clear();
+  }
+  virtual bool GetCandidateRows(const base::StringPiece& literal,
+                                std::vector<int>* rows) {
+    return false;
+  }
+  virtual bool GetRowSummary(int row, LogRowSummary* summary) {
+    return false;
+  }
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie) {
+    *registration_cookie = 1;
+  }
+  virtual void Unregister(int registration_cookie) {
+  }
+
+ private:
+  std::vector<std::string> messages_;
+};
+
+// Tests each of @p filters on @p row of @p log_view, the way FilteredLogView
+// used to.
+bool IsIncludedByFilters(const std::vector<Filter>& filters,
+                         ILogView* log_view,
+                         int row) {
+  bool has_inclusions = false;
+  bool included = false;
+  for (size_t i = 0; i < filters.size(); ++i) {
+    if (filters[i].action() == Filter::EXCLUDE) {
+      if (filters[i].Matches(log_view, row))
+        return false;
+    } else {
+      has_inclusions = true;
+      included = included || filters[i].Matches(log_view, row);
+    }
+  }
+
+  return included || !has_inclusions;
+}
+
+std::string GetRequiredLiteral(const char* pattern, bool* is_literal) {
+  return FilterProgram::GetRequiredLiteral(pattern, is_literal);
+}
+
+}  // namespace
+
+TEST(FilterProgramTest, GetRequiredLiteral) {
+  bool is_literal = false;
+  EXPECT_EQ("", GetRequiredLiteral("", &is_literal));
+  EXPECT_TRUE(is_literal);
+  EXPECT_EQ("i'm included", GetRequiredLiteral("I'm Included", &is_literal));
+  EXPECT_TRUE(is_literal);
+  EXPECT_EQ("{foo}", GetRequiredLiteral("{foo}", &is_literal));
+  EXPECT_TRUE(is_literal);
+
+  EXPECT_EQ("message ", GetRequiredLiteral("Message \\d+", &is_literal));
+  EXPECT_FALSE(is_literal);
+  EXPECT_EQ(" from thread",
+            GetRequiredLiteral("^\\w+ from thread.*$", &is_literal));
+  EXPECT_FALSE(is_literal);
+  // Optional characters and groups aren't required.
+  EXPECT_EQ("abc", GetRequiredLiteral("abcd?e", &is_literal));
+  EXPECT_EQ("abcd", GetRequiredLiteral("abcde{0,2}", &is_literal));
+  EXPECT_EQ("fgh", GetRequiredLiteral("ab(cdefghijk)?fgh", &is_literal));
+  EXPECT_EQ("def", GetRequiredLiteral("a[bc]+def", &is_literal));
+  EXPECT_EQ("ab", GetRequiredLiteral("ab+c", &is_literal));
+  EXPECT_EQ("-foo", GetRequiredLiteral("\\x41-foo", &is_literal));
+  EXPECT_EQ("bar", GetRequiredLiteral("\\012bar", &is_literal));
+
+  // Nothing is required of alternatives, and inline options may change how
+  // the pattern reads.
+  EXPECT_EQ("", GetRequiredLiteral("foo|bar", &is_literal));
+  EXPECT_FALSE(is_literal);
+  EXPECT_EQ("", GetRequiredLiteral("(?x)foo bar", &is_literal));
+  EXPECT_FALSE(is_literal);
+  EXPECT_EQ("", GetRequiredLiteral("[[:alpha:]]foo", &is_literal));
+  EXPECT_FALSE(is_literal);
+}
+
+TEST(FilterProgramTest, Empty) {
+  StrictMock<testing::MockILogView> mock_view;
+  FilterProgram program((std::vector<Filter>()));
+
+  EXPECT_TRUE(program.empty());
+  EXPECT_TRUE(program.IsIncluded(&mock_view, 0));
+}
+
+TEST(FilterProgramTest, FetchesColumnsOnce) {
+  StrictMock<testing::MockILogView> mock_view;
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"Foo"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"Bar \\d"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"Baz"));
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::EXCLUDE,
+                           L"42"));
+  FilterProgram program(filters);
+  EXPECT_FALSE(program.empty());
+
+  EXPECT_CALL(mock_view, GetProcessId(0)).WillOnce(Return(10));
+  EXPECT_CALL(mock_view, GetMessagePiece(0, _)).WillOnce(Return("Bar 1"));
+  EXPECT_TRUE(program.IsIncluded(&mock_view, 0));
+
+  EXPECT_CALL(mock_view, GetProcessId(1)).WillOnce(Return(10));
+  EXPECT_CALL(mock_view, GetMessagePiece(1, _)).WillOnce(Return("Foo Baz"));
+  EXPECT_FALSE(program.IsIncluded(&mock_view, 1));
+
+  EXPECT_CALL(mock_view, GetProcessId(2)).WillOnce(Return(10));
+  EXPECT_CALL(mock_view, GetMessagePiece(2, _)).WillOnce(Return("Bar"));
+  EXPECT_FALSE(program.IsIncluded(&mock_view, 2));
+
+  // The cheap process id settles the row before the message gets fetched.
+  EXPECT_CALL(mock_view, GetProcessId(3)).WillOnce(Return(42));
+  EXPECT_FALSE(program.IsIncluded(&mock_view, 3));
+}
+
+TEST(FilterProgramTest, SkipsRowsBySummary) {
+  // Summarize rows of error severity from process 8, thread 12.
+  LogRowSummary summary;
+  summary.AddRow(2, 8, 12, base::Time());
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"4"));
+  FilterProgram other_process(filters);
+  EXPECT_TRUE(other_process.can_skip_rows());
+  EXPECT_FALSE(other_process.MayIncludeRows(summary));
+
+  // Any inclusion filter that may match lets the rows in.
+  filters.push_back(Filter(Filter::THREAD_ID, Filter::IS, Filter::INCLUDE,
+                           L"12"));
+  FilterProgram same_thread(filters);
+  EXPECT_TRUE(same_thread.can_skip_rows());
+  EXPECT_TRUE(same_thread.MayIncludeRows(summary));
+
+  // As does an inclusion filter the summary can't rule out.
+  filters.clear();
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"4"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"Foo"));
+  FilterProgram message(filters);
+  EXPECT_FALSE(message.can_skip_rows());
+  EXPECT_TRUE(message.MayIncludeRows(summary));
+
+  // An exclusion filter rules rows out if it matches all of them.
+  filters.clear();
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"ERROR|WARNING"));
+  FilterProgram no_errors(filters);
+  EXPECT_TRUE(no_errors.can_skip_rows());
+  EXPECT_FALSE(no_errors.MayIncludeRows(summary));
+  summary.AddRow(4, 8, 12, base::Time());
+  EXPECT_TRUE(no_errors.MayIncludeRows(summary));
+}
+
+TEST(FilterProgramTest, MatchesLikeFilters) {
+  const int kNumRows = 100000;
+  SyntheticLogView log_view(kNumRows);
+
+  struct FilterInfo {
+    Filter::Column column;
+    Filter::Relation relation;
+    Filter::Action action;
+    const wchar_t* value;
+  };
+  const FilterInfo kFilterSets[][3] = {
+    { { Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE, L"message 1" } },
+    { { Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE, L"1003" },
+      { Filter::SEVERITY, Filter::CONTAINS, Filter::EXCLUDE, L"warn" } },
+    { { Filter::FILE, Filter::IS, Filter::INCLUDE, L"foo.cc" },
+      { Filter::LINE, Filter::CONTAINS, Filter::INCLUDE, L"42" },
+      { Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+        L"thread [0-3]$" } },
+    { { Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+        L"message \\d+ from thread 5" },
+      { Filter::THREAD_ID, Filter::IS, Filter::EXCLUDE, L"3" } },
+    { { Filter::TIME, Filter::CONTAINS, Filter::INCLUDE, L"9" },
+      { Filter::FILE, Filter::CONTAINS, Filter::EXCLUDE, L"bar" } },
+  };
+
+  for (size_t i = 0; i < arraysize(kFilterSets); ++i) {
+    std::vector<Filter> filters;
+    for (size_t j = 0; j < arraysize(kFilterSets[i]); ++j) {
+      const FilterInfo& info = kFilterSets[i][j];
+      if (info.value != NULL) {
+        filters.push_back(
+            Filter(info.column, info.relation, info.action, info.value));
+      }
+    }
+
+    FilterProgram program(filters);
+
+    std::vector<bool> expected(kNumRows);
+    base::Time start = base::Time::Now();
+    for (int row = 0; row < kNumRows; ++row)
+      expected[row] = IsIncludedByFilters(filters, &log_view, row);
+    base::TimeDelta filters_time = base::Time::Now() - start;
+
+    std::vector<bool> included(kNumRows);
+    start = base::Time::Now();
+    for (int row = 0; row < kNumRows; ++row)
+      included[row] = program.IsIncluded(&log_view, row);
+    base::TimeDelta program_time = base::Time::Now() - start;
+
+    for (int row = 0; row < kNumRows; ++row)
+      ASSERT_EQ(expected[row], included[row]) << "Set " << i << ", row " << row;
+
+    LOG(INFO) << "Filter set " << i << " took "
+              << filters_time.InMilliseconds() << " ms as filters, "
+              << program_time.InMilliseconds() << " ms as a program.";
+  }
+}
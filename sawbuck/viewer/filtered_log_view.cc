@@ -15,13 +15,204 @@
 // Filtered list view implementation.
 #include "sawbuck/viewer/filtered_log_view.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "base/bind.h"
 #include "base/logging.h"
-#include "pcrecpp.h"  // NOLINT
+#include "base/message_loop.h"
+#include "base/sys_info.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/worker_pool.h"
+#include "sawbuck/viewer/filter_program.h"
+
+namespace {
+
+// The maximum number of rows a job filters. Jobs on the current message loop
+// are kept short so as to keep the UI responsive.
+const int kMaxMessageLoopJobRows = 1000;
+const int kMaxWorkerPoolJobRows = 16 * 1024;
+
+// Returns true if |list| starts with |prefix|.
+bool StartsWith(const std::vector<Filter>& list,
+                const std::vector<Filter>& prefix) {
+  return list.size() >= prefix.size() &&
+      std::equal(prefix.begin(), prefix.end(), list.begin());
+}
+
+}  // namespace
+
+// The jobs of a pass run on the message loop the pass was created on, or on
+// the worker pool. They only read the filter programs and the candidate rows,
+// which don't change over the life of the pass, and store their results under
+// |lock_|. A cancelled pass doesn't start new jobs, and its running jobs bail
+// out early.
+class FilteredLogView::FilterPass
+    : public base::RefCountedThreadSafe<FilterPass> {
+ public:
+  FilterPass(FilteredLogView* view,
+             std::vector<int>* candidates,
+             const std::vector<Filter>& refine_filters,
+             const std::vector<Filter>& filters,
+             std::vector<int>* indexed_rows,
+             int indexed_limit)
+      : view_(view), original_(view->original_),
+        message_loop_(MessageLoop::current()),
+        refine_program_(refine_filters), program_(filters),
+        indexed_limit_(indexed_limit), running_jobs_(0), jobs_done_(&lock_) {
+    DCHECK(candidates != NULL);
+    DCHECK(indexed_rows != NULL);
+    candidates_.swap(*candidates);
+    indexed_rows_.swap(*indexed_rows);
+  }
+
+  // The rows the pass re-tests against the refining filters.
+  const std::vector<int>& candidates() const { return candidates_; }
+
+  // Runs @p job, stores its result and notifies the view on the message
+  // loop of the pass. This may be called on any thread.
+  void RunJob(const FilterJob& job);
+
+  // Takes the result of the job @p sequence, if it's done.
+  // @param sequence the sequence number of the job.
+  // @param included returns a bitmap of the rows the job included.
+  // @returns true if the job is done.
+  bool TakeResult(size_t sequence, std::vector<bool>* included);
+
+  // Cancels the pass, and waits for its running jobs. This must be called
+  // on the message loop of the pass.
+  void Cancel();
+
+ private:
+  friend class base::RefCountedThreadSafe<FilterPass>;
+  ~FilterPass() {}
+
+  // Invoked on the message loop of the pass as jobs are done.
+  void OnJobDone();
+
+  // The view we filter for, NULL once cancelled. Only accessed on
+  // |message_loop_|.
+  FilteredLogView* view_;
+  ILogView* original_;
+  MessageLoop* message_loop_;
+
+  std::vector<int> candidates_;
+  // The candidates are tested against |refine_program_|, the other rows
+  // against |program_|.
+  const FilterProgram refine_program_;
+  const FilterProgram program_;
+  // The rows of the original view below |indexed_limit_| that the index
+  // didn't return can't match |program_|, so only |indexed_rows_| of those
+  // get tested.
+  std::vector<int> indexed_rows_;
+  const int indexed_limit_;
+
+  base::CancellationFlag cancelled_;
+
+  // Protects the members below.
+  base::Lock lock_;
+  // The number of jobs running, which is signalled on |jobs_done_|.
+  int running_jobs_;
+  base::ConditionVariable jobs_done_;
+  // The results of the jobs done, by sequence number.
+  typedef std::map<size_t, std::vector<bool> > ResultMap;
+  ResultMap results_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilterPass);
+};
+
+void FilteredLogView::FilterPass::RunJob(const FilterJob& job) {
+  {
+    base::AutoLock lock(lock_);
+    if (cancelled_.IsSet())
+      return;
+    ++running_jobs_;
+  }
+
+  std::vector<bool> included(job.end - job.begin);
+  if (job.candidates) {
+    for (int i = job.begin; i < job.end && !cancelled_.IsSet(); ++i)
+      included[i - job.begin] = refine_program_.IsIncluded(original_,
+                                                           candidates_[i]);
+  } else {
+    int indexed_end = std::min(job.end, indexed_limit_);
+    std::vector<int>::const_iterator it(
+        std::lower_bound(indexed_rows_.begin(), indexed_rows_.end(),
+                         job.begin));
+    for (; it != indexed_rows_.end() && *it < indexed_end &&
+         !cancelled_.IsSet(); ++it) {
+      included[*it - job.begin] = program_.IsIncluded(original_, *it);
+    }
+
+    int row = std::max(job.begin, indexed_end);
+    while (row < job.end && !cancelled_.IsSet()) {
+      // Skip the ranges of rows the program rules out from their summary.
+      int end = job.end;
+      LogRowSummary summary;
+      if (program_.can_skip_rows() &&
+          original_->GetRowSummary(row, &summary)) {
+        DCHECK_LE(summary.first_row, row);
+        DCHECK_GT(summary.end_row, row);
+        end = std::min(end, summary.end_row);
+        if (!program_.MayIncludeRows(summary)) {
+          row = end;
+          continue;
+        }
+      }
+
+      for (; row < end && !cancelled_.IsSet(); ++row)
+        included[row - job.begin] = program_.IsIncluded(original_, row);
+    }
+  }
+
+  base::AutoLock lock(lock_);
+  results_[job.sequence].swap(included);
+  // Post before we stop running, as Cancel waits for us and the view it's
+  // called from doesn't outlive the message loop.
+  message_loop_->PostTask(FROM_HERE, base::Bind(&FilterPass::OnJobDone, this));
+  --running_jobs_;
+  jobs_done_.Broadcast();
+}
+
+bool FilteredLogView::FilterPass::TakeResult(size_t sequence,
+                                             std::vector<bool>* included) {
+  DCHECK(included != NULL);
+
+  base::AutoLock lock(lock_);
+  ResultMap::iterator it(results_.find(sequence));
+  if (it == results_.end())
+    return false;
+
+  included->swap(it->second);
+  results_.erase(it);
+  return true;
+}
+
+void FilteredLogView::FilterPass::Cancel() {
+  DCHECK_EQ(message_loop_, MessageLoop::current());
+
+  view_ = NULL;
+  cancelled_.Set();
+
+  base::AutoLock lock(lock_);
+  while (running_jobs_ > 0)
+    jobs_done_.Wait();
+}
+
+void FilteredLogView::FilterPass::OnJobDone() {
+  DCHECK_EQ(message_loop_, MessageLoop::current());
+
+  if (view_ != NULL)
+    view_->MergeFilterJobs();
+}
 
 FilteredLogView::FilteredLogView(ILogView* original,
                                  const std::vector<Filter>& filters) :
-    filtered_rows_(0), original_(original),
+    filtered_rows_(0), next_job_sequence_(0), scheduled_candidates_(0),
+    merged_candidates_(0), scheduled_rows_(0), pass_start_row_(0),
+    use_worker_pool_(false), original_(original),
     registration_cookie_(0), next_sink_cookie_(1) {
   DCHECK(original_ != NULL);
   original_->Register(this, &registration_cookie_);
@@ -32,6 +223,7 @@ FilteredLogView::~FilteredLogView() {
   // Make sure we're not pinged post-destruction.
   if (!task_.IsCancelled())
     task_.Cancel();
+  CancelPass();
 
   original_->Unregister(registration_cookie_);
 }
@@ -42,9 +234,7 @@ void FilteredLogView::LogViewNewItems() {
 
 void FilteredLogView::LogViewCleared() {
   RestartFiltering();
-  EventSinkMap::iterator it(event_sinks_.begin());
-  for (; it != event_sinks_.end(); ++it)
-    it->second->LogViewCleared();
+  NotifyCleared();
 }
 
 int FilteredLogView::GetNumRows() {
@@ -52,9 +242,10 @@ int FilteredLogView::GetNumRows() {
 }
 
 void FilteredLogView::ClearAll() {
+  // The jobs of the current pass may be reading the rows we're clearing.
+  CancelPass();
   original_->ClearAll();
 }
-
 int FilteredLogView::GetSeverity(int row) {
   DCHECK(row < GetNumRows());
 
@@ -97,12 +288,46 @@ std::string FilteredLogView::GetMessage(int row) {
   return original_->GetMessage(included_rows_[row]);
 }
 
+base::StringPiece FilteredLogView::GetMessagePiece(int row,
+                                                  std::string* buffer) {
+  DCHECK(row < GetNumRows());
+
+  return original_->GetMessagePiece(included_rows_[row], buffer);
+}
+
 void FilteredLogView::GetStackTrace(int row, std::vector<void*>* trace) {
   DCHECK(row < GetNumRows());
 
   return original_->GetStackTrace(included_rows_[row], trace);
 }
 
+bool FilteredLogView::GetCandidateRows(const base::StringPiece& literal,
+                                       std::vector<int>* rows) {
+  DCHECK(rows != NULL);
+
+  std::vector<int> original_rows;
+  if (!original_->GetCandidateRows(literal, &original_rows))
+    return false;
+
+  // Both lists are sorted, so the original rows map to ours in one sweep.
+  rows->clear();
+  std::vector<int>::const_iterator it(included_rows_.begin());
+  for (size_t i = 0; i < original_rows.size(); ++i) {
+    it = std::lower_bound(it, included_rows_.end(), original_rows[i]);
+    if (it == included_rows_.end())
+      break;
+    if (*it == original_rows[i])
+      rows->push_back(it - included_rows_.begin());
+  }
+
+  return true;
+}
+
+bool FilteredLogView::GetRowSummary(int row, LogRowSummary* summary) {
+  // Our rows are scattered over the original view, so we have no summaries.
+  return false;
+}
+
 void FilteredLogView::Register(ILogViewEvents* event_sink,
                             int* registration_cookie) {
   int cookie = next_sink_cookie_++;
@@ -115,92 +340,265 @@ void FilteredLogView::Unregister(int registration_cookie) {
   event_sinks_.erase(registration_cookie);
 }
 
-bool FilteredLogView::MatchesFilterList(const std::vector<Filter>& list,
-                                        int index) {
-  std::vector<Filter>::const_iterator iter(list.begin());
-  for (; iter != list.end(); ++iter) {
-    if (iter->Matches(original_, index)) {
-      return true;
+void FilteredLogView::ScheduleFilterJobs() {
+  task_.Cancel();
+
+  if (pass_ == NULL)
+    return;
+
+  size_t max_jobs = 1;
+  int max_job_rows = kMaxMessageLoopJobRows;
+  if (use_worker_pool_) {
+    max_jobs = 2 * static_cast<size_t>(base::SysInfo::NumberOfProcessors());
+    max_job_rows = kMaxWorkerPoolJobRows;
+  }
+
+  const int num_candidates = pass_->candidates().size();
+  const int num_rows = original_->GetNumRows();
+  while (jobs_.size() < max_jobs) {
+    // The candidates precede the rows left to filter, so they go first.
+    FilterJob job = { next_job_sequence_, false, 0, 0 };
+    if (static_cast<int>(scheduled_candidates_) < num_candidates) {
+      job.candidates = true;
+      job.begin = static_cast<int>(scheduled_candidates_);
+      job.end = std::min(job.begin + max_job_rows, num_candidates);
+      scheduled_candidates_ = job.end;
+    } else if (scheduled_rows_ < num_rows) {
+      job.begin = scheduled_rows_;
+      job.end = std::min(job.begin + max_job_rows, num_rows);
+      scheduled_rows_ = job.end;
+    } else {
+      break;
+    }
+
+    ++next_job_sequence_;
+    jobs_.push_back(job);
+
+    base::Closure task(base::Bind(&FilterPass::RunJob, pass_, job));
+    if (use_worker_pool_) {
+      base::WorkerPool::PostTask(FROM_HERE, task, true);
+    } else {
+      MessageLoop::current()->PostTask(FROM_HERE, task);
     }
   }
-  return false;
 }
 
-void FilteredLogView::FilterChunk() {
-  task_.Cancel();
+void FilteredLogView::MergeFilterJobs() {
+  DCHECK(pass_ != NULL);
 
   // Stash our starting row count.
   int starting_rows = GetNumRows();
 
-  // Figure the range we're going to filter.
-  const int kMaxFilterRows = 1000;
-  int start = filtered_rows_;
-  int end = std::min(filtered_rows_ + kMaxFilterRows, original_->GetNumRows());
-
-
-  if (inclusion_filters_.empty()) {
-    // If the inclusion_filters_ list is empty, show all rows that do not match
-    // a filter in the exclusion list
-    for (int i = start; i < end; ++i) {
-      // Run the exclusion filters here..
-      if (!MatchesFilterList(exclusion_filters_, i)) {
-        included_rows_.push_back(i);
-      }
+  // Merge the jobs that are done in order, up to the first one that isn't.
+  const std::vector<int>& candidates = pass_->candidates();
+  std::vector<bool> included;
+  while (!jobs_.empty() &&
+         pass_->TakeResult(jobs_.front().sequence, &included)) {
+    const FilterJob& job = jobs_.front();
+    DCHECK_EQ(static_cast<size_t>(job.end - job.begin), included.size());
+
+    for (int i = job.begin; i < job.end; ++i) {
+      if (included[i - job.begin])
+        included_rows_.push_back(job.candidates ? candidates[i] : i);
     }
-  } else {
-    // Otherwise, show all rows that match a filter in the inclusion list but
-    // match no rows in the exclusion list.
-    for (int i = start; i < end; ++i) {
-      if (MatchesFilterList(inclusion_filters_, i) &&
-          !MatchesFilterList(exclusion_filters_, i)) {
-        included_rows_.push_back(i);
-      }
+
+    // Update our cursors.
+    if (job.candidates) {
+      merged_candidates_ = job.end;
+    } else {
+      filtered_rows_ = job.end;
     }
+    jobs_.pop_front();
   }
 
-  // Update our cursor.
-  filtered_rows_ = end;
-
-  // Post again if we're not done.
-  if (end != original_->GetNumRows())
-    PostFilteringTask();
+  ScheduleFilterJobs();
+  ReportProgress();
 
   // If we added rows, signal the change.
-  if (starting_rows != GetNumRows()) {
-    EventSinkMap::iterator it(event_sinks_.begin());
-    for (; it != event_sinks_.end(); ++it)
-      it->second->LogViewNewItems();
-  }
+  if (starting_rows != GetNumRows())
+    NotifyNewItems();
 }
 
 void FilteredLogView::SetFilters(const std::vector<Filter>& filters) {
-  inclusion_filters_.clear();
-  exclusion_filters_.clear();
+  std::vector<Filter> inclusions;
+  std::vector<Filter> exclusions;
 
   std::vector<Filter>::const_iterator iter(filters.begin());
   for (; iter != filters.end(); ++iter) {
     if (iter->action() == Filter::INCLUDE) {
-      inclusion_filters_.push_back(*iter);
+      inclusions.push_back(*iter);
     } else if (iter->action() == Filter::EXCLUDE) {
-      exclusion_filters_.push_back(*iter);
+      exclusions.push_back(*iter);
     } else {
       NOTREACHED();
     }
   }
 
-  RestartFiltering();
+  std::vector<Filter> added_filters;
+  bool refinement = IsRefinement(inclusions, exclusions, &added_filters);
+  if (refinement && added_filters.empty())
+    return;
+
+  inclusion_filters_.swap(inclusions);
+  exclusion_filters_.swap(exclusions);
+
+  if (refinement) {
+    // The rows included so far only need to pass the appended filters, and
+    // filtering carries on from where it was for the rest.
+    std::vector<int> candidates;
+    candidates.swap(included_rows_);
+    StartPass(&candidates, added_filters);
+  } else {
+    RestartFiltering();
+  }
+
+  NotifyCleared();
 }
 
 void FilteredLogView::RestartFiltering() {
   // Reset our included state and our filtering state.
   filtered_rows_ = 0;
   included_rows_.clear();
+
+  std::vector<int> no_candidates;
+  StartPass(&no_candidates, std::vector<Filter>());
+}
+
+void FilteredLogView::CancelPass() {
+  if (pass_ != NULL) {
+    pass_->Cancel();
+    pass_ = NULL;
+  }
+
+  jobs_.clear();
+  next_job_sequence_ = 0;
+  scheduled_candidates_ = 0;
+  merged_candidates_ = 0;
+  scheduled_rows_ = filtered_rows_;
+  pass_start_row_ = filtered_rows_;
+}
+
+void FilteredLogView::StartPass(std::vector<int>* candidates,
+                                const std::vector<Filter>& refine_filters) {
+  std::vector<Filter> filters(inclusion_filters_);
+  filters.insert(filters.end(), exclusion_filters_.begin(),
+                 exclusion_filters_.end());
+
+  // The jobs in flight are lost, so filtering resumes from the last row
+  // merged.
+  CancelPass();
+
+  std::vector<int> indexed_rows;
+  int indexed_limit = 0;
+  if (!GetIndexedRows(&indexed_rows, &indexed_limit)) {
+    indexed_rows.clear();
+    indexed_limit = 0;
+  }
+
+  pass_ = new FilterPass(this, candidates, refine_filters, filters,
+                         &indexed_rows, indexed_limit);
   PostFilteringTask();
 }
 
+bool FilteredLogView::GetIndexedRows(std::vector<int>* rows, int* limit) {
+  DCHECK(rows != NULL);
+  DCHECK(limit != NULL);
+
+  // Every row included must contain the literal of one of the inclusion
+  // filters, so each of them must require one.
+  if (inclusion_filters_.empty())
+    return false;
+
+  std::vector<std::string> literals;
+  for (size_t i = 0; i < inclusion_filters_.size(); ++i) {
+    if (inclusion_filters_[i].column() != Filter::MESSAGE)
+      return false;
+
+    bool is_literal = false;
+    std::string literal(
+        FilterProgram::GetRequiredLiteral(inclusion_filters_[i].value(),
+                                          &is_literal));
+    if (literal.empty())
+      return false;
+    literals.push_back(literal);
+  }
+
+  // Rows are indexed as they're added, so those there before the lookups
+  // are covered by them.
+  *limit = original_->GetNumRows();
+
+  rows->clear();
+  for (size_t i = 0; i < literals.size(); ++i) {
+    std::vector<int> literal_rows;
+    if (!original_->GetCandidateRows(literals[i], &literal_rows))
+      return false;
+
+    std::vector<int> merged;
+    std::set_union(rows->begin(), rows->end(),
+                   literal_rows.begin(), literal_rows.end(),
+                   std::back_inserter(merged));
+    rows->swap(merged);
+  }
+
+  return true;
+}
+
+bool FilteredLogView::IsRefinement(const std::vector<Filter>& inclusions,
+                                   const std::vector<Filter>& exclusions,
+                                   std::vector<Filter>* added_filters) const {
+  DCHECK(added_filters != NULL);
+
+  // The candidates of the current pass that aren't merged yet haven't been
+  // tested against its refining filters.
+  if (pass_ == NULL || merged_candidates_ != pass_->candidates().size())
+    return false;
+
+  if (!StartsWith(inclusions, inclusion_filters_) ||
+      !StartsWith(exclusions, exclusion_filters_)) {
+    return false;
+  }
+
+  // Inclusion filters widen the set of included rows, unless there were
+  // none, in which case all rows were included.
+  if (inclusions.size() != inclusion_filters_.size() &&
+      !inclusion_filters_.empty()) {
+    return false;
+  }
+
+  added_filters->assign(inclusions.begin() + inclusion_filters_.size(),
+                        inclusions.end());
+  added_filters->insert(added_filters->end(),
+                        exclusions.begin() + exclusion_filters_.size(),
+                        exclusions.end());
+  return true;
+}
+
+void FilteredLogView::NotifyNewItems() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewNewItems();
+}
+
+void FilteredLogView::NotifyCleared() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewCleared();
+}
+
+void FilteredLogView::ReportProgress() {
+  if (progress_callback_.is_null() || pass_ == NULL)
+    return;
+
+  int processed_rows = static_cast<int>(merged_candidates_) + filtered_rows_ -
+      pass_start_row_;
+  int total_rows = static_cast<int>(pass_->candidates().size()) +
+      original_->GetNumRows() - pass_start_row_;
+  progress_callback_.Run(processed_rows, total_rows);
+}
+
 void FilteredLogView::PostFilteringTask() {
   if (task_.IsCancelled()) {
-    task_.Reset(base::Bind(&FilteredLogView::FilterChunk,
+    task_.Reset(base::Bind(&FilteredLogView::ScheduleFilterJobs,
                            base::Unretained(this)));
     MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
   }
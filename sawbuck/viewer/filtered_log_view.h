@@ -16,24 +16,48 @@
 #ifndef SAWBUCK_VIEWER_FILTERED_LOG_VIEW_H_
 #define SAWBUCK_VIEWER_FILTERED_LOG_VIEW_H_
 
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
 
+#include "base/callback.h"
 #include "base/cancelable_callback.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "sawbuck/viewer/filter.h"
 #include "sawbuck/viewer/log_list_view.h"
 
-// Provides a filtered view on a log.
+// Provides a filtered view on a log. The rows of the original log are
+// filtered in jobs over ranges of rows, which run either on the current
+// message loop or on the worker pool. Each job produces a bitmap of the rows
+// it includes, and the bitmaps are merged in row order on the current
+// message loop.
 class FilteredLogView
     : public ILogViewEvents,
       public ILogView {
  public:
+  // Invoked on the current message loop as rows get filtered, with the number
+  // of rows processed and the total number of rows the current filtering pass
+  // has to process.
+  typedef base::Callback<void(int processed_rows, int total_rows)>
+      ProgressCallback;
+
   explicit FilteredLogView(ILogView* original,
                            const std::vector<Filter>& filters);
   ~FilteredLogView();
 
+  // When set, the rows are filtered on the worker pool. The original view
+  // must then be safe to read from any thread, and may only be cleared
+  // through this view while it's being filtered.
+  void set_use_worker_pool(bool use_worker_pool) {
+    use_worker_pool_ = use_worker_pool;
+  }
+
+  void set_progress_callback(const ProgressCallback& progress_callback) {
+    progress_callback_ = progress_callback;
+  }
+
   // ILogViewEvents implementation.
   virtual void LogViewNewItems();
   virtual void LogViewCleared();
@@ -49,22 +73,73 @@ class FilteredLogView
   virtual std::string GetFileName(int row);
   virtual int GetLine(int row);
   virtual std::string GetMessage(int row);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
   virtual void GetStackTrace(int row, std::vector<void*>* trace);
+  virtual bool GetCandidateRows(const base::StringPiece& literal,
+                                std::vector<int>* rows);
+  virtual bool GetRowSummary(int row, LogRowSummary* summary);
   virtual void Register(ILogViewEvents* event_sink,
                         int* registration_cookie);
   virtual void Unregister(int registration_cookie);
   // @}
 
- void SetFilters(const std::vector<Filter>& filters);
+  // Changes the filters. If @p filters only narrow the current filters, that
+  // is they append exclusion filters, or inclusion filters to an empty list
+  // of inclusion filters, only the rows included so far are tested against
+  // the appended filters. Otherwise filtering restarts from the first row.
+  void SetFilters(const std::vector<Filter>& filters);
 
  protected:
+  // The state shared by the jobs of a filtering pass.
+  class FilterPass;
+
+  // Describes a job of the current filtering pass.
+  struct FilterJob {
+    // The sequence number of the job in its pass.
+    size_t sequence;
+    // True if the job tests the rows the pass re-tests, rather than rows
+    // of the original view.
+    bool candidates;
+    // The range [begin, end) of rows the job tests.
+    int begin;
+    int end;
+  };
+
   void PostFilteringTask();
-  void FilterChunk();
+  // Schedules filter jobs until the current pass has enough of them in
+  // flight, or it's out of rows to filter.
+  void ScheduleFilterJobs();
+  // Merges the results of the jobs of the current pass that are done, in
+  // order.
+  void MergeFilterJobs();
   virtual void RestartFiltering();
 
-  // Returns true if the item at |index| would match a filter in |list|,
-  // false otherwise.
-  bool MatchesFilterList(const std::vector<Filter>& list, int index);
+  // Cancels the current filtering pass, if any, and waits for its jobs
+  // running on the worker pool.
+  void CancelPass();
+  // Starts a new filtering pass, which first re-tests @p candidates against
+  // @p refine_filters, then tests the rows of the original view from
+  // filtered_rows_ on against the current filters.
+  void StartPass(std::vector<int>* candidates,
+                 const std::vector<Filter>& refine_filters);
+  // Looks up the rows of the original view that may match the inclusion
+  // filters in its index, which works when all of them are message filters
+  // requiring some literal.
+  // @param rows returns the rows that may be included, in order.
+  // @param limit returns the number of rows the lookup covers.
+  // @returns true on success.
+  bool GetIndexedRows(std::vector<int>* rows, int* limit);
+
+  // @returns true if @p inclusions and @p exclusions append to the current
+  //     filters and only narrow them. On success, the appended filters are
+  //     returned in @p added_filters.
+  bool IsRefinement(const std::vector<Filter>& inclusions,
+                    const std::vector<Filter>& exclusions,
+                    std::vector<Filter>* added_filters) const;
+
+  void NotifyNewItems();
+  void NotifyCleared();
+  void ReportProgress();
 
   // The filters we are using. We break them into two lists, one that contains
   // inclusion filters, the other exclusion filters.
@@ -76,9 +151,26 @@ class FilteredLogView
   // Row number of last row in |original_| that we've processed.
   int filtered_rows_;
 
+  // The current filtering pass, if any.
+  scoped_refptr<FilterPass> pass_;
+  // The jobs of the current pass that are in flight, in order.
+  std::deque<FilterJob> jobs_;
+  size_t next_job_sequence_;
+  // The next candidate row to schedule, and the number of candidate rows
+  // merged so far.
+  size_t scheduled_candidates_;
+  size_t merged_candidates_;
+  // The next row of |original_| to schedule.
+  int scheduled_rows_;
+  // The value of filtered_rows_ when the current pass started.
+  int pass_start_row_;
+
+  bool use_worker_pool_;
+  ProgressCallback progress_callback_;
+
   typedef base::CancelableCallback<void()> FilterCallback;
 
-  // Non-NULL if there's a task pending to process additional rows.
+  // Non-NULL if there's a task pending to schedule filter jobs.
   FilterCallback task_;
 
   ILogView* original_;
@@ -13,7 +13,11 @@
 // limitations under the License.
 #include "sawbuck/viewer/filtered_log_view.h"
 
+#include <wmistr.h>
+#include <evntrace.h>
+#include "base/bind.h"
 #include "base/message_loop.h"
+#include "base/stringprintf.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "sawbuck/viewer/mock_log_view_interfaces.h"
@@ -22,10 +26,73 @@ namespace {
 
 using testing::_;
 using testing::AtLeast;
+using testing::DoAll;
 using testing::Return;
 using testing::SetArgumentPointee;
 using testing::StrictMock;
 
+// A log view with fixed contents, which is safe to read from any thread.
+class FixedLogView : public ILogView {
+ public:
+  explicit FixedLogView(int num_rows) {
+    for (int i = 0; i < num_rows; ++i)
+      messages_.push_back(base::StringPrintf("Message %d", i));
+  }
+
+  virtual int GetNumRows() { return messages_.size(); }
+  virtual void ClearAll() { messages_.clear(); }
+  virtual int GetSeverity(int row) { return 0; }
+  virtual DWORD GetProcessId(int row) { return 0; }
+  virtual DWORD GetThreadId(int row) { return 0; }
+  virtual base::Time GetTime(int row) { return base::Time(); }
+  virtual std::string GetFileName(int row) { return ""; }
+  virtual int GetLine(int row) { return 0; }
+  virtual std::string GetMessage(int row) { return messages_[row]; }
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) {
+    return messages_[row];
+  }
+  virtual void GetStackTrace(int row, std::vector<void*>* trace) {
+    trace->clear();
+  }
+  virtual bool GetCandidateRows(const base::StringPiece& literal,
+                                std::vector<int>* rows) {
+    return false;
+  }
+  virtual bool GetRowSummary(int row, LogRowSummary* summary) {
+    return false;
+  }
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie) {
+    *registration_cookie = 1;
+  }
+  virtual void Unregister(int registration_cookie) {
+  }
+
+ private:
+  std::vector<std::string> messages_;
+};
+
+// A fixed log view whose rows all have error severity, but whose summaries
+// claim that every other block of rows has verbose severity only. Filters
+// that use the summaries skip those blocks.
+class SummarizedLogView : public FixedLogView {
+ public:
+  static const int kBlockRows = 100;
+
+  explicit SummarizedLogView(int num_rows) : FixedLogView(num_rows) {
+  }
+
+  virtual int GetSeverity(int row) { return TRACE_LEVEL_ERROR; }
+  virtual bool GetRowSummary(int row, LogRowSummary* summary) {
+    int block = row / kBlockRows;
+    summary->first_row = block * kBlockRows;
+    summary->end_row = std::min(summary->first_row + kBlockRows,
+                                GetNumRows());
+    summary->AddRow(block % 2 ? TRACE_LEVEL_VERBOSE : TRACE_LEVEL_ERROR, 0, 0,
+                    base::Time());
+    return true;
+  }
+};
 
 class TestingFilteredLogView: public FilteredLogView {
  public:
@@ -50,6 +117,13 @@ class FilteredLogViewTest: public testing::Test {
     EXPECT_CALL(mock_view_, Unregister(kRegCookie)).Times(1);
   }
 
+  // Quits the message loop once filtering is done.
+  void OnProgress(int processed_rows, int total_rows) {
+    EXPECT_LE(processed_rows, total_rows);
+    if (processed_rows == total_rows)
+      MessageLoop::current()->Quit();
+  }
+
  protected:
   std::vector<Filter> filters_;
   MessageLoop message_loop_;
@@ -147,6 +221,14 @@ TEST_F(FilteredLogViewTest, Filtering) {
       .WillRepeatedly(Return("I'm Included"));
   EXPECT_CALL(mock_view_, GetMessage(2))
       .WillRepeatedly(Return("I'm Included but also Excluded"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(0, _))
+      .WillRepeatedly(Return("I'm not included"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(1, _))
+      .WillRepeatedly(Return("I'm Included"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(2, _))
+      .WillRepeatedly(Return("I'm Included but also Excluded"));
+  EXPECT_CALL(mock_view_, GetCandidateRows(_, _))
+      .WillRepeatedly(Return(false));
 
   // Run the identity filter to start with.
   message_loop_.RunAllPending();
@@ -196,6 +278,174 @@ TEST_F(FilteredLogViewTest, Filtering) {
   ExpectUnregistration();
 }
 
+TEST_F(FilteredLogViewTest, IncrementalFiltering) {
+  const int kNumRows = 4;
+  ExpectCreation(kNumRows);
+
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(kNumRows));
+  EXPECT_CALL(mock_view_, GetMessagePiece(0, _))
+      .WillRepeatedly(Return("Foo zero"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(1, _))
+      .WillRepeatedly(Return("Bar one"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(2, _))
+      .WillRepeatedly(Return("Foo two"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(3, _))
+      .WillRepeatedly(Return("Bar three"));
+  EXPECT_CALL(mock_view_, GetCandidateRows(_, _))
+      .WillRepeatedly(Return(false));
+
+  Filter include(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE, L"Foo");
+  Filter exclude(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE, L"two");
+
+  std::vector<Filter> filters;
+  filters.push_back(include);
+  filtered.SetFilters(filters);
+  message_loop_.RunAllPending();
+  ASSERT_EQ(2, filtered.GetNumRows());
+
+  // Appending an exclusion filter only re-tests the included rows.
+  testing::Mock::VerifyAndClearExpectations(&mock_view_);
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(kNumRows));
+  EXPECT_CALL(mock_view_, GetMessagePiece(0, _))
+      .WillOnce(Return("Foo zero"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(2, _))
+      .WillOnce(Return("Foo two"));
+  EXPECT_CALL(mock_view_, GetMessage(0))
+      .WillOnce(Return("Foo zero"));
+  EXPECT_CALL(mock_view_, GetCandidateRows(_, _))
+      .WillRepeatedly(Return(false));
+
+  filters.push_back(exclude);
+  filtered.SetFilters(filters);
+  EXPECT_EQ(0, filtered.GetNumRows());
+
+  message_loop_.RunAllPending();
+  ASSERT_EQ(1, filtered.GetNumRows());
+  EXPECT_STREQ("Foo zero", filtered.GetMessage(0).c_str());
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, IndexedFiltering) {
+  const int kNumRows = 4;
+  ExpectCreation(kNumRows);
+
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  // Only the rows the index returns get tested.
+  std::vector<int> candidates;
+  candidates.push_back(0);
+  candidates.push_back(2);
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(kNumRows));
+  EXPECT_CALL(mock_view_, GetCandidateRows(base::StringPiece("foo"), _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<1>(candidates), Return(true)));
+  EXPECT_CALL(mock_view_, GetMessagePiece(0, _))
+      .WillRepeatedly(Return("Foo zero"));
+  EXPECT_CALL(mock_view_, GetMessagePiece(2, _))
+      .WillRepeatedly(Return("Not two"));
+
+  std::vector<Filter> filters;
+  filters.push_back(
+      Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE, L"Foo"));
+  filtered.SetFilters(filters);
+  message_loop_.RunAllPending();
+  ASSERT_EQ(1, filtered.GetNumRows());
+
+  // The candidates map to the rows of the filtered view.
+  candidates.push_back(3);
+  EXPECT_CALL(mock_view_, GetCandidateRows(base::StringPiece("zero"), _))
+      .WillOnce(DoAll(SetArgumentPointee<1>(candidates), Return(true)));
+  std::vector<int> rows;
+  EXPECT_TRUE(filtered.GetCandidateRows("zero", &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ(0, rows[0]);
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, WorkerPoolFiltering) {
+  const int kNumRows = 100000;
+  FixedLogView original(kNumRows);
+
+  Filter include(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE, L"7");
+  Filter exclude(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE, L"3");
+  std::vector<Filter> filters;
+  filters.push_back(include);
+
+  FilteredLogView filtered(&original, filters);
+  filtered.set_use_worker_pool(true);
+  filtered.set_progress_callback(
+      base::Bind(&FilteredLogViewTest::OnProgress, base::Unretained(this)));
+
+  message_loop_.Run();
+
+  std::vector<int> expected_rows;
+  for (int i = 0; i < kNumRows; ++i) {
+    if (original.GetMessage(i).find('7') != std::string::npos)
+      expected_rows.push_back(i);
+  }
+  ASSERT_EQ(expected_rows.size(),
+            static_cast<size_t>(filtered.GetNumRows()));
+  for (size_t i = 0; i < expected_rows.size(); ++i)
+    ASSERT_EQ(original.GetMessage(expected_rows[i]), filtered.GetMessage(i));
+
+  // Narrow the filters, the included rows are merged back in order.
+  filters.push_back(exclude);
+  filtered.SetFilters(filters);
+  message_loop_.Run();
+
+  std::vector<int> narrowed_rows;
+  for (size_t i = 0; i < expected_rows.size(); ++i) {
+    if (original.GetMessage(expected_rows[i]).find('3') == std::string::npos)
+      narrowed_rows.push_back(expected_rows[i]);
+  }
+  expected_rows.swap(narrowed_rows);
+  ASSERT_EQ(expected_rows.size(),
+            static_cast<size_t>(filtered.GetNumRows()));
+  for (size_t i = 0; i < expected_rows.size(); ++i)
+    ASSERT_EQ(original.GetMessage(expected_rows[i]), filtered.GetMessage(i));
+}
+
+TEST_F(FilteredLogViewTest, SkipsSummarizedRows) {
+  const int kNumRows = 1050;
+  SummarizedLogView original(kNumRows);
+
+  std::vector<Filter> filters;
+  filters.push_back(
+      Filter(Filter::SEVERITY, Filter::IS, Filter::INCLUDE, L"ERROR"));
+  FilteredLogView filtered(&original, filters);
+  message_loop_.RunAllPending();
+
+  // Only the even blocks are tested, and all of their rows are included.
+  ASSERT_EQ(550, filtered.GetNumRows());
+  for (int i = 0; i < filtered.GetNumRows(); ++i) {
+    int row = i / SummarizedLogView::kBlockRows * 2 *
+        SummarizedLogView::kBlockRows + i % SummarizedLogView::kBlockRows;
+    ASSERT_EQ(original.GetMessage(row), filtered.GetMessage(i));
+  }
+
+  // Excluding verbose rows skips the odd blocks as well.
+  filters.clear();
+  filters.push_back(
+      Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE, L"VERBOSE"));
+  filtered.SetFilters(filters);
+  message_loop_.RunAllPending();
+  EXPECT_EQ(550, filtered.GetNumRows());
+
+  // Message filters don't use the summaries.
+  filters.clear();
+  filters.push_back(
+      Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE, L"Message"));
+  filtered.SetFilters(filters);
+  message_loop_.RunAllPending();
+  EXPECT_EQ(kNumRows, filtered.GetNumRows());
+}
+
 class MockFilteredLogView : public TestingFilteredLogView {
  public:
   explicit MockFilteredLogView(ILogView* original,
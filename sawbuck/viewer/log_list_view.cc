@@ -19,6 +19,7 @@
 #include <atlframe.h>
 #include <wmistr.h>
 #include <evntrace.h>
+#include <algorithm>
 #include "base/i18n/time_formatting.h"
 #include "base/logging.h"
 #include "base/string_util.h"
@@ -27,38 +28,12 @@
 #include "pcrecpp.h"  // NOLINT
 #include "sawbuck/log_lib/process_info_service.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/filter_program.h"
 #include "sawbuck/viewer/resource.h"
 #include "sawbuck/viewer/stack_trace_list_view.h"
 
 namespace {
 
-const char* GetSeverityText(UCHAR severity) {
-  switch (severity)  {
-    case TRACE_LEVEL_NONE:
-      return "NONE";
-    case TRACE_LEVEL_FATAL:
-      return "FATAL";
-    case TRACE_LEVEL_ERROR:
-      return "ERROR";
-    case TRACE_LEVEL_WARNING:
-      return "WARNING";
-    case TRACE_LEVEL_INFORMATION:
-      return "INFORMATION";
-    case TRACE_LEVEL_VERBOSE:
-      return "VERBOSE";
-    case TRACE_LEVEL_RESERVED6:
-      return "RESERVED6";
-    case TRACE_LEVEL_RESERVED7:
-      return "RESERVED7";
-    case TRACE_LEVEL_RESERVED8:
-      return "RESERVED8";
-    case TRACE_LEVEL_RESERVED9:
-      return "RESERVED9";
-  }
-
-  return "UNKNOWN";
-}
-
 // Returns true iff state indicates a selected listview item.
 bool IsSelected(UINT state) {
   return (state & LVIS_SELECTED) == LVIS_SELECTED;
@@ -66,6 +41,18 @@ bool IsSelected(UINT state) {
 
 const int kNoItem = -1;
 
+// Returns true iff the message of @p row of @p log_view matches
+// @p expression.
+// @param buffer the buffer the message may be copied to.
+bool MessageMatches(ILogView* log_view,
+                    int row,
+                    const pcrecpp::RE& expression,
+                    std::string* buffer) {
+  base::StringPiece message(log_view->GetMessagePiece(row, buffer));
+  return expression.PartialMatch(pcrecpp::StringPiece(message.data(),
+                                                      message.size()));
+}
+
 }  // namespace
 
 using base::StringPrintf;
@@ -91,6 +78,34 @@ const wchar_t* LogListView::kColumnWidthValueName =
 LogViewFormatter::LogViewFormatter() {
 }
 
+// static
+const char* LogViewFormatter::GetSeverityText(UCHAR severity) {
+  switch (severity)  {
+    case TRACE_LEVEL_NONE:
+      return "NONE";
+    case TRACE_LEVEL_FATAL:
+      return "FATAL";
+    case TRACE_LEVEL_ERROR:
+      return "ERROR";
+    case TRACE_LEVEL_WARNING:
+      return "WARNING";
+    case TRACE_LEVEL_INFORMATION:
+      return "INFORMATION";
+    case TRACE_LEVEL_VERBOSE:
+      return "VERBOSE";
+    case TRACE_LEVEL_RESERVED6:
+      return "RESERVED6";
+    case TRACE_LEVEL_RESERVED7:
+      return "RESERVED7";
+    case TRACE_LEVEL_RESERVED8:
+      return "RESERVED8";
+    case TRACE_LEVEL_RESERVED9:
+      return "RESERVED9";
+  }
+
+  return "UNKNOWN";
+}
+
 bool LogViewFormatter::FormatColumn(ILogView* log_view,
                                     int row,
                                     Column col,
@@ -527,10 +542,39 @@ void LogListView::FindNext() {
   if (i < 0)
     i = 0;  // in case start == -1.
 
-  for (; down ? i < num_rows : i >= 0; down ? ++i : --i) {
-    std::string message(log_view_->GetMessage(i));
-    if (expression.PartialMatch(message))
-      break;
+  // Where the view can narrow down the rows holding the literal the
+  // expression requires, only those need searching.
+  bool is_literal = false;
+  std::string literal(
+      FilterProgram::GetRequiredLiteral(find_params_.expression_,
+                                        &is_literal));
+  std::string buffer;
+  std::vector<int> candidates;
+  if (!literal.empty() && log_view_->GetCandidateRows(literal, &candidates)) {
+    std::vector<int>::const_iterator it;
+    if (down) {
+      it = std::lower_bound(candidates.begin(), candidates.end(), i);
+      for (; it != candidates.end() && *it < num_rows; ++it) {
+        if (MessageMatches(log_view_, *it, expression, &buffer))
+          break;
+      }
+      i = it != candidates.end() && *it < num_rows ? *it : num_rows;
+    } else {
+      it = std::upper_bound(candidates.begin(), candidates.end(), i);
+      i = kNoItem;
+      while (it != candidates.begin()) {
+        --it;
+        if (MessageMatches(log_view_, *it, expression, &buffer)) {
+          i = *it;
+          break;
+        }
+      }
+    }
+  } else {
+    for (; down ? i < num_rows : i >= 0; down ? ++i : --i) {
+      if (MessageMatches(log_view_, i, expression, &buffer))
+        break;
+    }
   }
 
   if (i >= 0 && i < num_rows) {
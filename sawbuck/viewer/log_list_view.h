@@ -24,8 +24,10 @@
 #include <string>
 #include <vector>
 #include "base/message_loop.h"
+#include "base/string_piece.h"
 #include "sawbuck/viewer/find_dialog.h"
 #include "sawbuck/viewer/list_view_base.h"
+#include "sawbuck/viewer/log_row_summary.h"
 #include "sawbuck/viewer/resource.h"
 
 // Callback interface for ILogView.
@@ -52,8 +54,27 @@ class ILogView {
   virtual std::string GetFileName(int row) = 0;
   virtual int GetLine(int row) = 0;
   virtual std::string GetMessage(int row) = 0;
+  // Returns the message of @p row, copying it to @p buffer only if need be.
+  // The returned piece refers either to @p buffer, or to text that remains
+  // valid until the log is cleared. Reusing @p buffer saves allocations.
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) = 0;
   virtual void GetStackTrace(int row, std::vector<void*>* trace) = 0;
 
+  // Finds the rows whose message may contain @p literal, ignoring ASCII case.
+  // @param literal the literal to find.
+  // @param rows returns the candidate rows in increasing order, which
+  //     include all rows containing @p literal.
+  // @returns false if the view can't narrow down the rows, in which case
+  //     all rows are candidates.
+  virtual bool GetCandidateRows(const base::StringPiece& literal,
+                                std::vector<int>* rows) = 0;
+
+  // Gets the summary of a range of rows that includes @p row.
+  // @param row the row to summarize.
+  // @param summary returns the summary, along with its range of rows.
+  // @returns false if the view has no summary of @p row.
+  virtual bool GetRowSummary(int row, LogRowSummary* summary) = 0;
+
   // Register for change notifications. Notifications will be issued
   // on the thread where the registration was made.
   virtual void Register(ILogViewEvents* event_sink,
@@ -78,6 +99,9 @@ class LogViewFormatter {
 
   LogViewFormatter();
 
+  // @returns the text the SEVERITY column shows for @p severity.
+  static const char* GetSeverityText(UCHAR severity);
+
   bool FormatColumn(ILogView* log_view,
                     int row,
                     Column col,
@@ -0,0 +1,413 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message store implementation.
+#include "sawbuck/viewer/log_message_store.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// The layout of the arrays in the block of a page, widest fields first so
+// that each array is aligned.
+const size_t kTimesOffset = 0;
+const size_t kMessageChunksOffset =
+    kTimesOffset + LogMessageStore::kRowsPerPage * sizeof(int64);
+const size_t kMessageOffsetsOffset =
+    kMessageChunksOffset + LogMessageStore::kRowsPerPage * sizeof(uint32);
+const size_t kMessageLengthsOffset =
+    kMessageOffsetsOffset + LogMessageStore::kRowsPerPage * sizeof(uint32);
+const size_t kProcessIdsOffset =
+    kMessageLengthsOffset + LogMessageStore::kRowsPerPage * sizeof(uint32);
+const size_t kThreadIdsOffset =
+    kProcessIdsOffset + LogMessageStore::kRowsPerPage * sizeof(DWORD);
+const size_t kLinesOffset =
+    kThreadIdsOffset + LogMessageStore::kRowsPerPage * sizeof(DWORD);
+const size_t kFileIdsOffset =
+    kLinesOffset + LogMessageStore::kRowsPerPage * sizeof(int);
+const size_t kTraceIdsOffset =
+    kFileIdsOffset + LogMessageStore::kRowsPerPage * sizeof(uint32);
+const size_t kLevelsOffset =
+    kTraceIdsOffset + LogMessageStore::kRowsPerPage * sizeof(uint32);
+const size_t kPageSize =
+    kLevelsOffset + LogMessageStore::kRowsPerPage * sizeof(UCHAR);
+
+// The value of current_chunk_ while there's no current chunk.
+const size_t kNoChunk = static_cast<size_t>(-1);
+
+// @returns the array at @p offset in the page block @p data.
+template <typename T>
+T* GetColumn(char* data, size_t offset) {
+  return reinterpret_cast<T*>(data + offset);
+}
+
+}  // namespace
+
+LogMessageStore::MessageInfo::MessageInfo()
+    : level(0), process_id(0), thread_id(0), line(0), trace(NULL),
+      trace_depth(0) {
+}
+
+LogMessageStore::Block::Block()
+    : offset(-1), size(0), data(NULL), last_access(0) {
+}
+
+LogMessageStore::LogMessageStore()
+    : size_(0), page_file_failed_(false),
+      max_mapped_blocks_(kDefaultMaxMappedBlocks), access_clock_(0),
+      current_chunk_(kNoChunk), current_chunk_used_(0), last_file_id_(0) {
+  ResetTables();
+}
+
+LogMessageStore::~LogMessageStore() {
+  Clear();
+}
+
+size_t LogMessageStore::AddMessage(const MessageInfo& info) {
+  DCHECK(info.trace != NULL || info.trace_depth == 0);
+
+  size_t row = size_;
+  size_t index = row % kRowsPerPage;
+  if (index == 0)
+    AddPage();
+
+  uint32 chunk = 0;
+  uint32 offset = 0;
+  AppendMessageText(info.message, &chunk, &offset);
+
+  // The current page stays mapped.
+  Page& page = pages_.back();
+  char* data = blocks_[page.block].data;
+  GetColumn<int64>(data, kTimesOffset)[index] = info.time.ToInternalValue();
+  GetColumn<uint32>(data, kMessageChunksOffset)[index] = chunk;
+  GetColumn<uint32>(data, kMessageOffsetsOffset)[index] = offset;
+  GetColumn<uint32>(data, kMessageLengthsOffset)[index] = info.message.size();
+  GetColumn<DWORD>(data, kProcessIdsOffset)[index] = info.process_id;
+  GetColumn<DWORD>(data, kThreadIdsOffset)[index] = info.thread_id;
+  GetColumn<int>(data, kLinesOffset)[index] = info.line;
+  GetColumn<uint32>(data, kFileIdsOffset)[index] = InternFileName(info.file);
+  GetColumn<uint32>(data, kTraceIdsOffset)[index] = InternStackTrace(info);
+  GetColumn<UCHAR>(data, kLevelsOffset)[index] = info.level;
+  page.summary.AddRow(info.level, info.process_id, info.thread_id, info.time);
+
+  ++size_;
+  return row;
+}
+
+void LogMessageStore::Clear() {
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    Block& block = blocks_[i];
+    if (block.data == NULL)
+      continue;
+
+    if (block.offset == -1)
+      delete [] block.data;
+    else
+      page_file_.Unmap(block.data);
+  }
+  // Swap the vectors out, as clear() keeps their storage.
+  std::vector<Block>().swap(blocks_);
+  std::vector<size_t>().swap(mapped_blocks_);
+  std::vector<Page>().swap(pages_);
+  size_ = 0;
+
+  current_chunk_ = kNoChunk;
+  current_chunk_used_ = 0;
+
+  // All views are gone, and the page file along with them.
+  page_file_.Close();
+  page_file_failed_ = false;
+
+  ResetTables();
+}
+
+UCHAR LogMessageStore::GetLevel(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return GetColumn<UCHAR>(data, kLevelsOffset)[index];
+}
+
+DWORD LogMessageStore::GetProcessId(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return GetColumn<DWORD>(data, kProcessIdsOffset)[index];
+}
+
+DWORD LogMessageStore::GetThreadId(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return GetColumn<DWORD>(data, kThreadIdsOffset)[index];
+}
+
+base::Time LogMessageStore::GetTime(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return base::Time::FromInternalValue(
+      GetColumn<int64>(data, kTimesOffset)[index]);
+}
+
+const std::string& LogMessageStore::GetFileName(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return *file_names_[GetColumn<uint32>(data, kFileIdsOffset)[index]];
+}
+
+int LogMessageStore::GetLine(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return GetColumn<int>(data, kLinesOffset)[index];
+}
+
+base::StringPiece LogMessageStore::GetMessage(size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  uint32 length = GetColumn<uint32>(data, kMessageLengthsOffset)[index];
+  if (length == 0)
+    return base::StringPiece();
+
+  // Mapping the chunk may unmap the page, so read the page first.
+  uint32 chunk = GetColumn<uint32>(data, kMessageChunksOffset)[index];
+  uint32 offset = GetColumn<uint32>(data, kMessageOffsetsOffset)[index];
+  return base::StringPiece(GetBlockData(chunk) + offset, length);
+}
+
+const LogMessageStore::StackTrace& LogMessageStore::GetStackTrace(
+    size_t row) {
+  size_t index = 0;
+  char* data = GetPageData(row, &index);
+  return *stack_traces_[GetColumn<uint32>(data, kTraceIdsOffset)[index]];
+}
+
+void LogMessageStore::GetRowSummary(size_t row,
+                                    LogRowSummary* summary) const {
+  DCHECK_LT(row, size_);
+  DCHECK(summary != NULL);
+
+  size_t page_index = row / kRowsPerPage;
+  size_t first_row = page_index * kRowsPerPage;
+  *summary = pages_[page_index].summary;
+  summary->first_row = static_cast<int>(first_row);
+  summary->end_row =
+      static_cast<int>(std::min(size_, first_row + kRowsPerPage));
+}
+
+size_t LogMessageStore::GetMemoryUsage() const {
+  size_t usage = blocks_.capacity() * sizeof(blocks_[0]) +
+      mapped_blocks_.capacity() * sizeof(mapped_blocks_[0]) +
+      pages_.capacity() * sizeof(pages_[0]);
+
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    if (blocks_[i].data != NULL)
+      usage += blocks_[i].size;
+  }
+
+  FileNameMap::const_iterator file_it = file_name_ids_.begin();
+  for (; file_it != file_name_ids_.end(); ++file_it) {
+    usage += sizeof(*file_it) + sizeof(const std::string*) +
+        file_it->first.capacity();
+  }
+
+  StackTraceMap::const_iterator trace_it = stack_trace_ids_.begin();
+  for (; trace_it != stack_trace_ids_.end(); ++trace_it) {
+    usage += sizeof(*trace_it) + sizeof(const StackTrace*) +
+        trace_it->first.capacity() * sizeof(void*);
+  }
+
+  return usage;
+}
+
+char* LogMessageStore::GetPageData(size_t row, size_t* index) {
+  DCHECK_LT(row, size_);
+  DCHECK(index != NULL);
+
+  *index = row % kRowsPerPage;
+  return GetBlockData(pages_[row / kRowsPerPage].block);
+}
+
+char* LogMessageStore::GetBlockData(size_t block_index) {
+  DCHECK_LT(block_index, blocks_.size());
+
+  if (blocks_[block_index].data == NULL)
+    MapBlock(block_index);
+
+  Block& block = blocks_[block_index];
+  block.last_access = ++access_clock_;
+  return block.data;
+}
+
+void LogMessageStore::MapBlock(size_t block_index) {
+  Block& block = blocks_[block_index];
+  DCHECK(block.data == NULL);
+  DCHECK_NE(-1, block.offset);
+
+  while (!mapped_blocks_.empty() &&
+         mapped_blocks_.size() >= max_mapped_blocks_) {
+    UnmapLeastRecentlyUsedBlock();
+  }
+
+  // There's no recovering from running out of address space.
+  block.data = page_file_.Map(block.offset, block.size);
+  CHECK(block.data != NULL) << "Unable to map a log block.";
+  mapped_blocks_.push_back(block_index);
+}
+
+void LogMessageStore::ReleaseBlock(size_t block_index) {
+  Block& block = blocks_[block_index];
+  if (block.offset == -1)
+    return;
+
+  // The block was just written to, and so is the most recently used.
+  block.last_access = ++access_clock_;
+  mapped_blocks_.push_back(block_index);
+  while (mapped_blocks_.size() > max_mapped_blocks_)
+    UnmapLeastRecentlyUsedBlock();
+}
+
+void LogMessageStore::UnmapLeastRecentlyUsedBlock() {
+  DCHECK(!mapped_blocks_.empty());
+
+  std::vector<size_t>::iterator lru(mapped_blocks_.begin());
+  std::vector<size_t>::iterator it(mapped_blocks_.begin());
+  for (; it != mapped_blocks_.end(); ++it) {
+    if (blocks_[*it].last_access < blocks_[*lru].last_access)
+      lru = it;
+  }
+
+  Block& block = blocks_[*lru];
+  page_file_.Unmap(block.data);
+  block.data = NULL;
+
+  *lru = mapped_blocks_.back();
+  mapped_blocks_.pop_back();
+}
+
+void LogMessageStore::AddPage() {
+  // The current page becomes like any other page of the page file.
+  if (!pages_.empty())
+    ReleaseBlock(pages_.back().block);
+
+  Page page;
+  page.block = AllocateBlock(kPageSize);
+  pages_.push_back(page);
+}
+
+size_t LogMessageStore::AllocateBlock(size_t size) {
+  if (!page_file_.is_open() && !page_file_failed_) {
+    page_file_failed_ = !page_file_.Create();
+    if (page_file_failed_)
+      LOG(WARNING) << "Keeping the log in memory.";
+  }
+
+  Block block;
+  block.size = size;
+  block.last_access = ++access_clock_;
+  if (page_file_.is_open()) {
+    int64 offset = page_file_.Allocate(size);
+    if (offset != -1) {
+      block.data = page_file_.Map(offset, size);
+      if (block.data != NULL)
+        block.offset = offset;
+    }
+  }
+
+  if (block.data == NULL)
+    block.data = new char[size];
+
+  blocks_.push_back(block);
+  return blocks_.size() - 1;
+}
+
+void LogMessageStore::AppendMessageText(const base::StringPiece& message,
+                                        uint32* chunk,
+                                        uint32* offset) {
+  DCHECK(chunk != NULL);
+  DCHECK(offset != NULL);
+
+  *chunk = 0;
+  *offset = 0;
+  if (message.empty())
+    return;
+
+  // Messages longer than a chunk get their own chunk, which leaves the
+  // current chunk alone.
+  if (message.size() > kMessageChunkSize) {
+    size_t block_index = AllocateBlock(message.size());
+    message.copy(blocks_[block_index].data, message.size());
+    ReleaseBlock(block_index);
+    *chunk = block_index;
+    return;
+  }
+
+  if (current_chunk_ == kNoChunk ||
+      kMessageChunkSize - current_chunk_used_ < message.size()) {
+    if (current_chunk_ != kNoChunk)
+      ReleaseBlock(current_chunk_);
+    current_chunk_ = AllocateBlock(kMessageChunkSize);
+    current_chunk_used_ = 0;
+  }
+
+  // The current chunk stays mapped.
+  message.copy(blocks_[current_chunk_].data + current_chunk_used_,
+               message.size());
+  *chunk = current_chunk_;
+  *offset = current_chunk_used_;
+  current_chunk_used_ += message.size();
+}
+
+uint32 LogMessageStore::InternFileName(const base::StringPiece& file) {
+  if (file == *file_names_[last_file_id_])
+    return last_file_id_;
+
+  std::pair<FileNameMap::iterator, bool> inserted =
+      file_name_ids_.insert(std::make_pair(file.as_string(),
+                                           file_names_.size()));
+  if (inserted.second)
+    file_names_.push_back(&inserted.first->first);
+
+  last_file_id_ = inserted.first->second;
+  return last_file_id_;
+}
+
+uint32 LogMessageStore::InternStackTrace(const MessageInfo& info) {
+  if (info.trace_depth == 0)
+    return 0;
+
+  std::pair<StackTraceMap::iterator, bool> inserted =
+      stack_trace_ids_.insert(
+          std::make_pair(StackTrace(info.trace, info.trace + info.trace_depth),
+                         stack_traces_.size()));
+  if (inserted.second)
+    stack_traces_.push_back(&inserted.first->first);
+
+  return inserted.first->second;
+}
+
+void LogMessageStore::ResetTables() {
+  file_name_ids_.clear();
+  file_names_.clear();
+  stack_trace_ids_.clear();
+  stack_traces_.clear();
+
+  std::pair<FileNameMap::iterator, bool> file_inserted =
+      file_name_ids_.insert(std::make_pair(std::string(), 0));
+  DCHECK(file_inserted.second);
+  file_names_.push_back(&file_inserted.first->first);
+  last_file_id_ = 0;
+
+  std::pair<StackTraceMap::iterator, bool> trace_inserted =
+      stack_trace_ids_.insert(std::make_pair(StackTrace(), 0));
+  DCHECK(trace_inserted.second);
+  stack_traces_.push_back(&trace_inserted.first->first);
+}
@@ -0,0 +1,236 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message store declaration.
+#ifndef SAWBUCK_VIEWER_LOG_MESSAGE_STORE_H_
+#define SAWBUCK_VIEWER_LOG_MESSAGE_STORE_H_
+
+#include <windows.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/string_piece.h"
+#include "base/time.h"
+#include "sawbuck/viewer/log_page_file.h"
+#include "sawbuck/viewer/log_row_summary.h"
+
+// Stores log messages column by column, which keeps the per-message overhead
+// down on large logs. The rows are partitioned into pages, which hold the
+// fixed-width fields of their messages in one array per field, and a summary
+// of their rows. The file names are interned, the message text is appended
+// to large chunks, and identical stack traces are stored once.
+//
+// The pages and the chunks of message text live in a temporary page file, so
+// that the system can write them out and drop them under memory pressure.
+// Only the most recently used pages and chunks stay mapped, the others are
+// mapped back in as their rows are accessed. Should the page file be
+// unavailable, the pages and the chunks live on the heap instead.
+// Note: This class is not thread-safe. The accessors may map pages in, and
+//     so aren't const.
+class LogMessageStore {
+ public:
+  typedef std::vector<void*> StackTrace;
+
+  // Describes a message to append to the store. The strings and the stack
+  // trace are only referred to, AddMessage copies them.
+  struct MessageInfo {
+    MessageInfo();
+
+    UCHAR level;
+    DWORD process_id;
+    DWORD thread_id;
+    base::Time time;
+    base::StringPiece file;
+    int line;
+    base::StringPiece message;
+    void* const* trace;
+    size_t trace_depth;
+  };
+
+  // The size of the chunks the message text is appended to.
+  static const size_t kMessageChunkSize = 1024 * 1024;
+  // The number of rows in a page.
+  static const size_t kRowsPerPage = 16 * 1024;
+  // The default number of pages and message chunks kept mapped.
+  static const size_t kDefaultMaxMappedBlocks = 64;
+
+  LogMessageStore();
+  ~LogMessageStore();
+
+  // Appends a message to the store.
+  // @param info the message to append.
+  // @returns the row of the new message.
+  size_t AddMessage(const MessageInfo& info);
+
+  // Removes all of the messages from the store.
+  void Clear();
+
+  // @returns the number of messages in the store.
+  size_t size() const { return size_; }
+
+  // @name Accessors for the fields of the message at @p row.
+  // @{
+  UCHAR GetLevel(size_t row);
+  DWORD GetProcessId(size_t row);
+  DWORD GetThreadId(size_t row);
+  base::Time GetTime(size_t row);
+  const std::string& GetFileName(size_t row);
+  int GetLine(size_t row);
+  // @returns the message text, which stays valid until the next call to the
+  //     store, as that may unmap its chunk.
+  base::StringPiece GetMessage(size_t row);
+  const StackTrace& GetStackTrace(size_t row);
+  // @}
+
+  // Gets the summary of the page holding @p row, which covers the rows of
+  // the page added so far.
+  void GetRowSummary(size_t row, LogRowSummary* summary) const;
+
+  // @returns the number of distinct file names in the store.
+  size_t num_file_names() const { return file_names_.size(); }
+  // @returns the number of distinct stack traces in the store.
+  size_t num_stack_traces() const { return stack_traces_.size(); }
+
+  // @returns the number of pages in the store.
+  size_t num_pages() const { return pages_.size(); }
+  // @returns the number of pages and message chunks of the page file
+  //     mapped, not counting the current page and chunk.
+  size_t num_mapped_blocks() const { return mapped_blocks_.size(); }
+
+  // Sets the number of pages and message chunks kept mapped. The current
+  // page and chunk, and the blocks on the heap, are always mapped and don't
+  // count.
+  void set_max_mapped_blocks(size_t max_mapped_blocks) {
+    max_mapped_blocks_ = max_mapped_blocks;
+  }
+
+  // @returns an estimate of the memory used by the store, in bytes. This
+  //     counts the mapped pages and message chunks, part of which the system
+  //     may have dropped.
+  size_t GetMemoryUsage() const;
+
+ private:
+  // A page of rows, or a chunk of message text.
+  struct Block {
+    Block();
+
+    // The offset of the block in the page file, or -1 if the block lives on
+    // the heap.
+    int64 offset;
+    size_t size;
+    // The block while it's mapped, or NULL.
+    char* data;
+    // The value of access_clock_ when the block was last accessed.
+    uint32 last_access;
+  };
+
+  // A page of rows. Its fields are laid out in one block, one array after
+  // the other.
+  struct Page {
+    // The index of the page's block in blocks_.
+    size_t block;
+    LogRowSummary summary;
+  };
+
+  // @returns the mapped block of the page holding @p row, and the index of
+  //     @p row in the page.
+  char* GetPageData(size_t row, size_t* index);
+
+  // @returns the block at @p block_index, mapping it back in as needed.
+  char* GetBlockData(size_t block_index);
+
+  // Maps the block at @p block_index back in, unmapping the least recently
+  // used blocks as needed.
+  void MapBlock(size_t block_index);
+
+  // Makes the block at @p block_index like any other of the page file, which
+  // can be unmapped once no longer in use.
+  void ReleaseBlock(size_t block_index);
+
+  // Unmaps the least recently used of mapped_blocks_.
+  void UnmapLeastRecentlyUsedBlock();
+
+  // Appends a page to the store, which becomes the current page.
+  void AddPage();
+
+  // Appends a mapped block of @p size bytes to blocks_, which lives in the
+  // page file, or on the heap should that fail.
+  // @returns the index of the block.
+  size_t AllocateBlock(size_t size);
+
+  // Copies @p message to the message chunks.
+  // @param chunk returns the index of the block the copy is in.
+  // @param offset returns the offset of the copy in the block.
+  void AppendMessageText(const base::StringPiece& message,
+                         uint32* chunk,
+                         uint32* offset);
+
+  // Interns @p file.
+  // @returns the id of @p file in file_names_.
+  uint32 InternFileName(const base::StringPiece& file);
+
+  // Interns the stack trace of @p info.
+  // @returns the id of the stack trace in stack_traces_.
+  uint32 InternStackTrace(const MessageInfo& info);
+
+  // Resets the interning tables to contain only the empty file name and the
+  // empty stack trace, both with id 0.
+  void ResetTables();
+
+  // The number of messages in the store.
+  size_t size_;
+
+  // The backing file of the pages and the message text, which is created
+  // along with the first page. If that fails, all blocks live on the heap
+  // until the store is cleared.
+  LogPageFile page_file_;
+  bool page_file_failed_;
+
+  // The blocks of the pages and of the message text.
+  std::vector<Block> blocks_;
+  // The mapped blocks of the page file, other than the current page and
+  // chunk.
+  std::vector<size_t> mapped_blocks_;
+  size_t max_mapped_blocks_;
+  // Counts block accesses, to find the least recently used block. Should it
+  // wrap, a few blocks get unmapped out of order, which is harmless.
+  uint32 access_clock_;
+
+  // The pages of the store. The last page is the current page, which rows
+  // are added to.
+  std::vector<Page> pages_;
+
+  // The index of the block messages are currently appended to, and how much
+  // of it is used. Messages longer than a chunk get a chunk of their own.
+  size_t current_chunk_;
+  size_t current_chunk_used_;
+
+  // The interned file names. The vector points to the keys of the map.
+  typedef std::map<std::string, uint32> FileNameMap;
+  FileNameMap file_name_ids_;
+  std::vector<const std::string*> file_names_;
+  // The id of the last file name interned, as consecutive messages often
+  // share their file.
+  uint32 last_file_id_;
+
+  // The distinct stack traces. The vector points to the keys of the map.
+  typedef std::map<StackTrace, uint32> StackTraceMap;
+  StackTraceMap stack_trace_ids_;
+  std::vector<const StackTrace*> stack_traces_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogMessageStore);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_MESSAGE_STORE_H_
@@ -0,0 +1,248 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message store unittests.
+#include "sawbuck/viewer/log_message_store.h"
+
+#include "base/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class LogMessageStoreTest : public testing::Test {
+ public:
+  LogMessageStore::MessageInfo CreateMessage(const char* file,
+                                             const char* message) {
+    LogMessageStore::MessageInfo info;
+    info.level = 2;
+    info.process_id = 10;
+    info.thread_id = 20;
+    info.time = base::Time::FromInternalValue(12345);
+    info.file = file;
+    info.line = 42;
+    info.message = message;
+    return info;
+  }
+
+ protected:
+  LogMessageStore store_;
+};
+
+}  // namespace
+
+TEST_F(LogMessageStoreTest, AddMessage) {
+  void* trace[] = { &trace, this };
+  LogMessageStore::MessageInfo info = CreateMessage("foo.cc", "Hello");
+  info.trace = trace;
+  info.trace_depth = arraysize(trace);
+
+  EXPECT_EQ(0U, store_.size());
+  EXPECT_EQ(0U, store_.AddMessage(info));
+  EXPECT_EQ(1U, store_.AddMessage(CreateMessage("", "")));
+  ASSERT_EQ(2U, store_.size());
+
+  EXPECT_EQ(2, store_.GetLevel(0));
+  EXPECT_EQ(10, store_.GetProcessId(0));
+  EXPECT_EQ(20, store_.GetThreadId(0));
+  EXPECT_EQ(12345, store_.GetTime(0).ToInternalValue());
+  EXPECT_EQ("foo.cc", store_.GetFileName(0));
+  EXPECT_EQ(42, store_.GetLine(0));
+  EXPECT_EQ("Hello", store_.GetMessage(0).as_string());
+  ASSERT_EQ(2U, store_.GetStackTrace(0).size());
+  EXPECT_EQ(trace[0], store_.GetStackTrace(0)[0]);
+  EXPECT_EQ(trace[1], store_.GetStackTrace(0)[1]);
+
+  EXPECT_EQ("", store_.GetFileName(1));
+  EXPECT_TRUE(store_.GetMessage(1).empty());
+  EXPECT_TRUE(store_.GetStackTrace(1).empty());
+
+  store_.Clear();
+  EXPECT_EQ(0U, store_.size());
+  EXPECT_EQ(1U, store_.num_file_names());
+  EXPECT_EQ(1U, store_.num_stack_traces());
+}
+
+TEST_F(LogMessageStoreTest, InternsFileNamesAndStackTraces) {
+  void* trace1[] = { &trace1 };
+  void* trace2[] = { &trace2 };
+
+  const char* kFiles[] = { "foo.cc", "bar.cc", "foo.cc", "bar.cc" };
+  void** kTraces[] = { trace1, trace2, trace2, trace1 };
+  for (size_t i = 0; i < arraysize(kFiles); ++i) {
+    LogMessageStore::MessageInfo info = CreateMessage(kFiles[i], "Message");
+    info.trace = kTraces[i];
+    info.trace_depth = 1;
+    store_.AddMessage(info);
+  }
+
+  // The empty file name and stack trace are always present.
+  EXPECT_EQ(3U, store_.num_file_names());
+  EXPECT_EQ(3U, store_.num_stack_traces());
+
+  for (size_t i = 0; i < arraysize(kFiles); ++i) {
+    EXPECT_EQ(kFiles[i], store_.GetFileName(i));
+    ASSERT_EQ(1U, store_.GetStackTrace(i).size());
+    EXPECT_EQ(kTraces[i][0], store_.GetStackTrace(i)[0]);
+  }
+  EXPECT_EQ(&store_.GetFileName(0), &store_.GetFileName(2));
+  EXPECT_EQ(&store_.GetStackTrace(0), &store_.GetStackTrace(3));
+}
+
+TEST_F(LogMessageStoreTest, StoresMessagesAcrossChunks) {
+  std::string long_message(LogMessageStore::kMessageChunkSize + 1, 'x');
+  std::string chunk_filler(LogMessageStore::kMessageChunkSize / 2, 'y');
+
+  store_.AddMessage(CreateMessage("", "First"));
+
+  // Fill the first chunk past the point where a message fits, and add a
+  // message that doesn't fit in any chunk.
+  store_.AddMessage(CreateMessage("", chunk_filler.c_str()));
+  store_.AddMessage(CreateMessage("", long_message.c_str()));
+  store_.AddMessage(CreateMessage("", chunk_filler.c_str()));
+  for (size_t i = 0; i < 1000; ++i)
+    store_.AddMessage(CreateMessage("", "Some message"));
+
+  EXPECT_EQ("First", store_.GetMessage(0).as_string());
+  EXPECT_EQ(chunk_filler, store_.GetMessage(1).as_string());
+  EXPECT_EQ(long_message, store_.GetMessage(2).as_string());
+  EXPECT_EQ(chunk_filler, store_.GetMessage(3).as_string());
+  EXPECT_EQ("Some message", store_.GetMessage(1003).as_string());
+}
+
+TEST_F(LogMessageStoreTest, MemoryUsage) {
+  // Each message costs 41 bytes in its page, plus the slack of the current
+  // page and its message text. A message with its own strings and stack
+  // trace costs over twice that before counting their heap blocks.
+  const size_t kNumMessages = 100000;
+  const size_t kMaxOverheadPerMessage = 80;
+
+  void* trace[] = { &trace, this };
+  size_t message_bytes = 0;
+  for (size_t i = 0; i < kNumMessages; ++i) {
+    std::string message(
+        base::StringPrintf("Message number %d", static_cast<int>(i)));
+    LogMessageStore::MessageInfo info =
+        CreateMessage(i % 2 ? "foo.cc" : "bar.cc", message.c_str());
+    info.trace = trace;
+    info.trace_depth = arraysize(trace);
+    store_.AddMessage(info);
+
+    message_bytes += message.size();
+  }
+
+  // Round up to the chunks holding the message text.
+  size_t message_chunk_bytes =
+      (message_bytes / LogMessageStore::kMessageChunkSize + 1) *
+          LogMessageStore::kMessageChunkSize;
+  size_t usage = store_.GetMemoryUsage();
+  EXPECT_LT(usage, message_chunk_bytes + kNumMessages * kMaxOverheadPerMessage);
+}
+
+TEST_F(LogMessageStoreTest, MapsPagesInAndOut) {
+  const size_t kNumRows = 5 * LogMessageStore::kRowsPerPage + 10;
+  store_.set_max_mapped_blocks(2);
+
+  for (size_t i = 0; i < kNumRows; ++i) {
+    std::string message(base::StringPrintf("Message %d", static_cast<int>(i)));
+    LogMessageStore::MessageInfo info = CreateMessage("", message.c_str());
+    info.level = i % 7;
+    info.process_id = i;
+    info.time = base::Time::FromInternalValue(i);
+    info.line = i;
+    store_.AddMessage(info);
+  }
+  ASSERT_EQ(kNumRows, store_.size());
+  EXPECT_EQ(6U, store_.num_pages());
+  EXPECT_GE(2U, store_.num_mapped_blocks());
+
+  // Stride across the pages, so that each access maps a page back in.
+  for (size_t start = 0; start < LogMessageStore::kRowsPerPage; start += 997) {
+    for (size_t row = start; row < kNumRows;
+         row += LogMessageStore::kRowsPerPage) {
+      int value = static_cast<int>(row);
+      ASSERT_EQ(value % 7, store_.GetLevel(row));
+      ASSERT_EQ(value, store_.GetProcessId(row));
+      ASSERT_EQ(20, store_.GetThreadId(row));
+      ASSERT_EQ(value, store_.GetTime(row).ToInternalValue());
+      ASSERT_EQ(value, store_.GetLine(row));
+      ASSERT_EQ(base::StringPrintf("Message %d", value),
+                store_.GetMessage(row).as_string());
+    }
+    EXPECT_GE(2U, store_.num_mapped_blocks());
+  }
+}
+
+TEST_F(LogMessageStoreTest, MapsMessageChunksInAndOut) {
+  const size_t kNumMessages = 20;
+  store_.set_max_mapped_blocks(2);
+
+  // Each message fills most of a chunk of its own.
+  std::vector<std::string> messages;
+  for (size_t i = 0; i < kNumMessages; ++i) {
+    messages.push_back(
+        std::string(LogMessageStore::kMessageChunkSize * 3 / 4, 'a' + i));
+    store_.AddMessage(CreateMessage("", messages.back().c_str()));
+  }
+  EXPECT_GE(2U, store_.num_mapped_blocks());
+
+  // Only the recently used chunks stay mapped as they're read back.
+  for (size_t i = 0; i < kNumMessages; ++i) {
+    ASSERT_EQ(messages[i], store_.GetMessage(i).as_string());
+    EXPECT_GE(2U, store_.num_mapped_blocks());
+  }
+}
+
+TEST_F(LogMessageStoreTest, SummarizesPages) {
+  const int kRowsPerPage = LogMessageStore::kRowsPerPage;
+  const int kNumRows = kRowsPerPage + 2;
+
+  for (int i = 0; i < kNumRows; ++i) {
+    LogMessageStore::MessageInfo info = CreateMessage("", "");
+    bool first_page = i < kRowsPerPage;
+    info.level = first_page ? 1 : 200;
+    info.process_id = first_page ? 4 : 8;
+    info.thread_id = first_page ? 12 : 16;
+    info.time = base::Time::FromInternalValue(first_page ? 1000 - i : i);
+    store_.AddMessage(info);
+  }
+
+  LogRowSummary summary;
+  store_.GetRowSummary(10, &summary);
+  EXPECT_EQ(0, summary.first_row);
+  EXPECT_EQ(kRowsPerPage, summary.end_row);
+  EXPECT_EQ(1000 - kRowsPerPage + 1,
+            summary.min_time.ToInternalValue());
+  EXPECT_EQ(1000, summary.max_time.ToInternalValue());
+  EXPECT_TRUE(summary.MayHaveSeverity(1));
+  EXPECT_FALSE(summary.MayHaveSeverity(200));
+  EXPECT_TRUE(summary.MayHaveProcessId(4));
+  EXPECT_FALSE(summary.MayHaveProcessId(8));
+  EXPECT_TRUE(summary.MayHaveThreadId(12));
+  EXPECT_FALSE(summary.MayHaveThreadId(16));
+
+  // The current page covers the rows added so far. Severities above 31 share
+  // a bit.
+  store_.GetRowSummary(kNumRows - 1, &summary);
+  EXPECT_EQ(kRowsPerPage, summary.first_row);
+  EXPECT_EQ(kNumRows, summary.end_row);
+  EXPECT_EQ(kRowsPerPage, summary.min_time.ToInternalValue());
+  EXPECT_EQ(kNumRows - 1, summary.max_time.ToInternalValue());
+  EXPECT_FALSE(summary.MayHaveSeverity(1));
+  EXPECT_TRUE(summary.MayHaveSeverity(200));
+  EXPECT_TRUE(summary.MayHaveSeverity(100));
+  EXPECT_TRUE(summary.MayHaveProcessId(8));
+  EXPECT_FALSE(summary.MayHaveProcessId(4));
+  // Ids that are 256 apart share a bit.
+  EXPECT_TRUE(summary.MayHaveProcessId(8 + 256));
+}
@@ -0,0 +1,132 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log page file implementation.
+#include "sawbuck/viewer/log_page_file.h"
+
+#include <algorithm>
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+
+namespace {
+
+// The mapping grows by at least the smaller of its size and the maximum step,
+// which keeps down the number of mappings without reserving too much disk.
+const int64 kMinMappingStep = 16 * 1024 * 1024;
+const int64 kMaxMappingStep = 256 * 1024 * 1024;
+
+}  // namespace
+
+LogPageFile::LogPageFile() : mapping_size_(0), size_(0) {
+}
+
+LogPageFile::~LogPageFile() {
+  Close();
+}
+
+bool LogPageFile::Create() {
+  DCHECK(!is_open());
+
+  FilePath path;
+  if (!file_util::CreateTemporaryFile(&path)) {
+    LOG(ERROR) << "Unable to create a temporary file.";
+    return false;
+  }
+
+  // The file is only ever written through views, and goes away with its
+  // last handle.
+  file_.Set(::CreateFile(path.value().c_str(),
+                         GENERIC_READ | GENERIC_WRITE,
+                         0,
+                         NULL,
+                         CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                         NULL));
+  if (!file_.IsValid()) {
+    DWORD err = ::GetLastError();
+    LOG(ERROR) << "Unable to open page file \"" << path.value()
+               << "\", error: " << err;
+    file_util::Delete(path, false);
+    return false;
+  }
+
+  return true;
+}
+
+void LogPageFile::Close() {
+  mapping_.Close();
+  file_.Close();
+  mapping_size_ = 0;
+  size_ = 0;
+}
+
+int64 LogPageFile::Allocate(size_t size) {
+  DCHECK(is_open());
+
+  int64 block_size =
+      (size + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+  int64 offset = size_;
+  if (offset + block_size > mapping_size_) {
+    // Mapping past the end of the file extends it.
+    int64 step = std::min(std::max(mapping_size_, kMinMappingStep),
+                          kMaxMappingStep);
+    int64 mapping_size = std::max(offset + block_size, mapping_size_ + step);
+    HANDLE mapping = ::CreateFileMapping(file_,
+                                         NULL,
+                                         PAGE_READWRITE,
+                                         static_cast<DWORD>(mapping_size >> 32),
+                                         static_cast<DWORD>(mapping_size),
+                                         NULL);
+    if (mapping == NULL) {
+      DWORD err = ::GetLastError();
+      LOG(ERROR) << "Unable to grow page file to " << mapping_size
+                 << " bytes, error: " << err;
+      return -1;
+    }
+
+    mapping_.Set(mapping);
+    mapping_size_ = mapping_size;
+  }
+
+  size_ = offset + block_size;
+  return offset;
+}
+
+char* LogPageFile::Map(int64 offset, size_t size) {
+  DCHECK(is_open());
+  DCHECK_EQ(0, offset % static_cast<int64>(kBlockAlignment));
+  DCHECK_LE(offset + static_cast<int64>(size), size_);
+
+  void* view = ::MapViewOfFile(mapping_,
+                               FILE_MAP_WRITE,
+                               static_cast<DWORD>(offset >> 32),
+                               static_cast<DWORD>(offset),
+                               size);
+  if (view == NULL) {
+    DWORD err = ::GetLastError();
+    LOG(ERROR) << "Unable to map " << size << " bytes of page file at "
+               << offset << ", error: " << err;
+  }
+
+  return reinterpret_cast<char*>(view);
+}
+
+void LogPageFile::Unmap(char* view) {
+  DCHECK(view != NULL);
+  if (!::UnmapViewOfFile(view)) {
+    DWORD err = ::GetLastError();
+    LOG(ERROR) << "Unable to unmap page file view, error: " << err;
+  }
+}
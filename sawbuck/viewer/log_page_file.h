@@ -0,0 +1,77 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log page file declaration.
+#ifndef SAWBUCK_VIEWER_LOG_PAGE_FILE_H_
+#define SAWBUCK_VIEWER_LOG_PAGE_FILE_H_
+
+#include <windows.h>
+#include "base/basictypes.h"
+#include "base/win/scoped_handle.h"
+
+// A temporary file that backs the pages of a log, which are mapped into
+// memory while in use. As the pages are backed by the file rather than by
+// the page file, the system writes them out and drops them from memory
+// under memory pressure, and an unmapped page takes no memory at all.
+// The file is deleted once closed.
+// Note: This class is not thread-safe.
+class LogPageFile {
+ public:
+  // The alignment and granularity of the blocks in the file, which is the
+  // allocation granularity of views.
+  static const size_t kBlockAlignment = 64 * 1024;
+
+  LogPageFile();
+  ~LogPageFile();
+
+  // Creates the file in the temporary directory.
+  // @returns true on success.
+  bool Create();
+
+  // Closes and deletes the file. All views must be unmapped first.
+  void Close();
+
+  // @returns true if the file is open.
+  bool is_open() const { return file_.IsValid(); }
+
+  // Allocates a zeroed block at the end of the file.
+  // @param size the size of the block, which is rounded up to a multiple of
+  //     kBlockAlignment.
+  // @returns the offset of the block, or -1 on failure.
+  int64 Allocate(size_t size);
+
+  // Maps a block for reading and writing.
+  // @param offset the offset of the block, as returned by Allocate.
+  // @param size the size of the block.
+  // @returns the view of the block, or NULL on failure.
+  char* Map(int64 offset, size_t size);
+
+  // Unmaps a view returned by Map. The contents of the block are kept.
+  void Unmap(char* view);
+
+  // @returns the size of the blocks allocated.
+  int64 size() const { return size_; }
+
+ private:
+  base::win::ScopedHandle file_;
+  // The mapping views are created from, and its size. The mapping grows
+  // with the file, and views of earlier mappings stay valid and coherent.
+  base::win::ScopedHandle mapping_;
+  int64 mapping_size_;
+  int64 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogPageFile);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_PAGE_FILE_H_
@@ -0,0 +1,73 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log page file unittests.
+#include "sawbuck/viewer/log_page_file.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const int64 kAlignment = LogPageFile::kBlockAlignment;
+
+}  // namespace
+
+TEST(LogPageFileTest, CreateAndClose) {
+  LogPageFile file;
+  EXPECT_FALSE(file.is_open());
+  ASSERT_TRUE(file.Create());
+  EXPECT_TRUE(file.is_open());
+  EXPECT_EQ(0, file.size());
+
+  file.Close();
+  EXPECT_FALSE(file.is_open());
+}
+
+TEST(LogPageFileTest, KeepsBlocksAcrossMappings) {
+  LogPageFile file;
+  ASSERT_TRUE(file.Create());
+
+  // Blocks are aligned, and zeroed.
+  int64 first = file.Allocate(100);
+  int64 second = file.Allocate(kAlignment + 1);
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(kAlignment, second);
+  EXPECT_EQ(3 * kAlignment, file.size());
+
+  char* view = file.Map(second, kAlignment + 1);
+  ASSERT_TRUE(view != NULL);
+  EXPECT_EQ(0, view[0]);
+  EXPECT_EQ(0, view[kAlignment]);
+  view[0] = 'a';
+  view[kAlignment] = 'b';
+  file.Unmap(view);
+
+  // Growing the file leaves the contents of the blocks alone.
+  int64 large = file.Allocate(64 * 1024 * 1024);
+  EXPECT_EQ(3 * kAlignment, large);
+
+  view = file.Map(second, kAlignment + 1);
+  ASSERT_TRUE(view != NULL);
+  EXPECT_EQ('a', view[0]);
+  EXPECT_EQ('b', view[kAlignment]);
+
+  // Views of the same block see each other's writes.
+  char* other_view = file.Map(second, kAlignment + 1);
+  ASSERT_TRUE(other_view != NULL);
+  view[1] = 'c';
+  EXPECT_EQ('c', other_view[1]);
+
+  file.Unmap(other_view);
+  file.Unmap(view);
+}
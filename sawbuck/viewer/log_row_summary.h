@@ -0,0 +1,94 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log row summary declaration.
+#ifndef SAWBUCK_VIEWER_LOG_ROW_SUMMARY_H_
+#define SAWBUCK_VIEWER_LOG_ROW_SUMMARY_H_
+
+#include <windows.h>
+#include <algorithm>
+#include "base/basictypes.h"
+#include "base/time.h"
+
+// Summarizes a range of consecutive rows of a log, so that filters can rule
+// out the whole range without looking at its rows. The severities, process
+// ids and thread ids of the rows are kept as bitmasks, which may have false
+// positives but no false negatives.
+struct LogRowSummary {
+  LogRowSummary()
+      : first_row(0), end_row(0), severity_mask(0), process_id_mask(0),
+        thread_id_mask(0) {
+  }
+
+  // Adds a row to the summary, without changing its range.
+  void AddRow(int severity, DWORD process_id, DWORD thread_id,
+              base::Time time) {
+    // Each row sets a severity bit, so none are set before the first row.
+    if (severity_mask == 0) {
+      min_time = time;
+      max_time = time;
+    } else if (time < min_time) {
+      min_time = time;
+    } else if (time > max_time) {
+      max_time = time;
+    }
+
+    severity_mask |= GetSeverityBit(severity);
+    process_id_mask |= GetIdBit(process_id);
+    thread_id_mask |= GetIdBit(thread_id);
+  }
+
+  // @name Test for the fields of the summarized rows.
+  // @returns false if no row has the field value, true if some row may.
+  // @{
+  bool MayHaveSeverity(int severity) const {
+    return (severity_mask & GetSeverityBit(severity)) != 0;
+  }
+  bool MayHaveProcessId(DWORD process_id) const {
+    return (process_id_mask & GetIdBit(process_id)) != 0;
+  }
+  bool MayHaveThreadId(DWORD thread_id) const {
+    return (thread_id_mask & GetIdBit(thread_id)) != 0;
+  }
+  // @}
+
+  // @returns the bit of @p severity in severity_mask. Severities above 31
+  //     share the top bit.
+  static uint32 GetSeverityBit(int severity) {
+    // Severities are formatted as a UCHAR.
+    int bit = std::min(static_cast<int>(static_cast<UCHAR>(severity)), 31);
+    return 1U << bit;
+  }
+
+  // @returns the bit of @p id in the process and thread id masks. Process
+  //     and thread ids are multiples of four, so the low bits are dropped.
+  static uint64 GetIdBit(DWORD id) {
+    return 1ULL << ((id >> 2) % 64);
+  }
+
+  // The rows summarized are [first_row, end_row).
+  int first_row;
+  int end_row;
+
+  // The earliest and latest times of the rows. These are only meaningful
+  // once a row has been added.
+  base::Time min_time;
+  base::Time max_time;
+
+  uint32 severity_mask;
+  uint64 process_id_mask;
+  uint64 thread_id_mask;
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_ROW_SUMMARY_H_
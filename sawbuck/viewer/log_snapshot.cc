@@ -0,0 +1,591 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log snapshot implementation.
+#include "sawbuck/viewer/log_snapshot.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+
+namespace {
+
+// The file header, which is followed by the section table.
+struct FileHeader {
+  char magic[8];
+  uint32 version;
+  uint32 num_sections;
+};
+COMPILE_ASSERT(sizeof(FileHeader) == 16, file_header_size_is_wrong);
+
+struct SectionHeader {
+  uint32 type;
+  uint32 reserved;
+  uint64 offset;
+  uint64 size;
+};
+COMPILE_ASSERT(sizeof(SectionHeader) == 24, section_header_size_is_wrong);
+
+struct ModuleEventRecord {
+  uint32 type;
+  uint32 process_id;
+  int64 time;
+  uint64 base_address;
+  uint32 module_size;
+  uint32 image_checksum;
+  uint32 time_date_stamp;
+  uint32 reserved;
+};
+COMPILE_ASSERT(sizeof(ModuleEventRecord) == 40,
+               module_event_record_size_is_wrong);
+
+// The sections of a snapshot, each of which occurs once. Readers skip the
+// sections they don't know.
+enum SectionType {
+  kLevels,
+  kProcessIds,
+  kThreadIds,
+  kTimes,
+  kLines,
+  kFileIds,
+  kTraceIds,
+  kMessageOffsets,
+  kMessageText,
+  kFileNameOffsets,
+  kFileNameText,
+  kTraceOffsets,
+  kTraceAddresses,
+  kModuleEvents,
+  kModuleNameOffsets,
+  kModuleNameText,
+  kIndexTokenOffsets,
+  kIndexTokenText,
+  kIndexPostingOffsets,
+  kIndexPostingText,
+
+  kNumSectionTypes,
+};
+
+const char kMagic[8] = "SAWSNAP";
+const uint32 kVersion = 2;
+const uint64 kSectionAlignment = 8;
+
+// A section of the mapped file, which Parse has checked to be in bounds.
+struct MappedSection {
+  MappedSection() : data(NULL), size(0) {
+  }
+
+  const uint8* data;
+  size_t size;
+};
+
+// @returns true if @p section holds exactly @p count elements of @p T.
+template <typename T>
+bool HasCount(const MappedSection& section, size_t count) {
+  return section.size / sizeof(T) == count && section.size % sizeof(T) == 0;
+}
+
+// @returns true if the @p count + 1 @p offsets increase from zero to
+//     @p size.
+template <typename T>
+bool AreValidOffsets(const T* offsets, size_t count, size_t size) {
+  if (offsets[0] != 0 || offsets[count] != size)
+    return false;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (offsets[i] > offsets[i + 1])
+      return false;
+  }
+
+  return true;
+}
+
+// @returns true if all @p count @p ids are less than @p limit.
+bool AreValidIds(const uint32* ids, size_t count, size_t limit) {
+  for (size_t i = 0; i < count; ++i) {
+    if (ids[i] >= limit)
+      return false;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+LogSnapshotModuleEvent::LogSnapshotModuleEvent()
+    : type(MODULE_LOAD), process_id(0), base_address(0), module_size(0),
+      image_checksum(0), time_date_stamp(0) {
+}
+
+LogSnapshot::LogSnapshot()
+    : num_rows_(0), levels_(NULL), process_ids_(NULL), thread_ids_(NULL),
+      times_(NULL), lines_(NULL), file_ids_(NULL), trace_ids_(NULL),
+      trace_offsets_(NULL), trace_addresses_(NULL), num_module_events_(0),
+      module_events_(NULL), num_index_tokens_(0) {
+}
+
+LogSnapshot::~LogSnapshot() {
+}
+
+bool LogSnapshot::Open(const FilePath& path) {
+  DCHECK(!is_open());
+
+  scoped_ptr<file_util::MemoryMappedFile> file(
+      new file_util::MemoryMappedFile());
+  if (!file->Initialize(path)) {
+    LOG(ERROR) << "Unable to map snapshot \"" << path.value() << "\".";
+    return false;
+  }
+
+  if (!Parse(file->data(), file->length())) {
+    LOG(ERROR) << "\"" << path.value() << "\" is not a valid snapshot.";
+    num_rows_ = 0;
+    num_module_events_ = 0;
+    num_index_tokens_ = 0;
+    return false;
+  }
+
+  file_.swap(file);
+  return true;
+}
+
+void LogSnapshot::GetStackTrace(size_t row, std::vector<void*>* trace) const {
+  DCHECK(trace != NULL);
+
+  uint32 id = trace_ids_[row];
+  trace->clear();
+  trace->reserve(trace_offsets_[id + 1] - trace_offsets_[id]);
+  for (uint32 i = trace_offsets_[id]; i < trace_offsets_[id + 1]; ++i) {
+    trace->push_back(
+        reinterpret_cast<void*>(static_cast<uintptr_t>(trace_addresses_[i])));
+  }
+}
+
+void LogSnapshot::GetModuleEvent(size_t index, ModuleEvent* event) const {
+  DCHECK_LT(index, num_module_events_);
+  DCHECK(event != NULL);
+
+  const ModuleEventRecord& record =
+      reinterpret_cast<const ModuleEventRecord*>(module_events_)[index];
+  event->type = static_cast<ModuleEvent::Type>(record.type);
+  event->process_id = record.process_id;
+  event->time = base::Time::FromInternalValue(record.time);
+  event->base_address = record.base_address;
+  event->module_size = record.module_size;
+  event->image_checksum = record.image_checksum;
+  event->time_date_stamp = record.time_date_stamp;
+  module_names_.Get(index).CopyToString(&event->image_file_name);
+}
+
+bool LogSnapshot::LoadMessageIndex(MessageIndex* index) const {
+  DCHECK(index != NULL);
+  DCHECK_EQ(0U, index->num_tokens());
+
+  for (size_t i = 0; i < num_index_tokens_; ++i) {
+    if (!index->AddPostings(index_tokens_.Get(i), index_postings_.Get(i),
+                            num_rows_)) {
+      LOG(ERROR) << "The snapshot message index is not valid.";
+      index->Clear();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LogSnapshot::Parse(const uint8* data, size_t length) {
+  if (length < sizeof(FileHeader))
+    return false;
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion) {
+    return false;
+  }
+  if (header->num_sections >
+          (length - sizeof(FileHeader)) / sizeof(SectionHeader)) {
+    return false;
+  }
+
+  // Locate the sections.
+  const SectionHeader* section_headers =
+      reinterpret_cast<const SectionHeader*>(header + 1);
+  MappedSection sections[kNumSectionTypes];
+  bool found[kNumSectionTypes] = {};
+  for (uint32 i = 0; i < header->num_sections; ++i) {
+    const SectionHeader& section = section_headers[i];
+    if (section.type >= kNumSectionTypes)
+      continue;
+    if (found[section.type] || section.offset % kSectionAlignment != 0 ||
+        section.offset > length || section.size > length - section.offset) {
+      return false;
+    }
+
+    found[section.type] = true;
+    sections[section.type].data = data + static_cast<size_t>(section.offset);
+    sections[section.type].size = static_cast<size_t>(section.size);
+  }
+  for (size_t i = 0; i < kNumSectionTypes; ++i) {
+    if (!found[i])
+      return false;
+  }
+
+  // The fixed-width columns.
+  num_rows_ = sections[kLevels].size;
+  if (!HasCount<uint32>(sections[kProcessIds], num_rows_) ||
+      !HasCount<uint32>(sections[kThreadIds], num_rows_) ||
+      !HasCount<int64>(sections[kTimes], num_rows_) ||
+      !HasCount<int32>(sections[kLines], num_rows_) ||
+      !HasCount<uint32>(sections[kFileIds], num_rows_) ||
+      !HasCount<uint32>(sections[kTraceIds], num_rows_) ||
+      !HasCount<uint64>(sections[kMessageOffsets], num_rows_ + 1)) {
+    return false;
+  }
+  levels_ = sections[kLevels].data;
+  process_ids_ = reinterpret_cast<const uint32*>(sections[kProcessIds].data);
+  thread_ids_ = reinterpret_cast<const uint32*>(sections[kThreadIds].data);
+  times_ = reinterpret_cast<const int64*>(sections[kTimes].data);
+  lines_ = reinterpret_cast<const int32*>(sections[kLines].data);
+  file_ids_ = reinterpret_cast<const uint32*>(sections[kFileIds].data);
+  trace_ids_ = reinterpret_cast<const uint32*>(sections[kTraceIds].data);
+
+  // The message text.
+  messages_.offsets =
+      reinterpret_cast<const uint64*>(sections[kMessageOffsets].data);
+  messages_.text = reinterpret_cast<const char*>(sections[kMessageText].data);
+  if (!AreValidOffsets(messages_.offsets, num_rows_,
+                       sections[kMessageText].size)) {
+    return false;
+  }
+
+  // The file names.
+  size_t num_file_names = sections[kFileNameOffsets].size / sizeof(uint64);
+  if (num_file_names == 0 ||
+      !HasCount<uint64>(sections[kFileNameOffsets], num_file_names)) {
+    return false;
+  }
+  --num_file_names;
+  file_names_.offsets =
+      reinterpret_cast<const uint64*>(sections[kFileNameOffsets].data);
+  file_names_.text =
+      reinterpret_cast<const char*>(sections[kFileNameText].data);
+  if (!AreValidOffsets(file_names_.offsets, num_file_names,
+                       sections[kFileNameText].size) ||
+      !AreValidIds(file_ids_, num_rows_, num_file_names)) {
+    return false;
+  }
+
+  // The stack traces.
+  size_t num_traces = sections[kTraceOffsets].size / sizeof(uint32);
+  if (num_traces == 0 ||
+      !HasCount<uint32>(sections[kTraceOffsets], num_traces) ||
+      sections[kTraceAddresses].size % sizeof(uint64) != 0) {
+    return false;
+  }
+  --num_traces;
+  trace_offsets_ = reinterpret_cast<const uint32*>(sections[kTraceOffsets].data);
+  trace_addresses_ =
+      reinterpret_cast<const uint64*>(sections[kTraceAddresses].data);
+  if (!AreValidOffsets(trace_offsets_, num_traces,
+                       sections[kTraceAddresses].size / sizeof(uint64)) ||
+      !AreValidIds(trace_ids_, num_rows_, num_traces)) {
+    return false;
+  }
+
+  // The module events.
+  num_module_events_ = sections[kModuleEvents].size / sizeof(ModuleEventRecord);
+  if (!HasCount<ModuleEventRecord>(sections[kModuleEvents],
+                                   num_module_events_) ||
+      !HasCount<uint64>(sections[kModuleNameOffsets],
+                        num_module_events_ + 1)) {
+    return false;
+  }
+  module_events_ = sections[kModuleEvents].data;
+  module_names_.offsets =
+      reinterpret_cast<const uint64*>(sections[kModuleNameOffsets].data);
+  module_names_.text =
+      reinterpret_cast<const char*>(sections[kModuleNameText].data);
+  if (!AreValidOffsets(module_names_.offsets, num_module_events_,
+                       sections[kModuleNameText].size)) {
+    return false;
+  }
+  const ModuleEventRecord* module_events =
+      reinterpret_cast<const ModuleEventRecord*>(module_events_);
+  for (size_t i = 0; i < num_module_events_; ++i) {
+    switch (module_events[i].type) {
+      case ModuleEvent::MODULE_IS_LOADED:
+      case ModuleEvent::MODULE_LOAD:
+      case ModuleEvent::MODULE_UNLOAD:
+        break;
+      default:
+        return false;
+    }
+  }
+
+  // The message index. Its postings are checked as they are loaded.
+  num_index_tokens_ = sections[kIndexTokenOffsets].size / sizeof(uint64);
+  if (num_index_tokens_ == 0 ||
+      !HasCount<uint64>(sections[kIndexTokenOffsets], num_index_tokens_) ||
+      !HasCount<uint64>(sections[kIndexPostingOffsets], num_index_tokens_)) {
+    return false;
+  }
+  --num_index_tokens_;
+  index_tokens_.offsets =
+      reinterpret_cast<const uint64*>(sections[kIndexTokenOffsets].data);
+  index_tokens_.text =
+      reinterpret_cast<const char*>(sections[kIndexTokenText].data);
+  index_postings_.offsets =
+      reinterpret_cast<const uint64*>(sections[kIndexPostingOffsets].data);
+  index_postings_.text =
+      reinterpret_cast<const char*>(sections[kIndexPostingText].data);
+  if (!AreValidOffsets(index_tokens_.offsets, num_index_tokens_,
+                       sections[kIndexTokenText].size) ||
+      !AreValidOffsets(index_postings_.offsets, num_index_tokens_,
+                       sections[kIndexPostingText].size)) {
+    return false;
+  }
+
+  return true;
+}
+
+LogSnapshotWriter::Message::Message()
+    : level(0), process_id(0), thread_id(0), line(0), trace(NULL),
+      trace_depth(0) {
+}
+
+LogSnapshotWriter::LogSnapshotWriter() : file_size_(0) {
+}
+
+LogSnapshotWriter::~LogSnapshotWriter() {
+  // Discard an unfinished snapshot.
+  if (!temp_path_.empty()) {
+    file_.reset();
+    file_util::Delete(temp_path_, false);
+  }
+}
+
+bool LogSnapshotWriter::Create(const FilePath& path) {
+  DCHECK(file_.get() == NULL);
+  DCHECK(temp_path_.empty());
+
+  path_ = path;
+  if (!file_util::CreateTemporaryFileInDir(path.DirName(), &temp_path_)) {
+    LOG(ERROR) << "Unable to create a temporary file for snapshot \""
+               << path.value() << "\".";
+    return false;
+  }
+
+  file_.reset(file_util::OpenFile(temp_path_, "wb"));
+  if (file_.get() == NULL) {
+    LOG(ERROR) << "Unable to create snapshot \"" << path.value() << "\".";
+    return false;
+  }
+
+  // Reserve room for the header, which Finish writes once the sections are
+  // laid out. The message text follows it.
+  std::vector<uint8> header(sizeof(FileHeader) +
+                            kNumSectionTypes * sizeof(SectionHeader));
+  if (!Write(&header[0], header.size()) || !Align())
+    return false;
+
+  sections_[kMessageText].offset = file_size_;
+  message_offsets_.push_back(0);
+  return true;
+}
+
+bool LogSnapshotWriter::AddMessage(const Message& message) {
+  DCHECK(file_.get() != NULL);
+
+  if (!Write(message.message.data(), message.message.size()))
+    return false;
+  message_index_.AddMessage(levels_.size(), message.message);
+  message_offsets_.push_back(message_offsets_.back() +
+                             message.message.size());
+
+  levels_.push_back(message.level);
+  process_ids_.push_back(message.process_id);
+  thread_ids_.push_back(message.thread_id);
+  times_.push_back(message.time.ToInternalValue());
+  lines_.push_back(message.line);
+
+  // Intern the file name.
+  std::string file(message.file.as_string());
+  std::pair<base::hash_map<std::string, uint32>::iterator, bool> file_id(
+      file_name_map_.insert(std::make_pair(file, file_names_.size())));
+  if (file_id.second)
+    file_names_.push_back(file);
+  file_ids_.push_back(file_id.first->second);
+
+  // Intern the stack trace.
+  StackTrace trace(message.trace_depth);
+  for (size_t i = 0; i < message.trace_depth; ++i)
+    trace[i] = reinterpret_cast<uintptr_t>(message.trace[i]);
+  std::pair<std::map<StackTrace, uint32>::iterator, bool> trace_id(
+      trace_map_.insert(std::make_pair(trace, traces_.size())));
+  if (trace_id.second)
+    traces_.push_back(trace);
+  trace_ids_.push_back(trace_id.first->second);
+
+  return true;
+}
+
+void LogSnapshotWriter::AddModuleEvent(const ModuleEvent& event) {
+  module_events_.push_back(event);
+}
+
+bool LogSnapshotWriter::Finish() {
+  DCHECK(file_.get() != NULL);
+
+  sections_[kMessageText].size =
+      file_size_ - sections_[kMessageText].offset;
+
+  // Flatten the stack traces.
+  std::vector<uint32> trace_offsets(1, 0);
+  std::vector<uint64> trace_addresses;
+  for (size_t i = 0; i < traces_.size(); ++i) {
+    trace_addresses.insert(trace_addresses.end(),
+                           traces_[i].begin(), traces_[i].end());
+    DCHECK_GE(kuint32max, trace_addresses.size());
+    trace_offsets.push_back(trace_addresses.size());
+  }
+
+  std::vector<ModuleEventRecord> module_events(module_events_.size());
+  std::vector<std::string> module_names(module_events_.size());
+  for (size_t i = 0; i < module_events_.size(); ++i) {
+    const ModuleEvent& event = module_events_[i];
+    ModuleEventRecord& record = module_events[i];
+    record.type = event.type;
+    record.process_id = event.process_id;
+    record.time = event.time.ToInternalValue();
+    record.base_address = event.base_address;
+    record.module_size = event.module_size;
+    record.image_checksum = event.image_checksum;
+    record.time_date_stamp = event.time_date_stamp;
+    record.reserved = 0;
+    module_names[i] = event.image_file_name;
+  }
+
+  std::vector<std::string> index_tokens;
+  std::vector<std::string> index_postings;
+  message_index_.GetPostings(&index_tokens, &index_postings);
+
+  if (!WriteSection(kLevels, levels_) ||
+      !WriteSection(kProcessIds, process_ids_) ||
+      !WriteSection(kThreadIds, thread_ids_) ||
+      !WriteSection(kTimes, times_) ||
+      !WriteSection(kLines, lines_) ||
+      !WriteSection(kFileIds, file_ids_) ||
+      !WriteSection(kTraceIds, trace_ids_) ||
+      !WriteSection(kMessageOffsets, message_offsets_) ||
+      !WriteStringTable(kFileNameOffsets, kFileNameText, file_names_) ||
+      !WriteSection(kTraceOffsets, trace_offsets) ||
+      !WriteSection(kTraceAddresses, trace_addresses) ||
+      !WriteSection(kModuleEvents, module_events) ||
+      !WriteStringTable(kModuleNameOffsets, kModuleNameText, module_names) ||
+      !WriteStringTable(kIndexTokenOffsets, kIndexTokenText, index_tokens) ||
+      !WriteStringTable(kIndexPostingOffsets, kIndexPostingText,
+                        index_postings)) {
+    return false;
+  }
+  DCHECK_EQ(static_cast<size_t>(kNumSectionTypes), sections_.size());
+
+  // Go back and write the header.
+  FileHeader header = {};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_sections = sections_.size();
+
+  std::vector<SectionHeader> section_headers;
+  std::map<uint32, SectionInfo>::const_iterator it(sections_.begin());
+  for (; it != sections_.end(); ++it) {
+    SectionHeader section = {};
+    section.type = it->first;
+    section.offset = it->second.offset;
+    section.size = it->second.size;
+    section_headers.push_back(section);
+  }
+
+  if (::fseek(file_.get(), 0, SEEK_SET) != 0 ||
+      ::fwrite(&header, sizeof(header), 1, file_.get()) != 1 ||
+      ::fwrite(&section_headers[0], sizeof(section_headers[0]),
+               section_headers.size(), file_.get()) !=
+          section_headers.size()) {
+    LOG(ERROR) << "Unable to write snapshot header.";
+    return false;
+  }
+
+  if (::fclose(file_.release()) != 0) {
+    LOG(ERROR) << "Unable to close snapshot.";
+    return false;
+  }
+
+  if (!file_util::ReplaceFile(temp_path_, path_)) {
+    LOG(ERROR) << "Unable to move snapshot to \"" << path_.value() << "\".";
+    return false;
+  }
+  temp_path_.clear();
+
+  return true;
+}
+
+bool LogSnapshotWriter::Write(const void* data, size_t size) {
+  if (size != 0 && ::fwrite(data, 1, size, file_.get()) != size) {
+    LOG(ERROR) << "Unable to write to snapshot.";
+    return false;
+  }
+
+  file_size_ += size;
+  return true;
+}
+
+bool LogSnapshotWriter::Align() {
+  static const uint8 kPadding[kSectionAlignment] = {};
+  return Write(kPadding, static_cast<size_t>(
+      (kSectionAlignment - file_size_ % kSectionAlignment) %
+          kSectionAlignment));
+}
+
+template <typename T>
+bool LogSnapshotWriter::WriteSection(uint32 type, const std::vector<T>& data) {
+  DCHECK(sections_.find(type) == sections_.end());
+
+  if (!Align())
+    return false;
+
+  SectionInfo& section = sections_[type];
+  section.offset = file_size_;
+  section.size = data.size() * sizeof(T);
+  return data.empty() || Write(&data[0], data.size() * sizeof(T));
+}
+
+bool LogSnapshotWriter::WriteStringTable(
+    uint32 offsets_type,
+    uint32 text_type,
+    const std::vector<std::string>& strings) {
+  std::vector<uint64> offsets(1, 0);
+  for (size_t i = 0; i < strings.size(); ++i)
+    offsets.push_back(offsets.back() + strings[i].size());
+
+  if (!WriteSection(offsets_type, offsets) || !Align())
+    return false;
+
+  SectionInfo& section = sections_[text_type];
+  section.offset = file_size_;
+  section.size = offsets.back();
+  for (size_t i = 0; i < strings.size(); ++i) {
+    if (!Write(strings[i].data(), strings[i].size()))
+      return false;
+  }
+
+  return true;
+}
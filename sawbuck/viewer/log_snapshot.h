@@ -0,0 +1,273 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log snapshot declarations.
+//
+// A log snapshot holds parsed log messages and the module events needed to
+// resolve their stack traces, laid out so that it can be memory mapped and
+// read in place. This spares re-parsing the original event trace files, and
+// makes reopening a large capture near instant.
+//
+// A snapshot file starts with a header and a table of sections, each of
+// which holds one array:
+//   - one column per fixed-width message field, indexed by row;
+//   - the message text, with a column of offsets into it;
+//   - the distinct file names and stack traces, which rows refer to by id;
+//   - the module events, with their image file names;
+//   - the message index, as its tokens and their encoded rows.
+// All integers are little-endian, and each section is aligned to 8 bytes.
+#ifndef SAWBUCK_VIEWER_LOG_SNAPSHOT_H_
+#define SAWBUCK_VIEWER_LOG_SNAPSHOT_H_
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string_piece.h"
+#include "base/time.h"
+#include "sawbuck/viewer/message_index.h"
+
+// A module load or unload, as seen in the kernel log.
+struct LogSnapshotModuleEvent {
+  enum Type {
+    // The module was loaded before the capture started.
+    MODULE_IS_LOADED,
+    MODULE_LOAD,
+    MODULE_UNLOAD,
+  };
+
+  LogSnapshotModuleEvent();
+
+  Type type;
+  uint32 process_id;
+  base::Time time;
+  uint64 base_address;
+  uint32 module_size;
+  uint32 image_checksum;
+  uint32 time_date_stamp;
+  // The UTF-8 image file name.
+  std::string image_file_name;
+};
+
+// Reads a memory mapped log snapshot. The accessors read the mapping in
+// place, and return pieces of it that stay valid while the snapshot is
+// open.
+// Note: The snapshot doesn't change once open, so it can be read from any
+//     number of threads at once.
+class LogSnapshot {
+ public:
+  typedef LogSnapshotModuleEvent ModuleEvent;
+
+  LogSnapshot();
+  ~LogSnapshot();
+
+  // Maps and validates the snapshot at @p path.
+  // @returns true on success.
+  bool Open(const FilePath& path);
+
+  // @returns true if a snapshot is open.
+  bool is_open() const { return file_.get() != NULL; }
+
+  // @returns the number of messages in the snapshot.
+  size_t size() const { return num_rows_; }
+
+  // @name Accessors for the fields of the message at @p row.
+  // @{
+  uint8 GetLevel(size_t row) const { return levels_[row]; }
+  uint32 GetProcessId(size_t row) const { return process_ids_[row]; }
+  uint32 GetThreadId(size_t row) const { return thread_ids_[row]; }
+  base::Time GetTime(size_t row) const {
+    return base::Time::FromInternalValue(times_[row]);
+  }
+  base::StringPiece GetFileName(size_t row) const {
+    return file_names_.Get(file_ids_[row]);
+  }
+  int GetLine(size_t row) const { return lines_[row]; }
+  base::StringPiece GetMessage(size_t row) const {
+    return messages_.Get(row);
+  }
+  void GetStackTrace(size_t row, std::vector<void*>* trace) const;
+  // @}
+
+  // @returns the number of module events in the snapshot.
+  size_t num_module_events() const { return num_module_events_; }
+  // Gets the module event at @p index, in the order they were written.
+  void GetModuleEvent(size_t index, ModuleEvent* event) const;
+
+  // Adds the persisted message index of the snapshot to @p index, which must
+  // be empty. This costs a pass over the postings, rather than over the
+  // message text.
+  // @returns false if the persisted index isn't valid.
+  bool LoadMessageIndex(MessageIndex* index) const;
+
+ private:
+  // A table of strings, stored back to back.
+  struct StringTable {
+    StringTable() : offsets(NULL), text(NULL) {
+    }
+
+    base::StringPiece Get(size_t index) const {
+      return base::StringPiece(
+          text + static_cast<size_t>(offsets[index]),
+          static_cast<size_t>(offsets[index + 1] - offsets[index]));
+    }
+
+    // The offset of each string, followed by the size of the text.
+    const uint64* offsets;
+    const char* text;
+  };
+
+  // Validates the @p length bytes of the mapped file at @p data, and points
+  // the columns at its sections.
+  // @returns true on success.
+  bool Parse(const uint8* data, size_t length);
+
+  scoped_ptr<file_util::MemoryMappedFile> file_;
+
+  size_t num_rows_;
+  const uint8* levels_;
+  const uint32* process_ids_;
+  const uint32* thread_ids_;
+  const int64* times_;
+  const int32* lines_;
+  const uint32* file_ids_;
+  const uint32* trace_ids_;
+  StringTable messages_;
+  StringTable file_names_;
+
+  // The offset of each trace in trace_addresses_, followed by the number of
+  // addresses.
+  const uint32* trace_offsets_;
+  const uint64* trace_addresses_;
+
+  size_t num_module_events_;
+  // The records of the module events section, which are private to the
+  // implementation.
+  const void* module_events_;
+  StringTable module_names_;
+
+  // The tokens of the message index, and the encoded rows of each.
+  size_t num_index_tokens_;
+  StringTable index_tokens_;
+  StringTable index_postings_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSnapshot);
+};
+
+// Writes a log snapshot. The message text goes to the file as messages are
+// added, while the other columns and the message index are kept in memory
+// until Finish.
+class LogSnapshotWriter {
+ public:
+  typedef LogSnapshotModuleEvent ModuleEvent;
+
+  // Describes a message to add to the snapshot.
+  struct Message {
+    Message();
+
+    uint8 level;
+    uint32 process_id;
+    uint32 thread_id;
+    base::Time time;
+    base::StringPiece file;
+    int line;
+    base::StringPiece message;
+    void* const* trace;
+    size_t trace_depth;
+  };
+
+  LogSnapshotWriter();
+  ~LogSnapshotWriter();
+
+  // Creates the snapshot file at @p path. The snapshot is written to a
+  // temporary file next to @p path, which only replaces it once Finish
+  // succeeds. Should the writer fail or be destroyed before that, the
+  // temporary file is deleted and @p path is left untouched.
+  // @returns true on success.
+  bool Create(const FilePath& path);
+
+  // Appends @p message to the snapshot.
+  // @returns true on success.
+  bool AddMessage(const Message& message);
+
+  // Appends @p event to the snapshot.
+  void AddModuleEvent(const ModuleEvent& event);
+
+  // Writes out the columns and tables, closes the file, and moves it to the
+  // path given to Create.
+  // @returns true on success.
+  bool Finish();
+
+ private:
+  typedef std::vector<uint64> StackTrace;
+
+  // Writes @p size bytes at @p data to the file.
+  bool Write(const void* data, size_t size);
+  // Pads the file up to the alignment of sections.
+  bool Align();
+  // Writes @p data as section @p type.
+  template <typename T>
+  bool WriteSection(uint32 type, const std::vector<T>& data);
+  // Writes @p strings as the sections @p offsets_type and @p text_type.
+  bool WriteStringTable(uint32 offsets_type,
+                        uint32 text_type,
+                        const std::vector<std::string>& strings);
+
+  // The path of the snapshot, and of the temporary file it's written to
+  // until Finish succeeds.
+  FilePath path_;
+  FilePath temp_path_;
+
+  file_util::ScopedFILE file_;
+  // The number of bytes written so far.
+  uint64 file_size_;
+
+  // The location of each section.
+  struct SectionInfo {
+    uint64 offset;
+    uint64 size;
+  };
+  std::map<uint32, SectionInfo> sections_;
+
+  // The fixed-width columns.
+  std::vector<uint8> levels_;
+  std::vector<uint32> process_ids_;
+  std::vector<uint32> thread_ids_;
+  std::vector<int64> times_;
+  std::vector<int32> lines_;
+  std::vector<uint32> file_ids_;
+  std::vector<uint32> trace_ids_;
+  // The offset of each message in the message text section.
+  std::vector<uint64> message_offsets_;
+
+  // The distinct file names and stack traces, and their ids.
+  std::vector<std::string> file_names_;
+  base::hash_map<std::string, uint32> file_name_map_;
+  std::vector<StackTrace> traces_;
+  std::map<StackTrace, uint32> trace_map_;
+
+  std::vector<ModuleEvent> module_events_;
+
+  // Indexes the messages as they are added.
+  MessageIndex message_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSnapshotWriter);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_SNAPSHOT_H_
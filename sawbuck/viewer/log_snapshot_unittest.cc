@@ -0,0 +1,327 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log snapshot unittests.
+#include "sawbuck/viewer/log_snapshot.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class LogSnapshotTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().Append(L"snapshot.bin");
+  }
+
+  LogSnapshotWriter::Message CreateMessage(const char* file,
+                                           const char* message) {
+    LogSnapshotWriter::Message info;
+    info.level = 2;
+    info.process_id = 10;
+    info.thread_id = 20;
+    info.time = base::Time::FromInternalValue(12345);
+    info.file = file;
+    info.line = 42;
+    info.message = message;
+    return info;
+  }
+
+  // Overwrites the snapshot with @p contents.
+  void RewriteSnapshot(const std::string& contents) {
+    ASSERT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(path_, contents.data(), contents.size()));
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+}  // namespace
+
+TEST_F(LogSnapshotTest, Empty) {
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+  ASSERT_TRUE(writer.Finish());
+
+  LogSnapshot snapshot;
+  EXPECT_FALSE(snapshot.is_open());
+  ASSERT_TRUE(snapshot.Open(path_));
+  EXPECT_TRUE(snapshot.is_open());
+  EXPECT_EQ(0U, snapshot.size());
+  EXPECT_EQ(0U, snapshot.num_module_events());
+}
+
+TEST_F(LogSnapshotTest, UnfinishedSnapshotLeavesFileUntouched) {
+  RewriteSnapshot("old");
+
+  {
+    LogSnapshotWriter writer;
+    ASSERT_TRUE(writer.Create(path_));
+    ASSERT_TRUE(writer.AddMessage(CreateMessage("foo.cc", "Hello")));
+  }
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  EXPECT_EQ("old", contents);
+
+  // The temporary file should be gone too.
+  file_util::FileEnumerator files(temp_dir_.path(), false,
+                                  file_util::FileEnumerator::FILES);
+  EXPECT_EQ(path_.value(), files.Next().value());
+  EXPECT_TRUE(files.Next().empty());
+}
+
+TEST_F(LogSnapshotTest, RoundTrip) {
+  void* trace[] = { &trace, this };
+
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+
+  LogSnapshotWriter::Message info = CreateMessage("foo.cc", "Hello");
+  info.trace = trace;
+  info.trace_depth = arraysize(trace);
+  ASSERT_TRUE(writer.AddMessage(info));
+  ASSERT_TRUE(writer.AddMessage(CreateMessage("", "")));
+  info.level = 4;
+  info.process_id = 11;
+  info.thread_id = 21;
+  info.time = base::Time::FromInternalValue(67890);
+  info.line = -1;
+  info.message = "World";
+  ASSERT_TRUE(writer.AddMessage(info));
+
+  LogSnapshotWriter::ModuleEvent event;
+  event.type = LogSnapshotWriter::ModuleEvent::MODULE_UNLOAD;
+  event.process_id = 10;
+  event.time = base::Time::FromInternalValue(1000);
+  event.base_address = 0x10000000;
+  event.module_size = 0x2000;
+  event.image_checksum = 0xCAFE;
+  event.time_date_stamp = 0xF00D;
+  event.image_file_name = "C:\\foo.dll";
+  writer.AddModuleEvent(event);
+  writer.AddModuleEvent(LogSnapshotWriter::ModuleEvent());
+
+  ASSERT_TRUE(writer.Finish());
+
+  LogSnapshot snapshot;
+  ASSERT_TRUE(snapshot.Open(path_));
+  ASSERT_EQ(3U, snapshot.size());
+
+  EXPECT_EQ(2, snapshot.GetLevel(0));
+  EXPECT_EQ(10, snapshot.GetProcessId(0));
+  EXPECT_EQ(20, snapshot.GetThreadId(0));
+  EXPECT_EQ(12345, snapshot.GetTime(0).ToInternalValue());
+  EXPECT_EQ("foo.cc", snapshot.GetFileName(0));
+  EXPECT_EQ(42, snapshot.GetLine(0));
+  EXPECT_EQ("Hello", snapshot.GetMessage(0));
+  std::vector<void*> stack_trace;
+  snapshot.GetStackTrace(0, &stack_trace);
+  ASSERT_EQ(arraysize(trace), stack_trace.size());
+  EXPECT_EQ(trace[0], stack_trace[0]);
+  EXPECT_EQ(trace[1], stack_trace[1]);
+
+  EXPECT_EQ("", snapshot.GetFileName(1));
+  EXPECT_EQ("", snapshot.GetMessage(1));
+  snapshot.GetStackTrace(1, &stack_trace);
+  EXPECT_TRUE(stack_trace.empty());
+
+  EXPECT_EQ(4, snapshot.GetLevel(2));
+  EXPECT_EQ(11, snapshot.GetProcessId(2));
+  EXPECT_EQ(21, snapshot.GetThreadId(2));
+  EXPECT_EQ(67890, snapshot.GetTime(2).ToInternalValue());
+  EXPECT_EQ("foo.cc", snapshot.GetFileName(2));
+  EXPECT_EQ(-1, snapshot.GetLine(2));
+  EXPECT_EQ("World", snapshot.GetMessage(2));
+  snapshot.GetStackTrace(2, &stack_trace);
+  EXPECT_EQ(arraysize(trace), stack_trace.size());
+
+  ASSERT_EQ(2U, snapshot.num_module_events());
+  LogSnapshot::ModuleEvent read_event;
+  snapshot.GetModuleEvent(0, &read_event);
+  EXPECT_EQ(event.type, read_event.type);
+  EXPECT_EQ(event.process_id, read_event.process_id);
+  EXPECT_EQ(event.time, read_event.time);
+  EXPECT_EQ(event.base_address, read_event.base_address);
+  EXPECT_EQ(event.module_size, read_event.module_size);
+  EXPECT_EQ(event.image_checksum, read_event.image_checksum);
+  EXPECT_EQ(event.time_date_stamp, read_event.time_date_stamp);
+  EXPECT_EQ(event.image_file_name, read_event.image_file_name);
+  snapshot.GetModuleEvent(1, &read_event);
+  EXPECT_EQ("", read_event.image_file_name);
+}
+
+TEST_F(LogSnapshotTest, RejectsInvalidFiles) {
+  LogSnapshot snapshot;
+  EXPECT_FALSE(snapshot.Open(path_));
+
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+  ASSERT_TRUE(writer.AddMessage(CreateMessage("foo.cc", "Hello")));
+  ASSERT_TRUE(writer.Finish());
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+
+  // A bad magic.
+  RewriteSnapshot("NOTSNAP" + contents.substr(7));
+  EXPECT_FALSE(snapshot.Open(path_));
+  EXPECT_FALSE(snapshot.is_open());
+  EXPECT_EQ(0U, snapshot.size());
+
+  // A truncated file.
+  RewriteSnapshot(contents.substr(0, contents.size() - 1));
+  EXPECT_FALSE(snapshot.Open(path_));
+
+  // A truncated header.
+  RewriteSnapshot(contents.substr(0, 20));
+  EXPECT_FALSE(snapshot.Open(path_));
+
+  // The original contents are fine.
+  RewriteSnapshot(contents);
+  ASSERT_TRUE(snapshot.Open(path_));
+}
+
+TEST_F(LogSnapshotTest, RejectsInvalidModuleEvents) {
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+  LogSnapshotWriter::ModuleEvent event;
+  event.type = LogSnapshotWriter::ModuleEvent::MODULE_UNLOAD;
+  event.base_address = 0x0123456789ABCDEFULL;
+  writer.AddModuleEvent(event);
+  ASSERT_TRUE(writer.Finish());
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  {
+    LogSnapshot snapshot;
+    ASSERT_TRUE(snapshot.Open(path_));
+  }
+
+  // The type precedes the process id, time and base address of the record.
+  std::string base_address(reinterpret_cast<const char*>(&event.base_address),
+                           sizeof(event.base_address));
+  size_t pos = contents.find(base_address);
+  ASSERT_NE(std::string::npos, pos);
+  ASSERT_LE(16U, pos);
+  uint32 bad_type = 7;
+  contents.replace(pos - 16, sizeof(bad_type),
+                   reinterpret_cast<const char*>(&bad_type),
+                   sizeof(bad_type));
+  RewriteSnapshot(contents);
+  LogSnapshot snapshot;
+  EXPECT_FALSE(snapshot.Open(path_));
+}
+
+TEST_F(LogSnapshotTest, PersistsMessageIndex) {
+  const char* kMessages[] = {
+      "Opened file C:\\foo\\bar.txt",
+      "Closed file C:\\foo\\baz.txt",
+      "OPENED the Foobar",
+      "thread_id=42 a b c",
+  };
+
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+  MessageIndex expected_index;
+  for (size_t i = 0; i < arraysize(kMessages); ++i) {
+    ASSERT_TRUE(writer.AddMessage(CreateMessage("foo.cc", kMessages[i])));
+    expected_index.AddMessage(i, kMessages[i]);
+  }
+  std::string blob(std::string("Blob ") + std::string(100, 'x'));
+  ASSERT_TRUE(writer.AddMessage(CreateMessage("foo.cc", blob.c_str())));
+  expected_index.AddMessage(arraysize(kMessages), blob);
+  ASSERT_TRUE(writer.Finish());
+
+  LogSnapshot snapshot;
+  ASSERT_TRUE(snapshot.Open(path_));
+  MessageIndex index;
+  ASSERT_TRUE(snapshot.LoadMessageIndex(&index));
+  EXPECT_EQ(expected_index.num_tokens(), index.num_tokens());
+  EXPECT_EQ(expected_index.num_postings(), index.num_postings());
+
+  const char* kLiterals[] = {
+      " file ", " opened file ", "foo", "ooba", "=42 ", " a ", "xxxxxxxx" };
+  for (size_t i = 0; i < arraysize(kLiterals); ++i) {
+    std::vector<int> expected_rows;
+    std::vector<int> rows;
+    EXPECT_EQ(expected_index.GetCandidateRows(kLiterals[i], &expected_rows),
+              index.GetCandidateRows(kLiterals[i], &rows));
+    EXPECT_EQ(expected_rows, rows);
+  }
+}
+
+TEST_F(LogSnapshotTest, LargeSnapshot) {
+  const size_t kNumRows = 1000000;
+  const char* kFiles[] = { "foo.cc", "bar.cc", "foo_bar.h" };
+  size_t message_size = 0;
+  void* trace[] = { &trace, this, &message_size };
+
+  base::Time start = base::Time::Now();
+  LogSnapshotWriter writer;
+  ASSERT_TRUE(writer.Create(path_));
+  for (size_t i = 0; i < kNumRows; ++i) {
+    std::string message(
+        base::StringPrintf("Message %d", static_cast<int>(i)));
+    LogSnapshotWriter::Message info =
+        CreateMessage(kFiles[i % arraysize(kFiles)], message.c_str());
+    info.trace = trace;
+    info.trace_depth = i % arraysize(trace);
+    ASSERT_TRUE(writer.AddMessage(info));
+  }
+  ASSERT_TRUE(writer.Finish());
+  base::TimeDelta write_time = base::Time::Now() - start;
+
+  start = base::Time::Now();
+  LogSnapshot snapshot;
+  ASSERT_TRUE(snapshot.Open(path_));
+  base::TimeDelta open_time = base::Time::Now() - start;
+  ASSERT_EQ(kNumRows, snapshot.size());
+
+  start = base::Time::Now();
+  MessageIndex index;
+  ASSERT_TRUE(snapshot.LoadMessageIndex(&index));
+  base::TimeDelta index_time = base::Time::Now() - start;
+  std::vector<int> rows;
+  ASSERT_TRUE(index.GetCandidateRows(" 12345 ", &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ(12345, rows[0]);
+
+  start = base::Time::Now();
+  std::vector<void*> stack_trace;
+  for (size_t i = 0; i < kNumRows; ++i) {
+    message_size += snapshot.GetMessage(i).size();
+    ASSERT_EQ(kFiles[i % arraysize(kFiles)], snapshot.GetFileName(i));
+    snapshot.GetStackTrace(i, &stack_trace);
+    ASSERT_EQ(i % arraysize(trace), stack_trace.size());
+  }
+  base::TimeDelta read_time = base::Time::Now() - start;
+  EXPECT_LT(0U, message_size);
+  EXPECT_EQ(base::StringPrintf("Message %d", static_cast<int>(kNumRows - 1)),
+            snapshot.GetMessage(kNumRows - 1).as_string());
+
+  LOG(INFO) << kNumRows << " messages took " << write_time.InMilliseconds()
+            << " ms to write, " << open_time.InMilliseconds()
+            << " ms to open, " << index_time.InMilliseconds()
+            << " ms to load the index and " << read_time.InMilliseconds()
+            << " ms to read.";
+}
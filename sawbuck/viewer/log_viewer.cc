@@ -17,7 +17,9 @@
 
 #include <atlbase.h>
 #include <atlframe.h>
+#include "base/bind.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "pcrecpp.h"  // NOLINT
 #include "sawbuck/viewer/filtered_log_view.h"
@@ -41,6 +43,15 @@ void LogViewer::SetLogView(ILogView* log_view) {
   log_list_view_.SetLogView(log_view);
 }
 
+void LogViewer::ClearAll() {
+  // The filtered view reads the original view while filtering, so it must
+  // do the clearing.
+  if (filtered_log_view_.get() != NULL)
+    filtered_log_view_->ClearAll();
+  else
+    log_view_->ClearAll();
+}
+
 int LogViewer::OnCreate(LPCREATESTRUCT create_struct) {
   DCHECK(log_view_ != NULL) << "SetLogView not called before window creation.";
 
@@ -71,12 +82,8 @@ int LogViewer::OnCreate(LPCREATESTRUCT create_struct) {
   prefs.ReadStringValue(config::kFilterValues, &filter_string, "");
   if (!filter_string.empty()) {
     std::vector<Filter> filters(Filter::DeserializeFilters(filter_string));
-    if (!filters.empty()) {
-      scoped_ptr<FilteredLogView> new_view(new FilteredLogView(log_view_,
-                                                               filters));
-      log_list_view_.SetLogView(new_view.get());
-      filtered_log_view_.reset(new_view.release());
-    }
+    if (!filters.empty())
+      SetFilters(filters);
   }
 
   SetMsgHandled(FALSE);
@@ -102,11 +109,36 @@ void LogViewer::OnLogFilter(UINT code, int id, CWindow window) {
 
     // TODO(robertshield): If dialog.get_filters() is empty, we should set it
     // back to the non filtered log view.
-    scoped_ptr<FilteredLogView> new_view(new FilteredLogView(log_view_,
-                                                             filters));
-    log_list_view_.SetLogView(new_view.get());
-    filtered_log_view_.reset(new_view.release());
+    SetFilters(filters);
+  }
+}
+
+void LogViewer::SetFilters(const std::vector<Filter>& filters) {
+  // Reuse the filtered view, if any, so that narrowing the filters only
+  // re-tests the rows it includes.
+  if (filtered_log_view_.get() != NULL) {
+    filtered_log_view_->SetFilters(filters);
+    return;
   }
+
+  scoped_ptr<FilteredLogView> new_view(new FilteredLogView(log_view_,
+                                                           filters));
+  new_view->set_use_worker_pool(true);
+  new_view->set_progress_callback(
+      base::Bind(&LogViewer::OnFilteringProgress, base::Unretained(this)));
+  log_list_view_.SetLogView(new_view.get());
+  filtered_log_view_.reset(new_view.release());
+}
+
+void LogViewer::OnFilteringProgress(int processed_rows, int total_rows) {
+  if (processed_rows >= total_rows) {
+    update_ui_->UISetText(0, L"Ready");
+    return;
+  }
+
+  int percent = static_cast<int>(100LL * processed_rows / total_rows);
+  update_ui_->UISetText(0, base::StringPrintf(L"Filtering %d%%",
+                                              percent).c_str());
 }
 
 void LogViewer::OnIncludeColumn(UINT code, int id, CWindow window) {
@@ -22,6 +22,7 @@
 #include <atlctrls.h>
 #include <atlsplit.h>
 #include <atlmisc.h>
+#include <vector>
 #include "base/memory/scoped_ptr.h"
 #include "sawbuck/viewer/log_list_view.h"
 #include "sawbuck/viewer/resource.h"
@@ -31,6 +32,7 @@
 namespace WTL {
 class CUpdateUIBase;
 };
+class Filter;
 class FilteredLogView;
 class IProcessInfoService;
 
@@ -57,6 +59,9 @@ class LogViewer : public CSplitterWindowImpl<LogViewer, false> {
   // This must be called before the log window viewer is created.
   void SetLogView(ILogView* log_view);
 
+  // Clears the log, stopping any filtering of it first.
+  void ClearAll();
+
   void SetSymbolLookupService(ISymbolLookupService* symbol_lookup_service) {
     stack_trace_list_view_.SetSymbolLookupService(symbol_lookup_service);
   }
@@ -71,6 +76,11 @@ class LogViewer : public CSplitterWindowImpl<LogViewer, false> {
   void OnIncludeColumn(UINT code, int id, CWindow window);
   void OnExcludeColumn(UINT code, int id, CWindow window);
 
+  // Filters the log with @p filters, creating the filtered view if need be.
+  void SetFilters(const std::vector<Filter>& filters);
+  // Shows the progress of the filtered view in the status bar.
+  void OnFilteringProgress(int processed_rows, int total_rows);
+
   // Non-null iff filtering is enabled.
   scoped_ptr<FilteredLogView> filtered_log_view_;
 
@@ -0,0 +1,329 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Message index implementation.
+#include "sawbuck/viewer/message_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "base/logging.h"
+#include "base/string_util.h"
+
+namespace {
+
+// Partial tokens shorter than this are part of too many tokens to be worth
+// looking up.
+const size_t kMinPartialTokenLength = 3;
+
+bool IsTokenChar(char c) {
+  return IsAsciiAlpha(c) || IsAsciiDigit(c) || c == '_';
+}
+
+// Returns the end of the token starting at |pos| in |text|.
+size_t FindTokenEnd(const base::StringPiece& text, size_t pos) {
+  while (pos < text.size() && IsTokenChar(text[pos]))
+    ++pos;
+  return pos;
+}
+
+}  // namespace
+
+MessageIndex::MessageIndex() : num_postings_(0) {
+}
+
+MessageIndex::~MessageIndex() {
+}
+
+void MessageIndex::AddMessage(int row, const base::StringPiece& message) {
+  DCHECK_LE(0, row);
+
+  base::TimeTicks start = base::TimeTicks::Now();
+
+  size_t pos = 0;
+  while (pos < message.size()) {
+    if (!IsTokenChar(message[pos])) {
+      ++pos;
+      continue;
+    }
+
+    size_t end = FindTokenEnd(message, pos);
+    size_t length = end - pos;
+    if (length > kMaxTokenLength) {
+      AddRow(row, &unindexed_rows_);
+    } else if (length >= kMinTokenLength) {
+      token_.assign(message.data() + pos, length);
+      StringToLowerASCII(&token_);
+      PostingList& list = tokens_[token_];
+      if (list.last_row != row) {
+        AddRow(row, &list);
+        ++num_postings_;
+      }
+    }
+
+    pos = end;
+  }
+
+  build_time_ += base::TimeTicks::Now() - start;
+}
+
+void MessageIndex::Clear() {
+  // Swap the map out, as clear() keeps its buckets.
+  TokenMap().swap(tokens_);
+  unindexed_rows_ = PostingList();
+  num_postings_ = 0;
+  build_time_ = base::TimeDelta();
+}
+
+void MessageIndex::Swap(MessageIndex* other) {
+  DCHECK(other != NULL);
+
+  tokens_.swap(other->tokens_);
+  std::swap(unindexed_rows_, other->unindexed_rows_);
+  std::swap(num_postings_, other->num_postings_);
+  std::swap(build_time_, other->build_time_);
+}
+
+void MessageIndex::GetPostings(std::vector<std::string>* tokens,
+                               std::vector<std::string>* postings) const {
+  DCHECK(tokens != NULL);
+  DCHECK(postings != NULL);
+
+  tokens->clear();
+  postings->clear();
+  if (!unindexed_rows_.deltas.empty()) {
+    tokens->push_back(std::string());
+    postings->push_back(unindexed_rows_.deltas);
+  }
+
+  TokenMap::const_iterator it(tokens_.begin());
+  for (; it != tokens_.end(); ++it) {
+    tokens->push_back(it->first);
+    postings->push_back(it->second.deltas);
+  }
+}
+
+bool MessageIndex::AddPostings(const base::StringPiece& token,
+                               const base::StringPiece& postings,
+                               int end_row) {
+  if (!token.empty() &&
+      (token.size() < kMinTokenLength || token.size() > kMaxTokenLength)) {
+    return false;
+  }
+
+  std::string key(token.as_string());
+  if (key.empty() ? unindexed_rows_.last_row != -1 : tokens_.count(key) != 0)
+    return false;
+
+  // Check that the rows decode, increase and are in range before adding them.
+  int row = -1;
+  size_t num_rows = 0;
+  size_t pos = 0;
+  while (pos < postings.size()) {
+    uint32 delta = 0;
+    if (!DecodeDelta(postings, &pos, &delta) || delta == 0 ||
+        row + static_cast<int64>(delta) >= end_row) {
+      return false;
+    }
+    row += delta;
+    ++num_rows;
+  }
+  if (num_rows == 0)
+    return false;
+
+  PostingList* list = &unindexed_rows_;
+  if (!key.empty()) {
+    list = &tokens_[key];
+    num_postings_ += num_rows;
+  }
+  postings.CopyToString(&list->deltas);
+  list->last_row = row;
+  return true;
+}
+
+bool MessageIndex::GetCandidateRows(const base::StringPiece& literal,
+                                    std::vector<int>* rows) const {
+  DCHECK(rows != NULL);
+
+  rows->clear();
+
+  // Intersect the rows of each token of the literal.
+  bool narrowed = false;
+  std::string token;
+  size_t pos = 0;
+  while (pos < literal.size()) {
+    if (!IsTokenChar(literal[pos])) {
+      ++pos;
+      continue;
+    }
+
+    size_t end = FindTokenEnd(literal, pos);
+    token.assign(literal.data() + pos, end - pos);
+    StringToLowerASCII(&token);
+
+    std::vector<int> token_rows;
+    if (GetTokenRows(token, pos > 0, end < literal.size(), &token_rows)) {
+      if (narrowed) {
+        std::vector<int> intersection;
+        std::set_intersection(rows->begin(), rows->end(),
+                              token_rows.begin(), token_rows.end(),
+                              std::back_inserter(intersection));
+        rows->swap(intersection);
+      } else {
+        rows->swap(token_rows);
+        narrowed = true;
+      }
+    }
+
+    pos = end;
+  }
+
+  if (!narrowed)
+    return false;
+
+  // The rows with tokens too long to index may contain anything.
+  std::vector<int> unindexed_rows;
+  DecodeRows(unindexed_rows_, &unindexed_rows);
+  if (!unindexed_rows.empty()) {
+    std::vector<int> merged;
+    std::set_union(rows->begin(), rows->end(),
+                   unindexed_rows.begin(), unindexed_rows.end(),
+                   std::back_inserter(merged));
+    rows->swap(merged);
+  }
+
+  return true;
+}
+
+size_t MessageIndex::GetMemoryUsage() const {
+  // Count the map nodes as their value plus a couple of links.
+  size_t usage = unindexed_rows_.deltas.capacity() + token_.capacity();
+  TokenMap::const_iterator it(tokens_.begin());
+  for (; it != tokens_.end(); ++it) {
+    usage += sizeof(*it) + 2 * sizeof(void*) + it->first.capacity() +
+        it->second.deltas.capacity();
+  }
+
+  return usage;
+}
+
+// static
+void MessageIndex::AddRow(int row, PostingList* list) {
+  DCHECK(list != NULL);
+
+  if (list->last_row == row)
+    return;
+
+  DCHECK_GT(row, list->last_row);
+  uint32 delta = row - list->last_row;
+  while (delta >= 0x80) {
+    list->deltas.push_back(static_cast<char>(0x80 | (delta & 0x7F)));
+    delta >>= 7;
+  }
+  list->deltas.push_back(static_cast<char>(delta));
+  list->last_row = row;
+}
+
+// static
+void MessageIndex::DecodeRows(const PostingList& list,
+                              std::vector<int>* rows) {
+  DCHECK(rows != NULL);
+
+  int row = -1;
+  size_t pos = 0;
+  base::StringPiece deltas(list.deltas);
+  while (pos < deltas.size()) {
+    uint32 delta = 0;
+    bool decoded = DecodeDelta(deltas, &pos, &delta);
+    DCHECK(decoded);
+
+    row += delta;
+    rows->push_back(row);
+  }
+
+  DCHECK_EQ(list.last_row, row);
+}
+
+// static
+bool MessageIndex::DecodeDelta(const base::StringPiece& deltas,
+                               size_t* pos,
+                               uint32* delta) {
+  DCHECK(pos != NULL);
+  DCHECK(delta != NULL);
+
+  *delta = 0;
+  int shift = 0;
+  uint8 byte = 0;
+  do {
+    // A 32 bit value takes at most five bytes.
+    if (*pos >= deltas.size() || shift > 28)
+      return false;
+
+    byte = static_cast<uint8>(deltas[(*pos)++]);
+    *delta |= static_cast<uint32>(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0);
+
+  return true;
+}
+
+bool MessageIndex::GetTokenRows(const std::string& token,
+                                bool bounded_before,
+                                bool bounded_after,
+                                std::vector<int>* rows) const {
+  DCHECK(rows != NULL);
+
+  // Tokens longer than any indexed token are only found in the unindexed
+  // rows, which the caller adds to any result.
+  if (token.size() > kMaxTokenLength)
+    return true;
+
+  if (bounded_before && bounded_after) {
+    if (token.size() < kMinTokenLength)
+      return false;
+
+    TokenMap::const_iterator it(tokens_.find(token));
+    if (it != tokens_.end())
+      DecodeRows(it->second, rows);
+    return true;
+  }
+
+  if (token.size() < kMinPartialTokenLength)
+    return false;
+
+  // The token may be part of longer tokens, so look through all of them.
+  TokenMap::const_iterator it(tokens_.begin());
+  for (; it != tokens_.end(); ++it) {
+    const std::string& key = it->first;
+    if (key.size() < token.size())
+      continue;
+
+    bool matches = false;
+    if (bounded_before) {
+      matches = key.compare(0, token.size(), token) == 0;
+    } else if (bounded_after) {
+      matches = key.compare(key.size() - token.size(), token.size(),
+                            token) == 0;
+    } else {
+      matches = key.find(token) != std::string::npos;
+    }
+
+    if (matches)
+      DecodeRows(it->second, rows);
+  }
+
+  std::sort(rows->begin(), rows->end());
+  rows->erase(std::unique(rows->begin(), rows->end()), rows->end());
+  return true;
+}
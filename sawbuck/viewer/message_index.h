@@ -0,0 +1,139 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Message index declaration.
+#ifndef SAWBUCK_VIEWER_MESSAGE_INDEX_H_
+#define SAWBUCK_VIEWER_MESSAGE_INDEX_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/string_piece.h"
+#include "base/time.h"
+
+// An inverted index of the tokens of log messages. A token is a run of ASCII
+// letters, digits and underscores, which is indexed without regard to case.
+// Each token maps to the rows whose message contains it, which are stored as
+// varint-encoded deltas. The index is built incrementally as messages arrive,
+// and narrows searches for a literal down to the rows that may contain it.
+// Note: This class is not thread-safe.
+class MessageIndex {
+ public:
+  // Tokens shorter than this are too common to be worth indexing.
+  static const size_t kMinTokenLength = 2;
+  // Tokens longer than this aren't indexed, which keeps hashes, blobs and the
+  // like out of the index. The rows containing them are candidates for any
+  // search.
+  static const size_t kMaxTokenLength = 64;
+
+  MessageIndex();
+  ~MessageIndex();
+
+  // Indexes the tokens of a message.
+  // @param row the row of the message, which must be greater than the row of
+  //     any message already indexed.
+  // @param message the message.
+  void AddMessage(int row, const base::StringPiece& message);
+
+  // Removes all messages from the index.
+  void Clear();
+
+  // Swaps the contents of this index with @p other.
+  void Swap(MessageIndex* other);
+
+  // Gets the posting lists of the index, so that it can be persisted. The
+  // rows of a token are encoded as by AddPostings.
+  // @param tokens receives the indexed tokens, in no particular order. An
+  //     empty token stands for the rows with tokens too long to index.
+  // @param postings receives the encoded rows of each token.
+  void GetPostings(std::vector<std::string>* tokens,
+                   std::vector<std::string>* postings) const;
+
+  // Adds the persisted rows of a token to the index, which must not hold
+  // the token yet.
+  // @param token the token, or an empty token for the rows with tokens too
+  //     long to index.
+  // @param postings the rows of the token, each as a varint of its delta
+  //     from the previous row.
+  // @param end_row the rows must be less than this.
+  // @returns false if @p postings isn't valid.
+  bool AddPostings(const base::StringPiece& token,
+                   const base::StringPiece& postings,
+                   int end_row);
+
+  // Finds the rows whose message may contain @p literal, ignoring ASCII case.
+  // @param literal the literal to find.
+  // @param rows returns the candidate rows, in increasing order. These
+  //     include all rows containing @p literal, but may include others.
+  // @returns true on success, or false if the index can't narrow down the
+  //     rows for @p literal, in which case all rows are candidates.
+  bool GetCandidateRows(const base::StringPiece& literal,
+                        std::vector<int>* rows) const;
+
+  // @returns the number of distinct tokens indexed.
+  size_t num_tokens() const { return tokens_.size(); }
+  // @returns the number of (token, row) pairs indexed.
+  size_t num_postings() const { return num_postings_; }
+  // @returns the time spent indexing messages since the last Clear.
+  base::TimeDelta build_time() const { return build_time_; }
+
+  // @returns an estimate of the memory used by the index, in bytes.
+  size_t GetMemoryUsage() const;
+
+ private:
+  // The rows containing a token.
+  struct PostingList {
+    PostingList() : last_row(-1) {
+    }
+
+    // The rows, each as a varint of its delta from the previous row.
+    std::string deltas;
+    // The last row in the list.
+    int last_row;
+  };
+  typedef base::hash_map<std::string, PostingList> TokenMap;
+
+  // Appends @p row to @p list, unless it's there already.
+  static void AddRow(int row, PostingList* list);
+  // Decodes the rows of @p list, and appends them to @p rows.
+  static void DecodeRows(const PostingList& list, std::vector<int>* rows);
+  // Decodes the varint at @p pos in @p deltas, and advances @p pos past it.
+  // @returns false if @p deltas ends within the varint or it overflows.
+  static bool DecodeDelta(const base::StringPiece& deltas,
+                          size_t* pos,
+                          uint32* delta);
+
+  // Gets the rows containing a token of @p token. Where @p token isn't
+  // bounded by separators in the literal it comes from, it may be part of
+  // a longer token in the messages.
+  // @returns false if the index doesn't narrow down the rows.
+  bool GetTokenRows(const std::string& token,
+                    bool bounded_before,
+                    bool bounded_after,
+                    std::vector<int>* rows) const;
+
+  TokenMap tokens_;
+  // The rows containing tokens too long to index.
+  PostingList unindexed_rows_;
+  size_t num_postings_;
+  base::TimeDelta build_time_;
+
+  // Holds the token being indexed, to save allocations.
+  std::string token_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_MESSAGE_INDEX_H_
@@ -0,0 +1,174 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Message index unittests.
+#include "sawbuck/viewer/message_index.h"
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class MessageIndexTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    messages_.push_back("Opened file C:\\foo\\bar.txt");
+    messages_.push_back("Closed file C:\\foo\\baz.txt");
+    messages_.push_back("OPENED the Foobar");
+    messages_.push_back("thread_id=42 a b c");
+    messages_.push_back(std::string("Blob ") + std::string(100, 'x'));
+
+    for (size_t i = 0; i < messages_.size(); ++i)
+      index_.AddMessage(i, messages_[i]);
+  }
+
+  // Gets the candidate rows of @p literal, as a string.
+  std::string GetCandidates(const char* literal) {
+    std::vector<int> rows;
+    if (!index_.GetCandidateRows(literal, &rows))
+      return "all";
+
+    std::string candidates;
+    for (size_t i = 0; i < rows.size(); ++i)
+      candidates += base::StringPrintf(i == 0 ? "%d" : ",%d", rows[i]);
+    return candidates;
+  }
+
+ protected:
+  std::vector<std::string> messages_;
+  MessageIndex index_;
+};
+
+}  // namespace
+
+TEST_F(MessageIndexTest, Statistics) {
+  EXPECT_LT(0U, index_.num_tokens());
+  EXPECT_LE(index_.num_tokens(), index_.num_postings());
+  EXPECT_LT(0U, index_.GetMemoryUsage());
+
+  index_.Clear();
+  EXPECT_EQ(0U, index_.num_tokens());
+  EXPECT_EQ(0U, index_.num_postings());
+  EXPECT_EQ("", GetCandidates(" file "));
+}
+
+TEST_F(MessageIndexTest, WholeTokens) {
+  // Tokens bounded by separators are looked up as is, without regard to
+  // case. The row with the unindexed blob is a candidate for anything.
+  EXPECT_EQ("0,1,4", GetCandidates(" file "));
+  EXPECT_EQ("0,2,4", GetCandidates(" opened "));
+  EXPECT_EQ("0,4", GetCandidates(" opened file "));
+  EXPECT_EQ("4", GetCandidates(" nothing "));
+  EXPECT_EQ("3,4", GetCandidates("=42 "));
+
+  // Tokens too short to index don't narrow the rows.
+  EXPECT_EQ("all", GetCandidates(" a "));
+  EXPECT_EQ("all", GetCandidates(""));
+  EXPECT_EQ("all", GetCandidates(" = "));
+  EXPECT_EQ("3,4", GetCandidates(" a b thread_id="));
+}
+
+TEST_F(MessageIndexTest, PartialTokens) {
+  // Tokens at the ends of the literal may be part of longer tokens.
+  EXPECT_EQ("0,1,2,4", GetCandidates("foo"));
+  EXPECT_EQ("0,1,4", GetCandidates("foo\\"));
+  EXPECT_EQ("0,1,2,4", GetCandidates("\\foo"));
+  EXPECT_EQ("0,2,4", GetCandidates("bar"));
+  EXPECT_EQ("2,4", GetCandidates("ooba"));
+  EXPECT_EQ("0,4", GetCandidates("opened file c:"));
+
+  // Partial tokens that are too short don't narrow the rows.
+  EXPECT_EQ("all", GetCandidates("ba"));
+  EXPECT_EQ("1,4", GetCandidates("ba closed"));
+}
+
+TEST_F(MessageIndexTest, LongTokens) {
+  std::string blob(100, 'X');
+  EXPECT_EQ("4", GetCandidates(blob.c_str()));
+  EXPECT_EQ("4", GetCandidates(("blob " + blob).c_str()));
+}
+
+TEST_F(MessageIndexTest, ManyRows) {
+  // Rows far apart take several bytes to encode.
+  MessageIndex index;
+  const int kRows[] = { 0, 2, 129, 300, 16384, 100000, 20000000 };
+  for (size_t i = 0; i < arraysize(kRows); ++i) {
+    index.AddMessage(kRows[i], "Common message, common message");
+    index.AddMessage(kRows[i] + 1, base::StringPrintf("Row %d", kRows[i]));
+  }
+
+  std::vector<int> rows;
+  ASSERT_TRUE(index.GetCandidateRows("common", &rows));
+  ASSERT_EQ(arraysize(kRows), rows.size());
+  for (size_t i = 0; i < arraysize(kRows); ++i)
+    EXPECT_EQ(kRows[i], rows[i]);
+
+  ASSERT_TRUE(index.GetCandidateRows(" 16384", &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ(16385, rows[0]);
+}
+
+TEST_F(MessageIndexTest, PersistedPostings) {
+  std::vector<std::string> tokens;
+  std::vector<std::string> postings;
+  index_.GetPostings(&tokens, &postings);
+  ASSERT_EQ(tokens.size(), postings.size());
+  // The unindexed blob has its own, empty, token.
+  EXPECT_EQ(index_.num_tokens() + 1, tokens.size());
+
+  MessageIndex loaded;
+  for (size_t i = 0; i < tokens.size(); ++i)
+    ASSERT_TRUE(loaded.AddPostings(tokens[i], postings[i], messages_.size()));
+  EXPECT_EQ(index_.num_tokens(), loaded.num_tokens());
+  EXPECT_EQ(index_.num_postings(), loaded.num_postings());
+
+  // Messages added after the loaded ones are found along with them.
+  loaded.AddMessage(messages_.size(), "Opened another file");
+  index_.AddMessage(messages_.size(), "Opened another file");
+  const char* kLiterals[] = {
+      " file ", " opened file ", "foo", "ooba", "=42 ", " a ", " another " };
+  for (size_t i = 0; i < arraysize(kLiterals); ++i) {
+    std::vector<int> expected_rows;
+    std::vector<int> rows;
+    EXPECT_EQ(index_.GetCandidateRows(kLiterals[i], &expected_rows),
+              loaded.GetCandidateRows(kLiterals[i], &rows));
+    EXPECT_EQ(expected_rows, rows);
+  }
+
+  // Swapping an index moves its postings.
+  MessageIndex swapped;
+  swapped.Swap(&loaded);
+  EXPECT_EQ(0U, loaded.num_tokens());
+  EXPECT_EQ(index_.num_tokens(), swapped.num_tokens());
+}
+
+TEST_F(MessageIndexTest, RejectsInvalidPostings) {
+  MessageIndex index;
+  // Rows 0 and 2.
+  const char kPostings[] = "\x01\x02";
+  EXPECT_TRUE(index.AddPostings("foo", kPostings, 3));
+  // Tokens are only added once.
+  EXPECT_FALSE(index.AddPostings("foo", kPostings, 3));
+  // Rows past the end.
+  EXPECT_FALSE(index.AddPostings("bar", kPostings, 2));
+  // Rows that don't increase.
+  EXPECT_FALSE(index.AddPostings("baz", base::StringPiece("\x01\x00", 2), 3));
+  // A truncated varint.
+  EXPECT_FALSE(index.AddPostings("qux", "\x81", 3));
+  // Tokens that can't be indexed, and no rows.
+  EXPECT_FALSE(index.AddPostings("x", kPostings, 3));
+  EXPECT_FALSE(index.AddPostings("quux", "", 3));
+}
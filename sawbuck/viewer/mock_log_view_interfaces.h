@@ -40,7 +40,12 @@ class MockILogView: public ILogView {
   MOCK_METHOD1(GetFileName, std::string(int row));
   MOCK_METHOD1(GetLine, int(int row));
   MOCK_METHOD1(GetMessage, std::string(int row));
+  MOCK_METHOD2(GetMessagePiece,
+               base::StringPiece(int row, std::string* buffer));
   MOCK_METHOD2(GetStackTrace, void(int row, std::vector<void*>* trace));
+  MOCK_METHOD2(GetCandidateRows, bool(const base::StringPiece& literal,
+                                      std::vector<int>* rows));
+  MOCK_METHOD2(GetRowSummary, bool(int row, LogRowSummary* summary));
 
   MOCK_METHOD2(Register, void(ILogViewEvents* event_sink,
                               int* registration_cookie));
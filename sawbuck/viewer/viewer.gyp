@@ -60,6 +60,34 @@
         ],
       },
     },
+    {
+      # The snapshot format only depends on base, so that snapshots can be
+      # read outside of the viewer. Snapshots persist the message index.
+      'target_name': 'log_snapshot_lib',
+      'type': 'static_library',
+      'sources': [
+        'log_snapshot.cc',
+        'log_snapshot.h',
+        'message_index.cc',
+        'message_index.h',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+    },
+    {
+      'target_name': 'log_snapshot_unittests',
+      'type': 'executable',
+      'sources': [
+        'log_snapshot_unittest.cc',
+        'log_snapshot_unittest_main.cc',
+      ],
+      'dependencies': [
+        'log_snapshot_lib',
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/testing/gtest.gyp:gtest',
+      ],
+    },
     {
       'target_name': 'viewer',
       'type': 'static_library',
@@ -69,6 +97,8 @@
         'filter.h',
         'filter_dialog.cc',
         'filter_dialog.h',
+        'filter_program.cc',
+        'filter_program.h',
         'filtered_log_view.cc',
         'filtered_log_view.h',
         'find_dialog.cc',
@@ -77,6 +107,11 @@
         'log_viewer.cc',
         'log_list_view.h',
         'log_list_view.cc',
+        'log_message_store.cc',
+        'log_message_store.h',
+        'log_page_file.cc',
+        'log_page_file.h',
+        'log_row_summary.h',
         'preferences.cc',
         'preferences.h',
         'provider_configuration.cc',
@@ -90,6 +125,7 @@
         'viewer_window.h',
       ],
       'dependencies': [
+        'log_snapshot_lib',
         '../log_lib/log_lib.gyp:log_lib',
         '<(DEPTH)/base/base.gyp:base',
         '<(DEPTH)/third_party/pcre/pcre.gyp:pcre_lib',
@@ -146,8 +182,12 @@
       'target_name': 'viewer_unittests',
       'type': 'executable',
       'sources': [
+        'filter_program_unittest.cc',
         'filter_unittest.cc',
         'filtered_log_view_unittest.cc',
+        'log_message_store_unittest.cc',
+        'log_page_file_unittest.cc',
+        'message_index_unittest.cc',
         'preferences_unittest.cc',
         'provider_configuration_unittest.cc',
         'registry_test.h',
@@ -15,6 +15,8 @@
 // Log viewer window implementation.
 #include "sawbuck/viewer/viewer_window.h"
 
+#include <algorithm>
+
 #include "pcrecpp.h"  // NOLINT
 #include "base/bind.h"
 #include "base/environment.h"
@@ -23,8 +25,8 @@
 #include "base/path_service.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/sys_info.h"
 #include "base/utf_string_conversions.h"
-#include "base/win/event_trace_consumer.h"
 #include "sawbuck/viewer/const_config.h"
 #include "sawbuck/viewer/preferences.h"
 #include "sawbuck/viewer/provider_dialog.h"
@@ -44,6 +46,16 @@ const pcrecpp::RE kFileRe("\\[[^\\]]*\\:([^:]+)\\((\\d+)\\)\\].(.*\\w).*",
 
 const wchar_t kSessionName[] = L"Sawbuck Log Session";
 
+// The maximum number of threads dedicated to symbol lookups.
+const int kMaxSymbolLookupWorkers = 4;
+
+// The location of the symbol cache file in the local application data.
+const wchar_t kSymbolCacheDir[] = L"Sawbuck";
+const wchar_t kSymbolCacheFile[] = L"symbol_cache.bin";
+
+// The extension of snapshot files.
+const wchar_t kSnapshotExtension[] = L".sawsnap";
+
 bool Is64BitSystem() {
   if (sizeof(void*) == 8)  // NOLINT
     return true;
@@ -76,9 +88,9 @@ void ViewerWindow::CompileAsserts() {
 }
 
 ViewerWindow::ViewerWindow()
-     : symbol_lookup_worker_("Symbol Lookup Worker"),
-       next_sink_cookie_(1),
+     : next_sink_cookie_(1),
        log_viewer_(this),
+       snapshot_rows_(0),
        ui_loop_(NULL),
        notify_log_view_new_items_(
           base::Bind(&ViewerWindow::NotifyLogViewNewItems,
@@ -92,15 +104,23 @@ ViewerWindow::ViewerWindow()
   ui_loop_ = MessageLoop::current();
   DCHECK(ui_loop_ != NULL);
 
-  symbol_lookup_worker_.Start();
-  DCHECK(symbol_lookup_worker_.message_loop() != NULL);
-
   status_callback_ = base::Bind(&ViewerWindow::OnStatusUpdate,
                                 base::Unretained(this));
   symbol_lookup_service_.set_status_callback(status_callback_);
 
-  symbol_lookup_service_.set_background_thread(
-      symbol_lookup_worker_.message_loop());
+  InitSymbolCacheFile();
+  symbol_lookup_service_.set_symbol_cache_file(&symbol_cache_file_);
+
+  int num_workers = std::min(base::SysInfo::NumberOfProcessors(),
+                             kMaxSymbolLookupWorkers);
+  for (int i = 0; i < num_workers; ++i) {
+    base::Thread* worker = new base::Thread("Symbol Lookup Worker");
+    symbol_lookup_workers_.push_back(worker);
+    CHECK(worker->Start());
+    DCHECK(worker->message_loop() != NULL);
+
+    symbol_lookup_service_.AddWorkerThread(worker->message_loop());
+  }
 
   InitSymbolPath();
   symbol_lookup_service_.SetSymbolPath(symbol_path_.c_str());
@@ -113,94 +133,70 @@ ViewerWindow::~ViewerWindow() {
   // Last resort..
   StopCapturing();
 
-  symbol_lookup_worker_.Stop();
+  for (size_t i = 0; i < symbol_lookup_workers_.size(); ++i)
+    symbol_lookup_workers_[i]->Stop();
+
+  // The workers are gone, so the symbols they resolved can be written out.
+  symbol_cache_file_.Save();
 
   notify_log_view_new_items_.Cancel();
   update_status_task_.Cancel();
 }
 
-namespace {
-
-class ImportLogConsumer
-    : public base::win::EtwTraceConsumerBase<ImportLogConsumer>,
-      public LogParser,
-      public KernelLogParser {
- public:
-  ImportLogConsumer();
-  ~ImportLogConsumer();
-
-  static void ProcessEvent(PEVENT_TRACE event);
-
- private:
-  static ImportLogConsumer* current_;
-};
-
-ImportLogConsumer* ImportLogConsumer::current_ = NULL;
-
-ImportLogConsumer::ImportLogConsumer() {
-  DCHECK(current_ == NULL);
-  current_ = this;
-}
-
-ImportLogConsumer::~ImportLogConsumer() {
-  DCHECK(current_ == this);
-  current_ = NULL;
-}
-
-void ImportLogConsumer::ProcessEvent(PEVENT_TRACE event) {
-  DCHECK(current_ != NULL);
-
-  if (!current_->LogParser::ProcessOneEvent(event) &&
-      !current_->KernelLogParser::ProcessOneEvent(event)) {
-    LOG(INFO) << "Unknown event";
+void ViewerWindow::ImportLogFiles(const std::vector<FilePath>& paths) {
+  if (paths.size() == 1 &&
+      StringToLowerASCII(paths[0].Extension()) == kSnapshotExtension) {
+    OpenSnapshot(paths[0]);
+    return;
   }
-}
 
-}  // namespace
-
-void ViewerWindow::ImportLogFiles(const std::vector<FilePath>& paths) {
   UISetText(0, L"Importing");
   UIUpdateStatusBar();
 
-  ImportLogConsumer import_consumer;
-
-  // Open all the log files.
-  for (size_t i = 0; i < paths.size(); ++i) {
-    HRESULT hr = import_consumer.OpenFileSession(paths[i].value().c_str());
-
-    if (FAILED(hr)) {
-      std::wstring msg =
-          StringPrintf(L"Failed to open log file \"%ls\", error 0x%08X",
-                       paths[i].value().c_str(),
-                       hr);
-
-      ::MessageBox(m_hWnd, msg.c_str(), L"Error Importing Logs", MB_OK);
-      return;
-    }
-  }
-
-  // Attach our event sinks to the consumer.
-  import_consumer.set_event_sink(this);
-  import_consumer.set_trace_sink(this);
-  import_consumer.set_process_event_sink(&process_info_service_);
-  import_consumer.set_module_event_sink(&symbol_lookup_service_);
-
-  // Consume the files.
-  // TODO(siggi): Report progress here.
-  HRESULT hr = import_consumer.Consume();
+  // Attach our event sinks to the importer, which decodes the files on
+  // worker threads, and issues their events to us on this thread as they're
+  // decoded.
+  LogImporter importer;
+  importer.set_event_sink(this);
+  importer.set_trace_sink(this);
+  importer.set_process_event_sink(&process_info_service_);
+  importer.set_module_event_sink(this);
+  importer.set_progress_callback(
+      base::Bind(&ViewerWindow::OnImportProgress, base::Unretained(this)));
+
+  HRESULT hr = importer.Import(paths);
   if (FAILED(hr)) {
     std::wstring msg =
-        StringPrintf(L"Import failed with error 0x%08X",
+        StringPrintf(L"Failed to import log file \"%ls\", error 0x%08X",
+                     importer.failed_path().value().c_str(),
                      hr);
     ::MessageBox(m_hWnd, msg.c_str(), L"Error Importing Logs", MB_OK);
   }
 
+  {
+    base::AutoLock lock(list_lock_);
+    LOG(INFO) << "Indexed " << log_messages_.size() << " messages in "
+              << message_index_.build_time().InMilliseconds() << " ms: "
+              << message_index_.num_tokens() << " tokens, "
+              << message_index_.num_postings() << " postings, "
+              << message_index_.GetMemoryUsage() << " bytes.";
+  }
+
   UISetText(0, L"Ready");
   UIUpdateStatusBar();
 }
 
+void ViewerWindow::OnImportProgress(int percent_decoded, int issued_events) {
+  std::wstring status = StringPrintf(L"Importing: %d%% decoded, %d events",
+                                     percent_decoded,
+                                     issued_events);
+  UISetText(0, status.c_str());
+  UIUpdateStatusBar();
+}
+
 const wchar_t kLogFileFilter[] =
     L"Event Trace Files\0*.etl\0"
+    L"Sawbuck Snapshots\0*.sawsnap\0"
     L"All Files\n\0*.*\0";
 
 void ViewerWindow::SetCapture(bool capture) {
@@ -251,6 +247,132 @@ LRESULT ViewerWindow::OnImport(
   return 0;
 }
 
+const wchar_t kSnapshotFileFilter[] =
+    L"Sawbuck Snapshots\0*.sawsnap\0"
+    L"All Files\0*.*\0";
+
+LRESULT ViewerWindow::OnSaveSnapshot(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  CFileDialog dialog(FALSE, kSnapshotExtension + 1, NULL,
+                     OFN_OVERWRITEPROMPT | OFN_HIDEREADONLY,
+                     kSnapshotFileFilter, m_hWnd);
+
+  if (dialog.DoModal() == IDOK)
+    SaveSnapshot(FilePath(dialog.m_szFileName));
+
+  return 0;
+}
+
+bool ViewerWindow::SaveSnapshot(const FilePath& path) {
+  UISetText(0, L"Saving snapshot");
+  UIUpdateStatusBar();
+
+  // The writer only replaces the file at @p path once the whole snapshot is
+  // written, so a failed save leaves any previous snapshot intact.
+  LogSnapshotWriter writer;
+  bool success = writer.Create(path);
+
+  // Rows are only ever added while we write, so the rows counted up front
+  // stay valid throughout.
+  int num_rows = GetNumRows();
+  std::vector<void*> trace;
+  std::string message;
+  for (int row = 0; success && row < num_rows; ++row) {
+    std::string file_name(GetFileName(row));
+    GetStackTrace(row, &trace);
+
+    LogSnapshotWriter::Message msg;
+    msg.level = GetSeverity(row);
+    msg.process_id = GetProcessId(row);
+    msg.thread_id = GetThreadId(row);
+    msg.time = GetTime(row);
+    msg.file = file_name;
+    msg.line = GetLine(row);
+    msg.message = GetMessagePiece(row, &message);
+    if (!trace.empty()) {
+      msg.trace = &trace[0];
+      msg.trace_depth = trace.size();
+    }
+
+    success = writer.AddMessage(msg);
+  }
+
+  if (success) {
+    base::AutoLock lock(module_events_lock_);
+    for (size_t i = 0; i < module_events_.size(); ++i)
+      writer.AddModuleEvent(module_events_[i]);
+  }
+
+  if (success)
+    success = writer.Finish();
+
+  if (!success) {
+    std::wstring msg = StringPrintf(L"Failed to write snapshot \"%ls\"",
+                                    path.value().c_str());
+    ::MessageBox(m_hWnd, msg.c_str(), L"Error Saving Snapshot", MB_OK);
+  }
+
+  UISetText(0, L"Ready");
+  UIUpdateStatusBar();
+
+  return success;
+}
+
+void ViewerWindow::OpenSnapshot(const FilePath& path) {
+  UISetText(0, L"Opening snapshot");
+  UIUpdateStatusBar();
+
+  scoped_ptr<LogSnapshot> snapshot(new LogSnapshot());
+  MessageIndex snapshot_index;
+  if (!snapshot->Open(path) || !snapshot->LoadMessageIndex(&snapshot_index)) {
+    std::wstring msg = StringPrintf(L"Failed to open snapshot \"%ls\"",
+                                    path.value().c_str());
+    ::MessageBox(m_hWnd, msg.c_str(), L"Error Opening Snapshot", MB_OK);
+  } else {
+    // The snapshot replaces the log.
+    log_viewer_.ClearAll();
+
+    // Replay the module events, so that the stack traces resolve.
+    LogSnapshot::ModuleEvent event;
+    for (size_t i = 0; i < snapshot->num_module_events(); ++i) {
+      snapshot->GetModuleEvent(i, &event);
+
+      ModuleInformation module_info;
+      module_info.base_address = event.base_address;
+      module_info.module_size = event.module_size;
+      module_info.image_checksum = event.image_checksum;
+      module_info.time_date_stamp = event.time_date_stamp;
+      module_info.image_file_name = UTF8ToWide(event.image_file_name);
+
+      switch (event.type) {
+        case LogSnapshot::ModuleEvent::MODULE_IS_LOADED:
+          OnModuleIsLoaded(event.process_id, event.time, module_info);
+          break;
+        case LogSnapshot::ModuleEvent::MODULE_LOAD:
+          OnModuleLoad(event.process_id, event.time, module_info);
+          break;
+        case LogSnapshot::ModuleEvent::MODULE_UNLOAD:
+          OnModuleUnload(event.process_id, event.time, module_info);
+          break;
+        default:
+          NOTREACHED() << "Unexpected module event type.";
+          break;
+      }
+    }
+
+    base::AutoLock lock(list_lock_);
+    DCHECK_EQ(0U, log_messages_.size());
+    snapshot_rows_ = snapshot->size();
+    snapshot_.swap(snapshot);
+    // The live messages are indexed after the rows of the snapshot.
+    message_index_.Swap(&snapshot_index);
+    ScheduleNewItemsNotification();
+  }
+
+  UISetText(0, L"Ready");
+  UIUpdateStatusBar();
+}
+
 LRESULT ViewerWindow::OnExit(
     WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
   PostMessage(WM_CLOSE);
@@ -375,7 +497,7 @@ bool ViewerWindow::StartCapturing() {
   // And open a consumer on it.
   kernel_consumer_.reset(new KernelLogConsumer());
   DCHECK(NULL != kernel_consumer_.get());
-  kernel_consumer_->set_module_event_sink(&symbol_lookup_service_);
+  kernel_consumer_->set_module_event_sink(this);
   kernel_consumer_->set_process_event_sink(&process_info_service_);
   kernel_consumer_->set_is_64_bit_log(Is64BitSystem());
   hr = kernel_consumer_->OpenRealtimeSession(KERNEL_LOGGER_NAME);
@@ -405,39 +527,82 @@ void ViewerWindow::EnableProviders(
 }
 
 void ViewerWindow::OnLogMessage(const LogEvents::LogMessage& log_message) {
-  ViewerWindow::LogMessage msg;
+  LogMessageStore::MessageInfo msg;
   msg.level = log_message.level;
   msg.process_id = log_message.process_id;
   msg.thread_id = log_message.thread_id;
-  msg.time_stamp = log_message.time;
+  msg.time = log_message.time;
 
   // Use regular expression matching to extract the
   // file/line/message from the log string, which is of
   // format "[<stuff>:<file>(<line>)] <message><ws>".
-  if (!kFileRe.FullMatch(
+  pcrecpp::StringPiece file;
+  pcrecpp::StringPiece message;
+  if (kFileRe.FullMatch(
       pcrecpp::StringPiece(log_message.message, log_message.message_len),
-                           &msg.file, &msg.line, &msg.message)) {
+                           &file, &msg.line, &message)) {
+    msg.file.set(file.data(), file.size());
+    msg.message.set(message.data(), message.size());
+  } else {
     // As fallback, just slurp the entire string.
-    msg.message.assign(log_message.message, log_message.message_len);
+    msg.message.set(log_message.message, log_message.message_len);
   }
 
   // If the message carried file information, use that
   // in preference to the above.
   if (log_message.file_len != 0) {
-    msg.file.assign(log_message.file, log_message.file_len);
+    msg.file.set(log_message.file, log_message.file_len);
     msg.line = log_message.line;
   }
 
   if (log_message.trace_depth > 0) {
-    msg.trace.insert(msg.trace.begin(),
-                     &log_message.traces[0],
-                     &log_message.traces[log_message.trace_depth - 1]);
+    msg.trace = &log_message.traces[0];
+    msg.trace_depth = log_message.trace_depth - 1;
   }
 
-  base::AutoLock lock(list_lock_);
-  log_messages_.push_back(msg);
+  AddMessage(msg);
+}
 
-  ScheduleNewItemsNotification();
+void ViewerWindow::OnModuleIsLoaded(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info) {
+  RecordModuleEvent(LogSnapshot::ModuleEvent::MODULE_IS_LOADED,
+                    process_id, time, module_info);
+  symbol_lookup_service_.OnModuleIsLoaded(process_id, time, module_info);
+}
+
+void ViewerWindow::OnModuleUnload(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info) {
+  RecordModuleEvent(LogSnapshot::ModuleEvent::MODULE_UNLOAD,
+                    process_id, time, module_info);
+  symbol_lookup_service_.OnModuleUnload(process_id, time, module_info);
+}
+
+void ViewerWindow::OnModuleLoad(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+  RecordModuleEvent(LogSnapshot::ModuleEvent::MODULE_LOAD,
+                    process_id, time, module_info);
+  symbol_lookup_service_.OnModuleLoad(process_id, time, module_info);
+}
+
+void ViewerWindow::RecordModuleEvent(LogSnapshot::ModuleEvent::Type type,
+                                     DWORD process_id,
+                                     const base::Time& time,
+                                     const ModuleInformation& module_info) {
+  LogSnapshot::ModuleEvent event;
+  event.type = type;
+  event.process_id = process_id;
+  event.time = time;
+  event.base_address = module_info.base_address;
+  event.module_size = module_info.module_size;
+  event.image_checksum = module_info.image_checksum;
+  event.time_date_stamp = module_info.time_date_stamp;
+  event.image_file_name = WideToUTF8(module_info.image_file_name);
+
+  base::AutoLock lock(module_events_lock_);
+  module_events_.push_back(event);
 }
 
 void ViewerWindow::OnStatusUpdate(const wchar_t* status) {
@@ -496,26 +661,32 @@ void ViewerWindow::OnTraceEventInstant(
 
 void ViewerWindow::AddTraceEventToLog(const char* type,
     const TraceEvents::TraceMessage& trace_message) {
-  ViewerWindow::LogMessage msg;
+  LogMessageStore::MessageInfo msg;
   msg.level = trace_message.level;
   msg.process_id = trace_message.process_id;
   msg.thread_id = trace_message.thread_id;
-  msg.time_stamp = trace_message.time;
+  msg.time = trace_message.time;
 
   // The message will be of form "{BEGIN|END|INSTANT}(<name>, 0x<id>): <extra>"
-  msg.message = StringPrintf("%s(%*s, 0x%08X): %*s",
-                             type,
-                             trace_message.name_len,
-                             trace_message.name,
-                             trace_message.id,
-                             trace_message.extra_len,
-                             trace_message.extra);
-
-  for (size_t i = 0; i < trace_message.trace_depth; ++i)
-    msg.trace.push_back(trace_message.traces[i]);
+  std::string message = StringPrintf("%s(%*s, 0x%08X): %*s",
+                                     type,
+                                     trace_message.name_len,
+                                     trace_message.name,
+                                     trace_message.id,
+                                     trace_message.extra_len,
+                                     trace_message.extra);
+  msg.message = message;
+
+  msg.trace = trace_message.traces;
+  msg.trace_depth = trace_message.trace_depth;
+
+  AddMessage(msg);
+}
 
+void ViewerWindow::AddMessage(const LogMessageStore::MessageInfo& msg) {
   base::AutoLock lock(list_lock_);
-  log_messages_.push_back(msg);
+  size_t row = log_messages_.AddMessage(msg);
+  message_index_.AddMessage(snapshot_rows_ + row, msg.message);
 
   ScheduleNewItemsNotification();
 }
@@ -739,55 +910,112 @@ void ViewerWindow::OnDestroy() {
 
 int ViewerWindow::GetNumRows() {
   base::AutoLock lock(list_lock_);
-  return log_messages_.size();
+  return snapshot_rows_ + log_messages_.size();
 }
 
 void ViewerWindow::ClearAll() {
   {
     base::AutoLock lock(list_lock_);
-    log_messages_.clear();
+    log_messages_.Clear();
+    message_index_.Clear();
+    snapshot_.reset();
+    snapshot_rows_ = 0;
+  }
+  {
+    base::AutoLock lock(module_events_lock_);
+    module_events_.clear();
   }
   NotifyLogViewCleared();
 }
 
 int ViewerWindow::GetSeverity(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].level;
+  if (row < snapshot_rows_)
+    return snapshot_->GetLevel(row);
+  return log_messages_.GetLevel(row - snapshot_rows_);
 }
 
 DWORD ViewerWindow::GetProcessId(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].process_id;
+  if (row < snapshot_rows_)
+    return snapshot_->GetProcessId(row);
+  return log_messages_.GetProcessId(row - snapshot_rows_);
 }
 
 DWORD ViewerWindow::GetThreadId(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].thread_id;
+  if (row < snapshot_rows_)
+    return snapshot_->GetThreadId(row);
+  return log_messages_.GetThreadId(row - snapshot_rows_);
 }
 
 base::Time ViewerWindow::GetTime(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].time_stamp;
+  if (row < snapshot_rows_)
+    return snapshot_->GetTime(row);
+  return log_messages_.GetTime(row - snapshot_rows_);
 }
 
 std::string ViewerWindow::GetFileName(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].file;
+  if (row < snapshot_rows_)
+    return snapshot_->GetFileName(row).as_string();
+  return log_messages_.GetFileName(row - snapshot_rows_);
 }
 
 int ViewerWindow::GetLine(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].line;
+  if (row < snapshot_rows_)
+    return snapshot_->GetLine(row);
+  return log_messages_.GetLine(row - snapshot_rows_);
 }
 
 std::string ViewerWindow::GetMessage(int row) {
   base::AutoLock lock(list_lock_);
-  return log_messages_[row].message;
+  if (row < snapshot_rows_)
+    return snapshot_->GetMessage(row).as_string();
+  return log_messages_.GetMessage(row - snapshot_rows_).as_string();
+}
+
+base::StringPiece ViewerWindow::GetMessagePiece(int row,
+                                               std::string* buffer) {
+  DCHECK(buffer != NULL);
+
+  // The snapshot stays mapped until cleared, but the store may unmap the
+  // message text as soon as the lock is released, so copy it.
+  base::AutoLock lock(list_lock_);
+  if (row < snapshot_rows_)
+    return snapshot_->GetMessage(row);
+  log_messages_.GetMessage(row - snapshot_rows_).CopyToString(buffer);
+  return *buffer;
 }
 
 void ViewerWindow::GetStackTrace(int row, std::vector<void*>* trace) {
   base::AutoLock lock(list_lock_);
-  *trace = log_messages_[row].trace;
+  if (row < snapshot_rows_)
+    snapshot_->GetStackTrace(row, trace);
+  else
+    *trace = log_messages_.GetStackTrace(row - snapshot_rows_);
+}
+
+bool ViewerWindow::GetCandidateRows(const base::StringPiece& literal,
+                                    std::vector<int>* rows) {
+  base::AutoLock lock(list_lock_);
+  return message_index_.GetCandidateRows(literal, rows);
+}
+
+bool ViewerWindow::GetRowSummary(int row, LogRowSummary* summary) {
+  DCHECK(summary != NULL);
+
+  base::AutoLock lock(list_lock_);
+  // The rows of a snapshot aren't summarized.
+  if (row < snapshot_rows_)
+    return false;
+
+  log_messages_.GetRowSummary(row - snapshot_rows_, summary);
+  summary->first_row += snapshot_rows_;
+  summary->end_row += snapshot_rows_;
+  return true;
 }
 
 void ViewerWindow::Register(ILogViewEvents* event_sink,
@@ -802,6 +1030,18 @@ void ViewerWindow::Unregister(int registration_cookie) {
   event_sinks_.erase(registration_cookie);
 }
 
+void ViewerWindow::InitSymbolCacheFile() {
+  FilePath app_data_dir;
+  if (!PathService::Get(base::DIR_LOCAL_APP_DATA, &app_data_dir))
+    return;
+
+  FilePath cache_dir(app_data_dir.Append(kSymbolCacheDir));
+  if (!file_util::CreateDirectory(cache_dir))
+    return;
+
+  symbol_cache_file_.Open(cache_dir.Append(kSymbolCacheFile));
+}
+
 void ViewerWindow::InitSymbolPath() {
   {
     // Attempt to read our current preference if one exists.
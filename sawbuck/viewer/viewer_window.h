@@ -30,14 +30,19 @@
 #include "base/cancelable_callback.h"
 #include "base/file_path.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/thread.h"
 #include "base/win/event_trace_controller.h"
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 #include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/log_importer.h"
 #include "sawbuck/log_lib/process_info_service.h"
 #include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/viewer/log_message_store.h"
+#include "sawbuck/viewer/log_snapshot.h"
 #include "sawbuck/viewer/log_viewer.h"
+#include "sawbuck/viewer/message_index.h"
 #include "sawbuck/viewer/provider_configuration.h"
 #include "sawbuck/viewer/resource.h"
 
@@ -46,6 +51,7 @@ class ViewerWindow
     : public CFrameWindowImpl<ViewerWindow>,
       public LogEvents,
       public TraceEvents,
+      public KernelModuleEvents,
       public ILogView,
       public CIdleHandler,
       public CMessageFilter,
@@ -58,6 +64,7 @@ class ViewerWindow
     MSG_WM_CREATE(OnCreate)
     MSG_WM_DESTROY(OnDestroy)
     COMMAND_ID_HANDLER(ID_FILE_IMPORT, OnImport)
+    COMMAND_ID_HANDLER(ID_FILE_SAVE_SNAPSHOT, OnSaveSnapshot)
     COMMAND_ID_HANDLER(ID_FILE_EXIT, OnExit)
     COMMAND_ID_HANDLER(ID_APP_ABOUT, OnAbout)
     COMMAND_ID_HANDLER(ID_LOG_CONFIGUREPROVIDERS, OnConfigureProviders)
@@ -98,7 +105,11 @@ class ViewerWindow
   virtual std::string GetFileName(int row);
   virtual int GetLine(int row);
   virtual std::string GetMessage(int row);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
   virtual void GetStackTrace(int row, std::vector<void*>* stack_trace);
+  virtual bool GetCandidateRows(const base::StringPiece& literal,
+                                std::vector<int>* rows);
+  virtual bool GetRowSummary(int row, LogRowSummary* summary);
 
   virtual void Register(ILogViewEvents* event_sink,
                         int* registration_cookie);
@@ -107,11 +118,17 @@ class ViewerWindow
   // Turn capturing on or off.
   virtual void SetCapture(bool capture);
 
-  // Consumes the logs in paths.
+  // Consumes the logs in paths. A single snapshot file is opened in place.
   void ImportLogFiles(const std::vector<FilePath>& paths);
 
+  // Writes the log, and the module events seen so far, to a snapshot at
+  // @p path.
+  // @returns true on success.
+  bool SaveSnapshot(const FilePath& path);
+
  private:
   LRESULT OnImport(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnSaveSnapshot(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
   LRESULT OnExit(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
   LRESULT OnAbout(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
   LRESULT OnConfigureProviders(WORD code, LPARAM lparam, HWND wnd,
@@ -134,6 +151,9 @@ class ViewerWindow
   // Initializes the symbol path.
   void InitSymbolPath();
 
+  // Opens the symbol cache file in the user's local application data.
+  void InitSymbolCacheFile();
+
   // Called on UI thread to dispatch notifications to listeners.
   void NotifyLogViewNewItems();
   void NotifyLogViewCleared();
@@ -155,6 +175,31 @@ class ViewerWindow
   void AddTraceEventToLog(const char* type,
                           const TraceEvents::TraceMessage& trace_message);
 
+  // KernelModuleEvents implementation. Records the events for snapshots,
+  // and forwards them to the symbol lookup service.
+  void OnModuleIsLoaded(DWORD process_id,
+                        const base::Time& time,
+                        const ModuleInformation& module_info);
+  void OnModuleUnload(DWORD process_id,
+                      const base::Time& time,
+                      const ModuleInformation& module_info);
+  void OnModuleLoad(DWORD process_id,
+                    const base::Time& time,
+                    const ModuleInformation& module_info);
+  void RecordModuleEvent(LogSnapshot::ModuleEvent::Type type,
+                         DWORD process_id,
+                         const base::Time& time,
+                         const ModuleInformation& module_info);
+
+  // Shows the progress of an import in the status bar.
+  void OnImportProgress(int percent_decoded, int issued_events);
+
+  // Replaces the log with the snapshot at @p path.
+  void OpenSnapshot(const FilePath& path);
+
+  // Stores and indexes a message, and schedules a notification of it.
+  void AddMessage(const LogMessageStore::MessageInfo& msg);
+
   // Schedule a notification of new items on UI thread.
   // Must be called under list_lock_.
   void ScheduleNewItemsNotification();
@@ -164,26 +209,22 @@ class ViewerWindow
   // The currently configured symbol path.
   std::wstring symbol_path_;
 
-  struct LogMessage {
-    LogMessage() : level(0), process_id(0), thread_id(0), line(0) {
-    }
+  // We dedicate a pool of threads to the symbol lookup work.
+  ScopedVector<base::Thread> symbol_lookup_workers_;
 
-    UCHAR level;
-    DWORD process_id;
-    DWORD thread_id;
-    base::Time time_stamp;
-    std::string file;
-    int line;
-    std::string message;
-    std::vector<void*> trace;
-  };
+  base::Lock list_lock_;
+  LogMessageStore log_messages_;  // Under list_lock_.
+  MessageIndex message_index_;  // Under list_lock_.
 
-  // We dedicate a thread to the symbol lookup work.
-  base::Thread symbol_lookup_worker_;
+  // The snapshot the log was opened from, if any. Its rows precede the rows
+  // of log_messages_, and aren't indexed.
+  scoped_ptr<LogSnapshot> snapshot_;  // Under list_lock_.
+  int snapshot_rows_;  // Under list_lock_.
 
-  base::Lock list_lock_;
-  typedef std::vector<LogMessage> LogMessageList;
-  LogMessageList log_messages_;  // Under list_lock_.
+  // The module events seen so far, which snapshots carry along to resolve
+  // their stack traces.
+  base::Lock module_events_lock_;
+  std::vector<LogSnapshot::ModuleEvent> module_events_;
 
   typedef base::CancelableCallback<void()> NotifyNewItemsCallback;
 
@@ -201,6 +242,9 @@ class ViewerWindow
 
   // The symbol lookup service we provide to the log list view.
   SymbolLookupService symbol_lookup_service_;
+
+  // Persists the symbols the service resolves across sessions.
+  sym_util::SymbolCacheFile symbol_cache_file_;
   typedef base::Callback<void(const wchar_t*)> StatusCallback;
   StatusCallback status_callback_;
 
@@ -30,6 +30,8 @@
         'asan_heap.h',
         'asan_shadow.cc',
         'asan_shadow.h',
+        'asan_stack_trace_cache.cc',
+        'asan_stack_trace_cache.h',
       ],
     },
     {
@@ -57,6 +59,7 @@
         'asan_rtl_unittest.cc',
         'asan_rtl_unittests_main.cc',
         'asan_shadow_unittest.cc',
+        'asan_stack_trace_cache_unittest.cc',
       ],
       'dependencies': [
         'asan_rtl',
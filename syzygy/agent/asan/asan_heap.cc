@@ -14,6 +14,9 @@
 
 #include "syzygy/agent/asan/asan_heap.h"
 
+#include <algorithm>
+
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/debug/stack_trace.h"
 #include "syzygy/agent/asan/asan_shadow.h"
@@ -25,6 +28,10 @@ namespace {
 // Redzone size allocated at the start of every heap block.
 const size_t kRedZoneSize = 32U;
 
+// The freed blocks are moved from the pending stack to the quarantine in
+// batches of at most this many bytes.
+const size_t kMaxPendingFlushThreshold = 256 * 1024;
+
 // Utility class which implements an auto lock for a HeapProxy.
 class HeapLocker {
  public:
@@ -48,27 +55,9 @@ class HeapLocker {
   DISALLOW_COPY_AND_ASSIGN(HeapLocker);
 };
 
-// Capture a stack trace and store it in an array of instruction pointer values.
-// @param stack_trace A pointer to a non-allocated array of instruction pointer,
-//     *stack_trace is assumed to be equal NULL when we call this function, the
-//     array will be dynamically allocated.
-// @param trace_size A pointer to the variable where the stack size should be
-//     saved.
-void CaptureStackTrace(void** stack_trace, uint8* trace_size) {
-  DCHECK(stack_trace != NULL);
-  DCHECK(*stack_trace == NULL);
-
-  size_t trace_depth = 0;
-  base::debug::StackTrace trace;
-  const void* temp_trace = trace.Addresses(&trace_depth);
-  *stack_trace = new void*[trace_depth];
-  memcpy(*stack_trace, temp_trace, trace_depth * sizeof(void*));
-
-  // From http://msdn.microsoft.com/en-us/library/bb204633.aspx,
-  // the sum of FramesToSkip and FramesToCapture must be less than 63.
-  DCHECK_LE(trace_depth, 62U);
-  *trace_size = static_cast<uint8>(trace_depth);
-}
+// The stack trace cache shared by all the heaps.
+base::LazyInstance<StackTraceCache> stack_trace_cache =
+    LAZY_INSTANCE_INITIALIZER;
 
 }  // namespace
 
@@ -76,7 +65,12 @@ HeapProxy::HeapProxy()
     : heap_(NULL),
       head_(NULL),
       tail_(NULL),
-      quarantine_size_(0) {
+      quarantine_size_(0),
+      quarantine_max_size_(kDefaultQuarantineMaxSize),
+      pending_flush_threshold_(static_cast<LONG>(
+          GetPendingFlushThreshold(kDefaultQuarantineMaxSize))),
+      pending_head_(NULL),
+      pending_size_(0) {
 }
 
 HeapProxy::~HeapProxy() {
@@ -137,9 +131,8 @@ void* HeapProxy::Alloc(DWORD flags, size_t bytes) {
   block->magic_number = kBlockHeaderSignature;
   block->size = bytes;
   block->state = ALLOCATED;
-  block->alloc_stack_trace = NULL;
-  block->free_stack_trace = NULL;
-  CaptureStackTrace(&block->alloc_stack_trace, &block->alloc_stack_trace_size);
+  block->alloc_stack_trace_id = GetStackTraceCache()->CaptureStackTrace();
+  block->free_stack_trace_id = StackTraceCache::kInvalidTraceId;
 
   uint8* block_alloc = ToAlloc(block);
   Shadow::Unpoison(block_alloc, bytes);
@@ -183,7 +176,7 @@ bool HeapProxy::Free(DWORD flags, void* mem) {
     return false;
   }
 
-  CaptureStackTrace(&block->free_stack_trace, &block->free_stack_trace_size);
+  block->free_stack_trace_id = GetStackTraceCache()->CaptureStackTrace();
   DCHECK(ToAlloc(block) == mem);
   if (!Shadow::IsAccessible(ToAlloc(block)))
     return false;
@@ -245,61 +238,137 @@ bool HeapProxy::QueryInformation(HEAP_INFORMATION_CLASS info_class,
                                 return_length) == TRUE;
 }
 
-void HeapProxy::QuarantineBlock(BlockHeader* block) {
+size_t HeapProxy::quarantine_max_size() const {
+  base::AutoLock lock(lock_);
+  return quarantine_max_size_;
+}
+
+void HeapProxy::set_quarantine_max_size(size_t quarantine_max_size) {
+  base::AutoLock lock(lock_);
+  quarantine_max_size_ = quarantine_max_size;
+  ::InterlockedExchange(&pending_flush_threshold_, static_cast<LONG>(
+      GetPendingFlushThreshold(quarantine_max_size)));
+  FlushPendingBlocksLocked();
+}
+
+size_t HeapProxy::FlushQuarantine() {
   base::AutoLock lock(lock_);
+  FlushPendingBlocksLocked();
+  return quarantine_size_;
+}
+
+void HeapProxy::QuarantineBlock(BlockHeader* block) {
   FreeBlockHeader* free_block = static_cast<FreeBlockHeader*>(block);
+  size_t alloc_size = GetAllocSize(free_block->size);
 
-  free_block->next = NULL;
-  if (tail_ != NULL) {
-    tail_->next = free_block;
-  } else {
-    DCHECK(head_ == NULL);
-    head_ = free_block;
+  // A block that doesn't fit in the quarantine would flush every other block
+  // out of it, only to be flushed itself right away. Release it immediately.
+  // Only the blocks that will trigger a flush anyway can be that big, so the
+  // others don't need lock_ to check the quarantine size.
+  size_t flush_threshold = static_cast<size_t>(pending_flush_threshold_);
+  if (alloc_size >= flush_threshold) {
+    base::AutoLock lock(lock_);
+    if (alloc_size > quarantine_max_size_) {
+      ReleaseBlock(free_block);
+      return;
+    }
   }
-  tail_ = free_block;
 
-  // Poison the released alloc.
-  size_t alloc_size = GetAllocSize(free_block->size);
   // Trash the data in the block and poison it.
   memset(ToAlloc(free_block), 0xCC, free_block->size);
   Shadow::Poison(free_block, alloc_size);
-  quarantine_size_ += alloc_size;
   // Mark the block as quarantined.
   free_block->state = QUARANTINED;
-  // Arbitrarily keep ten megabytes of quarantine per heap.
-  const size_t kMaxQuarantineSizeBytes = 10 * 1024 * 1024;
+
+  // Push the block to the pending stack. Only this push is contended, the
+  // pending stack is always drained as a whole so there's no ABA hazard.
+  FreeBlockHeader* head = NULL;
+  do {
+    head = pending_head_;
+    free_block->next = head;
+  } while (::InterlockedCompareExchangePointer(
+               reinterpret_cast<void* volatile*>(&pending_head_),
+               free_block,
+               head) != head);
+
+  LONG pending_size = ::InterlockedExchangeAdd(
+      &pending_size_, static_cast<LONG>(alloc_size)) +
+      static_cast<LONG>(alloc_size);
+  if (pending_size < static_cast<LONG>(flush_threshold))
+    return;
+
+  base::AutoLock lock(lock_);
+  FlushPendingBlocksLocked();
+}
+
+void HeapProxy::FlushPendingBlocksLocked() {
+  lock_.AssertAcquired();
+
+  // Grab the whole pending stack, and reverse it to restore the order in
+  // which the blocks were freed.
+  FreeBlockHeader* pending = reinterpret_cast<FreeBlockHeader*>(
+      ::InterlockedExchangePointer(
+          reinterpret_cast<void* volatile*>(&pending_head_), NULL));
+  FreeBlockHeader* reversed = NULL;
+  size_t pending_size = 0;
+  while (pending != NULL) {
+    FreeBlockHeader* next = pending->next;
+    pending->next = reversed;
+    reversed = pending;
+    pending_size += GetAllocSize(pending->size);
+    pending = next;
+  }
+  ::InterlockedExchangeAdd(&pending_size_, -static_cast<LONG>(pending_size));
+
+  // Append the pending blocks to the quarantine queue.
+  if (reversed != NULL) {
+    if (tail_ != NULL) {
+      tail_->next = reversed;
+    } else {
+      DCHECK(head_ == NULL);
+      head_ = reversed;
+    }
+    while (reversed->next != NULL)
+      reversed = reversed->next;
+    tail_ = reversed;
+    quarantine_size_ += pending_size;
+  }
 
   // Flush quarantine overage.
-  while (quarantine_size_ > kMaxQuarantineSizeBytes) {
+  while (quarantine_size_ > quarantine_max_size_) {
     DCHECK(head_ != NULL && tail_ != NULL);
 
-    free_block = head_;
+    FreeBlockHeader* free_block = head_;
     head_ = free_block->next;
     if (head_ == NULL)
       tail_ = NULL;
 
-    alloc_size = GetAllocSize(free_block->size);
-    Shadow::Unpoison(free_block, alloc_size);
-    free_block->state = FREED;
-    free_block->magic_number = ~kBlockHeaderSignature;
-    if (free_block->alloc_stack_trace != NULL) {
-      delete free_block->alloc_stack_trace;
-      free_block->alloc_stack_trace = NULL;
-      free_block->alloc_stack_trace_size = 0;
-    }
-    if (free_block->free_stack_trace != NULL) {
-      delete free_block->free_stack_trace;
-      free_block->free_stack_trace = NULL;
-      free_block->free_stack_trace_size = 0;
-    }
-    DCHECK_NE(kBlockHeaderSignature, free_block->magic_number);
-    ::HeapFree(heap_, 0, free_block);
-
+    size_t alloc_size = GetAllocSize(free_block->size);
     DCHECK_GE(quarantine_size_, alloc_size);
     quarantine_size_ -= alloc_size;
+
+    ReleaseBlock(free_block);
   }
 }
 
+void HeapProxy::ReleaseBlock(FreeBlockHeader* free_block) {
+  DCHECK(free_block != NULL);
+
+  size_t alloc_size = GetAllocSize(free_block->size);
+  Shadow::Unpoison(free_block, alloc_size);
+  free_block->state = FREED;
+  free_block->magic_number = ~kBlockHeaderSignature;
+  DCHECK_NE(kBlockHeaderSignature, free_block->magic_number);
+  ::HeapFree(heap_, 0, free_block);
+}
+
+// static
+size_t HeapProxy::GetPendingFlushThreshold(size_t quarantine_max_size) {
+  // Keep the pending stack small relative to the quarantine, so that the
+  // quarantine doesn't overshoot its budget by much.
+  return std::min(quarantine_max_size / 8, kMaxPendingFlushThreshold);
+}
+
 size_t HeapProxy::GetAllocSize(size_t bytes) {
   bytes += kRedZoneSize;
   return (bytes + kRedZoneSize + kRedZoneSize - 1) & ~(kRedZoneSize - 1);
@@ -365,20 +434,8 @@ void HeapProxy::PrintAddressInformation(const void* addr,
           header->size,
           block_alloc,
           block_alloc + header->size);
-  if (header->free_stack_trace != NULL) {
-    fprintf(stderr, "freed here:\n");
-    base::debug::StackTrace alloc_trace(
-        static_cast<const void* const*>(header->free_stack_trace),
-        header->free_stack_trace_size);
-    alloc_trace.PrintBacktrace();
-  }
-  if (header->alloc_stack_trace != NULL) {
-    fprintf(stderr, "previously allocated here:\n");
-    base::debug::StackTrace alloc_trace(
-        static_cast<const void* const*>(header->alloc_stack_trace),
-        header->alloc_stack_trace_size);
-    alloc_trace.PrintBacktrace();
-  }
+  PrintStackTrace("freed here:", header->free_stack_trace_id);
+  PrintStackTrace("previously allocated here:", header->alloc_stack_trace_id);
 
   Shadow::PrintShadowMemoryForAddress(addr);
 }
@@ -464,6 +521,24 @@ void HeapProxy::ReportAsanError(const char* bug_descr,
       header, bad_access_kind);
 }
 
+StackTraceCache* HeapProxy::GetStackTraceCache() {
+  return stack_trace_cache.Pointer();
+}
+
+void HeapProxy::PrintStackTrace(const char* title,
+                                StackTraceCache::TraceId id) {
+  DCHECK(title != NULL);
+
+  const void* frames[StackTraceCache::kMaxNumFrames];
+  size_t num_frames = 0;
+  if (!GetStackTraceCache()->GetStackTrace(id, frames, &num_frames))
+    return;
+
+  fprintf(stderr, "%s\n", title);
+  base::debug::StackTrace trace(frames, num_frames);
+  trace.PrintBacktrace();
+}
+
 void HeapProxy::ReportAsanErrorBase(const char* bug_descr,
                                     const void* addr,
                                     BadAccessKind bad_access_kind) {
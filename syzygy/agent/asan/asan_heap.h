@@ -20,8 +20,8 @@
 
 #include <windows.h>  // NOLINT
 
-#include "base/debug/stack_trace.h"
 #include "base/synchronization/lock.h"
+#include "syzygy/agent/asan/asan_stack_trace_cache.h"
 #include "syzygy/agent/common/dlist.h"
 
 namespace agent {
@@ -31,6 +31,9 @@ namespace asan {
 // each allocation and maintains a quarantine list of freed blocks.
 class HeapProxy {
  public:
+  // The default maximum size of the quarantine of a heap, in bytes.
+  static const size_t kDefaultQuarantineMaxSize = 10 * 1024 * 1024;
+
   HeapProxy();
   ~HeapProxy();
 
@@ -64,6 +67,15 @@ class HeapProxy {
                         unsigned long* return_length);
   // @}
 
+  // @name Accessors for the quarantine budget of this heap. Freed blocks are
+  //     held in quarantine until their cumulative size exceeds this budget.
+  //     Blocks that are bigger than the budget bypass the quarantine
+  //     altogether, and a budget of zero disables the quarantine.
+  // @{
+  size_t quarantine_max_size() const;
+  void set_quarantine_max_size(size_t quarantine_max_size);
+  // @}
+
   // Report a bad access to the heap.
   // @param addr The red-zoned address causing a bad access.
   // @returns true if the address belongs to a memory block, false otherwise.
@@ -72,6 +84,10 @@ class HeapProxy {
   // Report an unknown error while attempting the red-zoned heap address @addr.
   static void ReportUnknownError(const void* addr);
 
+  // Returns the cache holding the allocation and free stack traces of the
+  // blocks of all the heaps.
+  static StackTraceCache* GetStackTraceCache();
+
   // @name Cast to/from HANDLE.
   // @{
   static LIST_ENTRY* ToListEntry(HeapProxy* proxy);
@@ -101,10 +117,8 @@ class HeapProxy {
     size_t magic_number;
     size_t size;
     BlockState state;
-    void* alloc_stack_trace;
-    void* free_stack_trace;
-    uint8 alloc_stack_trace_size;
-    uint8 free_stack_trace_size;
+    StackTraceCache::TraceId alloc_stack_trace_id;
+    StackTraceCache::TraceId free_stack_trace_id;
   };
 
   // Returns the block header for an alloc.
@@ -122,6 +136,11 @@ class HeapProxy {
   // @param header The header of the block containing this address.
   BadAccessKind GetBadAccessKind(const void* addr, BlockHeader* header);
 
+  // Moves the pending freed blocks to the quarantine and trims it to its
+  // maximum size.
+  // @returns the total size of the quarantined blocks.
+  size_t FlushQuarantine();
+
  private:
   // Magic number to identify the beginning of a block header.
   static const size_t kBlockHeaderSignature = 0x03CA80E7;
@@ -134,9 +153,25 @@ class HeapProxy {
   // Returns a string describing a bad access kind.
   static char* AccessTypeToStr(BadAccessKind bad_access_kind);
 
-  // Quarantines @p block and flushes quarantine overage.
+  // Quarantines @p block. The block is trashed, poisoned and pushed to the
+  // pending stack without taking lock_. The pending blocks get moved to the
+  // quarantine queue in a batch once their cumulative size gets big enough.
+  // Blocks that are big enough to trigger this on their own take lock_ to be
+  // checked against the quarantine size first.
   void QuarantineBlock(BlockHeader* block);
 
+  // Moves the pending blocks to the tail of the quarantine queue, and frees
+  // the quarantine overage.
+  // @note lock_ must be held by the caller.
+  void FlushPendingBlocksLocked();
+
+  // Returns @p free_block to the underlying heap.
+  void ReleaseBlock(FreeBlockHeader* free_block);
+
+  // Returns the cumulative size of pending blocks past which they get moved
+  // to a quarantine of @p quarantine_max_size bytes.
+  static size_t GetPendingFlushThreshold(size_t quarantine_max_size);
+
   // Calculates the underlying allocation size for a requested
   // allocation of @p bytes.
   static size_t GetAllocSize(size_t bytes);
@@ -152,6 +187,12 @@ class HeapProxy {
                                BlockHeader* header,
                                BadAccessKind bad_access_kind);
 
+  // Prints the stack trace @p id of the stack trace cache, if it's valid and
+  // hasn't been evicted.
+  // @param title The title printed before the stack trace.
+  // @param id The ID of the stack trace to print.
+  static void PrintStackTrace(const char* title, StackTraceCache::TraceId id);
+
   // Report a basic Asan error to stderr. This function just dump the stack
   // without providing information relative to the shadow memory.
   // @param bug_descr The description of the error.
@@ -175,13 +216,26 @@ class HeapProxy {
   // Contains the underlying heap we delegate to.
   HANDLE heap_;
 
-  base::Lock lock_;
+  mutable base::Lock lock_;
   // Points to the head of the quarantine queue.
   FreeBlockHeader* head_;  // Under lock_.
   // Points to the tail of the quarantine queue.
   FreeBlockHeader* tail_;  // Under lock_.
   // Total size of blocks in quarantine.
   size_t quarantine_size_;  // Under lock_.
+  // The maximum size of the quarantine.
+  size_t quarantine_max_size_;  // Under lock_.
+  // The pending flush threshold for quarantine_max_size_. This is updated
+  // along with it under lock_, and read without lock_ when freeing a block.
+  volatile LONG pending_flush_threshold_;
+
+  // Points to the top of the stack of freed blocks waiting to be moved to the
+  // quarantine queue. This is pushed to with interlocked operations, and only
+  // drained under lock_.
+  FreeBlockHeader* volatile pending_head_;
+  // Total size of the blocks in the pending stack. This may transiently be
+  // negative while a flush races with a push.
+  volatile LONG pending_size_;
 
   // The entry linking to us.
   LIST_ENTRY list_entry_;
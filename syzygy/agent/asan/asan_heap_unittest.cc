@@ -14,11 +14,15 @@
 
 #include "syzygy/agent/asan/asan_heap.h"
 
+#include <vector>
+
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/rand_util.h"
 #include "base/sha1.h"
+#include "base/time.h"
 #include "base/debug/debugger.h"
+#include "base/threading/simple_thread.h"
 #include "gtest/gtest.h"
 #include "syzygy/agent/asan/asan_shadow.h"
 
@@ -32,6 +36,7 @@ class TestHeapProxy : public HeapProxy {
  public:
   using HeapProxy::BlockHeader;
   using HeapProxy::FindAddressBlock;
+  using HeapProxy::FlushQuarantine;
   using HeapProxy::GetBadAccessKind;
   using HeapProxy::ToBlock;
 
@@ -52,6 +57,42 @@ class TestHeapProxy : public HeapProxy {
   }
 };
 
+// Allocates and frees blocks of random sizes in a loop, keeping a few of them
+// alive at any given time.
+class AllocFreeStressRunner : public base::DelegateSimpleThread::Delegate {
+ public:
+  AllocFreeStressRunner(HeapProxy* proxy, size_t iterations)
+      : proxy_(proxy), iterations_(iterations), failures_(0) {
+    DCHECK(proxy != NULL);
+  }
+
+  virtual void Run() OVERRIDE {
+    const size_t kLiveBlocks = 16;
+    void* blocks[kLiveBlocks] = {};
+    for (size_t i = 0; i < iterations_; ++i) {
+      size_t slot = i % kLiveBlocks;
+      if (blocks[slot] != NULL && !proxy_->Free(0, blocks[slot]))
+        ++failures_;
+      blocks[slot] = proxy_->Alloc(0, base::RandInt(1, 1024));
+      if (blocks[slot] == NULL)
+        ++failures_;
+    }
+    for (size_t i = 0; i < kLiveBlocks; ++i) {
+      if (blocks[i] != NULL && !proxy_->Free(0, blocks[i]))
+        ++failures_;
+    }
+  }
+
+  size_t failures() const { return failures_; }
+
+ private:
+  HeapProxy* proxy_;
+  size_t iterations_;
+  size_t failures_;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocFreeStressRunner);
+};
+
 class HeapTest : public testing::Test {
  public:
   virtual void SetUp() OVERRIDE {
@@ -242,5 +283,68 @@ TEST_F(HeapTest, GetBadAccessKind) {
   ASSERT_TRUE(proxy_.IsUseAfterAccess(mem, header));
 }
 
+TEST_F(HeapTest, QuarantineMaxSize) {
+  ASSERT_EQ(HeapProxy::kDefaultQuarantineMaxSize,
+            proxy_.quarantine_max_size());
+
+  const size_t kAllocSize = 100;
+  const size_t kMaxQuarantineSize = 16 * kAllocSize;
+  proxy_.set_quarantine_max_size(kMaxQuarantineSize);
+  ASSERT_EQ(kMaxQuarantineSize, proxy_.quarantine_max_size());
+
+  // Free a lot more than fits in the quarantine, it should stay within budget.
+  for (size_t i = 0; i < 100; ++i) {
+    void* mem = proxy_.Alloc(0, kAllocSize);
+    ASSERT_TRUE(mem != NULL);
+    ASSERT_TRUE(proxy_.Free(0, mem));
+    ASSERT_NO_FATAL_FAILURE(VerifyFreedAccess(mem, kAllocSize));
+  }
+  size_t quarantine_size = proxy_.FlushQuarantine();
+  ASSERT_LT(0U, quarantine_size);
+  ASSERT_GE(kMaxQuarantineSize, quarantine_size);
+
+  // A block that is bigger than the quarantine shouldn't evict anything.
+  void* mem = proxy_.Alloc(0, kMaxQuarantineSize);
+  ASSERT_TRUE(mem != NULL);
+  ASSERT_TRUE(proxy_.Free(0, mem));
+  ASSERT_EQ(quarantine_size, proxy_.FlushQuarantine());
+
+  // Shrinking the budget flushes the overage right away.
+  proxy_.set_quarantine_max_size(0);
+  ASSERT_EQ(0U, proxy_.FlushQuarantine());
+}
+
+TEST_F(HeapTest, MultiThreadedAllocFreeStress) {
+  const size_t kThreadCount = 8;
+  const size_t kIterations = 10000;
+
+  std::vector<AllocFreeStressRunner*> runners;
+  std::vector<base::DelegateSimpleThread*> threads;
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    runners.push_back(new AllocFreeStressRunner(&proxy_, kIterations));
+    threads.push_back(
+        new base::DelegateSimpleThread(runners.back(), "asan heap stress"));
+  }
+
+  base::Time start_time = base::Time::Now();
+  for (size_t i = 0; i < kThreadCount; ++i)
+    threads[i]->Start();
+  for (size_t i = 0; i < kThreadCount; ++i)
+    threads[i]->Join();
+  base::TimeDelta elapsed = base::Time::Now() - start_time;
+
+  LOG(INFO) << kThreadCount << " threads did " << kIterations
+            << " alloc/free pairs each in " << elapsed.InMilliseconds()
+            << " ms.";
+
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(0U, runners[i]->failures());
+    delete threads[i];
+    delete runners[i];
+  }
+
+  ASSERT_GE(proxy_.quarantine_max_size(), proxy_.FlushQuarantine());
+}
+
 }  // namespace asan
 }  // namespace agent
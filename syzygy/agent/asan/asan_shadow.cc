@@ -13,6 +13,8 @@
 // limitations under the License.
 #include "syzygy/agent/asan/asan_shadow.h"
 
+#include <emmintrin.h>
+
 #include "base/logging.h"
 
 namespace agent {
@@ -65,6 +67,86 @@ bool Shadow::IsAccessible(const void* addr) {
   return start < shadow;
 }
 
+bool Shadow::IsRangeAccessible(const void* addr, size_t size) {
+  return FindFirstPoisonedByte(addr, size) == NULL;
+}
+
+const void* Shadow::FindFirstPoisonedByte(const void* addr, size_t size) {
+  const uint8* mem = static_cast<const uint8*>(addr);
+  const uint8* mem_end = mem + size;
+  DCHECK_LE(mem, mem_end);
+
+  // Check the bytes up to the first granule boundary one at a time.
+  while (mem < mem_end && (reinterpret_cast<uintptr_t>(mem) & 0x7) != 0) {
+    if (!IsAccessible(mem))
+      return mem;
+    ++mem;
+  }
+
+  // Scan the shadow of the whole granules.
+  uintptr_t begin = reinterpret_cast<uintptr_t>(mem) >> 3;
+  uintptr_t end = reinterpret_cast<uintptr_t>(mem_end) >> 3;
+  if (begin < end) {
+    DCHECK_GE(arraysize(shadow_), end);
+    uintptr_t index = FindFirstNonZeroShadowByte(begin, end);
+    if (index != end) {
+      // A partially accessible granule has its first inaccessible byte at
+      // the offset given by its shadow value.
+      uint8 shadow = shadow_[index];
+      uintptr_t offset = shadow < 8 ? shadow : 0;
+      return reinterpret_cast<const uint8*>((index << 3) + offset);
+    }
+    mem = reinterpret_cast<const uint8*>(end << 3);
+  }
+
+  // Check the trailing bytes one at a time.
+  for (; mem < mem_end; ++mem) {
+    if (!IsAccessible(mem))
+      return mem;
+  }
+
+  return NULL;
+}
+
+uintptr_t Shadow::FindFirstNonZeroShadowByte(uintptr_t begin, uintptr_t end) {
+  DCHECK_LE(begin, end);
+
+  // Get to a 16-byte aligned shadow address.
+  uintptr_t index = begin;
+  while (index < end &&
+         (reinterpret_cast<uintptr_t>(shadow_ + index) & 0xF) != 0) {
+    if (shadow_[index] != 0)
+      return index;
+    ++index;
+  }
+
+  // Check 16 shadow bytes at a time, e.g. 128 bytes of memory.
+  const __m128i zero = _mm_setzero_si128();
+  for (; index + 16 <= end; index += 16) {
+    __m128i chunk =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(shadow_ + index));
+    int zero_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+    if (zero_mask != 0xFFFF) {
+      // Find the first byte that didn't compare equal to zero.
+      uintptr_t non_zero_mask = ~zero_mask & 0xFFFF;
+      uintptr_t offset = 0;
+      while ((non_zero_mask & 1) == 0) {
+        non_zero_mask >>= 1;
+        ++offset;
+      }
+      return index + offset;
+    }
+  }
+
+  // Check the remaining shadow bytes one at a time.
+  for (; index < end; ++index) {
+    if (shadow_[index] != 0)
+      return index;
+  }
+
+  return end;
+}
+
 void Shadow::PrintShadowBytes(const char *prefix, uintptr_t index) {
   fprintf(stderr, "%s0x%08x:", prefix, reinterpret_cast<void*>(index << 3));
   for (uint32 i = 0; i < 8; i++) {
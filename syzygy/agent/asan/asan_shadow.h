@@ -22,6 +22,11 @@ namespace agent {
 namespace asan {
 
 // An all-static class that manages the ASAN shadow memory.
+//
+// Every 8-byte aligned granule of memory has one shadow byte. A shadow value
+// of 0 means the whole granule is accessible, a value k in [1, 7] means that
+// only the first k bytes of the granule are accessible, and 0xFF means that
+// none of it is.
 class Shadow {
  public:
   // Poisons @p size bytes starting at @p addr.
@@ -35,6 +40,17 @@ class Shadow {
   // Returns true iff the byte at @p addr is not poisoned.
   static bool IsAccessible(const void* addr);
 
+  // Returns true iff none of the @p size bytes starting at @p addr is
+  // poisoned.
+  static bool IsRangeAccessible(const void* addr, size_t size);
+
+  // Finds the first poisoned byte in the range [@p addr, @p addr + @p size).
+  // The shadow of the range is scanned 16 bytes at a time, so this is much
+  // cheaper than calling IsAccessible for every byte of a large range.
+  // @returns the address of the first poisoned byte, or NULL if the whole
+  //     range is accessible.
+  static const void* FindFirstPoisonedByte(const void* addr, size_t size);
+
   // Print the content of the shadow memory for @p addr.
   static void PrintShadowMemoryForAddress(const void* addr);
 
@@ -43,6 +59,10 @@ class Shadow {
   // prefixed by @p prefix.
   static void PrintShadowBytes(const char *prefix, uintptr_t index);
 
+  // Returns the index of the first non-zero shadow byte in
+  // shadow_[@p begin, @p end), or @p end if they're all zero.
+  static uintptr_t FindFirstNonZeroShadowByte(uintptr_t begin, uintptr_t end);
+
   // One shadow byte for every 8 bytes in a 4G address space.
   static const size_t kShadowSize = 1 << (32 - 3);
   static uint8 shadow_[kShadowSize];
@@ -13,7 +13,9 @@
 // limitations under the License.
 #include "syzygy/agent/asan/asan_shadow.h"
 
+#include "base/logging.h"
 #include "base/rand_util.h"
+#include "base/time.h"
 #include "gtest/gtest.h"
 #include "syzygy/common/align.h"
 
@@ -48,5 +50,85 @@ TEST(ShadowTest, PoisonUnpoisonAccess) {
   }
 }
 
+TEST(ShadowTest, FindFirstPoisonedByte) {
+  for (size_t i = 0; i < 100; ++i) {
+    // Poison the tail of a random range, ending on an 8-byte boundary.
+    const size_t size = base::RandInt(1, 16384);
+    const uint8* start_addr =
+        reinterpret_cast<const uint8*>(base::RandInt(65536, 10*1024*1024) * 8);
+    const uint8* end_addr = start_addr + common::AlignUp(size, 8);
+    const uint8* poison_addr = start_addr + base::RandInt(0, size - 1);
+
+    EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, size));
+    EXPECT_TRUE(Shadow::FindFirstPoisonedByte(start_addr, size) == NULL);
+
+    Shadow::Poison(poison_addr, end_addr - poison_addr);
+    EXPECT_FALSE(Shadow::IsRangeAccessible(start_addr, size));
+    EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr,
+                                          poison_addr - start_addr));
+    EXPECT_EQ(poison_addr, Shadow::FindFirstPoisonedByte(start_addr, size));
+
+    // Also scan from an unaligned address.
+    if (poison_addr > start_addr + 1) {
+      EXPECT_EQ(poison_addr,
+                Shadow::FindFirstPoisonedByte(start_addr + 1, size - 1));
+    }
+
+    Shadow::Unpoison(start_addr, end_addr - start_addr);
+    EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, size));
+  }
+}
+
+TEST(ShadowTest, FindFirstPoisonedByteInPartialGranule) {
+  const uint8* start_addr = reinterpret_cast<const uint8*>(0x01000000);
+  const size_t kAccessibleSize = 1021;
+
+  // Only the first 5 bytes of the last granule are accessible.
+  Shadow::Poison(start_addr, 1024);
+  Shadow::Unpoison(start_addr, kAccessibleSize);
+  EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, kAccessibleSize));
+  EXPECT_FALSE(Shadow::IsRangeAccessible(start_addr, kAccessibleSize + 1));
+  EXPECT_EQ(start_addr + kAccessibleSize,
+            Shadow::FindFirstPoisonedByte(start_addr, 4096));
+
+  Shadow::Unpoison(start_addr, 1024);
+}
+
+TEST(ShadowTest, FindFirstPoisonedByteLargeRange) {
+  const uint8* start_addr = reinterpret_cast<const uint8*>(0x02000000);
+  const size_t kSize = 16 * 1024 * 1024;
+
+  EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, kSize));
+
+  // Poison a single granule near the end of the range.
+  const uint8* poison_addr = start_addr + kSize - 64;
+  Shadow::Poison(poison_addr, 8);
+  EXPECT_EQ(poison_addr, Shadow::FindFirstPoisonedByte(start_addr, kSize));
+  EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, kSize - 64));
+
+  Shadow::Unpoison(poison_addr, 8);
+  EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, kSize));
+
+  // Time the scan against checking the range byte by byte.
+  const size_t kIterations = 100;
+  base::Time start_time = base::Time::Now();
+  for (size_t i = 0; i < kIterations; ++i)
+    EXPECT_TRUE(Shadow::IsRangeAccessible(start_addr, kSize));
+  base::TimeDelta scan_time = base::Time::Now() - start_time;
+
+  start_time = base::Time::Now();
+  size_t accessible = 0;
+  for (size_t i = 0; i < kSize; ++i) {
+    if (Shadow::IsAccessible(start_addr + i))
+      ++accessible;
+  }
+  base::TimeDelta byte_time = base::Time::Now() - start_time;
+  EXPECT_EQ(kSize, accessible);
+
+  LOG(INFO) << kIterations << " scans of " << kSize << " bytes took "
+            << scan_time.InMilliseconds() << " ms, and one byte by byte "
+            << "check took " << byte_time.InMilliseconds() << " ms.";
+}
+
 }  // namespace asan
 }  // namespace agent
@@ -0,0 +1,330 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/agent/asan/asan_stack_trace_cache.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/debug/stack_trace.h"
+
+namespace agent {
+namespace asan {
+
+struct StackTraceCache::Slot {
+  // Zero while the slot is empty, odd while a trace is written to it, and
+  // bumped by two each time a trace is published to it.
+  volatile LONG version;
+  uint32 hash;
+  uint32 num_frames;
+  const void* frames[kMaxNumFrames];
+};
+
+namespace {
+
+// The mask of the slot index in a trace ID.
+const uint32 kTraceIndexMask = (1U << StackTraceCache::kTraceIndexBits) - 1;
+
+// Computes the FNV-1a hash of a stack trace.
+uint32 HashStackTrace(const void* const* frames, size_t num_frames) {
+  uint32 hash = 2166136261U;
+  for (size_t i = 0; i < num_frames; ++i) {
+    uintptr_t frame = reinterpret_cast<uintptr_t>(frames[i]);
+    for (size_t j = 0; j < sizeof(frame); ++j) {
+      hash ^= (frame >> (j * 8)) & 0xFF;
+      hash *= 16777619U;
+    }
+  }
+  return hash;
+}
+
+// @returns the generation of the traces published at @p version of a slot,
+//     as kept in the high bits of their IDs.
+uint32 VersionToGeneration(LONG version) {
+  return (static_cast<uint32>(version) >> 1) &
+      (0xFFFFFFFFU >> StackTraceCache::kTraceIndexBits);
+}
+
+}  // namespace
+
+StackTraceCache::StackTraceCache() {
+  Init(kDefaultCapacity, kDefaultMaxCapacity);
+}
+
+StackTraceCache::StackTraceCache(size_t capacity) {
+  Init(capacity, std::max(capacity, kDefaultMaxCapacity));
+}
+
+StackTraceCache::StackTraceCache(size_t capacity, size_t max_capacity) {
+  Init(capacity, max_capacity);
+}
+
+StackTraceCache::~StackTraceCache() {
+  Table* table = table_;
+  while (table != NULL) {
+    delete [] table->slots;
+
+    Table* next = table->next;
+    delete table;
+    table = next;
+  }
+}
+
+void StackTraceCache::Init(size_t capacity, size_t max_capacity) {
+  DCHECK_LT(0U, capacity);
+  DCHECK_EQ(0U, capacity & (capacity - 1));
+  DCHECK_LE(capacity, max_capacity);
+  DCHECK_GE(kTraceIndexMask, max_capacity);
+
+  table_ = CreateTable(capacity, 1);
+  max_capacity_ = max_capacity;
+  num_traces_ = 0;
+  num_frames_ = 0;
+  num_evicted_traces_ = 0;
+  num_dropped_traces_ = 0;
+  num_tables_ = 1;
+  total_capacity_ = static_cast<LONG>(capacity);
+}
+
+StackTraceCache::TraceId StackTraceCache::CaptureStackTrace() {
+  size_t num_frames = 0;
+  base::debug::StackTrace trace;
+  const void* const* frames = trace.Addresses(&num_frames);
+  return SaveStackTrace(frames, num_frames);
+}
+
+StackTraceCache::TraceId StackTraceCache::SaveStackTrace(
+    const void* const* frames, size_t num_frames) {
+  DCHECK(frames != NULL || num_frames == 0);
+
+  num_frames = std::min(num_frames, kMaxNumFrames);
+  uint32 hash = HashStackTrace(frames, num_frames);
+
+  // Linear probing from the home slot of the trace in each table, for a
+  // bounded number of slots.
+  Table* last_table = NULL;
+  for (Table* table = table_; table != NULL; table = GetNextTable(table)) {
+    last_table = table;
+    size_t mask = table->capacity - 1;
+    size_t num_probes = std::min(table->capacity, kMaxProbes);
+    for (size_t probe = 0; probe < num_probes; ++probe) {
+      size_t index = (hash + probe) & mask;
+      Slot* slot = &table->slots[index];
+      LONG version = slot->version;
+
+      if (version == 0) {
+        if (::InterlockedCompareExchange(&slot->version, 1, 0) == 0) {
+          // We claimed the empty slot.
+          WriteSlot(slot, 1, hash, frames, num_frames);
+          ::InterlockedIncrement(&num_traces_);
+          ::InterlockedExchangeAdd(&num_frames_,
+                                   static_cast<LONG>(num_frames));
+          return MakeTraceId(table, index, 2);
+        }
+        // Another thread claimed the slot first, it may be saving this very
+        // trace. If it's still writing it, we move on and may end up with a
+        // duplicate, which is harmless.
+        version = slot->version;
+      }
+
+      if (SlotEquals(slot, version, hash, frames, num_frames))
+        return MakeTraceId(table, index, version);
+    }
+  }
+
+  // The cache is at its maximum capacity.
+  DCHECK(last_table != NULL);
+  return EvictAndSave(last_table, hash, frames, num_frames);
+}
+
+bool StackTraceCache::GetStackTrace(TraceId id,
+                                    const void** frames,
+                                    size_t* num_frames) const {
+  DCHECK(frames != NULL);
+  DCHECK(num_frames != NULL);
+
+  if (id == kInvalidTraceId)
+    return false;
+
+  // Find the table the ID belongs to.
+  size_t trace_index = id & kTraceIndexMask;
+  const Table* table = table_;
+  while (table != NULL &&
+         trace_index - table->first_index >= table->capacity) {
+    table = table->next;
+  }
+  if (table == NULL)
+    return false;
+
+  // Copy the trace, and check that it wasn't replaced meanwhile.
+  const Slot* slot = &table->slots[trace_index - table->first_index];
+  LONG version = slot->version;
+  if (version == 0 || (version & 1) != 0 ||
+      VersionToGeneration(version) != id >> kTraceIndexBits) {
+    return false;
+  }
+  size_t count = std::min(static_cast<size_t>(slot->num_frames),
+                          kMaxNumFrames);
+  std::copy(slot->frames, slot->frames + count, frames);
+  ::MemoryBarrier();
+  if (slot->version != version)
+    return false;
+
+  *num_frames = count;
+  return true;
+}
+
+void StackTraceCache::GetStatistics(Statistics* stats) const {
+  DCHECK(stats != NULL);
+
+  stats->num_traces = num_traces_;
+  stats->num_frames = num_frames_;
+  stats->num_evicted_traces = num_evicted_traces_;
+  stats->num_dropped_traces = num_dropped_traces_;
+  stats->num_tables = num_tables_;
+  stats->memory_usage = sizeof(*this) +
+      stats->num_tables * sizeof(Table) +
+      total_capacity_ * sizeof(Slot);
+}
+
+// static
+StackTraceCache::Table* StackTraceCache::CreateTable(size_t capacity,
+                                                     size_t first_index) {
+  Table* table = new Table;
+  table->slots = new Slot[capacity];
+  ::memset(table->slots, 0, capacity * sizeof(Slot));
+  table->capacity = capacity;
+  table->first_index = first_index;
+  table->next = NULL;
+  return table;
+}
+
+StackTraceCache::Table* StackTraceCache::GetNextTable(Table* table) {
+  DCHECK(table != NULL);
+
+  Table* next = table->next;
+  if (next != NULL)
+    return next;
+
+  // Each table is twice the size of the previous one, so there are few of
+  // them.
+  size_t capacity = table->capacity * 2;
+  size_t first_index = table->first_index + table->capacity;
+  if (first_index - 1 + capacity > max_capacity_)
+    return NULL;
+
+  next = CreateTable(capacity, first_index);
+  Table* current = reinterpret_cast<Table*>(
+      ::InterlockedCompareExchangePointer(
+          reinterpret_cast<void* volatile*>(&table->next), next, NULL));
+  if (current != NULL) {
+    // Another thread added the table first.
+    delete [] next->slots;
+    delete next;
+    return current;
+  }
+
+  ::InterlockedIncrement(&num_tables_);
+  ::InterlockedExchangeAdd(&total_capacity_, static_cast<LONG>(capacity));
+  return next;
+}
+
+// static
+void StackTraceCache::WriteSlot(Slot* slot,
+                                LONG version,
+                                uint32 hash,
+                                const void* const* frames,
+                                size_t num_frames) {
+  DCHECK(slot != NULL);
+  DCHECK_EQ(1, version & 1);
+  DCHECK_GE(kMaxNumFrames, num_frames);
+
+  slot->hash = hash;
+  slot->num_frames = static_cast<uint32>(num_frames);
+  std::copy(frames, frames + num_frames, slot->frames);
+
+  // Publish the trace.
+  ::InterlockedExchange(&slot->version, version + 1);
+}
+
+// static
+bool StackTraceCache::SlotEquals(const Slot* slot,
+                                 LONG version,
+                                 uint32 hash,
+                                 const void* const* frames,
+                                 size_t num_frames) {
+  DCHECK(slot != NULL);
+
+  // The slot may be rewritten while we compare it, in which case the
+  // comparison is meaningless and the version tells us so.
+  if (version == 0 || (version & 1) != 0)
+    return false;
+  bool equals = slot->hash == hash && slot->num_frames == num_frames &&
+      std::equal(frames, frames + num_frames, slot->frames);
+  ::MemoryBarrier();
+  return equals && slot->version == version;
+}
+
+// static
+StackTraceCache::TraceId StackTraceCache::MakeTraceId(const Table* table,
+                                                      size_t index,
+                                                      LONG version) {
+  DCHECK(table != NULL);
+  DCHECK_GT(table->capacity, index);
+
+  return static_cast<TraceId>(
+      (VersionToGeneration(version) << kTraceIndexBits) |
+      (table->first_index + index));
+}
+
+StackTraceCache::TraceId StackTraceCache::EvictAndSave(
+    Table* table,
+    uint32 hash,
+    const void* const* frames,
+    size_t num_frames) {
+  DCHECK(table != NULL);
+
+  // Rotate through the probe range of the trace, so that the traces sharing
+  // it take turns being evicted.
+  size_t num_probes = std::min(table->capacity, kMaxProbes);
+  size_t probe = static_cast<size_t>(num_evicted_traces_) % num_probes;
+  size_t index = (hash + probe) & (table->capacity - 1);
+  Slot* slot = &table->slots[index];
+
+  LONG version = slot->version;
+  if ((version & 1) != 0 ||
+      ::InterlockedCompareExchange(&slot->version, version + 1, version) !=
+          version) {
+    // Another thread is writing to the slot.
+    ::InterlockedIncrement(&num_dropped_traces_);
+    return kInvalidTraceId;
+  }
+
+  // The slot may have been left empty by a thread that spilled over to a
+  // larger table, in which case there's nothing to evict.
+  LONG evicted_num_frames = 0;
+  if (version != 0) {
+    evicted_num_frames = static_cast<LONG>(slot->num_frames);
+    ::InterlockedIncrement(&num_evicted_traces_);
+  } else {
+    ::InterlockedIncrement(&num_traces_);
+  }
+  WriteSlot(slot, version + 1, hash, frames, num_frames);
+  ::InterlockedExchangeAdd(
+      &num_frames_, static_cast<LONG>(num_frames) - evicted_num_frames);
+  return MakeTraceId(table, index, version + 2);
+}
+
+}  // namespace asan
+}  // namespace agent
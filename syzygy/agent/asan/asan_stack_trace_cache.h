@@ -0,0 +1,205 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Implements StackTraceCache, a lock-free cache of deduplicated stack traces.
+
+#ifndef SYZYGY_AGENT_ASAN_ASAN_STACK_TRACE_CACHE_H_
+#define SYZYGY_AGENT_ASAN_ASAN_STACK_TRACE_CACHE_H_
+
+#include <windows.h>  // NOLINT
+
+#include "base/basictypes.h"
+
+namespace agent {
+namespace asan {
+
+// A hash-consed store of stack traces. Every distinct stack trace is stored
+// once and is identified by a 32-bit ID, which is all that the heap blocks
+// need to keep around. Saving and retrieving traces is lock-free.
+// Traces are stored in a chain of open-addressed tables, each twice the size
+// of the previous one. Probing a table is bounded, and a trace that finds no
+// room in a table moves on to the next one, which is created as needed up to
+// a maximum capacity. Once the cache is at its maximum capacity, a new trace
+// evicts one of the traces in its probe range of the last table, and the ID
+// of the evicted trace becomes invalid.
+// Each slot holds its trace in place and is reused on eviction, so the memory
+// of the cache is bounded by its maximum capacity. A slot carries a version,
+// which is odd while a trace is written to it; readers check that it didn't
+// change while they read the trace.
+class StackTraceCache {
+ public:
+  // The type of the IDs identifying the stack traces in the cache.
+  typedef uint32 TraceId;
+
+  // The ID of no stack trace.
+  static const TraceId kInvalidTraceId = 0;
+
+  // The maximum number of frames of a stack trace. From
+  // http://msdn.microsoft.com/en-us/library/bb204633.aspx, the sum of
+  // FramesToSkip and FramesToCapture must be less than 63.
+  static const size_t kMaxNumFrames = 62;
+
+  // The default capacity of the first table of the cache.
+  static const size_t kDefaultCapacity = 1 << 12;
+
+  // The default number of distinct stack traces the cache can hold, which
+  // fills four tables. A trace takes 260 bytes in a 32-bit process, so the
+  // cache takes up to 16MB.
+  static const size_t kDefaultMaxCapacity = 15 * kDefaultCapacity;
+
+  // The maximum number of slots probed in each table.
+  static const size_t kMaxProbes = 32;
+
+  // The low bits of a trace ID are its slot index, the high bits the version
+  // of its slot, which tells an evicted trace from the one that replaced it.
+  // The version bits wrap, so a stale ID may alias a trace once its slot has
+  // been rewritten 4096 times. The maximum capacity of a cache must be less
+  // than 1 << kTraceIndexBits.
+  static const size_t kTraceIndexBits = 20;
+
+  // Memory usage statistics of the cache.
+  struct Statistics {
+    // The number of distinct stack traces in the cache.
+    size_t num_traces;
+    // The total number of frames in these stack traces.
+    size_t num_frames;
+    // The number of stack traces that were evicted to make room for others.
+    size_t num_evicted_traces;
+    // The number of stack traces that were dropped as the slot they were to
+    // evict was being written by another thread.
+    size_t num_dropped_traces;
+    // The number of tables the cache has grown to.
+    size_t num_tables;
+    // The memory used by the cache, in bytes.
+    size_t memory_usage;
+  };
+
+  // Creates a cache of kDefaultCapacity traces, which grows up to
+  // kDefaultMaxCapacity traces.
+  StackTraceCache();
+
+  // Creates a cache which grows up to kDefaultMaxCapacity traces.
+  // @param capacity The capacity of the first table of the cache, must be a
+  //     power of two.
+  explicit StackTraceCache(size_t capacity);
+
+  // Creates a cache able to hold up to @p max_capacity distinct traces.
+  // @param capacity The capacity of the first table of the cache, must be a
+  //     power of two.
+  // @param max_capacity The total capacity the tables may grow to.
+  StackTraceCache(size_t capacity, size_t max_capacity);
+
+  ~StackTraceCache();
+
+  // Captures the current stack trace and saves it to the cache.
+  // @returns the ID of the stack trace, or kInvalidTraceId if it couldn't be
+  //     saved.
+  TraceId CaptureStackTrace();
+
+  // Saves a stack trace to the cache.
+  // @param frames The frames of the stack trace.
+  // @param num_frames The number of frames in @p frames. Only the first
+  //     kMaxNumFrames are kept.
+  // @returns the ID of the stack trace, or kInvalidTraceId if it couldn't be
+  //     saved.
+  TraceId SaveStackTrace(const void* const* frames, size_t num_frames);
+
+  // Retrieves a stack trace from the cache.
+  // @param id The ID of the stack trace to retrieve.
+  // @param frames On success, receives the frames of the trace. Must have
+  //     room for kMaxNumFrames frames.
+  // @param num_frames On success, receives the number of frames of the trace.
+  // @returns true on success, false if @p id isn't a valid ID or its trace
+  //     has been evicted.
+  bool GetStackTrace(TraceId id,
+                     const void** frames,
+                     size_t* num_frames) const;
+
+  // Retrieves the memory usage statistics of the cache.
+  // @param stats Receives the statistics.
+  void GetStatistics(Statistics* stats) const;
+
+ private:
+  // A slot holding a stack trace.
+  struct Slot;
+
+  // A table of slots. The index of a trace is the first index of the table
+  // plus its slot.
+  struct Table {
+    Slot* slots;
+    size_t capacity;
+    size_t first_index;
+    // The next, larger table, or NULL. Set once with a compare-and-swap.
+    Table* volatile next;
+  };
+
+  // Initializes the cache with a first table of @p capacity.
+  void Init(size_t capacity, size_t max_capacity);
+
+  // Creates a table of @p capacity whose indices start at @p first_index.
+  static Table* CreateTable(size_t capacity, size_t first_index);
+
+  // @returns the table after @p table, creating it if there is room for it,
+  //     or NULL if the cache is at its maximum capacity.
+  Table* GetNextTable(Table* table);
+
+  // Writes a trace to @p slot, which the caller claimed by making its
+  // @p version odd, and publishes it.
+  static void WriteSlot(Slot* slot,
+                        LONG version,
+                        uint32 hash,
+                        const void* const* frames,
+                        size_t num_frames);
+
+  // Returns true iff @p slot holds the stack trace @p frames, and it was
+  // still at @p version once compared.
+  static bool SlotEquals(const Slot* slot,
+                         LONG version,
+                         uint32 hash,
+                         const void* const* frames,
+                         size_t num_frames);
+
+  // @returns the ID of the trace in slot @p index of @p table, at @p version.
+  static TraceId MakeTraceId(const Table* table, size_t index, LONG version);
+
+  // Evicts a trace from the probe range of @p hash in @p table to make room
+  // for @p frames.
+  // @returns the ID of the saved trace, or kInvalidTraceId if the slot to
+  //     evict was being written by another thread.
+  TraceId EvictAndSave(Table* table,
+                       uint32 hash,
+                       const void* const* frames,
+                       size_t num_frames);
+
+  // The first table of the chain.
+  Table* table_;
+  size_t max_capacity_;
+
+  // @name Statistics, updated with interlocked operations.
+  // @{
+  volatile LONG num_traces_;
+  volatile LONG num_frames_;
+  volatile LONG num_evicted_traces_;
+  volatile LONG num_dropped_traces_;
+  volatile LONG num_tables_;
+  volatile LONG total_capacity_;
+  // @}
+
+  DISALLOW_COPY_AND_ASSIGN(StackTraceCache);
+};
+
+}  // namespace asan
+}  // namespace agent
+
+#endif  // SYZYGY_AGENT_ASAN_ASAN_STACK_TRACE_CACHE_H_
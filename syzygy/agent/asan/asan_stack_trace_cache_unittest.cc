@@ -0,0 +1,212 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/agent/asan/asan_stack_trace_cache.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace agent {
+namespace asan {
+
+namespace {
+
+// Fills @p frames with a fake stack trace derived from @p seed.
+void MakeStackTrace(size_t seed, size_t num_frames, const void** frames) {
+  for (size_t i = 0; i < num_frames; ++i)
+    frames[i] = reinterpret_cast<const void*>(0x10000000 + seed * 0x100 + i);
+}
+
+}  // namespace
+
+TEST(StackTraceCacheTest, SaveAndGetStackTrace) {
+  StackTraceCache cache(16);
+
+  const void* frames[10] = {};
+  MakeStackTrace(1, arraysize(frames), frames);
+  StackTraceCache::TraceId id =
+      cache.SaveStackTrace(frames, arraysize(frames));
+  ASSERT_NE(StackTraceCache::kInvalidTraceId, id);
+
+  const void* saved_frames[StackTraceCache::kMaxNumFrames] = {};
+  size_t num_saved_frames = 0;
+  ASSERT_TRUE(cache.GetStackTrace(id, saved_frames, &num_saved_frames));
+  ASSERT_EQ(arraysize(frames), num_saved_frames);
+  for (size_t i = 0; i < num_saved_frames; ++i)
+    EXPECT_EQ(frames[i], saved_frames[i]);
+
+  EXPECT_FALSE(cache.GetStackTrace(StackTraceCache::kInvalidTraceId,
+                                   saved_frames, &num_saved_frames));
+  EXPECT_FALSE(cache.GetStackTrace(17, saved_frames, &num_saved_frames));
+}
+
+TEST(StackTraceCacheTest, DeduplicatesStackTraces) {
+  StackTraceCache cache(16);
+
+  const void* frames[10] = {};
+  MakeStackTrace(1, arraysize(frames), frames);
+  StackTraceCache::TraceId id1 =
+      cache.SaveStackTrace(frames, arraysize(frames));
+  StackTraceCache::TraceId id2 =
+      cache.SaveStackTrace(frames, arraysize(frames));
+  EXPECT_EQ(id1, id2);
+
+  // A prefix of the trace is a different trace.
+  StackTraceCache::TraceId id3 =
+      cache.SaveStackTrace(frames, arraysize(frames) - 1);
+  EXPECT_NE(id1, id3);
+
+  StackTraceCache::Statistics stats = {};
+  cache.GetStatistics(&stats);
+  EXPECT_EQ(2U, stats.num_traces);
+  EXPECT_EQ(2 * arraysize(frames) - 1, stats.num_frames);
+  EXPECT_EQ(0U, stats.num_evicted_traces);
+  EXPECT_EQ(0U, stats.num_dropped_traces);
+  EXPECT_LT(stats.num_frames * sizeof(void*), stats.memory_usage);
+}
+
+TEST(StackTraceCacheTest, TruncatesLongStackTraces) {
+  StackTraceCache cache(16);
+
+  const void* frames[StackTraceCache::kMaxNumFrames + 10] = {};
+  MakeStackTrace(1, arraysize(frames), frames);
+  StackTraceCache::TraceId id =
+      cache.SaveStackTrace(frames, arraysize(frames));
+
+  const void* saved_frames[StackTraceCache::kMaxNumFrames] = {};
+  size_t num_saved_frames = 0;
+  ASSERT_TRUE(cache.GetStackTrace(id, saved_frames, &num_saved_frames));
+  EXPECT_EQ(StackTraceCache::kMaxNumFrames, num_saved_frames);
+}
+
+TEST(StackTraceCacheTest, EvictsStackTracesWhenFull) {
+  const size_t kCapacity = 16;
+  StackTraceCache cache(kCapacity, kCapacity);
+
+  const void* frames[4] = {};
+  std::vector<StackTraceCache::TraceId> ids;
+  for (size_t i = 0; i < kCapacity; ++i) {
+    MakeStackTrace(i, arraysize(frames), frames);
+    ids.push_back(cache.SaveStackTrace(frames, arraysize(frames)));
+    EXPECT_NE(StackTraceCache::kInvalidTraceId, ids.back());
+  }
+
+  // The cache is full, so a new trace evicts one of the others.
+  MakeStackTrace(kCapacity, arraysize(frames), frames);
+  StackTraceCache::TraceId new_id =
+      cache.SaveStackTrace(frames, arraysize(frames));
+  ASSERT_NE(StackTraceCache::kInvalidTraceId, new_id);
+
+  const void* saved_frames[StackTraceCache::kMaxNumFrames] = {};
+  size_t num_saved_frames = 0;
+  ASSERT_TRUE(cache.GetStackTrace(new_id, saved_frames, &num_saved_frames));
+  ASSERT_EQ(arraysize(frames), num_saved_frames);
+  EXPECT_EQ(frames[0], saved_frames[0]);
+
+  // The ID of the evicted trace is no longer valid, even though its slot was
+  // reused. The other traces are still there.
+  size_t evicted = kCapacity;
+  for (size_t i = 0; i < kCapacity; ++i) {
+    EXPECT_NE(new_id, ids[i]);
+    if (!cache.GetStackTrace(ids[i], saved_frames, &num_saved_frames)) {
+      EXPECT_EQ(kCapacity, evicted);
+      evicted = i;
+      continue;
+    }
+    MakeStackTrace(i, arraysize(frames), frames);
+    EXPECT_EQ(frames[0], saved_frames[0]);
+  }
+  ASSERT_GT(kCapacity, evicted);
+  EXPECT_EQ(ids[evicted] & ((1U << StackTraceCache::kTraceIndexBits) - 1),
+            new_id & ((1U << StackTraceCache::kTraceIndexBits) - 1));
+
+  // Saving the evicted trace again gives it a new ID.
+  MakeStackTrace(evicted, arraysize(frames), frames);
+  StackTraceCache::TraceId id = cache.SaveStackTrace(frames,
+                                                     arraysize(frames));
+  EXPECT_NE(StackTraceCache::kInvalidTraceId, id);
+  EXPECT_NE(ids[evicted], id);
+
+  StackTraceCache::Statistics stats = {};
+  cache.GetStatistics(&stats);
+  EXPECT_EQ(kCapacity, stats.num_traces);
+  EXPECT_EQ(kCapacity * arraysize(frames), stats.num_frames);
+  EXPECT_EQ(2U, stats.num_evicted_traces);
+  EXPECT_EQ(0U, stats.num_dropped_traces);
+}
+
+TEST(StackTraceCacheTest, GrowsWhenTablesAreFull) {
+  const size_t kCapacity = 16;
+  const size_t kMaxCapacity = 16 + 32 + 64;
+  StackTraceCache cache(kCapacity, kMaxCapacity);
+
+  // Fill all the tables the cache may grow to, until a trace finds no room
+  // and evicts another. Probing is bounded, so some traces may spill to a
+  // larger table before the smaller one is full.
+  const void* frames[4] = {};
+  std::vector<StackTraceCache::TraceId> ids;
+  StackTraceCache::Statistics stats = {};
+  for (size_t i = 0; stats.num_evicted_traces == 0; ++i) {
+    ASSERT_GT(kMaxCapacity, ids.size());
+    MakeStackTrace(i, arraysize(frames), frames);
+    StackTraceCache::TraceId id =
+        cache.SaveStackTrace(frames, arraysize(frames));
+    ASSERT_NE(StackTraceCache::kInvalidTraceId, id);
+    ids.push_back(id);
+    cache.GetStatistics(&stats);
+  }
+  EXPECT_LT(kCapacity, ids.size());
+  EXPECT_EQ(3U, stats.num_tables);
+  EXPECT_EQ(ids.size() - 1, stats.num_traces);
+
+  // Every trace but the evicted one is found again under its ID, in
+  // whichever table it landed.
+  size_t num_evicted = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const void* saved_frames[StackTraceCache::kMaxNumFrames] = {};
+    size_t num_saved_frames = 0;
+    if (!cache.GetStackTrace(ids[i], saved_frames, &num_saved_frames)) {
+      ++num_evicted;
+      continue;
+    }
+
+    MakeStackTrace(i, arraysize(frames), frames);
+    ASSERT_EQ(arraysize(frames), num_saved_frames);
+    EXPECT_EQ(frames[0], saved_frames[0]);
+    EXPECT_EQ(ids[i], cache.SaveStackTrace(frames, arraysize(frames)));
+  }
+  EXPECT_EQ(1U, num_evicted);
+
+  // IDs past the last table are invalid.
+  const void* saved_frames[StackTraceCache::kMaxNumFrames] = {};
+  size_t num_saved_frames = 0;
+  EXPECT_FALSE(cache.GetStackTrace(kMaxCapacity + 1, saved_frames,
+                                   &num_saved_frames));
+}
+
+TEST(StackTraceCacheTest, CaptureStackTrace) {
+  StackTraceCache cache(16);
+
+  StackTraceCache::TraceId id = cache.CaptureStackTrace();
+  ASSERT_NE(StackTraceCache::kInvalidTraceId, id);
+
+  const void* frames[StackTraceCache::kMaxNumFrames] = {};
+  size_t num_frames = 0;
+  ASSERT_TRUE(cache.GetStackTrace(id, frames, &num_frames));
+  EXPECT_LT(0U, num_frames);
+}
+
+}  // namespace asan
+}  // namespace agent
@@ -249,9 +249,8 @@ Instruction::Instruction(Size size, const uint8* data)
 
   CHECK(core::DecodeOneInstruction(data, size, &representation_));
 
-  uint8* new_data = new uint8[size];
-  memcpy(new_data, data, size);
-  data_ = new_data;
+  memcpy(data_buffer_, data, size);
+  data_ = data_buffer_;
   size_ = size;
   owns_data_ = true;
 }
@@ -266,15 +265,32 @@ Instruction::Instruction(const Instruction& other)
       label_(other.label_),
       offset_(BasicBlock::kNoOffset) {
   if (owns_data_) {
-    uint8* new_data = new uint8[size_];
-    memcpy(new_data, data_, size_);
-    data_ = new_data;
+    memcpy(data_buffer_, other.data_, size_);
+    data_ = data_buffer_;
   }
 }
 
 Instruction::~Instruction() {
-  if (owns_data_)
-    delete [] data_;
+}
+
+Instruction& Instruction::operator=(const Instruction& other) {
+  if (this == &other)
+    return *this;
+
+  representation_ = other.representation_;
+  references_ = other.references_;
+  source_range_ = other.source_range_;
+  size_ = other.size_;
+  data_ = other.data_;
+  owns_data_ = other.owns_data_;
+  label_ = other.label_;
+  offset_ = other.offset_;
+  if (owns_data_) {
+    memcpy(data_buffer_, other.data_, size_);
+    data_ = data_buffer_;
+  }
+
+  return *this;
 }
 
 bool Instruction::CallsNonReturningFunction() const {
@@ -638,8 +654,11 @@ const char* BasicBlock::BasicBlockTypeToString(
   return kBasicBlockType[type];
 }
 
-BasicCodeBlock::BasicCodeBlock(const base::StringPiece& name)
-    : BasicBlock(name, BASIC_CODE_BLOCK) {
+BasicCodeBlock::BasicCodeBlock(const base::StringPiece& name,
+                               BasicBlockArena* arena)
+    : BasicBlock(name, BASIC_CODE_BLOCK),
+      instructions_(Instructions::allocator_type(arena)),
+      successors_(Successors::allocator_type(arena)) {
 }
 
 BasicCodeBlock* BasicCodeBlock::Cast(BasicBlock* basic_block) {
@@ -21,6 +21,7 @@
 #define SYZYGY_BLOCK_GRAPH_BASIC_BLOCK_H_
 
 #include "base/string_piece.h"
+#include "syzygy/block_graph/basic_block_arena.h"
 #include "syzygy/block_graph/block_graph.h"
 #include "syzygy/core/assembler.h"
 #include "syzygy/core/disassembler_util.h"
@@ -244,6 +245,10 @@ class Instruction {
   typedef _DInst Representation;
   typedef std::map<Offset, BasicBlockReference> BasicBlockReferenceMap;
 
+  // The maximum size of an instruction. This is the size of the buffer
+  // holding the data of the instructions that own their data.
+  static const size_t kMaxSize = 15;
+
   // Initialize an Instruction instance.
   // @param value The low-level object representing this instruction.
   // @param source_range The source range for the instruction if any.
@@ -272,6 +277,9 @@ class Instruction {
   // Destructor.
   ~Instruction();
 
+  // Assignment operator.
+  Instruction& operator=(const Instruction& other);
+
   // Accessors.
   // @{
   const Representation& representation() const { return representation_; }
@@ -350,11 +358,14 @@ class Instruction {
   // The source range, if any, associated with this instruction.
   SourceRange source_range_;
 
-  // The data associated with this instruction.
+  // The data associated with this instruction. If the instruction owns its
+  // data, it's stored in data_buffer_ rather than on the heap, so that
+  // creating and copying instructions doesn't allocate.
   // @{
   Size size_;
   const uint8* data_;
   bool owns_data_;
+  uint8 data_buffer_[kMaxSize];
   // @}
 
   // Deprecated.
@@ -512,9 +523,11 @@ class BasicBlock {
   };
 
   typedef BlockGraph::BlockId BlockId;
-  typedef std::list<Instruction> Instructions;
+  typedef std::list<Instruction, BasicBlockArenaAllocator<Instruction> >
+      Instructions;
   typedef BlockGraph::Size Size;
-  typedef std::list<Successor> Successors;
+  typedef std::list<Successor, BasicBlockArenaAllocator<Successor> >
+      Successors;
   typedef BlockGraph::Offset Offset;
 
   // The collection of references this basic block makes to other basic
@@ -590,7 +603,10 @@ class BasicCodeBlock : public BasicBlock {
  public:
   // Initialize a basic code block.
   // @param name A textual identifier for this basic block.
-  explicit BasicCodeBlock(const base::StringPiece& name);
+  // @param arena The arena from which the instructions and successors are
+  //     allocated, or NULL to allocate them from the heap. It must outlive
+  //     the basic block.
+  BasicCodeBlock(const base::StringPiece& name, BasicBlockArena* arena);
 
   // Down-cast from basic block to basic code block.
   static BasicCodeBlock* Cast(BasicBlock* basic_block);
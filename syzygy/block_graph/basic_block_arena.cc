@@ -0,0 +1,56 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/block_graph/basic_block_arena.h"
+
+#include "base/logging.h"
+#include "syzygy/common/align.h"
+
+namespace block_graph {
+
+BasicBlockArena::BasicBlockArena()
+    : current_chunk_(NULL),
+      current_chunk_used_(kChunkSize),
+      allocated_bytes_(0) {
+}
+
+BasicBlockArena::~BasicBlockArena() {
+  for (size_t i = 0; i < chunks_.size(); ++i)
+    delete [] chunks_[i];
+}
+
+void* BasicBlockArena::Allocate(size_t size) {
+  allocated_bytes_ += size;
+
+  // Large allocations get a chunk of their own, leaving the current chunk
+  // available to the following allocations.
+  if (size > kChunkSize) {
+    chunks_.push_back(new uint8[size]);
+    return chunks_.back();
+  }
+
+  // Start a new chunk if the allocation doesn't fit in the current one.
+  size_t offset = common::AlignUp(current_chunk_used_, kAlignment);
+  if (offset + size > kChunkSize) {
+    current_chunk_ = new uint8[kChunkSize];
+    chunks_.push_back(current_chunk_);
+    offset = 0;
+  }
+
+  DCHECK(current_chunk_ != NULL);
+  current_chunk_used_ = offset + size;
+  return current_chunk_ + offset;
+}
+
+}  // namespace block_graph
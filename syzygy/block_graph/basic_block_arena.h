@@ -0,0 +1,152 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Declares the arena from which a basic-block sub-graph allocates its basic
+// blocks, and the elements of their instruction and successor lists.
+
+#ifndef SYZYGY_BLOCK_GRAPH_BASIC_BLOCK_ARENA_H_
+#define SYZYGY_BLOCK_GRAPH_BASIC_BLOCK_ARENA_H_
+
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace block_graph {
+
+// A bump allocator that hands out memory from chunks that it owns. The
+// memory is only released when the arena is destroyed; freeing individual
+// allocations is a no-op. This suits the basic-block sub-graphs, whose basic
+// blocks, instructions and successors are mostly created during decomposition
+// and all go away with the sub-graph.
+class BasicBlockArena {
+ public:
+  // The size of the chunks of memory from which allocations are made. Larger
+  // allocations get a chunk of their own.
+  static const size_t kChunkSize = 16 * 1024;
+
+  // The alignment of the allocations.
+  static const size_t kAlignment = 8;
+
+  BasicBlockArena();
+  ~BasicBlockArena();
+
+  // Allocates memory from the arena.
+  // @param size The number of bytes to allocate.
+  // @returns a pointer to @p size bytes of uninitialized memory, aligned to
+  //     kAlignment. This remains valid until the arena is destroyed.
+  void* Allocate(size_t size);
+
+  // @returns the number of bytes allocated from the arena.
+  size_t allocated_bytes() const { return allocated_bytes_; }
+
+ private:
+  // All of the chunks owned by the arena.
+  std::vector<uint8*> chunks_;
+
+  // The chunk allocations are currently made from, and the number of bytes
+  // used in it.
+  uint8* current_chunk_;
+  size_t current_chunk_used_;
+
+  // The number of bytes allocated from the arena.
+  size_t allocated_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(BasicBlockArena);
+};
+
+// An STL allocator that allocates from a BasicBlockArena, or from the heap if
+// it has no arena. Containers can only exchange elements, for instance with
+// splice or swap, if their allocators are equal; that is, if they use the same
+// arena or both use the heap.
+template <typename T>
+class BasicBlockArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U>
+  struct rebind {
+    typedef BasicBlockArenaAllocator<U> other;
+  };
+
+  // Creates an allocator that allocates from the heap.
+  BasicBlockArenaAllocator() : arena_(NULL) {
+  }
+
+  // Creates an allocator that allocates from @p arena, or from the heap if
+  // @p arena is NULL. The arena must outlive the allocations.
+  explicit BasicBlockArenaAllocator(BasicBlockArena* arena) : arena_(arena) {
+  }
+
+  template <typename U>
+  BasicBlockArenaAllocator(const BasicBlockArenaAllocator<U>& other)
+      : arena_(other.arena()) {
+  }
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+
+  pointer allocate(size_type count, const void* hint = NULL) {
+    if (arena_ == NULL)
+      return static_cast<pointer>(::operator new(count * sizeof(T)));
+    return static_cast<pointer>(arena_->Allocate(count * sizeof(T)));
+  }
+
+  void deallocate(pointer ptr, size_type count) {
+    // Memory allocated from the arena is released with the arena.
+    if (arena_ == NULL)
+      ::operator delete(ptr);
+  }
+
+  size_type max_size() const {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+  void construct(pointer ptr, const T& value) {
+    new(static_cast<void*>(ptr)) T(value);
+  }
+
+  void destroy(pointer ptr) {
+    ptr->~T();
+  }
+
+  // @returns the arena this allocates from, or NULL for the heap.
+  BasicBlockArena* arena() const { return arena_; }
+
+ private:
+  BasicBlockArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const BasicBlockArenaAllocator<T>& allocator1,
+                const BasicBlockArenaAllocator<U>& allocator2) {
+  return allocator1.arena() == allocator2.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const BasicBlockArenaAllocator<T>& allocator1,
+                const BasicBlockArenaAllocator<U>& allocator2) {
+  return allocator1.arena() != allocator2.arena();
+}
+
+}  // namespace block_graph
+
+#endif  // SYZYGY_BLOCK_GRAPH_BASIC_BLOCK_ARENA_H_
@@ -0,0 +1,118 @@
+// Copyright 2012 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/block_graph/basic_block_arena.h"
+
+#include <list>
+
+#include "gtest/gtest.h"
+
+namespace block_graph {
+
+namespace {
+
+typedef std::list<int, BasicBlockArenaAllocator<int> > IntList;
+
+bool IsAligned(const void* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % BasicBlockArena::kAlignment == 0;
+}
+
+}  // namespace
+
+TEST(BasicBlockArenaTest, Allocate) {
+  BasicBlockArena arena;
+  EXPECT_EQ(0U, arena.allocated_bytes());
+
+  // Successive allocations are aligned and don't overlap.
+  uint8* ptr1 = static_cast<uint8*>(arena.Allocate(3));
+  uint8* ptr2 = static_cast<uint8*>(arena.Allocate(5));
+  ASSERT_TRUE(ptr1 != NULL);
+  ASSERT_TRUE(ptr2 != NULL);
+  EXPECT_TRUE(IsAligned(ptr1));
+  EXPECT_TRUE(IsAligned(ptr2));
+  EXPECT_TRUE(ptr1 + 3 <= ptr2 || ptr2 + 5 <= ptr1);
+  ::memset(ptr1, 0xCC, 3);
+  ::memset(ptr2, 0xDD, 5);
+  EXPECT_EQ(8U, arena.allocated_bytes());
+
+  // Allocations larger than a chunk get their own.
+  const size_t kLargeSize = BasicBlockArena::kChunkSize * 2;
+  uint8* large = static_cast<uint8*>(arena.Allocate(kLargeSize));
+  ASSERT_TRUE(large != NULL);
+  EXPECT_TRUE(IsAligned(large));
+  ::memset(large, 0xEE, kLargeSize);
+
+  // Many allocations span several chunks.
+  for (size_t i = 0; i < 10000; ++i) {
+    void* ptr = arena.Allocate(24);
+    ASSERT_TRUE(ptr != NULL);
+    EXPECT_TRUE(IsAligned(ptr));
+    ::memset(ptr, 0xFF, 24);
+  }
+  EXPECT_EQ(8U + kLargeSize + 10000 * 24, arena.allocated_bytes());
+
+  EXPECT_EQ(0xCC, ptr1[2]);
+  EXPECT_EQ(0xDD, ptr2[4]);
+}
+
+TEST(BasicBlockArenaTest, AllocatorEquality) {
+  BasicBlockArena arena1;
+  BasicBlockArena arena2;
+
+  BasicBlockArenaAllocator<int> heap;
+  BasicBlockArenaAllocator<int> allocator1(&arena1);
+  BasicBlockArenaAllocator<double> allocator1_rebound(allocator1);
+  BasicBlockArenaAllocator<int> allocator2(&arena2);
+
+  EXPECT_TRUE(heap.arena() == NULL);
+  EXPECT_EQ(&arena1, allocator1_rebound.arena());
+  EXPECT_TRUE(heap == BasicBlockArenaAllocator<double>());
+  EXPECT_TRUE(allocator1 == allocator1_rebound);
+  EXPECT_TRUE(allocator1 != allocator2);
+  EXPECT_TRUE(allocator1 != heap);
+}
+
+TEST(BasicBlockArenaTest, ListsShareArena) {
+  BasicBlockArena arena;
+  IntList list1((IntList::allocator_type(&arena)));
+  IntList list2((IntList::allocator_type(&arena)));
+
+  for (int i = 0; i < 100; ++i)
+    list1.push_back(i);
+  EXPECT_LT(0U, arena.allocated_bytes());
+
+  // Elements move between the lists of an arena without being copied.
+  IntList::iterator it = list1.begin();
+  std::advance(it, 50);
+  const int* element = &(*it);
+  list2.splice(list2.end(), list1, it, list1.end());
+  EXPECT_EQ(50U, list1.size());
+  EXPECT_EQ(50U, list2.size());
+  EXPECT_EQ(element, &list2.front());
+
+  list1.swap(list2);
+  EXPECT_EQ(element, &list1.front());
+  EXPECT_EQ(0, list2.front());
+}
+
+TEST(BasicBlockArenaTest, HeapAllocator) {
+  IntList list;
+  for (int i = 0; i < 100; ++i)
+    list.push_back(i);
+  list.erase(list.begin());
+  EXPECT_EQ(99U, list.size());
+  EXPECT_EQ(1, list.front());
+}
+
+}  // namespace block_graph
@@ -140,6 +140,10 @@ BasicBlockDecomposer::BasicBlockDecomposer(const BlockGraph::Block* block,
       block_(block),
       subgraph_(subgraph),
       current_block_start_(0),
+      current_instructions_(
+          BasicBlock::Instructions::allocator_type(subgraph->arena())),
+      current_successors_(
+          BasicBlock::Successors::allocator_type(subgraph->arena())),
       check_decomposition_results_(true) {
   // TODO(rogerm): Once we're certain this is stable for all input binaries
   //     turn on check_decomposition_results_ by default only ifndef NDEBUG.
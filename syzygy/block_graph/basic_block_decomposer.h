@@ -34,6 +34,7 @@
 #include "syzygy/block_graph/basic_block_subgraph.h"
 #include "syzygy/block_graph/block_graph.h"
 #include "syzygy/core/address.h"
+#include "syzygy/core/address_space.h"
 #include "syzygy/core/disassembler.h"
 #include "distorm.h"  // NOLINT
 
@@ -84,7 +85,8 @@ class BasicBlockDecomposer : public core::Disassembler {
 
   // Initialize the BasicBlockDecomposer instance.
   // @param block The block to be decomposed
-  // @param subgraph The basic-block sub-graph data structure to populate.
+  // @param subgraph The basic-block sub-graph data structure to populate. It
+  //     must outlive the decomposer.
   // @pre block is safe for basic-block decomposition. That is,
   //     CodeBlockAttributesAreBasicBlockSafe(block) returns true.
   BasicBlockDecomposer(const BlockGraph::Block* block,
@@ -224,7 +226,9 @@ class BasicBlockDecomposer : public core::Disassembler {
   // The start of the current basic block during a walk.
   AbsoluteAddress current_block_start_;
 
-  // The list of instructions in the current basic block.
+  // The list of instructions in the current basic block. This and the
+  // successors are allocated from the arena of subgraph_, so that they can be
+  // swapped into the basic blocks.
   BasicBlock::Instructions current_instructions_;
 
   // The set of successors for the current basic block.
@@ -18,8 +18,6 @@
 
 #include <algorithm>
 
-#include "base/memory/scoped_ptr.h"
-
 namespace block_graph {
 
 namespace {
@@ -42,13 +40,12 @@ BasicBlockSubGraph::BasicBlockSubGraph()
 }
 
 BasicBlockSubGraph::~BasicBlockSubGraph() {
-  // Delete all the BB's we've been entrusted with.
-  BBCollection::iterator it = basic_blocks_.begin();
-  for (; it != basic_blocks_.end(); ++it)
-    delete *it;
-
-  // And wipe the collection.
+  // Destroy all the BB's we've been entrusted with, including the removed
+  // ones. Their memory belongs to the arena, which releases it.
   basic_blocks_.clear();
+  for (size_t i = 0; i < allocated_basic_blocks_.size(); ++i)
+    allocated_basic_blocks_[i]->~BasicBlock();
+  allocated_basic_blocks_.clear();
 }
 
 BasicBlockSubGraph::BlockDescription* BasicBlockSubGraph::AddBlockDescription(
@@ -71,11 +68,11 @@ block_graph::BasicCodeBlock* BasicBlockSubGraph::AddBasicCodeBlock(
     const base::StringPiece& name) {
   DCHECK(!name.empty());
 
-  scoped_ptr<BasicCodeBlock> new_code_block(new BasicCodeBlock(name));
-  bool inserted = basic_blocks_.insert(new_code_block.get()).second;
-  DCHECK(inserted);
+  BasicCodeBlock* new_code_block = new(
+      arena_.Allocate(sizeof(BasicCodeBlock))) BasicCodeBlock(name, &arena_);
+  AddBasicBlock(new_code_block);
 
-  return new_code_block.release();
+  return new_code_block;
 }
 
 block_graph::BasicDataBlock* BasicBlockSubGraph::AddBasicDataBlock(
@@ -85,12 +82,12 @@ block_graph::BasicDataBlock* BasicBlockSubGraph::AddBasicDataBlock(
     const uint8* data) {
   DCHECK(!name.empty());
 
-  scoped_ptr<BasicDataBlock> new_data_block(
-      new BasicDataBlock(name, type, data, size));
-  bool inserted = basic_blocks_.insert(new_data_block.get()).second;
-  DCHECK(inserted);
+  BasicDataBlock* new_data_block = new(
+      arena_.Allocate(sizeof(BasicDataBlock)))
+          BasicDataBlock(name, type, data, size);
+  AddBasicBlock(new_data_block);
 
-  return new_data_block.release();
+  return new_data_block;
 }
 
 void BasicBlockSubGraph::Remove(BasicBlock* bb) {
@@ -99,6 +96,14 @@ void BasicBlockSubGraph::Remove(BasicBlock* bb) {
   basic_blocks_.erase(bb);
 }
 
+void BasicBlockSubGraph::AddBasicBlock(BasicBlock* bb) {
+  DCHECK(bb != NULL);
+
+  allocated_basic_blocks_.push_back(bb);
+  bool inserted = basic_blocks_.insert(bb).second;
+  DCHECK(inserted);
+}
+
 bool BasicBlockSubGraph::IsValid() const {
   return MapsBasicBlocksToAtMostOneDescription() &&
       HasValidSuccessors() &&
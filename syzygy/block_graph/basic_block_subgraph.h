@@ -20,6 +20,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/string_piece.h"
@@ -35,7 +36,9 @@ namespace block_graph {
 //
 // In manipulating the basic block sub-graph, note that the sub-graph
 // acts as a basic-block factory and retains ownership of all basic-blocks
-// that participate in the composition.
+// that participate in the composition. The basic-blocks, as well as their
+// instructions and successors, are allocated from an arena owned by the
+// sub-graph, and are only released with it.
 class BasicBlockSubGraph {
  public:
   typedef block_graph::BasicBlock BasicBlock;
@@ -84,6 +87,11 @@ class BasicBlockSubGraph {
     return block_descriptions_;
   }
   BlockDescriptionList& block_descriptions() { return block_descriptions_; }
+
+  // The instruction and successor lists that are spliced into the basic
+  // code blocks of the sub-graph must allocate from this arena.
+  BasicBlockArena* arena() { return &arena_; }
+  const BasicBlockArena* arena() const { return &arena_; }
   // @}
 
   // Initializes and returns a new block description.
@@ -120,7 +128,8 @@ class BasicBlockSubGraph {
                                     Size size,
                                     const uint8* data);
 
-  // Remove a basic block from the subgraph.
+  // Remove a basic block from the subgraph. The basic block remains valid
+  // until the subgraph is destroyed.
   // @param bb The basic block to remove.
   // @pre @p bb must be in the graph.
   void Remove(BasicBlock* bb);
@@ -148,6 +157,10 @@ class BasicBlockSubGraph {
   bool HasValidReferrers() const;
   // @}
 
+  // Registers a newly constructed basic block with the sub-graph.
+  // @param bb The basic block, allocated from arena_.
+  void AddBasicBlock(BasicBlock* bb);
+
   // The original block corresponding from which this sub-graph derives. This
   // is optional, and may be NULL.
   const Block* original_block_;
@@ -160,6 +173,17 @@ class BasicBlockSubGraph {
   // A list of block descriptions for the blocks that are to be created from
   // this basic block sub-graph.
   BlockDescriptionList block_descriptions_;
+
+  // The arena from which the basic blocks, their instructions and their
+  // successors are allocated.
+  BasicBlockArena arena_;
+
+  // Every basic block allocated from the arena, including those that have
+  // been removed from the sub-graph, in order of creation.
+  std::vector<BasicBlock*> allocated_basic_blocks_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BasicBlockSubGraph);
 };
 
 }  // namespace block_graph
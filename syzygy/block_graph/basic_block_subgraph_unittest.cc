@@ -16,6 +16,10 @@
 
 #include "syzygy/block_graph/basic_block_subgraph.h"
 
+#include <set>
+#include <vector>
+
+#include "base/stringprintf.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "syzygy/block_graph/basic_block.h"
@@ -97,6 +101,63 @@ TEST(BasicBlockSubGraphTest, AddBasicBlock) {
   ASSERT_NE(implicit_cast<BasicBlock*>(bb2), bb3);
 }
 
+TEST(BasicBlockSubGraphTest, AddManyBasicBlocks) {
+  BasicBlockSubGraph subgraph;
+
+  // Add enough basic blocks to span several chunks of the arena.
+  std::vector<BasicBlock*> basic_blocks;
+  for (size_t i = 0; i < 1000; ++i) {
+    std::string name(base::StringPrintf("bb%d", i));
+    if (i % 2 == 0) {
+      basic_blocks.push_back(subgraph.AddBasicCodeBlock(name));
+    } else {
+      basic_blocks.push_back(subgraph.AddBasicDataBlock(
+          name, BasicBlock::BASIC_DATA_BLOCK, kDataSize, kData));
+    }
+  }
+  EXPECT_EQ(basic_blocks.size(), subgraph.basic_blocks().size());
+
+  // Removed basic blocks remain valid until the subgraph is destroyed.
+  subgraph.Remove(basic_blocks[0]);
+  EXPECT_EQ(basic_blocks.size() - 1, subgraph.basic_blocks().size());
+  EXPECT_EQ("bb0", basic_blocks[0]->name());
+
+  // The basic blocks don't overlap and are intact.
+  std::set<BasicBlock*> unique_blocks(basic_blocks.begin(),
+                                      basic_blocks.end());
+  EXPECT_EQ(basic_blocks.size(), unique_blocks.size());
+  for (size_t i = 0; i < basic_blocks.size(); ++i) {
+    EXPECT_EQ(base::StringPrintf("bb%d", i), basic_blocks[i]->name());
+    EXPECT_EQ(i % 2 == 0 ? BasicBlock::BASIC_CODE_BLOCK :
+                           BasicBlock::BASIC_DATA_BLOCK,
+              basic_blocks[i]->type());
+  }
+}
+
+TEST(BasicBlockSubGraphTest, InstructionsAllocatedFromArena) {
+  BasicBlockSubGraph subgraph;
+  BasicCodeBlock* bb1 = subgraph.AddBasicCodeBlock("bb1");
+  BasicCodeBlock* bb2 = subgraph.AddBasicCodeBlock("bb2");
+  ASSERT_TRUE(bb1 != NULL);
+  ASSERT_TRUE(bb2 != NULL);
+  EXPECT_EQ(subgraph.arena(), bb1->instructions().get_allocator().arena());
+  EXPECT_EQ(subgraph.arena(), bb1->successors().get_allocator().arena());
+
+  // Adding instructions allocates from the arena.
+  const uint8 kNop[] = { 0x90 };
+  size_t allocated_bytes = subgraph.arena()->allocated_bytes();
+  for (size_t i = 0; i < 10; ++i)
+    bb1->instructions().push_back(Instruction(sizeof(kNop), kNop));
+  EXPECT_LT(allocated_bytes, subgraph.arena()->allocated_bytes());
+
+  // The instructions move between the basic blocks in place.
+  const Instruction* first = &bb1->instructions().front();
+  bb2->instructions().splice(bb2->instructions().end(), bb1->instructions());
+  EXPECT_TRUE(bb1->instructions().empty());
+  EXPECT_EQ(10U, bb2->instructions().size());
+  EXPECT_EQ(first, &bb2->instructions().front());
+}
+
 TEST(BasicBlockSubGraphTest, AddBlockDescription) {
   TestBasicBlockSubGraph subgraph;
   BlockDescription* b1 = subgraph.AddBlockDescription(
@@ -183,6 +183,27 @@ TEST_F(BasicBlockTest, InstructionConstructor) {
     Instruction call_temp(call_instr);
     ASSERT_EQ(call_instr.references(), call_temp.references());
   }
+
+  {
+    // Copies of an instruction owning its data should have their own copy.
+    Instruction ret_temp(ret_instr.size(), ret_instr.data());
+    Instruction ret_copy(ret_temp);
+    ASSERT_TRUE(ret_copy.owns_data());
+    ASSERT_NE(ret_temp.data(), ret_copy.data());
+    ASSERT_EQ(0, memcmp(ret_temp.data(), ret_copy.data(), ret_copy.size()));
+
+    // And so should assigned instructions.
+    Instruction ret_assigned(ret_instr);
+    ret_assigned = ret_temp;
+    ASSERT_TRUE(ret_assigned.owns_data());
+    ASSERT_NE(ret_temp.data(), ret_assigned.data());
+    ASSERT_EQ(0,
+              memcmp(ret_temp.data(), ret_assigned.data(), ret_temp.size()));
+
+    ret_assigned = ret_instr;
+    ASSERT_FALSE(ret_assigned.owns_data());
+    ASSERT_EQ(ret_instr.data(), ret_assigned.data());
+  }
 }
 
 TEST_F(BasicBlockTest, Cast) {
@@ -485,7 +506,7 @@ TEST_F(SuccessorTest, BasicCodeBlockConstructor) {
   const Successor::Condition kCondition = Successor::kConditionAbove;
   const Successor::Size kSuccessorSize = 5;
   uint8 data[20] = {};
-  BasicCodeBlock bb("bb");
+  BasicCodeBlock bb("bb", NULL);
   BasicBlockReference bb_ref(BlockGraph::ABSOLUTE_REF, 4, &bb);
 
   Successor s(kCondition,
@@ -500,7 +521,7 @@ TEST_F(SuccessorTest, BasicCodeBlockConstructor) {
 
 TEST_F(SuccessorTest, SetBranchTarget) {
   uint8 data[20] = {};
-  BasicCodeBlock bb("bb");
+  BasicCodeBlock bb("bb", NULL);
   BasicBlockReference bb_ref(BlockGraph::ABSOLUTE_REF, 4, &bb);
 
   Successor s;
@@ -57,8 +57,11 @@ class MergeContext {
     DCHECK(bg != NULL);
   }
 
-  // Accessor.
+  // Accessors.
   const BlockVector& new_blocks() const { return new_blocks_; }
+  const BlockBuilder::SuccessorStatistics& successor_statistics() const {
+    return successor_statistics_;
+  }
 
   // Generate all of the blocks described in @p subgraph.
   // @param subgraph Defines the block properties and basic blocks to use
@@ -161,10 +164,16 @@ class MergeContext {
 
   // Generates a layout for @p order. This layout will arrange each basic block
   // in the ordering back-to-back with minimal reach encodings on each
-  // successor.
+  // successor. Only the successors found out of reach are grown, until the
+  // layout is stable.
   // @param order The basic block ordering to process.
   bool GenerateBlockLayout(const BasicBlockOrdering& order);
 
+  // Accounts for the successors manifested in the stable layout of @p order
+  // in successor_statistics_.
+  // @param order The basic block ordering to process.
+  void UpdateSuccessorStatistics(const BasicBlockOrdering& order);
+
   // Generates a layout for @p subgraph and stores it in layout_info_.
   // @param subgraph The subgraph to process.
   bool GenerateLayout(const BasicBlockSubGraph& subgraph);
@@ -189,6 +198,11 @@ class MergeContext {
   // Returns the maximal successor size for @p condition.
   static Size GetLongSuccessorSize(Successor::Condition condition);
 
+  // Returns the size @p successor is initially manifested with, before the
+  // layout is known. Successors to basic blocks start short and are only
+  // grown as needed, while successors to blocks are always long.
+  static Size GetInitialSuccessorSize(const SuccessorLayoutInfo& successor);
+
   // Computes and returns the required successor size for @p successor.
   // @param info The layout info for the basic block.
   // @param start_offset Offeset from the start of @p info.basic_block to
@@ -233,6 +247,9 @@ class MergeContext {
   // The set of blocks generated in this context so far.
   BlockVector new_blocks_;
 
+  // The statistics on the successors laid out in this context so far.
+  BlockBuilder::SuccessorStatistics successor_statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(MergeContext);
 };
 
@@ -386,28 +403,40 @@ bool MergeContext::CopyInstructions(
 
   // Copy the instruction data and assign each instruction an offset.
   InstructionConstIter it = instructions.begin();
-  for (; it != instructions.end(); ++it) {
-    const Instruction& instruction = *it;
+  while (it != instructions.end()) {
+    // Find the run of instructions whose data is contiguous, which is the
+    // case of the instructions left untouched since the decomposition of the
+    // original block. Their bytes are copied at once.
+    const uint8* run_data = it->data();
+    Size run_size = 0;
+    InstructionConstIter run_end = it;
+    do {
+      run_size += run_end->size();
+      ++run_end;
+    } while (run_end != instructions.end() &&
+             run_end->data() == run_data + run_size);
 
     // Copy the instruction bytes.
-    ::memcpy(buffer + offset,
-             instruction.data(),
-             instruction.size());
+    ::memcpy(buffer + offset, run_data, run_size);
+
+    for (; it != run_end; ++it) {
+      const Instruction& instruction = *it;
 
-    // Preserve the label on the instruction, if any.
-    if (instruction.has_label())
-      new_block->SetLabel(offset, instruction.label());
+      // Preserve the label on the instruction, if any.
+      if (instruction.has_label())
+        new_block->SetLabel(offset, instruction.label());
 
-    // Record the source range.
-    CopySourceRange(instruction.source_range(),
-                    offset, instruction.size(),
-                    new_block);
+      // Record the source range.
+      CopySourceRange(instruction.source_range(),
+                      offset, instruction.size(),
+                      new_block);
 
-    // Copy references.
-    CopyReferences(instruction.references(), offset, new_block);
+      // Copy references.
+      CopyReferences(instruction.references(), offset, new_block);
 
-    // Update the offset/bytes_written.
-    offset += instruction.size();
+      // Update the offset/bytes_written.
+      offset += instruction.size();
+    }
   }
 
   return true;
@@ -514,6 +543,11 @@ bool MergeContext::InitializeBlockLayout(const BasicBlockOrdering& order,
             info.successors[manifested_successors++];
         successor.condition = succ_it->condition();
         successor.reference = succ_it->reference();
+        successor.size = GetInitialSuccessorSize(successor);
+      } else {
+        ++successor_statistics_.elided_successors;
+        successor_statistics_.bytes_saved +=
+            GetLongSuccessorSize(succ_it->condition());
       }
 
       // Go to the next successor, if any.
@@ -555,6 +589,11 @@ bool MergeContext::InitializeBlockLayout(const BasicBlockOrdering& order,
 
         successor.condition = condition;
         successor.reference = succ_it->reference();
+        successor.size = GetInitialSuccessorSize(successor);
+      } else {
+        ++successor_statistics_.elided_successors;
+        successor_statistics_.bytes_saved +=
+            GetLongSuccessorSize(succ_it->condition());
       }
     }
   }
@@ -602,6 +641,13 @@ bool MergeContext::GenerateBlockLayout(const BasicBlockOrdering& order) {
         if (successor.condition == Successor::kInvalidCondition)
           break;
 
+        // Successors only ever grow, so those that are already manifested
+        // long are settled and needn't be looked at again.
+        if (successor.size == GetLongSuccessorSize(successor.condition)) {
+          start_offset += successor.size;
+          continue;
+        }
+
         // Compute the new size and update the start offset for the next
         // successor (if any).
         Size new_size =
@@ -623,11 +669,32 @@ bool MergeContext::GenerateBlockLayout(const BasicBlockOrdering& order) {
       new_block->set_size(next_block_start);
       new_block->AllocateData(next_block_start);
 
+      UpdateSuccessorStatistics(order);
       return true;
     }
   }
 }
 
+void MergeContext::UpdateSuccessorStatistics(const BasicBlockOrdering& order) {
+  BasicBlockOrderingConstIter it = order.begin();
+  for (; it != order.end(); ++it) {
+    const BasicBlockLayoutInfo& info = FindLayoutInfo(*it);
+    for (size_t i = 0; i < arraysize(info.successors); ++i) {
+      const SuccessorLayoutInfo& successor = info.successors[i];
+      if (successor.condition == Successor::kInvalidCondition)
+        break;
+
+      Size long_size = GetLongSuccessorSize(successor.condition);
+      if (successor.size == long_size) {
+        ++successor_statistics_.long_successors;
+      } else {
+        ++successor_statistics_.short_successors;
+        successor_statistics_.bytes_saved += long_size - successor.size;
+      }
+    }
+  }
+}
+
 bool MergeContext::GenerateLayout(const BasicBlockSubGraph& subgraph) {
   // Create each new block and initialize a layout for it.
   BlockDescriptionConstIter it = subgraph.block_descriptions().begin();
@@ -858,6 +925,16 @@ Size MergeContext::GetLongSuccessorSize(Successor::Condition condition) {
   }
 }
 
+Size MergeContext::GetInitialSuccessorSize(
+    const SuccessorLayoutInfo& successor) {
+  if (successor.reference.referred_type() ==
+          BasicBlockReference::REFERRED_TYPE_BASIC_BLOCK) {
+    return GetShortSuccessorSize(successor.condition);
+  }
+
+  return GetLongSuccessorSize(successor.condition);
+}
+
 Size MergeContext::ComputeRequiredSuccessorSize(
     const BasicBlockLayoutInfo& info,
     Offset start_offset,
@@ -943,6 +1020,20 @@ BlockGraph::Reference MergeContext::ResolveReference(
 
 }  // namespace
 
+BlockBuilder::SuccessorStatistics::SuccessorStatistics()
+    : elided_successors(0),
+      short_successors(0),
+      long_successors(0),
+      bytes_saved(0) {
+}
+
+void BlockBuilder::SuccessorStatistics::Add(const SuccessorStatistics& other) {
+  elided_successors += other.elided_successors;
+  short_successors += other.short_successors;
+  long_successors += other.long_successors;
+  bytes_saved += other.bytes_saved;
+}
+
 BlockBuilder::BlockBuilder(BlockGraph* bg) : block_graph_(bg) {
 }
 
@@ -962,6 +1053,7 @@ bool BlockBuilder::Merge(BasicBlockSubGraph* subgraph) {
   new_blocks_.insert(new_blocks_.end(),
                      context.new_blocks().begin(),
                      context.new_blocks().end());
+  successor_statistics_.Add(context.successor_statistics());
 
   // And we're done.
   return true;
@@ -25,6 +25,27 @@ namespace block_graph {
 // This class incorporates a BasicBlockSubGraph into a BlockGraph.
 class BlockBuilder {
  public:
+  // Statistics on how the successors of the merged basic blocks were
+  // manifested. Successors falling through to the next basic block are
+  // elided, and the others are manifested with the shortest branch that
+  // reaches their destination.
+  struct SuccessorStatistics {
+    SuccessorStatistics();
+
+    // Accumulates @p other into these statistics.
+    void Add(const SuccessorStatistics& other);
+
+    // The number of successors elided.
+    size_t elided_successors;
+    // The number of successors manifested with an 8-bit displacement.
+    size_t short_successors;
+    // The number of successors manifested with a 32-bit displacement.
+    size_t long_successors;
+    // The number of bytes saved by eliding and shortening successors, as
+    // opposed to manifesting all of them with 32-bit displacements.
+    size_t bytes_saved;
+  };
+
   explicit BlockBuilder(BlockGraph* block_graph);
 
   // Merge the @p subgraph into the block graph. This will create all blocks
@@ -36,6 +57,11 @@ class BlockBuilder {
   // subgraphs.
   const BlockVector& new_blocks() const { return new_blocks_; }
 
+  // Returns the statistics on the successors of the subgraphs merged so far.
+  const SuccessorStatistics& successor_statistics() const {
+    return successor_statistics_;
+  }
+
  private:
   // The block-graph that subgraphs will be merged into.
   BlockGraph* const block_graph_;
@@ -43,6 +69,9 @@ class BlockBuilder {
   // The set of blocks created so far.
   BlockVector new_blocks_;
 
+  // The statistics on the successors of the subgraphs merged so far.
+  SuccessorStatistics successor_statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(BlockBuilder);
 };
 
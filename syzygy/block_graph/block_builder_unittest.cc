@@ -22,6 +22,7 @@
 #include "syzygy/block_graph/basic_block_subgraph.h"
 #include "syzygy/block_graph/basic_block_test_util.h"
 #include "syzygy/block_graph/block_graph.h"
+#include "syzygy/core/disassembler_util.h"
 
 namespace block_graph {
 
@@ -95,11 +96,15 @@ class BlockBuilderTest : public testing::BasicBlockTest {
     BlockBuilder builder(&block_graph_);
     EXPECT_TRUE(builder.Merge(&subgraph_));
     EXPECT_EQ(1, builder.new_blocks().size());
+    successor_statistics_ = builder.successor_statistics();
 
     Block* new_block = builder.new_blocks()[0];
     EXPECT_TRUE(new_block != NULL);
     return new_block;
   }
+
+  // The successor statistics of the last layout created by CreateLayout.
+  BlockBuilder::SuccessorStatistics successor_statistics_;
 };
 
 }  // namespace
@@ -381,6 +386,88 @@ TEST_F(BlockBuilderTest, OutofReachJmpLayout) {
   EXPECT_EQ(expected_refs, new_block->references());
 }
 
+TEST_F(BlockBuilderTest, SuccessorStatistics) {
+  // The BB1->BB2 and BB3->BB4 successors are elided, and the others fit in
+  // short branches.
+  ASSERT_TRUE(CreateLayout(62, 62, 63, 1) != NULL);
+  EXPECT_EQ(2U, successor_statistics_.elided_successors);
+  EXPECT_EQ(2U, successor_statistics_.short_successors);
+  EXPECT_EQ(0U, successor_statistics_.long_successors);
+  EXPECT_EQ(core::AssemblerImpl::kLongBranchSize +
+                core::AssemblerImpl::kLongJumpSize +
+                core::AssemblerImpl::kLongBranchSize -
+                core::AssemblerImpl::kShortBranchSize +
+                core::AssemblerImpl::kLongJumpSize -
+                core::AssemblerImpl::kShortJumpSize,
+            successor_statistics_.bytes_saved);
+}
+
+TEST_F(BlockBuilderTest, SuccessorStatisticsOutOfReach) {
+  // The BB1->BB4 branch is just out of reach and has to be long.
+  ASSERT_TRUE(CreateLayout(62, 54, 72, 1) != NULL);
+  EXPECT_EQ(2U, successor_statistics_.elided_successors);
+  EXPECT_EQ(1U, successor_statistics_.short_successors);
+  EXPECT_EQ(1U, successor_statistics_.long_successors);
+  EXPECT_EQ(core::AssemblerImpl::kLongBranchSize +
+                core::AssemblerImpl::kLongJumpSize +
+                core::AssemblerImpl::kLongJumpSize -
+                core::AssemblerImpl::kShortJumpSize,
+            successor_statistics_.bytes_saved);
+}
+
+TEST_F(BlockBuilderTest, CopiesInstructionRuns) {
+  // nop; mov edi, edi; lea ecx, [ecx + 0].
+  static const uint8 kCode[] = { 0x90, 0x8B, 0xFF, 0x8D, 0x49, 0x00 };
+  const core::RelativeAddress kCodeAddress(0x1000);
+
+  // Interleave an instruction owning its data with instructions referring
+  // to kCode, as the original instructions of a block would.
+  BasicCodeBlock* bb = subgraph_.AddBasicCodeBlock("bb");
+  ASSERT_TRUE(bb != NULL);
+  size_t offsets[] = { 0, 1, 3 };
+  size_t sizes[] = { 1, 2, 3 };
+  for (size_t i = 0; i < arraysize(offsets); ++i) {
+    // The instruction owning its data goes before the last one.
+    if (i == 2) {
+      bb->instructions().push_back(
+          Instruction(sizes[i], kCode + offsets[i]));
+    }
+
+    _DInst repr = {};
+    ASSERT_TRUE(core::DecodeOneInstruction(kCode + offsets[i], sizes[i],
+                                           &repr));
+    Instruction::SourceRange source_range(kCodeAddress + offsets[i],
+                                          sizes[i]);
+    bb->instructions().push_back(
+        Instruction(repr, source_range, sizes[i], kCode + offsets[i]));
+  }
+
+  BasicBlockSubGraph::BlockDescription* d1 = subgraph_.AddBlockDescription(
+      "new_block", BlockGraph::CODE_BLOCK, 0, 1, 0);
+  d1->basic_block_order.push_back(bb);
+
+  BlockBuilder builder(&block_graph_);
+  ASSERT_TRUE(builder.Merge(&subgraph_));
+  ASSERT_EQ(1, builder.new_blocks().size());
+
+  Block* new_block = builder.new_blocks()[0];
+  ASSERT_TRUE(new_block != NULL);
+  static const uint8 kExpectedData[] = {
+      0x90, 0x8B, 0xFF, 0x8D, 0x49, 0x00, 0x8D, 0x49, 0x00 };
+  ASSERT_EQ(sizeof(kExpectedData), new_block->size());
+  ASSERT_TRUE(new_block->data() != NULL);
+  EXPECT_EQ(0, ::memcmp(kExpectedData, new_block->data(),
+                        sizeof(kExpectedData)));
+
+  // The source ranges of the contiguous original instructions are merged.
+  Block::SourceRanges expected_source_ranges;
+  ASSERT_TRUE(expected_source_ranges.Push(
+      Block::DataRange(0, 3), Block::SourceRange(kCodeAddress, 3)));
+  ASSERT_TRUE(expected_source_ranges.Push(
+      Block::DataRange(6, 3), Block::SourceRange(kCodeAddress + 3, 3)));
+  EXPECT_EQ(expected_source_ranges, new_block->source_ranges());
+}
+
 TEST_F(BlockBuilderTest, MergeAssemblesSourceRangesCorrectly) {
   ASSERT_NO_FATAL_FAILURE(InitBlockGraph());
   ASSERT_NO_FATAL_FAILURE(InitBasicBlockSubGraph());
@@ -214,7 +214,8 @@ const BlockGraph::SectionId BlockGraph::kInvalidSectionId = -1;
 
 BlockGraph::BlockGraph()
     : next_section_id_(0),
-      next_block_id_(0) {
+      next_block_id_(0),
+      instruction_cache_(NULL) {
 }
 
 BlockGraph::~BlockGraph() {
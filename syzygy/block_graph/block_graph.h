@@ -36,6 +36,13 @@
 #include "syzygy/core/address.h"
 #include "syzygy/core/address_space.h"
 
+namespace core {
+
+// Forward declaration.
+class DecodedInstructionCache;
+
+}  // namespace core
+
 namespace block_graph {
 
 // Forward declaration.
@@ -263,6 +270,19 @@ class BlockGraph {
   const BlockMap& blocks() const { return blocks_; }
   BlockMap& blocks_mutable() { return blocks_; }
 
+  // @{
+  // Accesses the cache of the instructions decoded from the code blocks of
+  // this graph. The decomposers that disassemble these blocks share it, so
+  // that code is only decoded once per relink. The cache isn't owned by the
+  // graph, and may be NULL.
+  core::DecodedInstructionCache* instruction_cache() const {
+    return instruction_cache_;
+  }
+  void set_instruction_cache(core::DecodedInstructionCache* instruction_cache) {
+    instruction_cache_ = instruction_cache;
+  }
+  // @}
+
   // @{
   // Retrieve the section with the given id.
   //
@@ -297,6 +317,9 @@ class BlockGraph {
 
   // Our block ID allocator.
   BlockId next_block_id_;
+
+  // The cache of decoded instructions, if any. Not owned.
+  core::DecodedInstructionCache* instruction_cache_;
 };
 
 // The BlockGraph maintains a list of sections, and each block belongs
@@ -56,6 +56,16 @@ bool ApplyBasicBlockSubGraphTransform(
     BlockGraph* block_graph,
     BlockGraph::Block* block,
     BlockVector* new_blocks) {
+  return ApplyBasicBlockSubGraphTransform(transform, block_graph, block,
+                                          new_blocks, NULL);
+}
+
+bool ApplyBasicBlockSubGraphTransform(
+    BasicBlockSubGraphTransformInterface* transform,
+    BlockGraph* block_graph,
+    BlockGraph::Block* block,
+    BlockVector* new_blocks,
+    BlockBuilder::SuccessorStatistics* successor_statistics) {
   DCHECK(transform != NULL);
   DCHECK(block_graph != NULL);
   DCHECK(block != NULL);
@@ -65,6 +75,7 @@ bool ApplyBasicBlockSubGraphTransform(
   // Decompose block to basic blocks.
   BasicBlockSubGraph subgraph;
   BasicBlockDecomposer bb_decomposer(block, &subgraph);
+  bb_decomposer.set_instruction_cache(block_graph->instruction_cache());
   if (!bb_decomposer.Decompose())
     return false;
 
@@ -82,7 +93,25 @@ bool ApplyBasicBlockSubGraphTransform(
                        builder.new_blocks().end());
   }
 
+  if (successor_statistics != NULL)
+    successor_statistics->Add(builder.successor_statistics());
+
   return true;
 }
 
+void LogSuccessorStatistics(
+    const char* transform_name,
+    const BlockBuilder::SuccessorStatistics& successor_statistics) {
+  DCHECK(transform_name != NULL);
+
+  size_t manifested = successor_statistics.short_successors +
+      successor_statistics.long_successors;
+  LOG(INFO) << transform_name << " laid out "
+            << successor_statistics.elided_successors
+            << " elided and " << manifested << " manifested successors ("
+            << successor_statistics.short_successors << " short, "
+            << successor_statistics.long_successors << " long), saving "
+            << successor_statistics.bytes_saved << " bytes of code.";
+}
+
 }  // namespace block_graph
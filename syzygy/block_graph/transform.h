@@ -18,6 +18,7 @@
 #define SYZYGY_BLOCK_GRAPH_TRANSFORM_H_
 
 #include "syzygy/block_graph/basic_block_subgraph.h"
+#include "syzygy/block_graph/block_builder.h"
 #include "syzygy/block_graph/block_graph.h"
 
 namespace block_graph {
@@ -94,6 +95,32 @@ bool ApplyBasicBlockSubGraphTransform(
     BlockGraph::Block* block,
     BlockVector* new_blocks);
 
+// Applies the provided BasicBlockSubGraphTransform to a single block, as
+// above, and accounts for the successors of the recomposed block.
+//
+// @param transform the transform to apply.
+// @param block_graph the block containing the block to be transformed.
+// @param block the block to be transformed.
+// @param new_blocks On success, any newly created blocks will be returned
+//     here. This may be NULL.
+// @param successor_statistics On success, the statistics on the successors
+//     of the newly created blocks will be added to this. This may be NULL.
+// @pre block must be a code block.
+// @returns true on success, false otherwise.
+bool ApplyBasicBlockSubGraphTransform(
+    BasicBlockSubGraphTransformInterface* transform,
+    BlockGraph* block_graph,
+    BlockGraph::Block* block,
+    BlockVector* new_blocks,
+    BlockBuilder::SuccessorStatistics* successor_statistics);
+
+// Logs the statistics on the successors laid out by a transform.
+// @param transform_name the name of the transform.
+// @param successor_statistics the statistics to log.
+void LogSuccessorStatistics(
+    const char* transform_name,
+    const BlockBuilder::SuccessorStatistics& successor_statistics);
+
 }  // namespace block_graph
 
 #endif  // SYZYGY_BLOCK_GRAPH_TRANSFORM_H_
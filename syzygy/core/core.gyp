@@ -33,6 +33,8 @@
         'address_space_internal.h',
         'assembler.cc',
         'assembler.h',
+        'decoded_instruction_cache.cc',
+        'decoded_instruction_cache.h',
         'disassembler.cc',
         'disassembler.h',
         'disassembler_util.cc',
@@ -76,6 +78,7 @@
         'address_space_unittest.cc',
         'core_unittests_main.cc',
         'assembler_unittest.cc',
+        'decoded_instruction_cache_unittest.cc',
         'disassembler_test_code.asm',
         'disassembler_unittest.cc',
         'disassembler_util_unittest.cc',
@@ -0,0 +1,71 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/core/decoded_instruction_cache.h"
+
+#include "base/logging.h"
+
+namespace core {
+
+DecodedInstructionCache::DecodedInstructionCache()
+    : max_size_(kDefaultMaxSize) {
+}
+
+DecodedInstructionCache::DecodedInstructionCache(size_t max_size)
+    : max_size_(max_size) {
+}
+
+DecodedInstructionCache::~DecodedInstructionCache() {
+}
+
+bool DecodedInstructionCache::Lookup(const uint8* code,
+                                     size_t length,
+                                     _DInst* inst) const {
+  DCHECK(code != NULL);
+  DCHECK(inst != NULL);
+
+  EntryMap::const_iterator it = entries_.find(code);
+  if (it == entries_.end())
+    return false;
+
+  // Decoding an instruction only depends on its own bytes, so the cached
+  // instruction is still valid if they haven't changed.
+  const Entry& entry = it->second;
+  if (entry.inst.size > length ||
+      ::memcmp(entry.bytes, code, entry.inst.size) != 0) {
+    return false;
+  }
+
+  *inst = entry.inst;
+  return true;
+}
+
+void DecodedInstructionCache::Insert(const uint8* code, const _DInst& inst) {
+  DCHECK(code != NULL);
+  DCHECK_LT(0U, inst.size);
+  DCHECK_GE(kMaxInstructionSize, inst.size);
+
+  EntryMap::iterator it = entries_.find(code);
+  if (it == entries_.end()) {
+    if (entries_.size() >= max_size_)
+      return;
+    it = entries_.insert(std::make_pair(code, Entry())).first;
+  }
+
+  Entry& entry = it->second;
+  entry.inst = inst;
+  ::memcpy(entry.bytes, code, inst.size);
+}
+
+}  // namespace core
@@ -0,0 +1,92 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Declares DecodedInstructionCache, which remembers the instructions decoded
+// by a Disassembler so that code that is disassembled several times, e.g. by
+// the PE decomposer and later by the basic-block decomposer, is only decoded
+// once.
+
+#ifndef SYZYGY_CORE_DECODED_INSTRUCTION_CACHE_H_
+#define SYZYGY_CORE_DECODED_INSTRUCTION_CACHE_H_
+
+#include <hash_map>
+
+#include "base/basictypes.h"
+#include "distorm.h"  // NOLINT
+
+namespace core {
+
+// A cache of decoded instructions, keyed by the location of their bytes in
+// memory. The bytes of each instruction are kept with it, so a cached
+// instruction is only returned if the code it was decoded from is unchanged.
+// Instructions are cached independently of their address: the address of an
+// instruction returned by Lookup must be set by the caller. The cache holds at
+// most max_size() instructions; once it is full, further instructions simply
+// aren't cached.
+// @note This class is not thread-safe.
+class DecodedInstructionCache {
+ public:
+  // The longest X86 instruction possible is 15 bytes according to distorm.
+  static const size_t kMaxInstructionSize = 15;
+
+  // The default capacity. Each entry takes a little under 100 bytes, so a
+  // full cache takes on the order of 25MB, which still leaves plenty of room
+  // for the block graph of a large image in a 32-bit process.
+  static const size_t kDefaultMaxSize = 256 * 1024;
+
+  DecodedInstructionCache();
+  // @param max_size the maximum number of instructions to cache.
+  explicit DecodedInstructionCache(size_t max_size);
+  ~DecodedInstructionCache();
+
+  // Looks up the instruction decoded from some code.
+  // @param code the code containing the instruction.
+  // @param length the number of bytes available at @p code.
+  // @param inst receives the cached instruction on success.
+  // @returns true if a matching instruction was found, false otherwise.
+  bool Lookup(const uint8* code, size_t length, _DInst* inst) const;
+
+  // Adds a decoded instruction to the cache, replacing any instruction
+  // previously cached at the same location. The instruction is dropped if
+  // the cache is full.
+  // @param code the code the instruction was decoded from. At least
+  //     inst.size bytes must be available.
+  // @param inst the decoded instruction.
+  void Insert(const uint8* code, const _DInst& inst);
+
+  // Removes all of the cached instructions.
+  void Clear() { entries_.clear(); }
+
+  // @returns the number of cached instructions.
+  size_t size() const { return entries_.size(); }
+
+  // @returns the maximum number of cached instructions.
+  size_t max_size() const { return max_size_; }
+
+ private:
+  struct Entry {
+    _DInst inst;
+    uint8 bytes[kMaxInstructionSize];
+  };
+  typedef stdext::hash_map<const uint8*, Entry> EntryMap;
+
+  const size_t max_size_;
+  EntryMap entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedInstructionCache);
+};
+
+}  // namespace core
+
+#endif  // SYZYGY_CORE_DECODED_INSTRUCTION_CACHE_H_
@@ -0,0 +1,99 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/core/decoded_instruction_cache.h"
+
+#include "base/basictypes.h"
+#include "gtest/gtest.h"
+#include "syzygy/core/disassembler_util.h"
+
+namespace core {
+
+namespace {
+
+// mov eax, 0x12345678; ret
+const uint8 kCode[] = { 0xB8, 0x78, 0x56, 0x34, 0x12, 0xC3 };
+
+}  // namespace
+
+TEST(DecodedInstructionCacheTest, InsertAndLookup) {
+  uint8 code[sizeof(kCode)];
+  ::memcpy(code, kCode, sizeof(kCode));
+
+  _DInst mov = {};
+  ASSERT_TRUE(DecodeOneInstruction(code, sizeof(code), &mov));
+  ASSERT_EQ(5U, mov.size);
+  _DInst ret = {};
+  ASSERT_TRUE(DecodeOneInstruction(code + mov.size, 1, &ret));
+
+  DecodedInstructionCache cache;
+  EXPECT_EQ(0U, cache.size());
+
+  _DInst inst = {};
+  EXPECT_FALSE(cache.Lookup(code, sizeof(code), &inst));
+
+  cache.Insert(code, mov);
+  cache.Insert(code + mov.size, ret);
+  EXPECT_EQ(2U, cache.size());
+
+  ASSERT_TRUE(cache.Lookup(code, sizeof(code), &inst));
+  EXPECT_EQ(mov.opcode, inst.opcode);
+  EXPECT_EQ(mov.size, inst.size);
+  EXPECT_EQ(mov.imm.dword, inst.imm.dword);
+  ASSERT_TRUE(cache.Lookup(code + mov.size, 1, &inst));
+  EXPECT_EQ(ret.opcode, inst.opcode);
+
+  // Instructions don't match if they don't fit in the code.
+  EXPECT_FALSE(cache.Lookup(code, mov.size - 1, &inst));
+
+  // Instructions don't match once their bytes have changed.
+  code[1] = 0x00;
+  EXPECT_FALSE(cache.Lookup(code, sizeof(code), &inst));
+  EXPECT_TRUE(cache.Lookup(code + mov.size, 1, &inst));
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_FALSE(cache.Lookup(code + mov.size, 1, &inst));
+}
+
+TEST(DecodedInstructionCacheTest, InsertStopsWhenFull) {
+  uint8 code[sizeof(kCode)];
+  ::memcpy(code, kCode, sizeof(kCode));
+
+  _DInst mov = {};
+  ASSERT_TRUE(DecodeOneInstruction(code, sizeof(code), &mov));
+  _DInst ret = {};
+  ASSERT_TRUE(DecodeOneInstruction(code + mov.size, 1, &ret));
+
+  DecodedInstructionCache cache(1);
+  EXPECT_EQ(1U, cache.max_size());
+
+  cache.Insert(code, mov);
+  cache.Insert(code + mov.size, ret);
+  EXPECT_EQ(1U, cache.size());
+
+  _DInst inst = {};
+  EXPECT_TRUE(cache.Lookup(code, sizeof(code), &inst));
+  EXPECT_FALSE(cache.Lookup(code + mov.size, 1, &inst));
+
+  // Instructions already in a full cache can still be replaced.
+  code[1] = 0x00;
+  ASSERT_TRUE(DecodeOneInstruction(code, sizeof(code), &mov));
+  cache.Insert(code, mov);
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_TRUE(cache.Lookup(code, sizeof(code), &inst));
+  EXPECT_EQ(0x12345600U, inst.imm.dword);
+}
+
+}  // namespace core
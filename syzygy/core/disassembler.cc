@@ -15,6 +15,8 @@
 // Implementation of disassembler.
 #include "syzygy/core/disassembler.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/stringprintf.h"
 
@@ -28,7 +30,11 @@ Disassembler::Disassembler(const uint8* code,
       code_size_(code_size),
       code_addr_(code_addr),
       on_instruction_(on_instruction),
-      disassembled_bytes_(0) {
+      visited_(code_size, 0),
+      disassembled_bytes_(0),
+      instruction_cache_(NULL),
+      batch_size_(0),
+      batch_next_(0) {
 }
 
 Disassembler::Disassembler(const uint8* code,
@@ -40,7 +46,11 @@ Disassembler::Disassembler(const uint8* code,
       code_size_(code_size),
       code_addr_(code_addr),
       on_instruction_(on_instruction),
-      disassembled_bytes_(0) {
+      visited_(code_size, 0),
+      disassembled_bytes_(0),
+      instruction_cache_(NULL),
+      batch_size_(0),
+      batch_next_(0) {
 
   AddressSet::const_iterator it = entry_points.begin();
   for (; it != entry_points.end(); ++it)
@@ -75,11 +85,6 @@ Disassembler::CallbackDirective Disassembler::OnDisassemblyComplete() {
 }
 
 Disassembler::WalkResult Disassembler::Walk() {
-  // Initialize our disassembly state.
-  _CodeInfo code = {};
-  code.dt = Decode32Bits;
-  code.features = DF_NONE;
-
   // This is to keep track of whether we cover the entire function.
   bool incomplete_branches = false;
 
@@ -97,6 +102,11 @@ Disassembler::WalkResult Disassembler::Walk() {
     if (OnStartInstructionRun(addr) == kDirectiveAbort)
       return kWalkError;
 
+    // The instructions decoded ahead along the previous run don't apply to
+    // this one.
+    batch_size_ = 0;
+    batch_next_ = 0;
+
     // This continues disassembly along a contiguous instruction run until we
     // run out of code, jump somewhere else, or are requested to terminate the
     // path by the OnInstruction callback. We call notification methods to
@@ -106,43 +116,35 @@ Disassembler::WalkResult Disassembler::Walk() {
     ControlFlowFlag control_flow = kControlFlowTerminates;
     _DInst inst = {};
     for (; addr != AbsoluteAddress(0) && !terminate; addr += inst.size) {
-      code.codeOffset = addr.value();
-      code.codeLen = code_size_ - (addr - code_addr_);
-      code.code = code_ + (addr - code_addr_);
-      if (code.codeLen == 0)
+      size_t code_offset = addr - code_addr_;
+      if (code_offset == code_size_)
         break;
 
       bool conditional_branch_handled = false;
 
-      unsigned int decoded = 0;
-      _DecodeResult result = distorm_decompose(&code, &inst, 1, &decoded);
-
-      if (decoded == 0) {
+      if (!DecodeInstruction(addr, &inst)) {
         LOG(ERROR) << "Unable to decode instruction at " << addr << ".";
 
         // Dump the next few bytes. The longest X86 instruction possible is 15
         // bytes according to distorm.
-        int max_bytes = code.codeLen;
-        if (max_bytes > 15)
-          max_bytes = 15;
+        size_t max_bytes = code_size_ - code_offset;
+        if (max_bytes > DecodedInstructionCache::kMaxInstructionSize)
+          max_bytes = DecodedInstructionCache::kMaxInstructionSize;
         std::string dump;
-        for (int i = 0; i < max_bytes; ++i) {
-          dump += base::StringPrintf(" 0x%02X", code.code[i]);
+        for (size_t i = 0; i < max_bytes; ++i) {
+          dump += base::StringPrintf(" 0x%02X", code_[code_offset + i]);
         }
         LOG(ERROR) << ".text =" << dump
-                   << (max_bytes < code.codeLen ? " ..." : ".");
+                   << (max_bytes < code_size_ - code_offset ? " ..." : ".");
         return kWalkError;
       }
 
-      CHECK_EQ(1U, decoded);
-      CHECK(result == DECRES_MEMORYERR || result == DECRES_SUCCESS);
-
       // Try to visit this instruction.
-      VisitedSpace::Range range(addr, inst.size);
-      if (!visited_.Insert(range, 0)) {
+      VisitResult visit = Visit(addr, inst.size);
+      if (visit != kVisitNew) {
         // If the collision is a repeat of a previously disassembled
         // instruction at a different offset then something went wrong.
-        if (!visited_.ContainsExactly(range)) {
+        if (visit == kVisitOverlap) {
           LOG(ERROR) << "Two disassembled instructions overlap.";
           return kWalkError;
         }
@@ -284,12 +286,23 @@ Disassembler::WalkResult Disassembler::Walk() {
 bool Disassembler::Unvisited(AbsoluteAddress addr) {
   DCHECK(IsInBlock(addr));
 
-  if (visited_.Intersects(addr))
+  if (IsVisited(addr))
     return false;
 
   return unvisited_.insert(addr).second;
 }
 
+bool Disassembler::IsVisited(AbsoluteAddress addr) const {
+  DCHECK(IsInBlock(addr));
+  return visited_[addr - code_addr_] != 0;
+}
+
+size_t Disassembler::GetVisitedInstructionSize(AbsoluteAddress addr) const {
+  DCHECK(IsInBlock(addr));
+  uint8 state = visited_[addr - code_addr_];
+  return state == kVisitedInstructionBody ? 0 : state;
+}
+
 Disassembler::CallbackDirective Disassembler::NotifyOnInstruction(
     AbsoluteAddress addr, const _DInst& inst) {
   // Invoke our local callback.
@@ -307,4 +320,80 @@ bool Disassembler::IsInBlock(AbsoluteAddress addr) const {
       static_cast<size_t>(addr - code_addr_) + 1 <= code_size_;
 }
 
+bool Disassembler::DecodeInstruction(AbsoluteAddress addr, _DInst* inst) {
+  DCHECK(IsInBlock(addr));
+  DCHECK(inst != NULL);
+
+  size_t code_offset = addr - code_addr_;
+  const uint8* code = code_ + code_offset;
+  size_t code_length = code_size_ - code_offset;
+
+  if (instruction_cache_ != NULL &&
+      instruction_cache_->Lookup(code, code_length, inst)) {
+    inst->addr = addr.value();
+
+    // Keep the batch in step with the run.
+    if (batch_next_ < batch_size_) {
+      DCHECK_EQ(addr.value(), batch_[batch_next_].addr);
+      ++batch_next_;
+    }
+    return true;
+  }
+
+  // Decode the following instructions in a single call to distorm. Most of
+  // them are usually consumed, as runs of instructions only end at control
+  // flow instructions.
+  if (batch_next_ == batch_size_) {
+    _CodeInfo code_info = {};
+    code_info.dt = Decode32Bits;
+    code_info.features = DF_NONE;
+    code_info.codeOffset = addr.value();
+    code_info.codeLen = code_length;
+    code_info.code = code;
+
+    batch_size_ = 0;
+    batch_next_ = 0;
+    _DecodeResult result = distorm_decompose(
+        &code_info, batch_, kDecodeBatchSize, &batch_size_);
+    if (batch_size_ == 0)
+      return false;
+
+    CHECK(result == DECRES_MEMORYERR || result == DECRES_SUCCESS);
+  }
+
+  *inst = batch_[batch_next_++];
+  DCHECK_EQ(addr.value(), inst->addr);
+
+  if (instruction_cache_ != NULL)
+    instruction_cache_->Insert(code, *inst);
+
+  return true;
+}
+
+Disassembler::VisitResult Disassembler::Visit(AbsoluteAddress addr,
+                                              size_t size) {
+  DCHECK(IsInBlock(addr));
+  DCHECK_LT(0U, size);
+  DCHECK_GT(kVisitedInstructionBody, size);
+
+  size_t begin = addr - code_addr_;
+  size_t end = std::min(begin + size, code_size_);
+  if (visited_[begin] != 0) {
+    // Decoding the same bytes always yields the same instruction, so this is
+    // a repeat if an instruction was already visited at this address.
+    return visited_[begin] == size ? kVisitRepeat : kVisitOverlap;
+  }
+
+  for (size_t i = begin + 1; i < end; ++i) {
+    if (visited_[i] != 0)
+      return kVisitOverlap;
+  }
+
+  visited_[begin] = static_cast<uint8>(size);
+  for (size_t i = begin + 1; i < end; ++i)
+    visited_[i] = kVisitedInstructionBody;
+
+  return kVisitNew;
+}
+
 }  // namespace core
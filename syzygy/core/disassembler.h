@@ -17,10 +17,11 @@
 #define SYZYGY_CORE_DISASSEMBLER_H_
 
 #include <set>
+#include <vector>
 #include "base/basictypes.h"
 #include "base/callback.h"
 #include "syzygy/core/address.h"
-#include "syzygy/core/address_space.h"
+#include "syzygy/core/decoded_instruction_cache.h"
 #include "distorm.h"  // NOLINT
 
 namespace core {
@@ -28,7 +29,6 @@ namespace core {
 class Disassembler {
  public:
   typedef std::set<AbsoluteAddress> AddressSet;
-  typedef core::AddressSpace<AbsoluteAddress, size_t, uint8> VisitedSpace;
 
   enum CallbackDirective {
     // Indicates that the disassembler should continue.
@@ -105,13 +105,33 @@ class Disassembler {
   //    disassembler follows the code's control flow.
   virtual WalkResult Walk();
 
+  // @returns true iff the byte at @p addr belongs to a visited instruction.
+  // @pre IsInBlock(addr).
+  bool IsVisited(AbsoluteAddress addr) const;
+
+  // @returns the size of the visited instruction starting at @p addr, or zero
+  //     if no visited instruction starts there.
+  // @pre IsInBlock(addr).
+  size_t GetVisitedInstructionSize(AbsoluteAddress addr) const;
+
+  // Sets the cache used to look up the instructions before decoding them, and
+  // where the decoded instructions are stored. This may be shared by several
+  // disassemblers. The cache must outlive the walk.
+  // @param instruction_cache the cache to use, or NULL to decode every
+  //     instruction.
+  void set_instruction_cache(DecodedInstructionCache* instruction_cache) {
+    instruction_cache_ = instruction_cache;
+  }
+
   // @name Accessors.
   // @{
   const uint8* code() const { return code_; }
   size_t code_size() const { return code_size_; }
   const AbsoluteAddress code_addr() const { return code_addr_; }
   const AddressSet& unvisited() const { return unvisited_; }
-  const VisitedSpace& visited() const { return visited_; }
+  DecodedInstructionCache* instruction_cache() const {
+    return instruction_cache_;
+  }
   size_t disassembled_bytes() const { return disassembled_bytes_; }
   // @}
 
@@ -164,6 +184,29 @@ class Disassembler {
   // @return true iff the range [addr ... addr + len) is in the function.
   bool IsInBlock(AbsoluteAddress addr) const;
 
+  // Decodes the instruction at @p addr, which must follow the previously
+  // decoded instruction unless the batch was reset. The instruction comes
+  // from the instruction cache if possible, otherwise from the batch of
+  // instructions decoded ahead along the current run.
+  // @param addr the address of the instruction.
+  // @param inst receives the decoded instruction.
+  // @returns true on success, false if no instruction could be decoded.
+  bool DecodeInstruction(AbsoluteAddress addr, _DInst* inst);
+
+  // The results of Visit.
+  enum VisitResult {
+    // The instruction was newly visited.
+    kVisitNew,
+    // The instruction had already been visited.
+    kVisitRepeat,
+    // The instruction overlaps a different visited instruction.
+    kVisitOverlap,
+  };
+
+  // Marks the instruction [addr ... addr + size) as visited.
+  // @returns the result of the visit.
+  VisitResult Visit(AbsoluteAddress addr, size_t size);
+
   // The code we refer to.
   const uint8* code_;
   const size_t code_size_;
@@ -178,8 +221,21 @@ class Disassembler {
   // This is seeded by the code entry point(s), and will also contain
   // branch targets during disassembly.
   AddressSet unvisited_;
-  // Each visited instruction is stored as a range in this space.
-  VisitedSpace visited_;
+  // The visited state of each byte of code_. The first byte of a visited
+  // instruction holds its size, the other ones hold kVisitedInstructionBody
+  // and unvisited bytes are zero.
+  static const uint8 kVisitedInstructionBody = 0xFF;
+  std::vector<uint8> visited_;
+
+  // The optional cache of decoded instructions.
+  DecodedInstructionCache* instruction_cache_;
+
+  // The instructions decoded ahead along the current instruction run. Those
+  // in [batch_next_, batch_size_) have yet to be consumed.
+  static const size_t kDecodeBatchSize = 16;
+  _DInst batch_[kDecodeBatchSize];
+  unsigned int batch_size_;
+  unsigned int batch_next_;
 
   // Number of bytes disassembled to this point during walk.
   size_t disassembled_bytes_;
@@ -81,6 +81,15 @@ class DisassemblerTest: public testing::Test {
     return reinterpret_cast<const uint8*>(ptr);
   }
 
+  static size_t CountVisitedInstructions(const Disassembler& disasm) {
+    size_t count = 0;
+    for (size_t i = 0; i < disasm.code_size(); ++i) {
+      if (disasm.GetVisitedInstructionSize(disasm.code_addr() + i) != 0)
+        ++count;
+    }
+    return count;
+  }
+
   Disassembler::CallbackDirective RecordFunctionEncounter(
       const Disassembler& disasm, const _DInst& inst) {
     switch (META_GET_FC(inst.meta)) {
@@ -161,6 +170,70 @@ TEST_F(DisassemblerTest, DisassembleFull) {
       disasm.disassembled_bytes());
 }
 
+TEST_F(DisassemblerTest, VisitedInstructions) {
+  Disassembler disasm(PointerTo(&assembly_func),
+                      PointerTo(&assembly_func_end) - PointerTo(&assembly_func),
+                      AddressOf(&assembly_func),
+                      on_instruction_);
+  ASSERT_TRUE(disasm.Unvisited(AddressOf(&assembly_func)));
+
+  EXPECT_CALL(*this, OnInstruction(_, _)).
+      WillRepeatedly(Return(Disassembler::kDirectiveContinue));
+
+  ASSERT_EQ(Disassembler::kWalkSuccess, disasm.Walk());
+
+  // The first instruction was visited, and its bytes aren't the start of
+  // another instruction.
+  AbsoluteAddress first_inst = AddressOf(&assembly_func);
+  size_t first_inst_size = disasm.GetVisitedInstructionSize(first_inst);
+  ASSERT_LT(0U, first_inst_size);
+  for (size_t i = 0; i < first_inst_size; ++i) {
+    EXPECT_TRUE(disasm.IsVisited(first_inst + i));
+    if (i != 0)
+      EXPECT_EQ(0U, disasm.GetVisitedInstructionSize(first_inst + i));
+  }
+
+  // The visited addresses can't be visited anew.
+  EXPECT_FALSE(disasm.Unvisited(first_inst));
+
+  // The internal label isn't reachable from the entry point.
+  EXPECT_FALSE(disasm.IsVisited(AddressOf(&internal_label)));
+  EXPECT_EQ(6U, CountVisitedInstructions(disasm));
+}
+
+TEST_F(DisassemblerTest, InstructionCache) {
+  DecodedInstructionCache instruction_cache;
+  std::vector<AbsoluteAddress> uncached_functions;
+
+  for (size_t i = 0; i < 2; ++i) {
+    Disassembler disasm(
+        PointerTo(&assembly_func),
+        PointerTo(&assembly_func_end) - PointerTo(&assembly_func),
+        AddressOf(&assembly_func),
+        on_instruction_);
+    disasm.set_instruction_cache(&instruction_cache);
+    ASSERT_TRUE(disasm.Unvisited(AddressOf(&assembly_func)));
+    ASSERT_TRUE(disasm.Unvisited(AddressOf(&internal_label)));
+
+    EXPECT_CALL(*this, OnInstruction(_, _)).Times(7).
+        WillRepeatedly(Invoke(this,
+                              &DisassemblerTest::RecordFunctionEncounter));
+
+    ASSERT_EQ(Disassembler::kWalkSuccess, disasm.Walk());
+    ASSERT_EQ(PointerTo(&assembly_func_end) - PointerTo(&assembly_func),
+              disasm.disassembled_bytes());
+
+    // The first walk fills the cache, the second one must find the same
+    // instructions at the same addresses in it.
+    EXPECT_EQ(7U, instruction_cache.size());
+    if (i == 0) {
+      uncached_functions.swap(functions_);
+    } else {
+      EXPECT_THAT(functions_, testing::ContainerEq(uncached_functions));
+    }
+  }
+}
+
 TEST_F(DisassemblerTest, EncounterFunctions) {
   Disassembler disasm(PointerTo(&assembly_func),
                       PointerTo(&assembly_func_end) - PointerTo(&assembly_func),
@@ -207,11 +280,10 @@ TEST_F(DisassemblerTest, RunOverDataWhenNoTerminatePathGiven) {
   ASSERT_EQ(Disassembler::kWalkTerminated, disasm.Walk());
 
   // We expect there to be 3 visited instructions
-  ASSERT_EQ(3, disasm.visited().ranges().size());
+  ASSERT_EQ(3, CountVisitedInstructions(disasm));
 
   // We expect the disassembly to have walked past the start of the data
-  ASSERT_TRUE(disasm.visited().ranges().rbegin()->first.Intersects(
-      AddressOf(&jump_table)));
+  ASSERT_TRUE(disasm.IsVisited(AddressOf(&jump_table)));
 }
 
 TEST_F(DisassemblerTest, StopsAtTerminateNoReturnFunctionCall) {
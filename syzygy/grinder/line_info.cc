@@ -23,6 +23,11 @@
 #include "base/win/scoped_comptr.h"
 #include "sawbuck/common/com_utils.h"
 #include "syzygy/core/address_space.h"
+#include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_dbi_stream.h"
+#include "syzygy/pdb/pdb_module_streams.h"
+#include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/pdb_util.h"
 
 namespace grinder {
 
@@ -120,6 +125,40 @@ const std::string* GetSourceFileName(DWORD source_file_id,
   return source_file_name;
 }
 
+// Reads the section headers of the image of a PDB. These are the headers of
+// the original image if the image has been transformed.
+bool ReadSectionHeaders(const pdb::PdbFile& pdb_file,
+                        const pdb::DbiDbgHeader& dbg_header,
+                        std::vector<IMAGE_SECTION_HEADER>* section_headers) {
+  DCHECK(section_headers != NULL);
+
+  int16 stream_index = dbg_header.section_header_origin;
+  if (stream_index < 0)
+    stream_index = dbg_header.section_header;
+
+  scoped_refptr<pdb::PdbStream> stream;
+  if (stream_index >= 0 &&
+      static_cast<size_t>(stream_index) < pdb_file.StreamCount()) {
+    stream = pdb_file.GetStream(stream_index);
+  }
+  if (stream.get() == NULL ||
+      stream->length() % sizeof(IMAGE_SECTION_HEADER) != 0 ||
+      !stream->Seek(0) ||
+      !stream->Read(section_headers,
+                    stream->length() / sizeof(IMAGE_SECTION_HEADER))) {
+    LOG(ERROR) << "Unable to read the section headers.";
+    return false;
+  }
+
+  return true;
+}
+
+// Used for sorting source lines by address.
+bool SourceLineAddressLess(const LineInfo::SourceLine& sl1,
+                           const LineInfo::SourceLine& sl2) {
+  return sl1.address < sl2.address;
+}
+
 // Used for comparing the ranges covered by two source lines.
 struct SourceLineAddressComparator {
   bool operator()(const LineInfo::SourceLine& sl1,
@@ -131,6 +170,89 @@ struct SourceLineAddressComparator {
 }  // namespace
 
 bool LineInfo::Init(const FilePath& pdb_path) {
+  pdb::PdbReader reader;
+  pdb::PdbFile pdb_file;
+  if (!reader.Read(pdb_path, &pdb_file)) {
+    LOG(ERROR) << "Unable to read PDB file \"" << pdb_path.value() << "\".";
+    return false;
+  }
+
+  scoped_refptr<pdb::PdbStream> dbi_stream_reader;
+  if (pdb::kDbiStream < pdb_file.StreamCount())
+    dbi_stream_reader = pdb_file.GetStream(pdb::kDbiStream);
+  pdb::DbiStream dbi_stream;
+  if (dbi_stream_reader.get() == NULL ||
+      !dbi_stream.Read(dbi_stream_reader.get())) {
+    LOG(ERROR) << "Unable to read the Dbi stream.";
+    return false;
+  }
+
+  pdb::OffsetStringMap name_table;
+  std::vector<IMAGE_SECTION_HEADER> section_headers;
+  if (!pdb::ReadNameTable(pdb_file, &name_table) ||
+      !ReadSectionHeaders(pdb_file, dbi_stream.dbg_header(),
+                          &section_headers)) {
+    return false;
+  }
+
+  pdb::ModuleStreamContentsVector modules;
+  if (!pdb::ReadModuleStreams(pdb_file, dbi_stream, pdb::kModuleStreamLines,
+                              &modules)) {
+    return false;
+  }
+
+  // Convert the lines of all modules to source lines. Their file names are
+  // looked up through a cache as successive lines mostly share a file.
+  std::map<uint32, const std::string*> source_file_map;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    const pdb::ModuleLineVector& lines = modules[i].lines();
+    for (size_t j = 0; j < lines.size(); ++j) {
+      const pdb::ModuleLine& line = lines[j];
+
+      // Lines outside of the sections of the image have no address.
+      if (line.section == 0 || line.section > section_headers.size())
+        continue;
+
+      const std::string*& source_file_name =
+          source_file_map[line.file_name_offset];
+      if (source_file_name == NULL) {
+        pdb::OffsetStringMap::const_iterator name_it =
+            name_table.find(line.file_name_offset);
+        if (name_it == name_table.end()) {
+          LOG(ERROR) << "Line refers to a source file that is not in the name "
+                     << "table.";
+          return false;
+        }
+        source_file_name = &(*source_files_.insert(name_it->second).first);
+      }
+
+      uint32 rva = section_headers[line.section - 1].VirtualAddress +
+          line.offset;
+      source_lines_.push_back(SourceLine(source_file_name,
+                                         line.line_number,
+                                         core::RelativeAddress(rva),
+                                         line.size));
+    }
+  }
+
+  // Sort the lines by address, keeping the lines of a module in the order in
+  // which they are stored in the PDB.
+  std::stable_sort(source_lines_.begin(), source_lines_.end(),
+                   SourceLineAddressLess);
+
+  // Give zero-length lines the length of the next line with the same address,
+  // as is done in InitWithDia.
+  for (size_t i = source_lines_.size(); i > 1; --i) {
+    SourceLine& line = source_lines_[i - 2];
+    const SourceLine& next_line = source_lines_[i - 1];
+    if (line.size == 0 && line.address == next_line.address)
+      line.size = next_line.size;
+  }
+
+  return true;
+}
+
+bool LineInfo::InitWithDia(const FilePath& pdb_path) {
   ScopedComPtr<IDiaDataSource> source;
   HRESULT hr = source.CreateInstance(CLSID_DiaSource);
   if (FAILED(hr)) {
@@ -44,10 +44,18 @@ class LineInfo {
   typedef std::vector<SourceLine> SourceLines;
 
   // Initializes this LineInfo object with data read from the provided PDB.
+  // The line information of the modules is read directly from the PDB, in
+  // parallel.
   // @param pdb_path the PDB whose line information is to be read.
   // @returns true on success, false otherwise.
   bool Init(const FilePath& pdb_path);
 
+  // Initializes this LineInfo object with data read from the provided PDB
+  // through DIA. This is slower than Init, and produces the same results.
+  // @param pdb_path the PDB whose line information is to be read.
+  // @returns true on success, false otherwise.
+  bool InitWithDia(const FilePath& pdb_path);
+
   // Visits the given address range. A partial visit of the code associated
   // with a line is considered as a visit of that line.
   // @param address the starting address of the address range.
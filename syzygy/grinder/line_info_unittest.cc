@@ -116,6 +116,48 @@ TEST_F(LineInfoTest, InitStaticPdb) {
   EXPECT_EQ(8379u, line_info.source_lines().size());
 }
 
+TEST_F(LineInfoTest, InitWithDiaStaticPdb) {
+  TestLineInfo line_info;
+  EXPECT_TRUE(line_info.InitWithDia(static_pdb_path_));
+  EXPECT_EQ(138u, line_info.source_files().size());
+  EXPECT_EQ(8379u, line_info.source_lines().size());
+}
+
+TEST_F(LineInfoTest, InitMatchesInitWithDia) {
+  TestLineInfo line_info;
+  TestLineInfo dia_line_info;
+  ASSERT_TRUE(line_info.Init(static_pdb_path_));
+  ASSERT_TRUE(dia_line_info.InitWithDia(static_pdb_path_));
+
+  EXPECT_THAT(line_info.source_files(),
+              ::testing::ContainerEq(dia_line_info.source_files()));
+  ASSERT_EQ(dia_line_info.source_lines().size(),
+            line_info.source_lines().size());
+
+  // Lines sharing an address may be enumerated in a different order, so the
+  // lines are compared as sorted sets.
+  typedef std::pair<std::pair<uint32, size_t>,
+                    std::pair<size_t, std::string> > LineKey;
+  std::vector<LineKey> lines;
+  std::vector<LineKey> dia_lines;
+  for (size_t i = 0; i < line_info.source_lines().size(); ++i) {
+    const LineInfo::SourceLine& line = line_info.source_lines()[i];
+    const LineInfo::SourceLine& dia_line = dia_line_info.source_lines()[i];
+    lines.push_back(std::make_pair(
+        std::make_pair(line.address.value(), line.size),
+        std::make_pair(line.line_number, *line.source_file_name)));
+    dia_lines.push_back(std::make_pair(
+        std::make_pair(dia_line.address.value(), dia_line.size),
+        std::make_pair(dia_line.line_number, *dia_line.source_file_name)));
+
+    // The lines are sorted by address in both cases.
+    EXPECT_EQ(dia_line.address, line.address);
+  }
+  std::sort(lines.begin(), lines.end());
+  std::sort(dia_lines.begin(), dia_lines.end());
+  EXPECT_THAT(lines, ::testing::ContainerEq(dia_lines));
+}
+
 TEST_F(LineInfoTest, Visit) {
   TestLineInfo line_info;
 
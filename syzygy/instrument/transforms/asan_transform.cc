@@ -359,14 +359,18 @@ bool AsanTransform::OnBlock(BlockGraph* block_graph,
     return true;
 
   AsanBasicBlockTransform transform(&hook_asan_check_access_);
-  if (!ApplyBasicBlockSubGraphTransform(&transform, block_graph, block, NULL))
+  if (!ApplyBasicBlockSubGraphTransform(&transform, block_graph, block, NULL,
+                                        &successor_statistics_)) {
     return false;
+  }
 
   return true;
 }
 
 bool AsanTransform::PostBlockGraphIteration(BlockGraph* block_graph,
                                             BlockGraph::Block* header_block) {
+  block_graph::LogSuccessorStatistics(kTransformName, successor_statistics_);
+
   // This function redirects a the heap-related kernel32 imports to point to
   // a set of "override" imports in the ASAN runtime.
 
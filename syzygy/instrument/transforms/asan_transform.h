@@ -22,6 +22,7 @@
 #include <utility>
 
 #include "base/string_piece.h"
+#include "syzygy/block_graph/block_builder.h"
 #include "syzygy/block_graph/iterate.h"
 #include "syzygy/block_graph/transforms/iterative_transform.h"
 #include "syzygy/block_graph/transforms/named_transform.h"
@@ -89,6 +90,10 @@ class AsanTransform
   const char* instrument_dll_name() const {
     return asan_dll_name_.c_str();
   }
+  const block_graph::BlockBuilder::SuccessorStatistics&
+      successor_statistics() const {
+    return successor_statistics_;
+  }
   // @}
 
   // The names of the imports for the Asan hooks.
@@ -108,6 +113,9 @@ class AsanTransform
   // PreBlockGraphIteration.
   BlockGraph::Reference hook_asan_check_access_;
 
+  // The statistics on the successors of the instrumented blocks.
+  block_graph::BlockBuilder::SuccessorStatistics successor_statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(AsanTransform);
 };
 
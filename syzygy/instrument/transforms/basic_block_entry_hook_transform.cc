@@ -140,8 +140,10 @@ bool BasicBlockEntryHookTransform::OnBlock(BlockGraph* block_graph,
     return true;
   }
 
-  if (!ApplyBasicBlockSubGraphTransform(this, block_graph, block, NULL))
+  if (!ApplyBasicBlockSubGraphTransform(this, block_graph, block, NULL,
+                                        &successor_statistics_)) {
     return false;
+  }
 
   return true;
 }
@@ -200,6 +202,8 @@ bool BasicBlockEntryHookTransform::PostBlockGraphIteration(
   DCHECK(block_graph != NULL);
   DCHECK(header_block != NULL);
 
+  block_graph::LogSuccessorStatistics(kTransformName, successor_statistics_);
+
   size_t num_basic_blocks = bb_ranges_.size();
   if (num_basic_blocks == 0) {
     LOG(WARNING) << "Encountered no basic code blocks during instrumentation.";
@@ -22,6 +22,7 @@
 
 #include "base/string_piece.h"
 #include "syzygy/block_graph/basic_block_assembler.h"
+#include "syzygy/block_graph/block_builder.h"
 #include "syzygy/block_graph/iterate.h"
 #include "syzygy/block_graph/transforms/iterative_transform.h"
 #include "syzygy/block_graph/transforms/named_transform.h"
@@ -58,6 +59,12 @@ class BasicBlockEntryHookTransform
   //    as its unique ID.
   const RelativeAddressRangeVector& bb_ranges() const { return bb_ranges_; }
 
+  // @returns the statistics on the successors of the instrumented blocks.
+  const block_graph::BlockBuilder::SuccessorStatistics&
+      successor_statistics() const {
+    return successor_statistics_;
+  }
+
   // Overrides the default instrument dll name used by this transform.
   void set_instrument_dll_name(const base::StringPiece& value) {
     DCHECK(!value.empty());
@@ -97,6 +104,9 @@ class BasicBlockEntryHookTransform
   // Stores the RVAs in the original image for each instrumented basic block.
   RelativeAddressRangeVector bb_ranges_;
 
+  // The statistics on the successors of the instrumented blocks.
+  block_graph::BlockBuilder::SuccessorStatistics successor_statistics_;
+
   // The entry hook to which basic-block entry events are directed.
   BlockGraph::Reference bb_entry_hook_ref_;
 
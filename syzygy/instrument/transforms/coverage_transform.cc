@@ -146,7 +146,8 @@ bool CoverageInstrumentationTransform::OnBlock(
     return true;
 
   // Apply our basic block transform.
-  if (!ApplyBasicBlockSubGraphTransform(this, block_graph, block, NULL)) {
+  if (!ApplyBasicBlockSubGraphTransform(this, block_graph, block, NULL,
+                                        &successor_statistics_)) {
     return false;
   }
 
@@ -158,6 +159,8 @@ bool CoverageInstrumentationTransform::PostBlockGraphIteration(
   DCHECK(block_graph != NULL);
   DCHECK(header_block != NULL);
 
+  block_graph::LogSuccessorStatistics(kTransformName, successor_statistics_);
+
   // Get a reference to the frequency data and make that the parameter that
   // we pass to the entry thunks. We run the thunk transform after the coverage
   // instrumentation transform as it creates new code blocks that we don't
@@ -25,6 +25,7 @@
 
 #include <vector>
 
+#include "syzygy/block_graph/block_builder.h"
 #include "syzygy/block_graph/transforms/iterative_transform.h"
 #include "syzygy/core/address_space.h"
 #include "syzygy/instrument/transforms/add_basic_block_frequency_data_transform.h"
@@ -65,6 +66,12 @@ class CoverageInstrumentationTransform
   //      as its unique ID.
   const RelativeAddressRangeVector& bb_ranges() const { return bb_ranges_; }
 
+  // @returns the statistics on the successors of the instrumented blocks.
+  const block_graph::BlockBuilder::SuccessorStatistics&
+      successor_statistics() const {
+    return successor_statistics_;
+  }
+
   // @}
 
   // @name Pass-throughs to EntryThunkTransform.
@@ -122,6 +129,9 @@ class CoverageInstrumentationTransform
   // Stores the RVAs in the original image for each instrumented basic block.
   RelativeAddressRangeVector bb_ranges_;
 
+  // The statistics on the successors of the instrumented blocks.
+  block_graph::BlockBuilder::SuccessorStatistics successor_statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(CoverageInstrumentationTransform);
 };
 
@@ -43,13 +43,25 @@
         'pdb_file.h',
         'pdb_file_stream.cc',
         'pdb_file_stream.h',
+        'pdb_mapped_file_stream.cc',
+        'pdb_mapped_file_stream.h',
+        'pdb_module_lines.cc',
+        'pdb_module_lines.h',
+        'pdb_module_streams.cc',
+        'pdb_module_streams.h',
         'pdb_mutator.h',
+        'pdb_parallel_jobs.cc',
+        'pdb_parallel_jobs.h',
         'pdb_reader.cc',
         'pdb_reader.h',
         'pdb_stream.cc',
         'pdb_stream.h',
+        'pdb_symbol_index.cc',
+        'pdb_symbol_index.h',
         'pdb_symbol_record.cc',
         'pdb_symbol_record.h',
+        'pdb_type_info_index.cc',
+        'pdb_type_info_index.h',
         'pdb_type_info_stream.cc',
         'pdb_type_info_stream.h',
         'pdb_util.cc',
@@ -85,9 +97,15 @@
         'pdb_dbi_stream_unittest.cc',
         'pdb_file_stream_unittest.cc',
         'pdb_file_unittest.cc',
+        'pdb_mapped_file_stream_unittest.cc',
+        'pdb_module_lines_unittest.cc',
+        'pdb_module_streams_unittest.cc',
+        'pdb_parallel_jobs_unittest.cc',
         'pdb_reader_unittest.cc',
         'pdb_stream_unittest.cc',
+        'pdb_symbol_index_unittest.cc',
         'pdb_symbol_record_unittest.cc',
+        'pdb_type_info_index_unittest.cc',
         'pdb_type_info_stream_unittest.cc',
         'pdb_util_unittest.cc',
         'pdb_unittests_main.cc',
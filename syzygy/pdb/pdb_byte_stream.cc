@@ -65,6 +65,13 @@ bool PdbByteStream::Init(PdbStream* stream) {
   if (data_.size() == 0)
     return true;
 
+  // Copy the stream in one go if it's available in memory.
+  const uint8* stream_data = stream->GetContiguousData();
+  if (stream_data != NULL) {
+    memcpy(data(), stream_data, length());
+    return true;
+  }
+
   // Read the file stream.
   if (!stream->Seek(0)) {
     LOG(ERROR) << "Failed to seek in pdb stream.";
@@ -108,6 +115,12 @@ scoped_refptr<WritablePdbStream> PdbByteStream::GetWritablePdbStream() {
   return scoped_refptr<WritablePdbStream>(writable_pdb_stream_);
 }
 
+const uint8* PdbByteStream::GetContiguousData() const {
+  if (data_.empty())
+    return NULL;
+  return &data_[0];
+}
+
 WritablePdbByteStream::WritablePdbByteStream(PdbByteStream* pdb_byte_stream) {
   DCHECK(pdb_byte_stream != NULL);
   pdb_byte_stream_ = pdb_byte_stream;
@@ -38,6 +38,8 @@ class PdbByteStream : public PdbStream {
   // @{
   virtual bool ReadBytes(void* dest, size_t count, size_t* bytes_read) OVERRIDE;
   virtual scoped_refptr<WritablePdbStream> GetWritablePdbStream() OVERRIDE;
+  virtual const uint8* GetContiguousData() const OVERRIDE;
+  virtual bool CanReadConcurrently() const OVERRIDE { return true; }
   // @}
 
   // Gets the stream's data pointer.
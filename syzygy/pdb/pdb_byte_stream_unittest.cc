@@ -62,6 +62,7 @@ TEST(PdbByteStreamTest, InitFromByteArray) {
   EXPECT_TRUE(stream->Init(data, arraysize(data)));
   EXPECT_EQ(arraysize(data), stream->length());
   EXPECT_TRUE(stream->data() != NULL);
+  EXPECT_TRUE(stream->CanReadConcurrently());
 
   for (size_t i = 0; i < stream->length(); ++i) {
     uint8 num = 0;
@@ -70,6 +71,22 @@ TEST(PdbByteStreamTest, InitFromByteArray) {
   }
 }
 
+TEST(PdbByteStreamTest, GetContiguousData) {
+  scoped_refptr<PdbByteStream> stream(new PdbByteStream());
+  EXPECT_TRUE(stream->GetContiguousData() == NULL);
+
+  uint8 data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  EXPECT_TRUE(stream->Init(data, arraysize(data)));
+  ASSERT_TRUE(stream->GetContiguousData() != NULL);
+  EXPECT_EQ(0, memcmp(data, stream->GetContiguousData(), arraysize(data)));
+
+  // A byte stream can be initialized from the contiguous data of another.
+  scoped_refptr<PdbByteStream> copy(new PdbByteStream());
+  EXPECT_TRUE(copy->Init(stream.get()));
+  ASSERT_EQ(stream->length(), copy->length());
+  EXPECT_EQ(0, memcmp(data, copy->data(), arraysize(data)));
+}
+
 TEST(PdbByteStreamTest, InitFromPdbStream) {
   scoped_refptr<TestPdbStream> test_stream(new TestPdbStream(64));
 
@@ -24,6 +24,8 @@ const uint8 kPdbHeaderMagicString[] = {
 
 const uint32 kPdbMaxDirPages = 0x49;
 
+const char kPdbNameTableStreamName[] = "/names";
+
 const char kSyzygyHistoryStreamName[] = "/Syzygy/History";
 
 const char kSyzygyBlockGraphStreamName[] = "/Syzygy/BlockGraph";
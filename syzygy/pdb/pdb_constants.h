@@ -43,6 +43,18 @@ const size_t kTpiStream = 2;
 // The index of the Dbi info stream.
 const size_t kDbiStream = 3;
 
+// The signature we've observed for the name hash tables of the global and
+// public symbol info streams.
+const uint32 kPdbSymbolInfoHashSignature = 0xFFFFFFFF;
+
+// The version we've observed for the name hash tables of the global and public
+// symbol info streams.
+const uint32 kPdbSymbolInfoHashVersion = 0xF12F091A;
+
+// The number of buckets of the name hash tables of the global and public
+// symbol info streams.
+const size_t kPdbSymbolInfoHashBuckets = 4096;
+
 // This is the magic value found at the start of all MSF v7.00 files.
 extern const uint8 kPdbHeaderMagicString[32];
 
@@ -54,6 +66,10 @@ extern const uint32 kPdbMaxDirPages;
 // files. Check bytes 32 through 35 (little endian) of any PDB file.
 const uint32 kPdbPageSize = 1024;
 
+// The named PDB stream containing the name table, which holds the names of the
+// source files referred to by the line information of the modules.
+extern const char kPdbNameTableStreamName[];
+
 // The named PDB stream containing the history of Syzygy transformations applied
 // to an image. This consists of a sequence of Metadata objects.
 extern const char kSyzygyHistoryStreamName[];
@@ -183,6 +183,57 @@ struct DbiSectionMapItem {
 COMPILE_ASSERT(sizeof(DbiSectionMapItem) == 20,
                pdb_dbi_sectionmapitem_wrong_size);
 
+// Symbol Info Hash Header
+// This is at the beginning of the name hash table of the global symbol info
+// stream and of the public symbol info stream. It's followed by the hash
+// records, then by a bitmap of the non-empty buckets and by the offsets of
+// their first hash record.
+struct SymbolInfoHashHeader {
+  // Equal to kPdbSymbolInfoHashSignature.
+  uint32 signature;
+  // Equal to kPdbSymbolInfoHashVersion.
+  uint32 version;
+  // The size of the hash records.
+  uint32 hash_records_size;
+  // The size of the bucket bitmap and of the bucket offsets.
+  uint32 buckets_size;
+};
+// We coerce a stream of bytes to this structure, so we require it to be
+// exactly 16 bytes in size.
+COMPILE_ASSERT(sizeof(SymbolInfoHashHeader) == 16,
+               pdb_symbol_info_hash_header_wrong_size);
+
+// Symbol Info Hash Record
+// Represent an element of the name hash table of a symbol info stream.
+struct SymbolInfoHashRecord {
+  // The offset of the symbol in the symbol record stream, plus one.
+  uint32 offset;
+  uint32 ref_count;
+};
+// We coerce a stream of bytes to this structure, so we require it to be
+// exactly 8 bytes in size.
+COMPILE_ASSERT(sizeof(SymbolInfoHashRecord) == 8,
+               pdb_symbol_info_hash_record_wrong_size);
+
+// Public Symbol Info Header
+// This is at the beginning of the public symbol info stream. It's followed by
+// the name hash table, then by the address map, which holds the offsets of
+// the public symbols in the symbol record stream sorted by address.
+struct PublicSymbolInfoHeader {
+  uint32 hash_size;
+  uint32 address_map_size;
+  uint32 num_thunks;
+  uint32 thunk_size;
+  uint16 thunk_table_section;
+  uint16 padding;
+  uint32 thunk_table_offset;
+  uint32 num_sections;
+};
+// We coerce a stream of bytes to this structure, so we require it to be
+// exactly 28 bytes in size.
+COMPILE_ASSERT(sizeof(PublicSymbolInfoHeader) == 28,
+               pdb_public_symbol_info_header_wrong_size);
+
 // Multi-Stream Format (MSF) Header
 // See http://code.google.com/p/pdbparser/wiki/MSF_Format
 struct PdbHeader {
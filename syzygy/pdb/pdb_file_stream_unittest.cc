@@ -59,6 +59,7 @@ TEST_F(PdbFileStreamTest, Constructor) {
   size_t pages[] = {1, 2, 3};
   scoped_refptr<PdbFileStream> stream(new PdbFileStream(file_, 10, pages, 8));
   EXPECT_EQ(10, stream->length());
+  EXPECT_FALSE(stream->CanReadConcurrently());
 }
 
 TEST_F(PdbFileStreamTest, ReadFromPage) {
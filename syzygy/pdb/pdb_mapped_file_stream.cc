@@ -0,0 +1,111 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_mapped_file_stream.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace pdb {
+
+PdbMappedFileStream::PdbMappedFileStream(RefCountedMappedFile* file,
+                                         size_t length,
+                                         const uint32* pages,
+                                         size_t page_size)
+    : PdbStream(length),
+      file_(file),
+      page_size_(page_size),
+      contiguous_(true) {
+  DCHECK(file != NULL);
+  size_t num_pages = (length + page_size - 1) / page_size;
+  pages_.assign(pages, pages + num_pages);
+
+  for (size_t i = 1; i < pages_.size(); ++i) {
+    if (pages_[i] != pages_[i - 1] + 1) {
+      contiguous_ = false;
+      break;
+    }
+  }
+}
+
+PdbMappedFileStream::~PdbMappedFileStream() {
+}
+
+bool PdbMappedFileStream::ReadBytes(void* dest,
+                                    size_t count,
+                                    size_t* bytes_read) {
+  DCHECK(dest != NULL);
+  DCHECK(bytes_read != NULL);
+
+  // Return 0 once we've reached the end of the stream.
+  if (pos() == length()) {
+    *bytes_read = 0;
+    return true;
+  }
+
+  // Don't read beyond the end of the known stream length.
+  count = std::min(count, length() - pos());
+
+  // A contiguous stream is read in a single copy.
+  const uint8* data = GetContiguousData();
+  if (data != NULL) {
+    memcpy(dest, data + pos(), count);
+    Seek(pos() + count);
+    *bytes_read = count;
+    return true;
+  }
+
+  // Otherwise copy the stream a page at a time.
+  size_t remaining = count;
+  while (remaining > 0) {
+    size_t page_index = pos() / page_size_;
+    size_t offset = pos() % page_size_;
+    size_t chunk_size = std::min(remaining, page_size_ - offset);
+    const uint8* page_data = GetPageData(pages_[page_index], offset,
+                                         chunk_size);
+    if (page_data == NULL)
+      return false;
+    memcpy(dest, page_data, chunk_size);
+
+    remaining -= chunk_size;
+    Seek(pos() + chunk_size);
+    dest = reinterpret_cast<uint8*>(dest) + chunk_size;
+  }
+
+  *bytes_read = count;
+  return true;
+}
+
+const uint8* PdbMappedFileStream::GetContiguousData() const {
+  if (!contiguous_ || pages_.empty())
+    return NULL;
+
+  return GetPageData(pages_[0], 0, length());
+}
+
+const uint8* PdbMappedFileStream::GetPageData(uint32 page_num,
+                                              size_t offset,
+                                              size_t count) const {
+  size_t file_offset = page_size_ * page_num + offset;
+  if (file_offset > file_->length() ||
+      count > file_->length() - file_offset) {
+    LOG(ERROR) << "Page read out of the bounds of the file.";
+    return NULL;
+  }
+
+  return file_->data() + file_offset;
+}
+
+}  // namespace pdb
@@ -0,0 +1,113 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYZYGY_PDB_PDB_MAPPED_FILE_STREAM_H_
+#define SYZYGY_PDB_PDB_MAPPED_FILE_STREAM_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_util.h"
+#include "base/memory/ref_counted.h"
+#include "syzygy/pdb/pdb_stream.h"
+
+namespace pdb {
+
+// A reference counted read-only memory mapping of a file.
+class RefCountedMappedFile : public base::RefCounted<RefCountedMappedFile> {
+ public:
+  RefCountedMappedFile() { }
+
+  // Maps the file at @p path into memory.
+  // @param path the path of the file to map.
+  // @returns true on success, false otherwise.
+  bool Init(const FilePath& path) { return file_.Initialize(path); }
+
+  // @returns a pointer to the mapped file contents.
+  const uint8* data() const { return file_.data(); }
+
+  // @returns the length of the mapped file.
+  size_t length() const { return file_.length(); }
+
+ private:
+  friend base::RefCounted<RefCountedMappedFile>;
+
+  // We disallow access to the destructor to enforce the use of reference
+  // counting pointers.
+  ~RefCountedMappedFile() { }
+
+  file_util::MemoryMappedFile file_;
+
+  DISALLOW_COPY_AND_ASSIGN(RefCountedMappedFile);
+};
+
+// This class represents a PDB stream in a memory mapped file. Reads are
+// served directly from the mapping, without any system calls.
+// @note The whole PDB file is mapped, and each stream holds a reference to
+//     the mapping. The mapping, and the address space it takes, stay alive
+//     for as long as any stream of the file does, even after the PdbReader
+//     and the PdbFile that created them are gone.
+class PdbMappedFileStream : public PdbStream {
+ public:
+  // Constructor.
+  // @param file the mapped file housing this stream.
+  // @param length the length of this stream.
+  // @param pages the indices of the pages that make up this stream in the file.
+  //     A copy is made of the data so the pointer need not remain valid
+  //     beyond the constructor. The length of this array is implicit in the
+  //     stream length and the page size.
+  // @param page_size the size of the pages, in bytes.
+  PdbMappedFileStream(RefCountedMappedFile* file,
+                      size_t length,
+                      const uint32* pages,
+                      size_t page_size);
+
+  // @name PdbStream implementation.
+  // @{
+  virtual bool ReadBytes(void* dest, size_t count, size_t* bytes_read) OVERRIDE;
+  // The contents of the stream are available in place when its pages are
+  // consecutive in the file.
+  virtual const uint8* GetContiguousData() const OVERRIDE;
+  // The mapping is shared read-only, and each stream has its own position.
+  virtual bool CanReadConcurrently() const OVERRIDE { return true; }
+  // @}
+
+ protected:
+  // Protected to enforce reference counted pointers at compile time.
+  virtual ~PdbMappedFileStream();
+
+  // Returns a pointer to @p count bytes at @p offset byte offset from page
+  // @p page_num in the mapping, or NULL if these are out of the mapping.
+  const uint8* GetPageData(uint32 page_num, size_t offset, size_t count) const;
+
+ private:
+  // The mapped PDB file. This is reference counted so that streams can
+  // outlive the PdbReader that created them.
+  scoped_refptr<RefCountedMappedFile> file_;
+
+  // The list of pages in the PDB file that make up this stream.
+  std::vector<uint32> pages_;
+
+  // The size of pages within the stream.
+  size_t page_size_;
+
+  // True iff the pages of the stream are consecutive in the file.
+  bool contiguous_;
+
+  DISALLOW_COPY_AND_ASSIGN(PdbMappedFileStream);
+};
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_MAPPED_FILE_STREAM_H_
@@ -0,0 +1,137 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_mapped_file_stream.h"
+
+#include "gtest/gtest.h"
+#include "syzygy/core/unittest_util.h"
+#include "syzygy/pdb/pdb_data.h"
+#include "syzygy/pdb/pdb_file_stream.h"
+#include "syzygy/pdb/unittest_util.h"
+
+namespace pdb {
+
+namespace {
+
+class PdbMappedFileStreamTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    file_ = new RefCountedMappedFile();
+    ASSERT_TRUE(file_->Init(
+        testing::GetSrcRelativePath(testing::kTestPdbFilePath)));
+  }
+
+ protected:
+  scoped_refptr<RefCountedMappedFile> file_;
+};
+
+}  // namespace
+
+TEST_F(PdbMappedFileStreamTest, Constructor) {
+  uint32 pages[] = {1, 2, 3};
+  scoped_refptr<PdbMappedFileStream> stream(
+      new PdbMappedFileStream(file_, 10, pages, 8));
+  EXPECT_EQ(10, stream->length());
+  EXPECT_TRUE(stream->CanReadConcurrently());
+}
+
+TEST_F(PdbMappedFileStreamTest, ReadBytes) {
+  // Different sections of the pdb header magic string.
+  char* test_cases[] = {
+    "Mic",
+    "roso",
+    "ft",
+    " C/C+",
+    "+ MS",
+    "F 7.00"
+  };
+
+  // Test that we can read varying sizes of bytes from the header of the
+  // file with varying page sizes.
+  char buffer[8] = {0};
+  for (size_t page_size = 4; page_size <= 32; page_size *= 2) {
+    uint32 pages[] = {0, 1, 2, 3, 4, 5, 6, 7};
+    scoped_refptr<PdbMappedFileStream> stream(new PdbMappedFileStream(
+        file_.get(), sizeof(PdbHeader), pages, page_size));
+
+    for (uint32 j = 0; j < arraysize(test_cases); ++j) {
+      char* test_case = test_cases[j];
+      size_t len = strlen(test_case);
+      size_t bytes_read = 0;
+      EXPECT_TRUE(stream->ReadBytes(&buffer, len, &bytes_read));
+      EXPECT_EQ(0, memcmp(buffer, test_case, len));
+      EXPECT_EQ(len, bytes_read);
+    }
+  }
+}
+
+TEST_F(PdbMappedFileStreamTest, ReadBytesFromScatteredPages) {
+  // Read the magic string from pages that are out of order.
+  uint32 pages[] = {1, 0, 3, 2};
+  scoped_refptr<PdbMappedFileStream> stream(
+      new PdbMappedFileStream(file_.get(), 16, pages, 4));
+  EXPECT_TRUE(stream->GetContiguousData() == NULL);
+
+  char buffer[16] = {0};
+  ASSERT_TRUE(stream->Read(buffer, sizeof(buffer)));
+  EXPECT_EQ(0, memcmp(buffer, "osofMicrC++ t C/", 16));
+}
+
+TEST_F(PdbMappedFileStreamTest, GetContiguousData) {
+  uint32 pages[] = {0, 1, 2, 3};
+  scoped_refptr<PdbMappedFileStream> stream(
+      new PdbMappedFileStream(file_.get(), 16, pages, 4));
+
+  const uint8* data = stream->GetContiguousData();
+  ASSERT_TRUE(data != NULL);
+  EXPECT_EQ(0, memcmp(data, "Microsoft C/C++", 15));
+}
+
+TEST_F(PdbMappedFileStreamTest, ReadOutOfFileFails) {
+  // The first page is in the file, the second is past its end.
+  uint32 pages[] = { 0, file_->length() / 4 };
+  scoped_refptr<PdbMappedFileStream> stream(
+      new PdbMappedFileStream(file_.get(), 8, pages, 4));
+  EXPECT_TRUE(stream->GetContiguousData() == NULL);
+
+  // A failed read doesn't report the bytes it copied before failing.
+  char buffer[8] = {0};
+  size_t bytes_read = 42;
+  EXPECT_FALSE(stream->ReadBytes(buffer, sizeof(buffer), &bytes_read));
+  EXPECT_EQ(42U, bytes_read);
+}
+
+TEST_F(PdbMappedFileStreamTest, SameContentsAsFileStream) {
+  scoped_refptr<RefCountedFILE> file(new RefCountedFILE(
+      file_util::OpenFile(testing::GetSrcRelativePath(
+          testing::kTestPdbFilePath), "rb")));
+  ASSERT_TRUE(file->file() != NULL);
+
+  // Read a scattered stream spanning a few pages of the file.
+  const size_t kPageSize = 1024;
+  uint32 pages[] = {3, 1, 2, 5, 4};
+  const size_t kLength = arraysize(pages) * kPageSize - 17;
+  scoped_refptr<PdbMappedFileStream> mapped_stream(
+      new PdbMappedFileStream(file_.get(), kLength, pages, kPageSize));
+  scoped_refptr<PdbFileStream> file_stream(
+      new PdbFileStream(file.get(), kLength, pages, kPageSize));
+
+  std::vector<uint8> mapped_data;
+  std::vector<uint8> file_data;
+  ASSERT_TRUE(mapped_stream->Read(&mapped_data));
+  ASSERT_TRUE(file_stream->Read(&file_data));
+  EXPECT_EQ(file_data, mapped_data);
+}
+
+}  // namespace pdb
@@ -0,0 +1,218 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_module_lines.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "syzygy/common/align.h"
+#include "syzygy/pdb/pdb_dbi_stream.h"
+#include "syzygy/pdb/pdb_stream.h"
+#include "third_party/cci/files/cvinfo.h"
+
+namespace pdb {
+
+namespace cci = Microsoft_Cci_Pdb;
+
+namespace {
+
+bool ModuleLineOffsetLess(const ModuleLine& line1, const ModuleLine& line2) {
+  return line1.offset < line2.offset;
+}
+
+// Reads the file checksum subsection of a module info stream.
+// @param stream the stream containing the subsection, positioned at its
+//     beginning.
+// @param length the length of the subsection.
+// @param file_checksums the map where the checksums should be stored.
+// @returns true on success, false on error.
+bool ReadFileChecksums(PdbStream* stream,
+                       size_t length,
+                       ModuleFileChecksumMap* file_checksums) {
+  DCHECK(stream != NULL);
+  DCHECK(file_checksums != NULL);
+
+  size_t base = stream->pos();
+  size_t end = base + length;
+  while (stream->pos() < end) {
+    size_t pos = stream->pos() - base;
+    cci::CV_FileCheckSum checksum = {};
+    if (!stream->Read(&checksum.name, 1) ||
+        !stream->Read(&checksum.len, 1) ||
+        !stream->Read(&checksum.type, 1)) {
+      LOG(ERROR) << "Unable to read file checksum.";
+      return false;
+    }
+    file_checksums->insert(std::make_pair(pos, checksum.name));
+
+    // Skip the checksum and align.
+    if (!stream->Seek(common::AlignUp(stream->pos() + checksum.len, 4))) {
+      LOG(ERROR) << "Unable to seek past file checksum.";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Reads a line subsection of a module info stream. It holds the lines of a
+// block of code, grouped by source file.
+// @param file_checksums the file checksums of the module.
+// @param stream the stream containing the subsection, positioned at its
+//     beginning.
+// @param length the length of the subsection.
+// @param lines the vector where the lines should be appended.
+// @returns true on success, false on error.
+bool ReadLines(const ModuleFileChecksumMap& file_checksums,
+               PdbStream* stream,
+               size_t length,
+               ModuleLineVector* lines) {
+  DCHECK(stream != NULL);
+  DCHECK(lines != NULL);
+
+  size_t end = stream->pos() + length;
+  cci::CV_LineSection line_section = {};
+  if (!stream->Read(&line_section, 1)) {
+    LOG(ERROR) << "Unable to read line section.";
+    return false;
+  }
+
+  size_t first_line = lines->size();
+  std::vector<cci::CV_Line> cv_lines;
+  while (stream->pos() < end) {
+    cci::CV_SourceFile source_file = {};
+    if (!stream->Read(&source_file, 1)) {
+      LOG(ERROR) << "Unable to read source info.";
+      return false;
+    }
+
+    ModuleFileChecksumMap::const_iterator it(
+        file_checksums.find(source_file.index));
+    if (it == file_checksums.end()) {
+      LOG(ERROR) << "Unable to find an index in the list of filenames used by "
+                 << "this module.";
+      return false;
+    }
+
+    cv_lines.clear();
+    if (source_file.count != 0 &&
+        !stream->Read(&cv_lines, source_file.count)) {
+      LOG(ERROR) << "Unable to read line records.";
+      return false;
+    }
+
+    // Skip the column records.
+    if ((line_section.flags & cci::CV_LINES_HAVE_COLUMNS) != 0 &&
+        !stream->Seek(stream->pos() +
+                      source_file.count * sizeof(cci::CV_Column))) {
+      LOG(ERROR) << "Unable to seek past column records.";
+      return false;
+    }
+
+    for (size_t i = 0; i < cv_lines.size(); ++i) {
+      ModuleLine line = {};
+      line.file_name_offset = it->second;
+      line.line_number = cv_lines[i].flags & cci::linenumStart;
+      line.section = line_section.sec;
+      line.offset = line_section.off + cv_lines[i].offset;
+      lines->push_back(line);
+    }
+  }
+
+  // The lines of the different source files may be interleaved. Each line
+  // extends up to the next one, and the last one up to the end of the block.
+  ModuleLineVector::iterator block_begin = lines->begin() + first_line;
+  std::stable_sort(block_begin, lines->end(), ModuleLineOffsetLess);
+  uint32 block_end = line_section.off + line_section.cod;
+  for (ModuleLineVector::iterator it = block_begin; it != lines->end(); ++it) {
+    ModuleLineVector::iterator next = it + 1;
+    uint32 line_end = next == lines->end() ? block_end : next->offset;
+    if (line_end < it->offset) {
+      LOG(ERROR) << "Line extends past the end of its block.";
+      return false;
+    }
+    it->size = line_end - it->offset;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+bool ReadModuleLines(const DbiModuleInfo& module_info,
+                     PdbStream* stream,
+                     ModuleFileChecksumMap* file_checksums,
+                     ModuleLineVector* lines) {
+  DCHECK(stream != NULL);
+  DCHECK(file_checksums != NULL);
+  DCHECK(lines != NULL);
+
+  const DbiModuleInfoBase& module_info_base = module_info.module_info_base();
+  if (module_info_base.lines_bytes == 0)
+    return true;
+
+  uint32 signature = 0;
+  if (!stream->Seek(0) || !stream->Read(&signature, 1) ||
+      signature != cci::C13) {
+    LOG(ERROR) << "Unexpected symbol stream type " << signature << ".";
+    return false;
+  }
+
+  // The C13 line information follows the symbols and the C11 line
+  // information.
+  size_t start = module_info_base.symbol_bytes +
+      module_info_base.old_lines_bytes;
+  size_t end = start + module_info_base.lines_bytes;
+  if (end > stream->length() || !stream->Seek(start)) {
+    LOG(ERROR) << "Unable to seek to line info.";
+    return false;
+  }
+
+  // The line information is arranged as a back-to-back run of {type, len}
+  // prefixed subsections. The file checksum subsection precedes the line
+  // subsections that refer to it.
+  while (stream->pos() < end) {
+    uint32 line_info_type = 0;
+    uint32 length = 0;
+    if (!stream->Read(&line_info_type, 1) || !stream->Read(&length, 1)) {
+      LOG(ERROR) << "Unable to read line info signature.";
+      return false;
+    }
+
+    size_t next_subsection = common::AlignUp(stream->pos() + length, 4);
+    switch (line_info_type) {
+      case cci::DEBUG_S_FILECHKSMS:
+        if (!ReadFileChecksums(stream, length, file_checksums))
+          return false;
+        break;
+      case cci::DEBUG_S_LINES:
+        if (!ReadLines(*file_checksums, stream, length, lines))
+          return false;
+        break;
+      default:
+        // Other subsections don't contain line information.
+        break;
+    }
+
+    if (!stream->Seek(next_subsection)) {
+      LOG(ERROR) << "Unable to seek to the next line info subsection.";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace pdb
@@ -0,0 +1,67 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// This file allows reading the line information of a module info stream
+// without going through DIA.
+
+#ifndef SYZYGY_PDB_PDB_MODULE_LINES_H_
+#define SYZYGY_PDB_PDB_MODULE_LINES_H_
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace pdb {
+
+// Forward declarations.
+class DbiModuleInfo;
+class PdbStream;
+
+// Stores a line of source code, as found in the C13 line information of a
+// module info stream.
+struct ModuleLine {
+  // The offset of the name of the source file in the PDB name table.
+  uint32 file_name_offset;
+  uint32 line_number;
+  // The address of the code of the line.
+  uint16 section;
+  uint32 offset;
+  // The size of the code of the line. This is zero when several lines share
+  // the same code.
+  uint32 size;
+};
+typedef std::vector<ModuleLine> ModuleLineVector;
+
+// Maps the position of a file checksum in the file checksum subsection of a
+// module info stream to the offset of the name of its file in the PDB name
+// table. The lines of the module refer to their files by these positions.
+typedef std::map<size_t, uint32> ModuleFileChecksumMap;
+
+// Reads the C13 line information of a module info stream. The lines of each
+// code block are sorted by address, and their size is the distance to the
+// next line of the block.
+// @param module_info the module info of the stream, from the Dbi stream.
+// @param stream the module info stream.
+// @param file_checksums the map where the file checksums should be stored.
+// @param lines the vector where the lines should be appended.
+// @returns true on success, false otherwise.
+bool ReadModuleLines(const DbiModuleInfo& module_info,
+                     PdbStream* stream,
+                     ModuleFileChecksumMap* file_checksums,
+                     ModuleLineVector* lines);
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_MODULE_LINES_H_
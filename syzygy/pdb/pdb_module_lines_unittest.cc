@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_module_lines.h"
+
+#include <set>
+
+#include "base/string_util.h"
+#include "gtest/gtest.h"
+#include "syzygy/core/unittest_util.h"
+#include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_dbi_stream.h"
+#include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/unittest_util.h"
+
+namespace pdb {
+
+namespace {
+
+class PdbModuleLinesTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    PdbReader reader;
+    ASSERT_TRUE(reader.Read(
+        testing::GetSrcRelativePath(testing::kTestPdbFilePath),
+        &pdb_file_));
+    ASSERT_TRUE(dbi_stream_.Read(pdb_file_.GetStream(kDbiStream)));
+    ASSERT_TRUE(ReadNameTable(pdb_file_, &name_table_));
+  }
+
+  bool ReadLines(const DbiModuleInfo& module_info, ModuleLineVector* lines) {
+    int16 stream_index = module_info.module_info_base().stream;
+    if (stream_index < 0)
+      return true;
+    ModuleFileChecksumMap file_checksums;
+    return ReadModuleLines(module_info,
+                           pdb_file_.GetStream(stream_index),
+                           &file_checksums,
+                           lines);
+  }
+
+ protected:
+  PdbFile pdb_file_;
+  DbiStream dbi_stream_;
+  OffsetStringMap name_table_;
+};
+
+}  // namespace
+
+TEST_F(PdbModuleLinesTest, ReadAllModules) {
+  ModuleLineVector lines;
+  for (size_t i = 0; i < dbi_stream_.modules().size(); ++i)
+    ASSERT_TRUE(ReadLines(dbi_stream_.modules()[i], &lines));
+
+  // The expected values were obtained by running "pdb_dumper --dump-modules"
+  // on test_dll.pdb.
+  EXPECT_EQ(4051u, lines.size());
+
+  std::set<uint32> file_name_offsets;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    EXPECT_TRUE(name_table_.find(lines[i].file_name_offset) !=
+                name_table_.end());
+    file_name_offsets.insert(lines[i].file_name_offset);
+  }
+  EXPECT_EQ(85u, file_name_offsets.size());
+}
+
+TEST_F(PdbModuleLinesTest, ReadTestDllModule) {
+  const DbiModuleInfo* test_dll_module = NULL;
+  for (size_t i = 0; i < dbi_stream_.modules().size(); ++i) {
+    if (EndsWith(dbi_stream_.modules()[i].module_name(), "test_dll.obj",
+                 false)) {
+      test_dll_module = &dbi_stream_.modules()[i];
+      break;
+    }
+  }
+  ASSERT_TRUE(test_dll_module != NULL);
+
+  ModuleLineVector lines;
+  ASSERT_TRUE(ReadLines(*test_dll_module, &lines));
+  ASSERT_EQ(29u, lines.size());
+
+  // DllMain is the first function of the image.
+  EXPECT_EQ(1, lines[0].section);
+  EXPECT_EQ(0u, lines[0].offset);
+  EXPECT_EQ(1u, lines[0].size);
+  EXPECT_EQ(23u, lines[0].line_number);
+  EXPECT_TRUE(EndsWith(name_table_[lines[0].file_name_offset],
+                       "test_dll.cc", false));
+
+  // The lines of a block follow each other.
+  EXPECT_EQ(1, lines[1].section);
+  EXPECT_EQ(1u, lines[1].offset);
+  EXPECT_EQ(5u, lines[1].size);
+  EXPECT_EQ(29u, lines[1].line_number);
+}
+
+}  // namespace pdb
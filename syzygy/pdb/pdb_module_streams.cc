@@ -0,0 +1,186 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_module_streams.h"
+
+#include <set>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "syzygy/pdb/pdb_byte_stream.h"
+#include "syzygy/pdb/pdb_dbi_stream.h"
+#include "syzygy/pdb/pdb_file.h"
+#include "syzygy/pdb/pdb_parallel_jobs.h"
+#include "syzygy/pdb/pdb_symbol_record.h"
+#include "third_party/cci/files/cvinfo.h"
+
+namespace pdb {
+
+namespace cci = Microsoft_Cci_Pdb;
+
+namespace {
+
+// The maximum number of threads used to read the module info streams.
+const size_t kMaxModuleStreamReaderThreads = 8;
+
+// A module info stream to be read.
+struct ModuleStreamJob {
+  const DbiModuleInfo* module_info;
+  uint32 parts;
+  scoped_refptr<PdbStream> stream;
+  ModuleStreamContents* contents;
+};
+typedef std::vector<ModuleStreamJob> ModuleStreamJobs;
+
+// Reads module info streams. Several readers share the same list of jobs,
+// each job having its own stream.
+class ModuleStreamReader : public ParallelJobWorker {
+ public:
+  explicit ModuleStreamReader(const ModuleStreamJobs* jobs) : jobs_(*jobs) {
+  }
+
+  virtual bool RunJob(size_t job_index) OVERRIDE {
+    const ModuleStreamJob& job = jobs_[job_index];
+    if (!job.contents->Read(*job.module_info, job.parts, job.stream.get())) {
+      LOG(ERROR) << "Unable to read the stream of module \""
+                 << job.module_info->module_name() << "\".";
+      return false;
+    }
+    return true;
+  }
+
+  static ParallelJobWorker* Create(const ModuleStreamJobs* jobs) {
+    return new ModuleStreamReader(jobs);
+  }
+
+ private:
+  const ModuleStreamJobs& jobs_;
+
+  DISALLOW_COPY_AND_ASSIGN(ModuleStreamReader);
+};
+
+}  // namespace
+
+ModuleStreamContents::ModuleStreamContents() : module_info_(NULL) {
+}
+
+ModuleStreamContents::~ModuleStreamContents() {
+}
+
+bool ModuleStreamContents::Read(const DbiModuleInfo& module_info,
+                                uint32 parts,
+                                PdbStream* stream) {
+  DCHECK(stream != NULL);
+
+  module_info_ = &module_info;
+  stream_ = stream;
+  symbols_.clear();
+  file_checksums_.clear();
+  lines_.clear();
+
+  if ((parts & kModuleStreamSymbols) != 0) {
+    // The symbol records follow the signature of the stream, and their size
+    // includes it.
+    const DbiModuleInfoBase& module_info_base = module_info.module_info_base();
+    uint32 signature = 0;
+    if (!stream->Seek(0) || !stream->Read(&signature, 1) ||
+        signature != cci::C13 ||
+        module_info_base.symbol_bytes < sizeof(signature)) {
+      LOG(ERROR) << "Unexpected symbol stream type " << signature << ".";
+      return false;
+    }
+
+    if (!ReadSymbolRecord(stream,
+                          module_info_base.symbol_bytes - sizeof(signature),
+                          &symbols_)) {
+      LOG(ERROR) << "Unable to read the symbol records.";
+      return false;
+    }
+  }
+
+  if ((parts & kModuleStreamLines) != 0 &&
+      !ReadModuleLines(module_info, stream, &file_checksums_, &lines_)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool ModuleStreamContents::HasParts(const DbiModuleInfo& module_info,
+                                    uint32 parts) {
+  const DbiModuleInfoBase& module_info_base = module_info.module_info_base();
+  if (module_info_base.stream < 0)
+    return false;
+  // The size of the symbol records includes the signature of the stream.
+  if ((parts & kModuleStreamSymbols) != 0 &&
+      module_info_base.symbol_bytes > sizeof(uint32)) {
+    return true;
+  }
+  if ((parts & kModuleStreamLines) != 0 && module_info_base.lines_bytes != 0)
+    return true;
+  return false;
+}
+
+bool ReadModuleStreams(const PdbFile& pdb_file,
+                       const DbiStream& dbi_stream,
+                       uint32 parts,
+                       ModuleStreamContentsVector* modules) {
+  DCHECK(modules != NULL);
+
+  const DbiStream::DbiModuleVector& module_infos = dbi_stream.modules();
+  modules->clear();
+  modules->resize(module_infos.size());
+
+  // The streams that can't be read concurrently, such as those that share a
+  // file handle, are first copied to memory. This only reads the file, which
+  // is cheap compared to parsing the streams. So is a stream that's shared by
+  // several modules, as each reader moves the position of its stream.
+  ModuleStreamJobs jobs;
+  std::set<int16> stream_indices;
+  for (size_t i = 0; i < module_infos.size(); ++i) {
+    if (!ModuleStreamContents::HasParts(module_infos[i], parts))
+      continue;
+
+    int16 stream_index = module_infos[i].module_info_base().stream;
+    scoped_refptr<PdbStream> stream;
+    if (static_cast<size_t>(stream_index) < pdb_file.StreamCount())
+      stream = pdb_file.GetStream(stream_index);
+    if (stream.get() == NULL) {
+      LOG(ERROR) << "Unable to read the stream of module \""
+                 << module_infos[i].module_name() << "\".";
+      return false;
+    }
+
+    bool is_shared = !stream_indices.insert(stream_index).second;
+    if (is_shared || !stream->CanReadConcurrently()) {
+      scoped_refptr<PdbByteStream> byte_stream(new PdbByteStream());
+      if (!byte_stream->Init(stream.get())) {
+        LOG(ERROR) << "Unable to copy the stream of module \""
+                   << module_infos[i].module_name() << "\".";
+        return false;
+      }
+      stream = byte_stream;
+    }
+
+    ModuleStreamJob job = { &module_infos[i], parts, stream, &(*modules)[i] };
+    jobs.push_back(job);
+  }
+
+  return RunParallelJobs(jobs.size(),
+                         kMaxModuleStreamReaderThreads,
+                         "ModuleStreamReader",
+                         base::Bind(&ModuleStreamReader::Create, &jobs));
+}
+
+}  // namespace pdb
@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// This file allows reading the module info streams referred to by the Dbi
+// stream of a PDB, or some parts of them, using several threads.
+
+#ifndef SYZYGY_PDB_PDB_MODULE_STREAMS_H_
+#define SYZYGY_PDB_PDB_MODULE_STREAMS_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "syzygy/pdb/pdb_data_types.h"
+#include "syzygy/pdb/pdb_module_lines.h"
+#include "syzygy/pdb/pdb_stream.h"
+
+namespace pdb {
+
+// Forward declarations.
+class DbiModuleInfo;
+class DbiStream;
+class PdbFile;
+
+// The parts of a module info stream to read. These can be combined.
+enum ModuleStreamParts {
+  kModuleStreamSymbols = 1 << 0,
+  kModuleStreamLines = 1 << 1,
+  kModuleStreamAllParts = kModuleStreamSymbols | kModuleStreamLines,
+};
+
+// The parsed contents of the module info stream of a module. This is empty for
+// the modules that have no stream, or none of the parts that were asked for.
+class ModuleStreamContents {
+ public:
+  ModuleStreamContents();
+  ~ModuleStreamContents();
+
+  // Reads the contents of a module info stream.
+  // @param module_info the module info of the stream, from the Dbi stream. It
+  //     must outlive this object.
+  // @param parts the ModuleStreamParts to read. The symbols are left empty
+  //     unless kModuleStreamSymbols is given, and the file checksums and lines
+  //     unless kModuleStreamLines is.
+  // @param stream the module info stream. It must not be accessed by another
+  //     thread while this is reading it.
+  // @returns true on success, false otherwise.
+  bool Read(const DbiModuleInfo& module_info, uint32 parts, PdbStream* stream);
+
+  // @param module_info the module info of a module, from the Dbi stream.
+  // @param parts the ModuleStreamParts to read.
+  // @returns true if the module has a stream with some of @p parts in it.
+  static bool HasParts(const DbiModuleInfo& module_info, uint32 parts);
+
+  // @name Accessors.
+  // @{
+  // @returns the module info of the module.
+  const DbiModuleInfo* module_info() const { return module_info_; }
+  // @returns the module info stream, which is where the symbol records are to
+  //     be read from. This is NULL if the module has no stream.
+  PdbStream* stream() const { return stream_.get(); }
+  const SymbolRecordVector& symbols() const { return symbols_; }
+  const ModuleFileChecksumMap& file_checksums() const {
+    return file_checksums_;
+  }
+  const ModuleLineVector& lines() const { return lines_; }
+  // @}
+
+ private:
+  const DbiModuleInfo* module_info_;
+  scoped_refptr<PdbStream> stream_;
+  SymbolRecordVector symbols_;
+  ModuleFileChecksumMap file_checksums_;
+  ModuleLineVector lines_;
+};
+typedef std::vector<ModuleStreamContents> ModuleStreamContentsVector;
+
+// Reads the module info streams of all of the modules of a PDB. The streams
+// are parsed by a pool of threads. Those that can't be read concurrently with
+// the other streams of @p pdb_file, such as the streams read through a shared
+// file handle, are first copied to memory. The streams of @p pdb_file must not
+// be accessed by other threads meanwhile.
+// @param pdb_file the PDB file containing the streams.
+// @param dbi_stream the Dbi stream of @p pdb_file. It must outlive
+//     @p modules.
+// @param parts the ModuleStreamParts to read. The modules with none of them
+//     are skipped.
+// @param modules receives the contents of the module info streams, in the
+//     order of the modules of @p dbi_stream.
+// @returns true on success, false otherwise.
+bool ReadModuleStreams(const PdbFile& pdb_file,
+                       const DbiStream& dbi_stream,
+                       uint32 parts,
+                       ModuleStreamContentsVector* modules);
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_MODULE_STREAMS_H_
@@ -0,0 +1,134 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_module_streams.h"
+
+#include "gtest/gtest.h"
+#include "syzygy/core/unittest_util.h"
+#include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_dbi_stream.h"
+#include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/unittest_util.h"
+
+namespace pdb {
+
+namespace {
+
+class PdbModuleStreamsTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    PdbReader reader;
+    ASSERT_TRUE(reader.Read(
+        testing::GetSrcRelativePath(testing::kTestPdbFilePath),
+        &pdb_file_));
+    ASSERT_TRUE(dbi_stream_.Read(pdb_file_.GetStream(kDbiStream)));
+  }
+
+ protected:
+  PdbFile pdb_file_;
+  DbiStream dbi_stream_;
+};
+
+}  // namespace
+
+TEST_F(PdbModuleStreamsTest, ReadModuleStreams) {
+  ModuleStreamContentsVector modules;
+  ASSERT_TRUE(ReadModuleStreams(pdb_file_, dbi_stream_, kModuleStreamAllParts,
+                                &modules));
+  ASSERT_EQ(dbi_stream_.modules().size(), modules.size());
+
+  size_t num_lines = 0;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    const DbiModuleInfo& module_info = dbi_stream_.modules()[i];
+    ASSERT_EQ(&module_info, modules[i].module_info());
+    EXPECT_FALSE(modules[i].symbols().empty());
+    num_lines += modules[i].lines().size();
+
+    // The streams are mapped, so they're read in place.
+    scoped_refptr<PdbStream> stream(
+        pdb_file_.GetStream(module_info.module_info_base().stream));
+    ASSERT_TRUE(stream->CanReadConcurrently());
+    EXPECT_EQ(stream.get(), modules[i].stream());
+
+    // The results are the same as when reading the stream directly.
+    ModuleStreamContents contents;
+    ASSERT_TRUE(contents.Read(module_info, kModuleStreamAllParts,
+                              stream.get()));
+    ASSERT_EQ(contents.symbols().size(), modules[i].symbols().size());
+    for (size_t j = 0; j < contents.symbols().size(); ++j) {
+      EXPECT_EQ(contents.symbols()[j].start_position,
+                modules[i].symbols()[j].start_position);
+      EXPECT_EQ(contents.symbols()[j].type, modules[i].symbols()[j].type);
+    }
+    EXPECT_EQ(contents.file_checksums(), modules[i].file_checksums());
+    EXPECT_EQ(contents.lines().size(), modules[i].lines().size());
+  }
+
+  // This is the number of lines of test_dll.pdb, as read by ReadModuleLines.
+  EXPECT_EQ(4051u, num_lines);
+}
+
+TEST_F(PdbModuleStreamsTest, ReadModuleLinesOnly) {
+  ModuleStreamContentsVector modules;
+  ASSERT_TRUE(ReadModuleStreams(pdb_file_, dbi_stream_, kModuleStreamLines,
+                                &modules));
+  ASSERT_EQ(dbi_stream_.modules().size(), modules.size());
+
+  size_t num_lines = 0;
+  size_t num_skipped = 0;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    const DbiModuleInfo& module_info = dbi_stream_.modules()[i];
+    EXPECT_TRUE(modules[i].symbols().empty());
+    num_lines += modules[i].lines().size();
+
+    // The modules without lines aren't read at all.
+    if (module_info.module_info_base().lines_bytes == 0) {
+      EXPECT_TRUE(modules[i].module_info() == NULL);
+      EXPECT_TRUE(modules[i].stream() == NULL);
+      ++num_skipped;
+    } else {
+      EXPECT_EQ(&module_info, modules[i].module_info());
+    }
+  }
+
+  EXPECT_EQ(4051u, num_lines);
+  EXPECT_LT(0u, num_skipped);
+}
+
+TEST_F(PdbModuleStreamsTest, ReadModuleSymbolsOnly) {
+  ModuleStreamContentsVector modules;
+  ASSERT_TRUE(ReadModuleStreams(pdb_file_, dbi_stream_, kModuleStreamSymbols,
+                                &modules));
+  ASSERT_EQ(dbi_stream_.modules().size(), modules.size());
+
+  for (size_t i = 0; i < modules.size(); ++i) {
+    EXPECT_EQ(&dbi_stream_.modules()[i], modules[i].module_info());
+    EXPECT_FALSE(modules[i].symbols().empty());
+    EXPECT_TRUE(modules[i].file_checksums().empty());
+    EXPECT_TRUE(modules[i].lines().empty());
+  }
+}
+
+TEST_F(PdbModuleStreamsTest, FailsOnMissingStream) {
+  // Drop the stream of the first module.
+  int16 stream_index = dbi_stream_.modules()[0].module_info_base().stream;
+  ASSERT_LE(0, stream_index);
+  pdb_file_.ReplaceStream(stream_index, NULL);
+
+  ModuleStreamContentsVector modules;
+  EXPECT_FALSE(ReadModuleStreams(pdb_file_, dbi_stream_, kModuleStreamAllParts,
+                                 &modules));
+}
+
+}  // namespace pdb
@@ -0,0 +1,108 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_parallel_jobs.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/sys_info.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/threading/simple_thread.h"
+
+namespace pdb {
+
+namespace {
+
+// Runs the jobs of a worker on its thread.
+class JobRunner : public base::DelegateSimpleThread::Delegate {
+ public:
+  JobRunner(ParallelJobWorker* worker,
+            size_t num_jobs,
+            volatile base::subtle::Atomic32* next_job)
+      : worker_(worker), num_jobs_(num_jobs), next_job_(next_job),
+        succeeded_(false) {
+    DCHECK(worker != NULL);
+    DCHECK(next_job != NULL);
+  }
+
+  virtual void Run() OVERRIDE {
+    if (!worker_->Start())
+      return;
+
+    while (true) {
+      size_t job_index = base::subtle::NoBarrier_AtomicIncrement(next_job_, 1);
+      if (job_index > num_jobs_)
+        break;
+
+      if (!worker_->RunJob(job_index - 1))
+        return;
+    }
+
+    succeeded_ = worker_->Finish();
+  }
+
+  bool succeeded() const { return succeeded_; }
+
+ private:
+  scoped_ptr<ParallelJobWorker> worker_;
+  size_t num_jobs_;
+  volatile base::subtle::Atomic32* next_job_;
+  bool succeeded_;
+
+  DISALLOW_COPY_AND_ASSIGN(JobRunner);
+};
+
+}  // namespace
+
+bool RunParallelJobs(size_t num_jobs,
+                     size_t max_threads,
+                     const char* thread_name,
+                     const ParallelJobWorkerFactory& create_worker) {
+  DCHECK(thread_name != NULL);
+  DCHECK(!create_worker.is_null());
+
+  if (num_jobs == 0)
+    return true;
+
+  size_t num_threads = std::min(
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors()),
+      std::min(num_jobs, max_threads));
+  num_threads = std::max(num_threads, static_cast<size_t>(1));
+
+  volatile base::subtle::Atomic32 next_job = 0;
+  std::vector<JobRunner*> runners;
+  std::vector<base::DelegateSimpleThread*> threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    runners.push_back(new JobRunner(create_worker.Run(), num_jobs, &next_job));
+    threads.push_back(
+        new base::DelegateSimpleThread(runners.back(), thread_name));
+    threads.back()->Start();
+  }
+
+  bool succeeded = true;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads[i]->Join();
+    succeeded = succeeded && runners[i]->succeeded();
+  }
+  STLDeleteElements(&threads);
+  STLDeleteElements(&runners);
+
+  return succeeded;
+}
+
+}  // namespace pdb
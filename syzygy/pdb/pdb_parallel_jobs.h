@@ -0,0 +1,65 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Runs a list of independent jobs on a pool of threads, as done when reading
+// and writing the streams of a PDB.
+
+#ifndef SYZYGY_PDB_PDB_PARALLEL_JOBS_H_
+#define SYZYGY_PDB_PDB_PARALLEL_JOBS_H_
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+
+namespace pdb {
+
+// Runs jobs on one thread of the pool. Each thread has its own worker, which
+// takes the next job from a shared counter until none are left.
+class ParallelJobWorker {
+ public:
+  virtual ~ParallelJobWorker() {}
+
+  // Called on the thread of the worker before it runs any job.
+  // @returns true on success. On failure the worker runs no job.
+  virtual bool Start() { return true; }
+
+  // Runs a job.
+  // @param job_index the index of the job to run.
+  // @returns true on success. On failure the worker runs no more jobs.
+  virtual bool RunJob(size_t job_index) = 0;
+
+  // Called on the thread of the worker once there are no jobs left.
+  // @returns true on success.
+  virtual bool Finish() { return true; }
+};
+
+// Creates the worker of a thread. This is called on the calling thread of
+// RunParallelJobs.
+typedef base::Callback<ParallelJobWorker*()> ParallelJobWorkerFactory;
+
+// Runs jobs on a pool of threads, and waits for them to complete.
+// @param num_jobs the number of jobs to run.
+// @param max_threads the maximum number of threads to use. No more threads
+//     are used than there are processors or jobs.
+// @param thread_name the name of the threads.
+// @param create_worker creates the worker of each thread, which is deleted
+//     once its thread is done.
+// @returns true if all the workers succeeded.
+bool RunParallelJobs(size_t num_jobs,
+                     size_t max_threads,
+                     const char* thread_name,
+                     const ParallelJobWorkerFactory& create_worker);
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_PARALLEL_JOBS_H_
@@ -0,0 +1,95 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_parallel_jobs.h"
+
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "gtest/gtest.h"
+
+namespace pdb {
+
+namespace {
+
+// Counts the runs of each job, and fails the jobs it's told to.
+class CountingWorker : public ParallelJobWorker {
+ public:
+  CountingWorker(std::vector<base::subtle::Atomic32>* runs,
+                 size_t failing_job,
+                 bool fail_start)
+      : runs_(*runs), failing_job_(failing_job), fail_start_(fail_start) {
+  }
+
+  virtual bool Start() OVERRIDE {
+    return !fail_start_;
+  }
+
+  virtual bool RunJob(size_t job_index) OVERRIDE {
+    base::subtle::NoBarrier_AtomicIncrement(&runs_[job_index], 1);
+    return job_index != failing_job_;
+  }
+
+  static ParallelJobWorker* Create(std::vector<base::subtle::Atomic32>* runs,
+                                   size_t failing_job,
+                                   bool fail_start) {
+    return new CountingWorker(runs, failing_job, fail_start);
+  }
+
+ private:
+  std::vector<base::subtle::Atomic32>& runs_;
+  size_t failing_job_;
+  bool fail_start_;
+};
+
+const size_t kNoFailingJob = static_cast<size_t>(-1);
+
+}  // namespace
+
+TEST(PdbParallelJobsTest, RunsEachJobOnce) {
+  const size_t kNumJobs = 1000;
+  std::vector<base::subtle::Atomic32> runs(kNumJobs, 0);
+  EXPECT_TRUE(RunParallelJobs(
+      kNumJobs, 4, "TestWorker",
+      base::Bind(&CountingWorker::Create, &runs, kNoFailingJob, false)));
+
+  for (size_t i = 0; i < kNumJobs; ++i)
+    EXPECT_EQ(1, runs[i]);
+}
+
+TEST(PdbParallelJobsTest, NoJobs) {
+  std::vector<base::subtle::Atomic32> runs;
+  EXPECT_TRUE(RunParallelJobs(
+      0, 4, "TestWorker",
+      base::Bind(&CountingWorker::Create, &runs, kNoFailingJob, false)));
+}
+
+TEST(PdbParallelJobsTest, ReportsFailures) {
+  const size_t kNumJobs = 100;
+  std::vector<base::subtle::Atomic32> runs(kNumJobs, 0);
+  EXPECT_FALSE(RunParallelJobs(
+      kNumJobs, 4, "TestWorker",
+      base::Bind(&CountingWorker::Create, &runs, 10, false)));
+  EXPECT_EQ(1, runs[10]);
+
+  std::vector<base::subtle::Atomic32> no_runs(kNumJobs, 0);
+  EXPECT_FALSE(RunParallelJobs(
+      kNumJobs, 4, "TestWorker",
+      base::Bind(&CountingWorker::Create, &no_runs, kNoFailingJob, true)));
+  for (size_t i = 0; i < kNumJobs; ++i)
+    EXPECT_EQ(0, no_runs[i]);
+}
+
+}  // namespace pdb
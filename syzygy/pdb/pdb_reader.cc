@@ -17,11 +17,34 @@
 #include "base/logging.h"
 #include "base/string_util.h"
 #include "syzygy/pdb/pdb_file_stream.h"
+#include "syzygy/pdb/pdb_mapped_file_stream.h"
 
 namespace pdb {
 
 namespace {
 
+// Creates the streams of a PDB file. These are served from a memory mapping
+// of the file if there is one, and read from the file itself otherwise.
+class StreamFactory {
+ public:
+  StreamFactory(RefCountedMappedFile* mapped_file, RefCountedFILE* file)
+      : mapped_file_(mapped_file), file_(file) {
+    DCHECK(mapped_file != NULL || file != NULL);
+  }
+
+  PdbStream* CreateStream(size_t length,
+                          const uint32* pages,
+                          size_t page_size) const {
+    if (mapped_file_ != NULL)
+      return new PdbMappedFileStream(mapped_file_, length, pages, page_size);
+    return new PdbFileStream(file_, length, pages, page_size);
+  }
+
+ private:
+  scoped_refptr<RefCountedMappedFile> mapped_file_;
+  scoped_refptr<RefCountedFILE> file_;
+};
+
 bool GetFileSize(FILE* file, uint32* size) {
   DCHECK(file != NULL);
   DCHECK(size != NULL);
@@ -53,26 +76,39 @@ bool PdbReader::Read(const FilePath& pdb_path, PdbFile* pdb_file) {
 
   pdb_file->Clear();
 
-  scoped_refptr<RefCountedFILE> file(new RefCountedFILE(
-      file_util::OpenFile(pdb_path, "rb")));
-  if (!file->file()) {
-    LOG(ERROR) << "Unable to open '" << pdb_path.value() << "'.";
-    return false;
-  }
-
-  // Get the file size.
+  // Memory map the file, falling back to reading it if that fails. This can
+  // happen for huge PDBs in a fragmented 32-bit address space.
+  scoped_refptr<RefCountedMappedFile> mapped_file(new RefCountedMappedFile());
+  scoped_refptr<RefCountedFILE> file;
   uint32 file_size = 0;
-  if (!GetFileSize(file->file(), &file_size)) {
-    LOG(ERROR) << "Unable to determine size of '" << pdb_path.value() << "'.";
-    return false;
+  if (mapped_file->Init(pdb_path)) {
+    file_size = mapped_file->length();
+  } else {
+    LOG(WARNING) << "Unable to map '" << pdb_path.value() << "', reading it "
+                 << "instead.";
+    mapped_file = NULL;
+
+    file = new RefCountedFILE(file_util::OpenFile(pdb_path, "rb"));
+    if (!file->file()) {
+      LOG(ERROR) << "Unable to open '" << pdb_path.value() << "'.";
+      return false;
+    }
+
+    // Get the file size.
+    if (!GetFileSize(file->file(), &file_size)) {
+      LOG(ERROR) << "Unable to determine size of '" << pdb_path.value()
+                 << "'.";
+      return false;
+    }
   }
+  StreamFactory factory(mapped_file, file);
 
   PdbHeader header = { 0 };
 
   // Read the header from the first page in the file.
   uint32 header_page = 0;
-  scoped_refptr<PdbFileStream> header_stream(new PdbFileStream(
-      file, sizeof(header), &header_page, kPdbPageSize));
+  scoped_refptr<PdbStream> header_stream(factory.CreateStream(
+      sizeof(header), &header_page, kPdbPageSize));
   if (!header_stream->Read(&header, 1)) {
     LOG(ERROR) << "Failed to read PDB file header.";
     return false;
@@ -96,9 +132,8 @@ bool PdbReader::Read(const FilePath& pdb_path, PdbFile* pdb_file) {
   // containing that many page pointers from the root pages array.
   int num_dir_pages = static_cast<int>(GetNumPages(header,
                                                    header.directory_size));
-  scoped_refptr<PdbFileStream> dir_page_stream(new PdbFileStream(
-      file, num_dir_pages * sizeof(uint32),
-      header.root_pages, header.page_size));
+  scoped_refptr<PdbStream> dir_page_stream(factory.CreateStream(
+      num_dir_pages * sizeof(uint32), header.root_pages, header.page_size));
   scoped_array<uint32> dir_pages(new uint32[num_dir_pages]);
   if (dir_pages.get() == NULL) {
     LOG(ERROR) << "Failed to allocate directory pages.";
@@ -111,8 +146,8 @@ bool PdbReader::Read(const FilePath& pdb_path, PdbFile* pdb_file) {
 
   // Load the actual directory.
   int dir_size = static_cast<int>(header.directory_size / sizeof(uint32));
-  scoped_refptr<PdbFileStream> dir_stream(new PdbFileStream(
-      file, header.directory_size, dir_pages.get(), header.page_size));
+  scoped_refptr<PdbStream> dir_stream(factory.CreateStream(
+      header.directory_size, dir_pages.get(), header.page_size));
   std::vector<uint32> directory(dir_size);
   if (!dir_stream->Read(&directory[0], dir_size)) {
     LOG(ERROR) << "Failed to read directory stream.";
@@ -126,10 +161,9 @@ bool PdbReader::Read(const FilePath& pdb_path, PdbFile* pdb_file) {
 
   uint32 page_index = 0;
   for (uint32 stream_index = 0; stream_index < num_streams; ++stream_index) {
-    pdb_file->AppendStream(new PdbFileStream(file,
-                                             stream_lengths[stream_index],
-                                             stream_pages + page_index,
-                                             header.page_size));
+    pdb_file->AppendStream(factory.CreateStream(stream_lengths[stream_index],
+                                                stream_pages + page_index,
+                                                header.page_size));
     page_index += GetNumPages(header, stream_lengths[stream_index]);
   }
 
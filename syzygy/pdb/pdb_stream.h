@@ -119,6 +119,19 @@ class PdbStream : public base::RefCounted<PdbStream> {
     return scoped_refptr<WritablePdbStream>();
   }
 
+  // Returns the contents of the stream if they're available in memory in one
+  // piece, allowing them to be parsed or copied without going through
+  // ReadBytes. The returned data stays valid until the stream is modified.
+  // @returns a pointer to the contents of the stream, or NULL if they're not
+  //     available.
+  virtual const uint8* GetContiguousData() const { return NULL; }
+
+  // Returns whether this stream can be read on one thread while the other
+  // streams of its file are read on others. This isn't the case of streams
+  // that share a file handle.
+  // @returns true if the stream can be read concurrently with its siblings.
+  virtual bool CanReadConcurrently() const { return false; }
+
   // Sets the current read position.
   bool Seek(size_t pos);
 
@@ -0,0 +1,396 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_symbol_index.h"
+
+#include <stddef.h>
+#include <algorithm>
+
+#include "base/logging.h"
+#include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_data.h"
+#include "syzygy/pdb/pdb_file.h"
+#include "syzygy/pdb/pdb_util.h"
+#include "third_party/cci/files/cvinfo.h"
+
+namespace pdb {
+
+namespace cci = Microsoft_Cci_Pdb;
+
+namespace {
+
+// The bucket offsets of a name hash table index the hash records as they're
+// laid out in memory by the linker, which uses 12 bytes per record.
+const size_t kHashRecordInMemorySize = 12;
+
+// The bucket bitmap has a bit for each bucket, plus an extra one.
+const size_t kNumBucketBitmapWords = (kPdbSymbolInfoHashBuckets + 1 + 31) / 32;
+
+bool PublicSymbolAddressLess(const SymbolIndex::PublicSymbol& symbol1,
+                             const SymbolIndex::PublicSymbol& symbol2) {
+  if (symbol1.section != symbol2.section)
+    return symbol1.section < symbol2.section;
+  return symbol1.offset < symbol2.offset;
+}
+
+// Returns the offset of the name in the data of a symbol record, or 0 if this
+// isn't a supported symbol or its data can't be parsed.
+size_t GetSymbolNameOffset(uint16 type, const std::vector<uint8>& data) {
+  size_t offset = 0;
+  switch (type) {
+    case cci::S_PUB32:
+      offset = offsetof(cci::PubSym32, name);
+      break;
+    case cci::S_LDATA32:
+    case cci::S_GDATA32:
+      offset = offsetof(cci::DatasSym32, name);
+      break;
+    case cci::S_LTHREAD32:
+    case cci::S_GTHREAD32:
+      offset = offsetof(cci::ThreadSym32, name);
+      break;
+    case cci::S_PROCREF:
+    case cci::S_DATAREF:
+    case cci::S_LPROCREF:
+      offset = offsetof(cci::RefSym2, name);
+      break;
+    case cci::S_UDT:
+      offset = offsetof(cci::UdtSym, name);
+      break;
+    case cci::S_CONSTANT: {
+      // The name follows the value, which is a numeric leaf.
+      offset = offsetof(cci::ConstSym, value);
+      if (offset >= data.size())
+        return 0;
+      size_t value_size = GetNumericLeafSize(&data[offset],
+                                             data.size() - offset);
+      if (value_size == 0)
+        return 0;
+      offset += value_size;
+      break;
+    }
+    default:
+      return 0;
+  }
+
+  if (offset >= data.size())
+    return 0;
+  return offset;
+}
+
+}  // namespace
+
+SymbolIndex::SymbolIndex() {
+}
+
+SymbolIndex::~SymbolIndex() {
+}
+
+bool SymbolIndex::Init(const PdbFile& pdb_file) {
+  if (pdb_file.StreamCount() <= kDbiStream) {
+    LOG(ERROR) << "The PDB has no Dbi stream.";
+    return false;
+  }
+
+  scoped_refptr<PdbStream> dbi_stream = pdb_file.GetStream(kDbiStream);
+  DbiHeader dbi_header = {};
+  if (dbi_stream.get() == NULL || !dbi_stream->Seek(0) ||
+      !dbi_stream->Read(&dbi_header, 1)) {
+    LOG(ERROR) << "Unable to read the Dbi header.";
+    return false;
+  }
+
+  // The stream indices are -1 when the streams don't exist.
+  if (dbi_header.symbol_record_stream < 0 ||
+      dbi_header.global_symbol_info_stream < 0 ||
+      dbi_header.public_symbol_info_stream < 0 ||
+      static_cast<size_t>(dbi_header.symbol_record_stream) >=
+          pdb_file.StreamCount() ||
+      static_cast<size_t>(dbi_header.global_symbol_info_stream) >=
+          pdb_file.StreamCount() ||
+      static_cast<size_t>(dbi_header.public_symbol_info_stream) >=
+          pdb_file.StreamCount()) {
+    LOG(ERROR) << "The PDB has no symbol info streams.";
+    return false;
+  }
+
+  scoped_refptr<PdbStream> symbol_record_stream =
+      pdb_file.GetStream(dbi_header.symbol_record_stream);
+  scoped_refptr<PdbStream> global_symbol_info_stream =
+      pdb_file.GetStream(dbi_header.global_symbol_info_stream);
+  scoped_refptr<PdbStream> public_symbol_info_stream =
+      pdb_file.GetStream(dbi_header.public_symbol_info_stream);
+  if (symbol_record_stream.get() == NULL ||
+      global_symbol_info_stream.get() == NULL ||
+      public_symbol_info_stream.get() == NULL) {
+    LOG(ERROR) << "The PDB has empty symbol info streams.";
+    return false;
+  }
+
+  return Init(symbol_record_stream.get(),
+              global_symbol_info_stream.get(),
+              public_symbol_info_stream.get());
+}
+
+bool SymbolIndex::Init(PdbStream* symbol_record_stream,
+                       PdbStream* global_symbol_info_stream,
+                       PdbStream* public_symbol_info_stream) {
+  DCHECK(symbol_record_stream != NULL);
+  DCHECK(global_symbol_info_stream != NULL);
+  DCHECK(public_symbol_info_stream != NULL);
+
+  symbol_record_stream_ = symbol_record_stream;
+  public_symbols_.clear();
+
+  if (!global_symbol_info_stream->Seek(0) ||
+      !ReadHashTable(global_symbol_info_stream,
+                     global_symbol_info_stream->length(),
+                     &global_symbols_hash_)) {
+    LOG(ERROR) << "Unable to read the global symbol info stream.";
+    return false;
+  }
+
+  PublicSymbolInfoHeader header = {};
+  if (!public_symbol_info_stream->Seek(0) ||
+      !public_symbol_info_stream->Read(&header, 1) ||
+      !ReadHashTable(public_symbol_info_stream, header.hash_size,
+                     &public_symbols_hash_) ||
+      !ReadPublicSymbols(public_symbol_info_stream,
+                         header.address_map_size)) {
+    LOG(ERROR) << "Unable to read the public symbol info stream.";
+    return false;
+  }
+
+  return true;
+}
+
+bool SymbolIndex::GetSymbolRecord(uint32 record_offset,
+                                  SymbolRecord* record) const {
+  DCHECK(record != NULL);
+
+  uint16 len = 0;
+  uint16 symbol_type = 0;
+  if (!symbol_record_stream_->Seek(record_offset) ||
+      !symbol_record_stream_->Read(&len, 1) ||
+      len < sizeof(symbol_type) ||
+      !symbol_record_stream_->Read(&symbol_type, 1)) {
+    LOG(ERROR) << "Unable to read the symbol record at offset "
+               << record_offset << ".";
+    return false;
+  }
+
+  record->type = symbol_type;
+  record->start_position = symbol_record_stream_->pos();
+  record->len = len - sizeof(symbol_type);
+  return true;
+}
+
+bool SymbolIndex::GetSymbolName(const SymbolRecord& record,
+                                std::string* name) const {
+  DCHECK(name != NULL);
+
+  std::vector<uint8> data;
+  if (!symbol_record_stream_->Seek(record.start_position) ||
+      !symbol_record_stream_->Read(&data, record.len)) {
+    LOG(ERROR) << "Unable to read the symbol record at position "
+               << record.start_position << ".";
+    return false;
+  }
+
+  size_t offset = GetSymbolNameOffset(record.type, data);
+  if (offset == 0)
+    return false;
+
+  // The name is zero terminated.
+  std::vector<uint8>::const_iterator name_end =
+      std::find(data.begin() + offset, data.end(), 0);
+  if (name_end == data.end())
+    return false;
+
+  name->assign(data.begin() + offset, name_end);
+  return true;
+}
+
+bool SymbolIndex::FindSymbolsByName(const base::StringPiece& name,
+                                    SymbolRecordVector* records) const {
+  DCHECK(records != NULL);
+
+  records->clear();
+  if (symbol_record_stream_.get() == NULL) {
+    LOG(ERROR) << "The symbol index hasn't been initialized.";
+    return false;
+  }
+
+  FindSymbolsInHashTable(global_symbols_hash_, name, records);
+  FindSymbolsInHashTable(public_symbols_hash_, name, records);
+  return true;
+}
+
+bool SymbolIndex::FindPublicSymbol(uint16 section,
+                                   uint32 offset,
+                                   PublicSymbol* symbol) const {
+  DCHECK(symbol != NULL);
+
+  PublicSymbol address = { section, offset, 0 };
+  PublicSymbolVector::const_iterator it =
+      std::upper_bound(public_symbols_.begin(), public_symbols_.end(),
+                       address, PublicSymbolAddressLess);
+  if (it == public_symbols_.begin())
+    return false;
+
+  --it;
+  if (it->section != section)
+    return false;
+
+  *symbol = *it;
+  return true;
+}
+
+bool SymbolIndex::ReadHashTable(PdbStream* stream,
+                                size_t size,
+                                HashTable* table) {
+  DCHECK(stream != NULL);
+  DCHECK(table != NULL);
+
+  size_t table_start = stream->pos();
+  SymbolInfoHashHeader header = {};
+  if (!stream->Read(&header, 1)) {
+    LOG(ERROR) << "Unable to read the symbol info hash header.";
+    return false;
+  }
+
+  if (header.signature != kPdbSymbolInfoHashSignature ||
+      header.version != kPdbSymbolInfoHashVersion ||
+      header.hash_records_size % sizeof(SymbolInfoHashRecord) != 0 ||
+      sizeof(header) + header.hash_records_size + header.buckets_size !=
+          size) {
+    LOG(ERROR) << "Unsupported symbol info hash table.";
+    return false;
+  }
+
+  std::vector<SymbolInfoHashRecord> hash_records;
+  std::vector<uint32> bucket_bitmap;
+  if (!stream->Read(&hash_records,
+                    header.hash_records_size / sizeof(SymbolInfoHashRecord)) ||
+      !stream->Read(&bucket_bitmap, kNumBucketBitmapWords)) {
+    LOG(ERROR) << "Unable to read the symbol info hash records.";
+    return false;
+  }
+
+  // There's an offset for each bucket whose bit is set in the bitmap.
+  size_t buckets_end = table_start + size;
+  size_t num_non_empty_buckets = (buckets_end - stream->pos()) / sizeof(uint32);
+  std::vector<uint32> first_records;
+  if (!stream->Read(&first_records, num_non_empty_buckets) ||
+      stream->pos() != buckets_end) {
+    LOG(ERROR) << "Unable to read the symbol info hash buckets.";
+    return false;
+  }
+
+  // Convert the sparse buckets to dense offsets into record_offsets. Empty
+  // buckets start where the next non-empty bucket starts.
+  std::vector<uint32> bucket_offsets(kPdbSymbolInfoHashBuckets + 1,
+                                     hash_records.size());
+  size_t non_empty_bucket = 0;
+  for (size_t i = 0; i < kPdbSymbolInfoHashBuckets; ++i) {
+    if ((bucket_bitmap[i / 32] & (1U << (i % 32))) == 0)
+      continue;
+    if (non_empty_bucket == first_records.size()) {
+      LOG(ERROR) << "Too many non-empty symbol info hash buckets.";
+      return false;
+    }
+    uint32 first_record =
+        first_records[non_empty_bucket++] / kHashRecordInMemorySize;
+    if (first_record > hash_records.size()) {
+      LOG(ERROR) << "Invalid symbol info hash bucket offset.";
+      return false;
+    }
+    bucket_offsets[i] = first_record;
+  }
+  for (size_t i = kPdbSymbolInfoHashBuckets; i > 0; --i) {
+    if (bucket_offsets[i - 1] > bucket_offsets[i])
+      bucket_offsets[i - 1] = bucket_offsets[i];
+  }
+
+  // The offsets of the hash records are biased by one.
+  std::vector<uint32> record_offsets(hash_records.size());
+  for (size_t i = 0; i < hash_records.size(); ++i) {
+    if (hash_records[i].offset == 0) {
+      LOG(ERROR) << "Invalid symbol info hash record.";
+      return false;
+    }
+    record_offsets[i] = hash_records[i].offset - 1;
+  }
+
+  table->bucket_offsets.swap(bucket_offsets);
+  table->record_offsets.swap(record_offsets);
+  return true;
+}
+
+bool SymbolIndex::ReadPublicSymbols(PdbStream* stream, size_t size) {
+  DCHECK(stream != NULL);
+
+  std::vector<uint32> address_map;
+  if (size % sizeof(uint32) != 0 ||
+      !stream->Read(&address_map, size / sizeof(uint32))) {
+    LOG(ERROR) << "Unable to read the public symbol address map.";
+    return false;
+  }
+
+  public_symbols_.reserve(address_map.size());
+  for (size_t i = 0; i < address_map.size(); ++i) {
+    SymbolRecord record = {};
+    uint32 flags = 0;
+    PublicSymbol entry = {};
+    entry.record_offset = address_map[i];
+    if (!GetSymbolRecord(entry.record_offset, &record) ||
+        record.type != cci::S_PUB32 ||
+        !symbol_record_stream_->Read(&flags, 1) ||
+        !symbol_record_stream_->Read(&entry.offset, 1) ||
+        !symbol_record_stream_->Read(&entry.section, 1)) {
+      LOG(ERROR) << "Unable to read a public symbol record.";
+      return false;
+    }
+
+    public_symbols_.push_back(entry);
+  }
+
+  // The address map should already be sorted, but the lookups rely on it.
+  std::stable_sort(public_symbols_.begin(), public_symbols_.end(),
+                   PublicSymbolAddressLess);
+  return true;
+}
+
+void SymbolIndex::FindSymbolsInHashTable(const HashTable& table,
+                                         const base::StringPiece& name,
+                                         SymbolRecordVector* records) const {
+  DCHECK(records != NULL);
+
+  if (table.bucket_offsets.empty())
+    return;
+
+  // Only the symbols in the bucket of the name are candidates.
+  size_t bucket = HashString(name) % kPdbSymbolInfoHashBuckets;
+  std::string symbol_name;
+  for (size_t i = table.bucket_offsets[bucket];
+       i < table.bucket_offsets[bucket + 1]; ++i) {
+    SymbolRecord record = {};
+    if (GetSymbolRecord(table.record_offsets[i], &record) &&
+        GetSymbolName(record, &symbol_name) && name == symbol_name) {
+      records->push_back(record);
+    }
+  }
+}
+
+}  // namespace pdb
@@ -0,0 +1,148 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Declares SymbolIndex, which looks up the global and public symbols of a PDB
+// by name and by address using the hash tables and the address map of its
+// global and public symbol info streams.
+
+#ifndef SYZYGY_PDB_PDB_SYMBOL_INDEX_H_
+#define SYZYGY_PDB_PDB_SYMBOL_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+#include "syzygy/pdb/pdb_data_types.h"
+#include "syzygy/pdb/pdb_stream.h"
+
+namespace pdb {
+
+// Forward declarations.
+class PdbFile;
+
+// An index of the global and public symbols of a PDB. Building it reads the
+// name hash tables of the global and public symbol info streams and the
+// address of every public symbol; the symbol records themselves are read from
+// the symbol record stream when they're looked up.
+class SymbolIndex {
+ public:
+  // An entry of the address table of the public symbols.
+  struct PublicSymbol {
+    uint16 section;
+    uint32 offset;
+    // The offset of the symbol in the symbol record stream.
+    uint32 record_offset;
+  };
+  typedef std::vector<PublicSymbol> PublicSymbolVector;
+
+  SymbolIndex();
+  ~SymbolIndex();
+
+  // Indexes the symbols of a PDB file, using the streams referred to by its
+  // Dbi header.
+  // @param pdb_file the PDB file. A reference to its symbol record stream is
+  //     kept to read the records on demand.
+  // @returns true on success, false otherwise.
+  bool Init(const PdbFile& pdb_file);
+
+  // Indexes the symbols of a PDB.
+  // @param symbol_record_stream the symbol record stream. A reference to it is
+  //     kept to read the records on demand.
+  // @param global_symbol_info_stream the global symbol info stream.
+  // @param public_symbol_info_stream the public symbol info stream.
+  // @returns true on success, false otherwise.
+  bool Init(PdbStream* symbol_record_stream,
+            PdbStream* global_symbol_info_stream,
+            PdbStream* public_symbol_info_stream);
+
+  // @returns the public symbols, sorted by address.
+  const PublicSymbolVector& public_symbols() const { return public_symbols_; }
+
+  // Reads the header of a symbol record.
+  // @param record_offset the offset of the record in the symbol record stream.
+  // @param record receives the header of the symbol record.
+  // @returns true on success, false otherwise.
+  bool GetSymbolRecord(uint32 record_offset, SymbolRecord* record) const;
+
+  // Reads the name of a symbol. This supports the records found in the symbol
+  // info streams, e.g. public, data, procedure reference, constant and
+  // user-defined type symbols.
+  // @param record the header of the symbol record.
+  // @param name receives the name of the symbol.
+  // @returns true on success, false if the record has no supported name or
+  //     can't be read.
+  bool GetSymbolName(const SymbolRecord& record, std::string* name) const;
+
+  // Finds the global and public symbols with a given name.
+  // @param name the name of the symbols to find.
+  // @param records receives the headers of the matching symbol records.
+  // @returns true on success, false otherwise.
+  bool FindSymbolsByName(const base::StringPiece& name,
+                         SymbolRecordVector* records) const;
+
+  // Finds the public symbol containing an address, i.e. the last public
+  // symbol of the section at or before the address.
+  // @param section the section of the address.
+  // @param offset the offset of the address in @p section.
+  // @param symbol receives the public symbol.
+  // @returns true if there's such a symbol, false otherwise.
+  bool FindPublicSymbol(uint16 section,
+                        uint32 offset,
+                        PublicSymbol* symbol) const;
+
+ private:
+  // A name hash table, with the symbols grouped by bucket. The symbols in
+  // bucket i are at record_offsets[bucket_offsets[i], bucket_offsets[i + 1]).
+  struct HashTable {
+    std::vector<uint32> bucket_offsets;
+    std::vector<uint32> record_offsets;
+  };
+
+  // Reads a name hash table.
+  // @param stream the stream containing the table, positioned at its header.
+  // @param size the size of the table.
+  // @param table receives the table.
+  // @returns true on success, false otherwise.
+  static bool ReadHashTable(PdbStream* stream, size_t size, HashTable* table);
+
+  // Reads the address table of the public symbols.
+  // @param stream the public symbol info stream, positioned at its address
+  //     map.
+  // @param size the size of the address map.
+  // @returns true on success, false otherwise.
+  bool ReadPublicSymbols(PdbStream* stream, size_t size);
+
+  // Appends the symbols of a hash table with a given name to @p records.
+  void FindSymbolsInHashTable(const HashTable& table,
+                              const base::StringPiece& name,
+                              SymbolRecordVector* records) const;
+
+  // The symbol record stream.
+  scoped_refptr<PdbStream> symbol_record_stream_;
+
+  // The name hash tables of the global and public symbols.
+  HashTable global_symbols_hash_;
+  HashTable public_symbols_hash_;
+
+  // The address table of the public symbols.
+  PublicSymbolVector public_symbols_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolIndex);
+};
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_SYMBOL_INDEX_H_
@@ -0,0 +1,134 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_symbol_index.h"
+
+#include "gtest/gtest.h"
+#include "syzygy/core/unittest_util.h"
+#include "syzygy/pdb/pdb_file.h"
+#include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/unittest_util.h"
+#include "third_party/cci/files/cvinfo.h"
+
+namespace pdb {
+
+namespace {
+
+namespace cci = Microsoft_Cci_Pdb;
+
+class PdbSymbolIndexTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    PdbReader reader;
+    ASSERT_TRUE(reader.Read(
+        testing::GetSrcRelativePath(testing::kTestPdbFilePath),
+        &pdb_file_));
+    ASSERT_TRUE(index_.Init(pdb_file_));
+  }
+
+ protected:
+  PdbFile pdb_file_;
+  SymbolIndex index_;
+};
+
+}  // namespace
+
+TEST_F(PdbSymbolIndexTest, PublicSymbolsAreSorted) {
+  const SymbolIndex::PublicSymbolVector& symbols = index_.public_symbols();
+  ASSERT_FALSE(symbols.empty());
+
+  for (size_t i = 1; i < symbols.size(); ++i) {
+    EXPECT_TRUE(symbols[i - 1].section < symbols[i].section ||
+                (symbols[i - 1].section == symbols[i].section &&
+                 symbols[i - 1].offset <= symbols[i].offset));
+  }
+}
+
+TEST_F(PdbSymbolIndexTest, FindPublicSymbol) {
+  // _DllMain@12 is at the beginning of the first section.
+  SymbolIndex::PublicSymbol symbol = {};
+  ASSERT_TRUE(index_.FindPublicSymbol(1, 0, &symbol));
+  EXPECT_EQ(1, symbol.section);
+  EXPECT_EQ(0U, symbol.offset);
+
+  SymbolRecord record = {};
+  std::string name;
+  ASSERT_TRUE(index_.GetSymbolRecord(symbol.record_offset, &record));
+  EXPECT_EQ(cci::S_PUB32, record.type);
+  ASSERT_TRUE(index_.GetSymbolName(record, &name));
+  EXPECT_EQ("_DllMain@12", name);
+
+  // An address inside of the function resolves to the same symbol.
+  SymbolIndex::PublicSymbol inner_symbol = {};
+  ASSERT_TRUE(index_.FindPublicSymbol(1, 1, &inner_symbol));
+  EXPECT_EQ(symbol.record_offset, inner_symbol.record_offset);
+
+  // There's nothing before the first symbol of a section.
+  EXPECT_FALSE(index_.FindPublicSymbol(0, 0, &symbol));
+}
+
+TEST_F(PdbSymbolIndexTest, FindEveryPublicSymbol) {
+  const SymbolIndex::PublicSymbolVector& symbols = index_.public_symbols();
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    SymbolIndex::PublicSymbol symbol = {};
+    ASSERT_TRUE(index_.FindPublicSymbol(symbols[i].section,
+                                        symbols[i].offset,
+                                        &symbol));
+    EXPECT_EQ(symbols[i].section, symbol.section);
+    EXPECT_EQ(symbols[i].offset, symbol.offset);
+
+    // Every public symbol can also be found by name.
+    SymbolRecord record = {};
+    std::string name;
+    SymbolRecordVector records;
+    ASSERT_TRUE(index_.GetSymbolRecord(symbols[i].record_offset, &record));
+    ASSERT_TRUE(index_.GetSymbolName(record, &name));
+    ASSERT_TRUE(index_.FindSymbolsByName(name, &records));
+    EXPECT_FALSE(records.empty());
+  }
+}
+
+TEST_F(PdbSymbolIndexTest, FindSymbolsByName) {
+  SymbolRecordVector records;
+  ASSERT_TRUE(index_.FindSymbolsByName("_DllMain@12", &records));
+  ASSERT_EQ(1U, records.size());
+  EXPECT_EQ(cci::S_PUB32, records[0].type);
+
+  ASSERT_TRUE(index_.FindSymbolsByName("__newclmap", &records));
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ(cci::S_GDATA32, records[0].type);
+  EXPECT_EQ(cci::S_GDATA32, records[1].type);
+
+  ASSERT_TRUE(index_.FindSymbolsByName("wchar_t", &records));
+  ASSERT_EQ(1U, records.size());
+  EXPECT_EQ(cci::S_UDT, records[0].type);
+
+  ASSERT_TRUE(index_.FindSymbolsByName("_RTC_ILLEGAL", &records));
+  ASSERT_EQ(1U, records.size());
+  EXPECT_EQ(cci::S_CONSTANT, records[0].type);
+
+  ASSERT_TRUE(index_.FindSymbolsByName("ThisSymbolDoesNotExist", &records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST(PdbSymbolIndexInitTest, FailsWithoutSymbolStreams) {
+  PdbFile pdb_file;
+  SymbolIndex index;
+  EXPECT_FALSE(index.Init(pdb_file));
+
+  SymbolRecordVector records;
+  EXPECT_FALSE(index.FindSymbolsByName("_DllMain@12", &records));
+}
+
+}  // namespace pdb
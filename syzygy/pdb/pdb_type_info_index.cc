@@ -0,0 +1,290 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_type_info_index.h"
+
+#include <stddef.h>
+#include <algorithm>
+
+#include "base/logging.h"
+#include "syzygy/pdb/pdb_util.h"
+#include "third_party/cci/files/cvinfo.h"
+
+namespace pdb {
+
+namespace cci = Microsoft_Cci_Pdb;
+
+namespace {
+
+// Returns the offset of the name in the leaf of a user-defined type, or 0 if
+// this isn't a user-defined type or its leaf can't be parsed.
+size_t GetTypeNameOffset(uint16 type, const std::vector<uint8>& data) {
+  // The fields preceding the size of the type, or its name for enums.
+  size_t offset = 0;
+  bool has_size = true;
+  switch (type) {
+    case cci::LF_CLASS:
+    case cci::LF_STRUCTURE:
+      offset = offsetof(cci::LeafClass, data);
+      break;
+    case cci::LF_UNION:
+      offset = offsetof(cci::LeafUnion, data);
+      break;
+    case cci::LF_ENUM:
+      offset = offsetof(cci::LeafEnum, name);
+      has_size = false;
+      break;
+    default:
+      return 0;
+  }
+
+  if (offset >= data.size())
+    return 0;
+
+  if (has_size) {
+    size_t size_leaf_size = GetNumericLeafSize(&data[offset],
+                                               data.size() - offset);
+    if (size_leaf_size == 0)
+      return 0;
+    offset += size_leaf_size;
+  }
+
+  return offset;
+}
+
+// Returns true if the leaf of a user-defined type is a forward reference.
+bool IsForwardReference(const std::vector<uint8>& data) {
+  // The property field is at the same offset for classes, structures, unions
+  // and enums.
+  COMPILE_ASSERT(offsetof(cci::LeafClass, property) ==
+                     offsetof(cci::LeafUnion, property) &&
+                 offsetof(cci::LeafClass, property) ==
+                     offsetof(cci::LeafEnum, property),
+                 property_offsets_differ);
+  size_t offset = offsetof(cci::LeafClass, property);
+  if (offset + sizeof(uint16) > data.size())
+    return false;
+
+  uint16 property = *reinterpret_cast<const uint16*>(&data[offset]);
+  return (property & cci::fwdref) != 0;
+}
+
+}  // namespace
+
+TypeInfoIndex::TypeInfoIndex() {
+  memset(&header_, 0, sizeof(header_));
+}
+
+TypeInfoIndex::~TypeInfoIndex() {
+}
+
+bool TypeInfoIndex::Init(PdbStream* stream) {
+  DCHECK(stream != NULL);
+
+  stream_ = stream;
+  records_.clear();
+  bucket_offsets_.clear();
+  bucket_types_.clear();
+
+  if (!stream->Seek(0) || !stream->Read(&header_, 1)) {
+    LOG(ERROR) << "Unable to read the type info stream header.";
+    return false;
+  }
+
+  size_t type_info_data_end = header_.len + header_.type_info_data_size;
+  if (header_.type_max < header_.type_min ||
+      type_info_data_end != stream->length() ||
+      !stream->Seek(header_.len)) {
+    LOG(ERROR) << "The type info stream is not valid.";
+    return false;
+  }
+
+  // The records are stored in increasing type ID order, so their position in
+  // the index gives their type ID.
+  records_.reserve(header_.type_max - header_.type_min);
+  while (stream->pos() < type_info_data_end) {
+    uint16 len = 0;
+    uint16 record_type = 0;
+    size_t record_start = stream->pos() + sizeof(len);
+    if (!stream->Read(&len, 1) || len < sizeof(record_type) ||
+        !stream->Read(&record_type, 1)) {
+      LOG(ERROR) << "Unable to read a type info record header.";
+      return false;
+    }
+
+    TypeInfoRecord record;
+    record.type = record_type;
+    record.start_position = stream->pos();
+    record.len = len - sizeof(record_type);
+    records_.push_back(record);
+
+    if (!stream->Seek(record_start + len)) {
+      LOG(ERROR) << "Unable to seek to the end of the type info record.";
+      return false;
+    }
+  }
+
+  if (records_.size() != header_.type_max - header_.type_min) {
+    LOG(ERROR) << "Unexpected number of type info records in the type info "
+               << "stream (expected " << header_.type_max - header_.type_min
+               << ", read " << records_.size() << ").";
+    return false;
+  }
+
+  return true;
+}
+
+bool TypeInfoIndex::InitHashes(PdbStream* hash_stream) {
+  DCHECK(hash_stream != NULL);
+
+  const TypeInfoHashHeader& hash_header = header_.type_info_hash;
+  if (hash_header.hash_key != sizeof(uint32) ||
+      hash_header.cb_hash_buckets == 0 ||
+      hash_header.offset_cb_hash_vals.cb != records_.size() * sizeof(uint32)) {
+    LOG(ERROR) << "Unsupported type info hash stream.";
+    return false;
+  }
+
+  std::vector<uint32> hash_values;
+  if (!hash_stream->Seek(hash_header.offset_cb_hash_vals.offset) ||
+      !hash_stream->Read(&hash_values, records_.size())) {
+    LOG(ERROR) << "Unable to read the type info hash values.";
+    return false;
+  }
+
+  // Group the type IDs by bucket with a counting sort.
+  size_t num_buckets = hash_header.cb_hash_buckets;
+  std::vector<uint32> bucket_offsets(num_buckets + 1, 0);
+  for (size_t i = 0; i < hash_values.size(); ++i) {
+    if (hash_values[i] >= num_buckets) {
+      LOG(ERROR) << "Invalid type info hash value.";
+      return false;
+    }
+    ++bucket_offsets[hash_values[i] + 1];
+  }
+  for (size_t i = 1; i <= num_buckets; ++i)
+    bucket_offsets[i] += bucket_offsets[i - 1];
+
+  std::vector<uint32> bucket_types(hash_values.size());
+  std::vector<uint32> next(bucket_offsets.begin(), bucket_offsets.end() - 1);
+  for (size_t i = 0; i < hash_values.size(); ++i)
+    bucket_types[next[hash_values[i]]++] = header_.type_min + i;
+
+  bucket_offsets_.swap(bucket_offsets);
+  bucket_types_.swap(bucket_types);
+  return true;
+}
+
+bool TypeInfoIndex::GetTypeRecord(uint32 type_id,
+                                  TypeInfoRecord* record) const {
+  DCHECK(record != NULL);
+
+  if (type_id < header_.type_min || type_id - header_.type_min >= size())
+    return false;
+
+  *record = records_[type_id - header_.type_min];
+  return true;
+}
+
+bool TypeInfoIndex::ReadTypeRecordData(uint32 type_id,
+                                       std::vector<uint8>* data) const {
+  DCHECK(data != NULL);
+
+  TypeInfoRecord record = {};
+  if (!GetTypeRecord(type_id, &record))
+    return false;
+
+  if (!stream_->Seek(record.start_position) ||
+      !stream_->Read(data, record.len)) {
+    LOG(ERROR) << "Unable to read type info record " << type_id << ".";
+    return false;
+  }
+
+  return true;
+}
+
+bool TypeInfoIndex::GetTypeName(uint32 type_id, std::string* name) const {
+  DCHECK(name != NULL);
+
+  bool is_forward_reference = false;
+  return ReadTypeName(type_id, name, &is_forward_reference);
+}
+
+bool TypeInfoIndex::ReadTypeName(uint32 type_id,
+                                 std::string* name,
+                                 bool* is_forward_reference) const {
+  DCHECK(name != NULL);
+  DCHECK(is_forward_reference != NULL);
+
+  TypeInfoRecord record = {};
+  if (!GetTypeRecord(type_id, &record))
+    return false;
+
+  // Only read the records of user-defined types.
+  switch (record.type) {
+    case cci::LF_CLASS:
+    case cci::LF_STRUCTURE:
+    case cci::LF_UNION:
+    case cci::LF_ENUM:
+      break;
+    default:
+      return false;
+  }
+
+  std::vector<uint8> data;
+  if (!ReadTypeRecordData(type_id, &data))
+    return false;
+
+  size_t offset = GetTypeNameOffset(record.type, data);
+  if (offset == 0)
+    return false;
+
+  // The name is zero terminated.
+  std::vector<uint8>::const_iterator name_end =
+      std::find(data.begin() + offset, data.end(), 0);
+  if (name_end == data.end())
+    return false;
+
+  name->assign(data.begin() + offset, name_end);
+  *is_forward_reference = IsForwardReference(data);
+  return true;
+}
+
+bool TypeInfoIndex::FindTypesByName(const base::StringPiece& name,
+                                    std::vector<uint32>* type_ids) const {
+  DCHECK(type_ids != NULL);
+
+  type_ids->clear();
+  if (!has_hashes()) {
+    LOG(ERROR) << "The type info hash values haven't been read.";
+    return false;
+  }
+
+  // Only the types in the bucket of the name are candidates.
+  size_t bucket = HashString(name) % header_.type_info_hash.cb_hash_buckets;
+  std::string type_name;
+  bool is_forward_reference = false;
+  for (size_t i = bucket_offsets_[bucket]; i < bucket_offsets_[bucket + 1];
+       ++i) {
+    uint32 type_id = bucket_types_[i];
+    if (ReadTypeName(type_id, &type_name, &is_forward_reference) &&
+        !is_forward_reference && name == type_name) {
+      type_ids->push_back(type_id);
+    }
+  }
+
+  return true;
+}
+
+}  // namespace pdb
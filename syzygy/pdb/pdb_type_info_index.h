@@ -0,0 +1,131 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Declares TypeInfoIndex, which gives random access to the records of the
+// type info stream of a PDB.
+
+#ifndef SYZYGY_PDB_PDB_TYPE_INFO_INDEX_H_
+#define SYZYGY_PDB_PDB_TYPE_INFO_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+#include "syzygy/pdb/pdb_data.h"
+#include "syzygy/pdb/pdb_data_types.h"
+#include "syzygy/pdb/pdb_stream.h"
+
+namespace pdb {
+
+// An index of the records of a type info stream. Building it only reads the
+// record headers; the records themselves are read from the stream when
+// they're looked up. The index can also use the hash values of the type info
+// hash stream to find user-defined types by name without parsing every
+// record.
+class TypeInfoIndex {
+ public:
+  TypeInfoIndex();
+  ~TypeInfoIndex();
+
+  // Indexes the records of a type info stream.
+  // @param stream the type info stream. A reference to it is kept to read the
+  //     records on demand.
+  // @returns true on success, false otherwise.
+  bool Init(PdbStream* stream);
+
+  // Reads the hash values of the type records, enabling FindTypesByName.
+  // @param hash_stream the type info hash stream, whose index is given by
+  //     header().type_info_hash.stream_number.
+  // @returns true on success, false otherwise.
+  bool InitHashes(PdbStream* hash_stream);
+
+  // @returns the header of the type info stream.
+  const TypeInfoHeader& header() const { return header_; }
+
+  // @returns the number of type records in the stream.
+  size_t size() const { return records_.size(); }
+
+  // @returns true if the hash values of the type records have been read.
+  bool has_hashes() const { return !bucket_offsets_.empty(); }
+
+  // Looks up the header of a type record in constant time.
+  // @param type_id the ID of the type.
+  // @param record receives the header of the type record.
+  // @returns true on success, false if there's no such type.
+  bool GetTypeRecord(uint32 type_id, TypeInfoRecord* record) const;
+
+  // Reads the data of a type record, e.g. the leaf following its type.
+  // @param type_id the ID of the type.
+  // @param data receives the data of the type record.
+  // @returns true on success, false otherwise.
+  bool ReadTypeRecordData(uint32 type_id, std::vector<uint8>* data) const;
+
+  // Reads the name of a user-defined type, e.g. a class, structure, union or
+  // enumeration.
+  // @param type_id the ID of the type.
+  // @param name receives the name of the type.
+  // @returns true on success, false if this isn't a user-defined type or its
+  //     record can't be read.
+  bool GetTypeName(uint32 type_id, std::string* name) const;
+
+  // Finds the definitions of the user-defined types with a given name. This
+  // requires InitHashes to have been called. Only the records the compiler
+  // hashed by their name can be found: the definitions of named types that
+  // aren't local to a function, whether or not they also have a unique
+  // (decorated) name. The other records are hashed by their unique name or
+  // by a CRC of the record, and aren't found by their plain name:
+  // - forward references;
+  // - definitions of anonymous types, such as "<unnamed-tag>";
+  // - definitions of types local to a function, which have a unique name.
+  // @param name the name of the types to find.
+  // @param type_ids receives the IDs of the matching types.
+  // @returns true on success, false otherwise.
+  bool FindTypesByName(const base::StringPiece& name,
+                       std::vector<uint32>* type_ids) const;
+
+ private:
+  // Reads the name of a user-defined type, and whether its record is a
+  // forward reference.
+  // @param type_id the ID of the type.
+  // @param name receives the name of the type.
+  // @param is_forward_reference receives true if the record is a forward
+  //     reference.
+  // @returns true on success, false if this isn't a user-defined type or its
+  //     record can't be read.
+  bool ReadTypeName(uint32 type_id,
+                    std::string* name,
+                    bool* is_forward_reference) const;
+
+  // The type info stream.
+  scoped_refptr<PdbStream> stream_;
+
+  // The header of the type info stream.
+  TypeInfoHeader header_;
+
+  // The headers of the type records, indexed by type ID - type_min.
+  std::vector<TypeInfoRecord> records_;
+
+  // The type IDs grouped by hash bucket. The IDs of the types in bucket i are
+  // bucket_types_[bucket_offsets_[i], bucket_offsets_[i + 1]).
+  std::vector<uint32> bucket_offsets_;
+  std::vector<uint32> bucket_types_;
+
+  DISALLOW_COPY_AND_ASSIGN(TypeInfoIndex);
+};
+
+}  // namespace pdb
+
+#endif  // SYZYGY_PDB_PDB_TYPE_INFO_INDEX_H_
@@ -0,0 +1,178 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "syzygy/pdb/pdb_type_info_index.h"
+
+#include "gtest/gtest.h"
+#include "syzygy/core/unittest_util.h"
+#include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/pdb_type_info_stream.h"
+#include "syzygy/pdb/unittest_util.h"
+
+namespace pdb {
+
+namespace {
+
+// The ID of the definition of _GUID in test_dll.pdb.
+const uint32 kGuidTypeId = 0x1034;
+
+// The ID of the definition of vc_attributes::YesNoMaybe in test_dll.pdb,
+// which also has the unique name "W4YesNoMaybe@vc_attributes@@".
+const uint32 kYesNoMaybeTypeId = 0x1001;
+
+class PdbTypeInfoIndexTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    PdbReader reader;
+    ASSERT_TRUE(reader.Read(
+        testing::GetSrcRelativePath(testing::kTestPdbFilePath),
+        &pdb_file_));
+    type_info_stream_ = pdb_file_.GetStream(kTpiStream);
+    ASSERT_TRUE(type_info_stream_ != NULL);
+  }
+
+ protected:
+  PdbFile pdb_file_;
+  PdbStream* type_info_stream_;
+};
+
+}  // namespace
+
+TEST_F(PdbTypeInfoIndexTest, InitMatchesReadTypeInfoStream) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+
+  TypeInfoHeader header = {};
+  TypeInfoRecordMap types_map;
+  ASSERT_TRUE(ReadTypeInfoStream(type_info_stream_, &header, &types_map));
+
+  EXPECT_EQ(0, memcmp(&header, &index.header(), sizeof(header)));
+  ASSERT_EQ(types_map.size(), index.size());
+
+  TypeInfoRecordMap::const_iterator it = types_map.begin();
+  for (; it != types_map.end(); ++it) {
+    TypeInfoRecord record = {};
+    ASSERT_TRUE(index.GetTypeRecord(it->first, &record));
+    EXPECT_EQ(it->second.start_position, record.start_position);
+    EXPECT_EQ(it->second.len, record.len);
+    EXPECT_EQ(it->second.type, record.type);
+  }
+}
+
+TEST_F(PdbTypeInfoIndexTest, GetTypeRecordOutOfRange) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+
+  TypeInfoRecord record = {};
+  EXPECT_FALSE(index.GetTypeRecord(index.header().type_min - 1, &record));
+  EXPECT_FALSE(index.GetTypeRecord(index.header().type_max, &record));
+  EXPECT_TRUE(index.GetTypeRecord(index.header().type_max - 1, &record));
+
+  std::vector<uint8> data;
+  EXPECT_FALSE(index.ReadTypeRecordData(index.header().type_max, &data));
+}
+
+TEST_F(PdbTypeInfoIndexTest, GetTypeName) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+
+  std::string name;
+  EXPECT_TRUE(index.GetTypeName(kGuidTypeId, &name));
+  EXPECT_EQ("_GUID", name);
+}
+
+TEST_F(PdbTypeInfoIndexTest, FindTypesByName) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+
+  // The hash values haven't been read yet.
+  std::vector<uint32> type_ids;
+  EXPECT_FALSE(index.has_hashes());
+  EXPECT_FALSE(index.FindTypesByName("_GUID", &type_ids));
+
+  PdbStream* hash_stream =
+      pdb_file_.GetStream(index.header().type_info_hash.stream_number);
+  ASSERT_TRUE(hash_stream != NULL);
+  ASSERT_TRUE(index.InitHashes(hash_stream));
+  EXPECT_TRUE(index.has_hashes());
+
+  EXPECT_TRUE(index.FindTypesByName("_GUID", &type_ids));
+  ASSERT_EQ(1U, type_ids.size());
+  EXPECT_EQ(kGuidTypeId, type_ids[0]);
+
+  EXPECT_TRUE(index.FindTypesByName("ThisTypeDoesNotExist", &type_ids));
+  EXPECT_TRUE(type_ids.empty());
+}
+
+TEST_F(PdbTypeInfoIndexTest, FindTypesByNameSkipsForwardReferences) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+  PdbStream* hash_stream =
+      pdb_file_.GetStream(index.header().type_info_hash.stream_number);
+  ASSERT_TRUE(hash_stream != NULL);
+  ASSERT_TRUE(index.InitHashes(hash_stream));
+
+  // vc_attributes::YesNoMaybe has a forward reference as well as its
+  // definition. The forward reference is hashed by a CRC of its record rather
+  // than by name, so only the definition is found.
+  std::vector<uint32> named_type_ids;
+  std::string name;
+  for (uint32 type_id = index.header().type_min;
+       type_id < index.header().type_max; ++type_id) {
+    if (index.GetTypeName(type_id, &name) &&
+        name == "vc_attributes::YesNoMaybe") {
+      named_type_ids.push_back(type_id);
+    }
+  }
+  ASSERT_EQ(2U, named_type_ids.size());
+
+  std::vector<uint32> type_ids;
+  ASSERT_TRUE(index.FindTypesByName("vc_attributes::YesNoMaybe", &type_ids));
+  ASSERT_EQ(1U, type_ids.size());
+  EXPECT_EQ(kYesNoMaybeTypeId, type_ids[0]);
+}
+
+TEST_F(PdbTypeInfoIndexTest, FindTypesByNameWithUniqueNames) {
+  TypeInfoIndex index;
+  ASSERT_TRUE(index.Init(type_info_stream_));
+  PdbStream* hash_stream =
+      pdb_file_.GetStream(index.header().type_info_hash.stream_number);
+  ASSERT_TRUE(hash_stream != NULL);
+  ASSERT_TRUE(index.InitHashes(hash_stream));
+
+  // A named type that isn't local to a function is hashed by its plain name,
+  // even though it has a unique name.
+  std::string name;
+  ASSERT_TRUE(index.GetTypeName(kYesNoMaybeTypeId, &name));
+  EXPECT_EQ("vc_attributes::YesNoMaybe", name);
+  std::vector<uint32> type_ids;
+  ASSERT_TRUE(index.FindTypesByName(name, &type_ids));
+  ASSERT_EQ(1U, type_ids.size());
+  EXPECT_EQ(kYesNoMaybeTypeId, type_ids[0]);
+
+  // Anonymous types also have a unique name, but they're hashed by a CRC of
+  // their record, so none of them is found by name.
+  size_t num_anonymous_types = 0;
+  for (uint32 type_id = index.header().type_min;
+       type_id < index.header().type_max; ++type_id) {
+    if (index.GetTypeName(type_id, &name) && name == "<unnamed-tag>")
+      ++num_anonymous_types;
+  }
+  EXPECT_LT(0U, num_anonymous_types);
+  ASSERT_TRUE(index.FindTypesByName("<unnamed-tag>", &type_ids));
+  EXPECT_TRUE(type_ids.empty());
+}
+
+}  // namespace pdb
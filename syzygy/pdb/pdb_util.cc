@@ -21,6 +21,7 @@
 #include "syzygy/pdb/pdb_byte_stream.h"
 #include "syzygy/pdb/pdb_reader.h"
 #include "syzygy/pdb/pdb_writer.h"
+#include "third_party/cci/files/cvinfo.h"
 
 namespace pdb {
 
@@ -774,4 +775,90 @@ bool ReadStringTable(PdbStream* stream,
   return true;
 }
 
+bool ReadNameTable(const PdbFile& pdb_file, OffsetStringMap* name_table) {
+  DCHECK(name_table != NULL);
+
+  PdbInfoHeader70 pdb_header = {};
+  NameStreamMap name_stream_map;
+  if (!ReadHeaderInfoStream(pdb_file, &pdb_header, &name_stream_map))
+    return false;
+
+  NameStreamMap::const_iterator it =
+      name_stream_map.find(kPdbNameTableStreamName);
+  if (it == name_stream_map.end() || it->second >= pdb_file.StreamCount()) {
+    LOG(ERROR) << "No name table found.";
+    return false;
+  }
+
+  scoped_refptr<PdbStream> stream(pdb_file.GetStream(it->second));
+  if (stream.get() == NULL) {
+    LOG(ERROR) << "No name table found.";
+    return false;
+  }
+
+  return ReadStringTable(stream.get(), "Name table", 0, stream->length(),
+                         name_table);
+}
+
+uint32 HashString(const base::StringPiece& name) {
+  // This hashes the name 4 bytes at a time, then the remaining 2 bytes and
+  // the remaining byte.
+  const uint8* data = reinterpret_cast<const uint8*>(name.data());
+  size_t size = name.size();
+  uint32 hash = 0;
+
+  for (; size >= sizeof(uint32); size -= sizeof(uint32)) {
+    hash ^= *reinterpret_cast<const uint32*>(data);
+    data += sizeof(uint32);
+  }
+  if (size >= sizeof(uint16)) {
+    hash ^= *reinterpret_cast<const uint16*>(data);
+    data += sizeof(uint16);
+    size -= sizeof(uint16);
+  }
+  if (size == 1)
+    hash ^= *data;
+
+  hash |= 0x20202020;
+  hash ^= hash >> 11;
+  return hash ^ (hash >> 16);
+}
+
+size_t GetNumericLeafSize(const uint8* data, size_t size) {
+  DCHECK(data != NULL);
+
+  if (size < sizeof(uint16))
+    return 0;
+
+  uint16 leaf = *reinterpret_cast<const uint16*>(data);
+  // Small values are stored directly in the leaf.
+  if (leaf < Microsoft_Cci_Pdb::LF_NUMERIC)
+    return sizeof(leaf);
+
+  size_t value_size = 0;
+  switch (leaf) {
+    case Microsoft_Cci_Pdb::LF_CHAR:
+      value_size = 1;
+      break;
+    case Microsoft_Cci_Pdb::LF_SHORT:
+    case Microsoft_Cci_Pdb::LF_USHORT:
+      value_size = 2;
+      break;
+    case Microsoft_Cci_Pdb::LF_LONG:
+    case Microsoft_Cci_Pdb::LF_ULONG:
+      value_size = 4;
+      break;
+    case Microsoft_Cci_Pdb::LF_QUADWORD:
+    case Microsoft_Cci_Pdb::LF_UQUADWORD:
+      value_size = 8;
+      break;
+    default:
+      return 0;
+  }
+
+  if (size < sizeof(leaf) + value_size)
+    return 0;
+  return sizeof(leaf) + value_size;
+}
+
 }  // namespace pdb
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "base/file_path.h"
+#include "base/string_piece.h"
 #include "syzygy/pdb/pdb_data.h"
 
 namespace pdb {
@@ -180,6 +181,27 @@ bool ReadStringTable(PdbStream* stream,
                      size_t string_table_end,
                      OffsetStringMap* string_map);
 
+// Reads the name table of the given PDB file, which is found in the stream
+// named kPdbNameTableStreamName.
+// @param pdb_file the file to read from.
+// @param name_table the map to be filled, keyed by the offsets of the names in
+//     the table.
+// @returns true on success, false on error.
+bool ReadNameTable(const PdbFile& pdb_file, OffsetStringMap* name_table);
+
+// Computes the hash of a name, as used by the name hash tables of the type info
+// and symbol info streams. The hash is insensitive to the case of ASCII
+// letters; it must be reduced modulo the number of buckets of the table.
+// @param name the name to hash.
+// @returns the hash of @p name.
+uint32 HashString(const base::StringPiece& name);
+
+// Gets the size of a numeric leaf, as found in type and symbol records.
+// @param data the beginning of the numeric leaf.
+// @param size the number of bytes available at @p data.
+// @returns the size of the numeric leaf, or 0 if it can't be parsed.
+size_t GetNumericLeafSize(const uint8* data, size_t size);
+
 }  // namespace pdb
 
 #endif  // SYZYGY_PDB_PDB_UTIL_H_
@@ -27,6 +27,7 @@
 #include "gtest/gtest.h"
 #include "syzygy/core/unittest_util.h"
 #include "syzygy/pdb/pdb_byte_stream.h"
+#include "syzygy/pdb/pdb_constants.h"
 #include "syzygy/pdb/pdb_reader.h"
 #include "syzygy/pdb/pdb_writer.h"
 #include "syzygy/pdb/unittest_util.h"
@@ -833,4 +834,61 @@ TEST_F(PdbUtilTest, NamedStreamsWorkWithPdbStr) {
   }
 }
 
+TEST(HashStringTest, Values) {
+  // These values were worked out by hand from the algorithm. The hash tables
+  // of a PDB only hold hash values modulo their number of buckets, so they
+  // can't be read from one; MatchesTypeInfoHashValues checks a real entry.
+  EXPECT_EQ(0x20240400U, HashString(""));
+  EXPECT_EQ(0x20240441U, HashString("a"));
+  EXPECT_EQ(0x697820EFU, HashString("_GUID"));
+  EXPECT_EQ(0x222152E7U, HashString("_DllMain@12"));
+
+  // The hash is insensitive to the case of ASCII letters.
+  EXPECT_EQ(HashString("_GUID"), HashString("_guid"));
+}
+
+TEST(HashStringTest, MatchesTypeInfoHashValues) {
+  PdbReader reader;
+  PdbFile pdb_file;
+  ASSERT_TRUE(reader.Read(
+      testing::GetSrcRelativePath(testing::kTestPdbFilePath), &pdb_file));
+
+  PdbStream* type_info_stream = pdb_file.GetStream(kTpiStream);
+  ASSERT_TRUE(type_info_stream != NULL);
+  TypeInfoHeader header = {};
+  ASSERT_TRUE(type_info_stream->Read(&header, 1));
+  const TypeInfoHashHeader& hash_header = header.type_info_hash;
+  ASSERT_EQ(sizeof(uint32), hash_header.hash_key);
+  ASSERT_LT(0U, hash_header.cb_hash_buckets);
+
+  // The hash value of the definition of _GUID, which is type 0x1034 in
+  // test_dll.pdb, is the hash of its name modulo the number of buckets.
+  const uint32 kGuidTypeId = 0x1034;
+  PdbStream* hash_stream = pdb_file.GetStream(hash_header.stream_number);
+  ASSERT_TRUE(hash_stream != NULL);
+  ASSERT_TRUE(hash_stream->Seek(hash_header.offset_cb_hash_vals.offset +
+      (kGuidTypeId - header.type_min) * sizeof(uint32)));
+  uint32 hash_value = 0;
+  ASSERT_TRUE(hash_stream->Read(&hash_value, 1));
+  EXPECT_EQ(HashString("_GUID") % hash_header.cb_hash_buckets, hash_value);
+}
+
+TEST(GetNumericLeafSizeTest, Sizes) {
+  const uint8 kSmallValue[] = { 0x34, 0x12 };
+  const uint8 kChar[] = { 0x00, 0x80, 0xFF };
+  const uint8 kLong[] = { 0x03, 0x80, 0x01, 0x02, 0x03, 0x04 };
+  const uint8 kQuadWord[] = { 0x09, 0x80, 0, 0, 0, 0, 0, 0, 0, 0 };
+  const uint8 kReal32[] = { 0x05, 0x80, 0, 0, 0, 0 };
+
+  EXPECT_EQ(2U, GetNumericLeafSize(kSmallValue, sizeof(kSmallValue)));
+  EXPECT_EQ(3U, GetNumericLeafSize(kChar, sizeof(kChar)));
+  EXPECT_EQ(6U, GetNumericLeafSize(kLong, sizeof(kLong)));
+  EXPECT_EQ(10U, GetNumericLeafSize(kQuadWord, sizeof(kQuadWord)));
+
+  // Truncated and unsupported leaves can't be parsed.
+  EXPECT_EQ(0U, GetNumericLeafSize(kSmallValue, 1));
+  EXPECT_EQ(0U, GetNumericLeafSize(kLong, sizeof(kLong) - 1));
+  EXPECT_EQ(0U, GetNumericLeafSize(kReal32, sizeof(kReal32)));
+}
+
 }  // namespace pdb
@@ -14,9 +14,11 @@
 
 #include "syzygy/pdb/pdb_writer.h"
 
+#include "base/bind.h"
 #include "base/logging.h"
 #include "syzygy/pdb/pdb_constants.h"
 #include "syzygy/pdb/pdb_data.h"
+#include "syzygy/pdb/pdb_parallel_jobs.h"
 
 namespace pdb {
 
@@ -24,6 +26,65 @@ namespace {
 
 const uint32 kZeroBuffer[kPdbPageSize] = { 0 };
 
+// The maximum number of threads used to write in-memory streams.
+const size_t kMaxStreamWriterThreads = 4;
+
+// An in-memory stream to be written at a given offset of the output file.
+struct StreamWriteJob {
+  const uint8* data;
+  uint32 offset;
+  uint32 length;
+};
+typedef std::vector<StreamWriteJob> StreamWriteJobs;
+
+// Writes in-memory streams at their offsets in the output file. Several
+// writers share the same list of jobs, each through its own file handle.
+class StreamWriter : public ParallelJobWorker {
+ public:
+  StreamWriter(const FilePath* path, const StreamWriteJobs* jobs)
+      : path_(*path), jobs_(*jobs) {
+  }
+
+  virtual bool Start() OVERRIDE {
+    file_.reset(file_util::OpenFile(path_, "r+b"));
+    if (!file_.get()) {
+      LOG(ERROR) << "Failed to open '" << path_.value() << "'.";
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool RunJob(size_t job_index) OVERRIDE {
+    const StreamWriteJob& job = jobs_[job_index];
+    if (fseek(file_.get(), job.offset, SEEK_SET) != 0 ||
+        fwrite(job.data, 1, job.length, file_.get()) != job.length) {
+      LOG(ERROR) << "Error writing pdb stream to file";
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool Finish() OVERRIDE {
+    if (fflush(file_.get()) != 0) {
+      LOG(ERROR) << "Error flushing pdb streams to file";
+      return false;
+    }
+    return true;
+  }
+
+  static ParallelJobWorker* Create(const FilePath* path,
+                                   const StreamWriteJobs* jobs) {
+    return new StreamWriter(path, jobs);
+  }
+
+ private:
+  const FilePath& path_;
+  const StreamWriteJobs& jobs_;
+  file_util::ScopedFILE file_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamWriter);
+};
+
 }  // namespace
 
 PdbWriter::PdbWriter() {
@@ -39,38 +100,24 @@ bool PdbWriter::Write(const FilePath& pdb_path, const PdbFile& pdb_file) {
     return false;
   }
 
-  uint32 total_bytes = 0;
-
   // Reserve space for the header and free page map.
   // TODO(rogerm): The free page map is a kludge. This should be sized to
   // correspond to the file instead of just one page. It should be relocated
   // to the end and sized properly.
-  if (fseek(file_.get(), kPdbPageSize * 3, SEEK_SET) != 0) {
-    LOG(ERROR) << "Failed to reserve header and free page map.";
-    return false;
-  }
-  total_bytes += kPdbPageSize * 3;
+  uint32 total_bytes = kPdbPageSize * 3;
 
-  // Append all the streams after the header.
+  // Lay out all the streams after the header up front, so that they can be
+  // written in any order.
   StreamInfoList stream_info_list;
-  for (size_t i = 0; i < pdb_file.StreamCount(); ++i) {
-    PdbStream* stream = pdb_file.GetStream(i);
-    if (stream == NULL) {
-      // A null stream is treated as an empty one.
-      StreamInfo info = { total_bytes, 0 };
-      stream_info_list.push_back(info);
-    } else {
-      // Save the offset and length for later.
-      StreamInfo info = { total_bytes, stream->length() };
-      stream_info_list.push_back(info);
-
-      uint32 bytes_written = 0;
-      if (!AppendStream(stream, &bytes_written))
-        return false;
+  LayoutStreams(pdb_file, &stream_info_list, &total_bytes);
 
-      total_bytes += bytes_written;
-      DCHECK_EQ(0U, total_bytes % kPdbPageSize);
-    }
+  if (!WriteStreams(pdb_path, pdb_file, stream_info_list))
+    return false;
+
+  // The directory goes right after the streams.
+  if (fseek(file_.get(), total_bytes, SEEK_SET) != 0) {
+    LOG(ERROR) << "Failed to seek past the streams.";
+    return false;
   }
 
   // Map out the directory: i.e., pages on which the streams have been written.
@@ -98,6 +145,74 @@ bool PdbWriter::Write(const FilePath& pdb_path, const PdbFile& pdb_file) {
   return true;
 }
 
+void PdbWriter::LayoutStreams(const PdbFile& pdb_file,
+                              StreamInfoList* stream_info_list,
+                              uint32* total_bytes) {
+  DCHECK(stream_info_list != NULL);
+  DCHECK(total_bytes != NULL);
+  DCHECK_EQ(0U, *total_bytes % kPdbPageSize);
+
+  stream_info_list->clear();
+  stream_info_list->reserve(pdb_file.StreamCount());
+  for (size_t i = 0; i < pdb_file.StreamCount(); ++i) {
+    PdbStream* stream = pdb_file.GetStream(i);
+
+    // A null stream is treated as an empty one.
+    StreamInfo info = { *total_bytes, 0 };
+    if (stream != NULL)
+      info.length = stream->length();
+    stream_info_list->push_back(info);
+
+    *total_bytes += (info.length + kPdbPageSize - 1) / kPdbPageSize *
+        kPdbPageSize;
+  }
+}
+
+bool PdbWriter::WriteStreams(const FilePath& pdb_path,
+                             const PdbFile& pdb_file,
+                             const StreamInfoList& stream_info_list) {
+  DCHECK_EQ(pdb_file.StreamCount(), stream_info_list.size());
+
+  // Streams that are in memory can be written concurrently, as writing them
+  // doesn't touch the stream objects. The others are read through their
+  // streams, which aren't thread-safe, so they're written from this thread.
+  StreamWriteJobs jobs;
+  for (size_t i = 0; i < pdb_file.StreamCount(); ++i) {
+    PdbStream* stream = pdb_file.GetStream(i);
+    if (stream == NULL || stream->length() == 0)
+      continue;
+
+    const StreamInfo& info = stream_info_list[i];
+    const uint8* data = stream->GetContiguousData();
+    if (data != NULL) {
+      StreamWriteJob job = { data, info.offset, info.length };
+      jobs.push_back(job);
+      continue;
+    }
+
+    uint32 bytes_written = 0;
+    if (fseek(file_.get(), info.offset, SEEK_SET) != 0 ||
+        !AppendStream(stream, &bytes_written)) {
+      LOG(ERROR) << "Failed to write stream " << i << ".";
+      return false;
+    }
+  }
+
+  if (jobs.empty())
+    return true;
+
+  // Make sure the other file handles see a consistent file.
+  if (fflush(file_.get()) != 0) {
+    LOG(ERROR) << "Failed to flush the streams.";
+    return false;
+  }
+
+  return RunParallelJobs(jobs.size(),
+                         kMaxStreamWriterThreads,
+                         "PdbStreamWriter",
+                         base::Bind(&StreamWriter::Create, &pdb_path, &jobs));
+}
+
 // Write an unsigned 32 bit value to the output file.
 bool PdbWriter::WriteUint32(const char* func,
                             const char* desc,
@@ -127,8 +242,8 @@ bool PdbWriter::PadToPageBoundary(const char* func,
   return true;
 }
 
-bool PdbWriter::AppendStream(PdbStream* stream, uint32* bytes_written) {
-  DCHECK(bytes_written != NULL);
+bool PdbWriter::CopyStream(PdbStream* stream) {
+  DCHECK(stream != NULL);
 
   // Append the contents of source to output file.
   stream->Seek(0);
@@ -148,6 +263,25 @@ bool PdbWriter::AppendStream(PdbStream* stream, uint32* bytes_written) {
     }
   }
 
+  return true;
+}
+
+bool PdbWriter::AppendStream(PdbStream* stream, uint32* bytes_written) {
+  DCHECK(bytes_written != NULL);
+
+  // Streams that are in memory in one piece, such as unmodified streams that
+  // are contiguous in a mapped input file, are written as is. Others are
+  // copied in chunks.
+  const uint8* data = stream->GetContiguousData();
+  if (data != NULL) {
+    if (fwrite(data, 1, stream->length(), file_.get()) != stream->length()) {
+      LOG(ERROR) << "Error appending pdb stream to file";
+      return false;
+    }
+  } else if (!CopyStream(stream)) {
+    return false;
+  }
+
   // Pad to the end of the current page boundary.
   uint32 padding = 0;
   if (!PadToPageBoundary("AppendStream", stream->length(), &padding))
@@ -46,6 +46,23 @@ class PdbWriter {
   };
   typedef std::vector<StreamInfo> StreamInfoList;
 
+  // Lays out the streams of @p pdb_file in the output file, one after the
+  // other at page boundaries starting at @p total_bytes.
+  // @param pdb_file the PDB file to be written.
+  // @param stream_info_list receives the location of each stream.
+  // @param total_bytes on input, the offset of the first stream. On output,
+  //     the offset past the last stream.
+  void LayoutStreams(const PdbFile& pdb_file,
+                     StreamInfoList* stream_info_list,
+                     uint32* total_bytes);
+
+  // Writes the streams of @p pdb_file at the locations given by
+  // @p stream_info_list. The streams whose contents are in memory are written
+  // concurrently, through additional handles to @p pdb_path.
+  bool WriteStreams(const FilePath& pdb_path,
+                    const PdbFile& pdb_file,
+                    const StreamInfoList& stream_info_list);
+
   // Write an unsigned 32 bit value to the output file.
   bool WriteUint32(const char* func,
                    const char* desc,
@@ -56,6 +73,9 @@ class PdbWriter {
                          uint32 offset,
                          uint32* padding);
 
+  // Copy the contents of the stream onto the file handle through a buffer.
+  bool CopyStream(PdbStream* stream);
+
   // Append the contents of the stream onto the file handle at the offset. The
   // contents of the file are padded to reach the next page boundary in the
   // output stream.
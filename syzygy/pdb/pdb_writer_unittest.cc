@@ -18,7 +18,9 @@
 #include "gtest/gtest.h"
 #include "syzygy/core/unittest_util.h"
 #include "syzygy/pdb/pdb_constants.h"
+#include "syzygy/pdb/pdb_byte_stream.h"
 #include "syzygy/pdb/pdb_reader.h"
+#include "syzygy/pdb/unittest_util.h"
 
 namespace pdb {
 
@@ -49,6 +51,7 @@ class TestPdbWriter : public PdbWriter {
   using PdbWriter::StreamInfoList;
   using PdbWriter::PadToPageBoundary;
   using PdbWriter::AppendStream;
+  using PdbWriter::LayoutStreams;
   using PdbWriter::WriteDirectory;
   using PdbWriter::WriteDirectoryPages;
   using PdbWriter::WriteHeader;
@@ -112,6 +115,70 @@ TEST(PdbWriterTest, WritePdbFile) {
   }
 }
 
+TEST(PdbWriterTest, RewriteTestPdbFile) {
+  PdbFile pdb_file;
+  PdbReader reader;
+  ASSERT_TRUE(reader.Read(
+      testing::GetSrcRelativePath(testing::kTestPdbFilePath), &pdb_file));
+
+  testing::ScopedTempFile file;
+  {
+    TestPdbWriter writer;
+    ASSERT_TRUE(writer.Write(file.path(), pdb_file));
+  }
+
+  // The streams should have been copied verbatim, whether they were written
+  // straight from the mapping of the input file or through a buffer.
+  PdbFile pdb_file_read;
+  ASSERT_TRUE(reader.Read(file.path(), &pdb_file_read));
+  ASSERT_EQ(pdb_file.StreamCount(), pdb_file_read.StreamCount());
+  for (size_t i = 0; i < pdb_file.StreamCount(); ++i) {
+    scoped_refptr<PdbStream> stream = pdb_file.GetStream(i);
+    scoped_refptr<PdbStream> stream_read = pdb_file_read.GetStream(i);
+    if (stream == NULL) {
+      EXPECT_EQ(0U, stream_read->length());
+      continue;
+    }
+
+    scoped_refptr<PdbByteStream> bytes(new PdbByteStream());
+    scoped_refptr<PdbByteStream> bytes_read(new PdbByteStream());
+    ASSERT_TRUE(bytes->Init(stream));
+    ASSERT_TRUE(bytes_read->Init(stream_read));
+    ASSERT_EQ(bytes->length(), bytes_read->length());
+    if (bytes->length() > 0)
+      EXPECT_EQ(0, memcmp(bytes->data(), bytes_read->data(), bytes->length()));
+  }
+}
+
+TEST(PdbWriterTest, LayoutStreams) {
+  PdbFile pdb_file;
+  pdb_file.AppendStream(new TestPdbStream(kPdbPageSize + 1));
+  pdb_file.AppendStream(NULL);
+  pdb_file.AppendStream(new TestPdbStream(10));
+  pdb_file.AppendStream(new TestPdbStream(0));
+  pdb_file.AppendStream(new TestPdbStream(kPdbPageSize));
+
+  TestPdbWriter writer;
+  TestPdbWriter::StreamInfoList stream_info_list;
+  uint32 total_bytes = 3 * kPdbPageSize;
+  writer.LayoutStreams(pdb_file, &stream_info_list, &total_bytes);
+
+  // Streams start on page boundaries, and empty streams take no space.
+  uint32 expected[][2] = {
+    {3 * kPdbPageSize, kPdbPageSize + 1},  // offset, length.
+    {5 * kPdbPageSize, 0},
+    {5 * kPdbPageSize, 10},
+    {6 * kPdbPageSize, 0},
+    {6 * kPdbPageSize, kPdbPageSize},
+  };
+  ASSERT_EQ(arraysize(expected), stream_info_list.size());
+  for (size_t i = 0; i < arraysize(expected); ++i) {
+    EXPECT_EQ(expected[i][0], stream_info_list[i].offset);
+    EXPECT_EQ(expected[i][1], stream_info_list[i].length);
+  }
+  EXPECT_EQ(7 * kPdbPageSize, total_bytes);
+}
+
 TEST(PdbWriterTest, PadToPageBoundary) {
   // Test that the right amount is padded for the given offset.
   uint32 test_cases[][2] = {
@@ -692,17 +692,20 @@ void LookForNonReturningFunctions(
   BlockGraph::Offset call_ref_offset = 0;
 
   AbsoluteAddress end_of_last_inst;
-  Disassembler::VisitedSpace::const_iterator inst_it =
-      disasm.visited().begin();
-  for (; inst_it != disasm.visited().end(); ++inst_it) {
+  for (size_t i = 0; i < disasm.code_size(); ++i) {
+    AbsoluteAddress inst_addr = disasm.code_addr() + i;
+    size_t inst_size = disasm.GetVisitedInstructionSize(inst_addr);
+    if (inst_size == 0)
+      continue;
+
     // Not contiguous with the last instruction? Then we're spanning a gap. If
     // it's an instruction then we didn't parse it; thus, we already know that
     // if the last instruction is a call it's to a non-returning function. So,
     // we only need to check for data.
-    if (inst_it->first.start() != end_of_last_inst) {
+    if (inst_addr != end_of_last_inst) {
       if (saw_call || saw_call_then_nop) {
         BlockGraph::Offset offset = end_of_last_inst - disasm.code_addr();
-        BlockGraph::Size size = inst_it->first.start() - end_of_last_inst;
+        BlockGraph::Size size = inst_addr - end_of_last_inst;
         if (HasDataLabelInRange(block, offset, size))
           // We do not expect this to ever occur in cl.exe generated code.
           // However, it is entirely possible in hand-written assembly.
@@ -716,9 +719,9 @@ void LookForNonReturningFunctions(
     }
 
     _DInst inst = { 0 };
-    BlockGraph::Offset offset = inst_it->first.start() - disasm.code_addr();
+    BlockGraph::Offset offset = i;
     const uint8* code = disasm.code() + offset;
-    CHECK(core::DecodeOneInstruction(code, inst_it->first.size(), &inst));
+    CHECK(core::DecodeOneInstruction(code, inst_size, &inst));
 
     // Previous instruction was a call?
     if (saw_call) {
@@ -739,13 +742,13 @@ void LookForNonReturningFunctions(
       // the offset of its operand (the call target).
       if (core::IsCall(inst)) {
         saw_call = true;
-        call_ref_offset = offset + inst_it->first.size() -
+        call_ref_offset = offset + inst_size -
             BlockGraph::Reference::kMaximumSize;
       }
     }
 
     // Remember the end of the last instruction we processed.
-    end_of_last_inst = inst_it->first.end();
+    end_of_last_inst = inst_addr + inst_size;
   }
 
   // If the last instruction was a call and we've marked that we've disassembled
@@ -2070,6 +2073,7 @@ bool Decomposer::CreateCodeReferencesForBlock(BlockGraph::Block* block) {
                       abs_block_addr,
                       starting_points,
                       on_instruction);
+  disasm.set_instruction_cache(image_->graph()->instruction_cache());
   Disassembler::WalkResult result = disasm.Walk();
 
   // If we're strict (that is, we're confident that the block was produced by
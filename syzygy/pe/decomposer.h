@@ -28,6 +28,7 @@
 #include "base/file_path.h"
 #include "pcrecpp.h"  // NOLINT
 #include "syzygy/block_graph/block_graph.h"
+#include "syzygy/core/address_space.h"
 #include "syzygy/core/disassembler.h"
 #include "syzygy/core/serialization.h"
 #include "syzygy/pdb/pdb_data.h"
@@ -24,6 +24,7 @@
 #include "syzygy/block_graph/block_graph_serializer.h"
 #include "syzygy/block_graph/typed_block.h"
 #include "syzygy/block_graph/unittest_util.h"
+#include "syzygy/core/decoded_instruction_cache.h"
 #include "syzygy/core/unittest_util.h"
 #include "syzygy/pdb/pdb_byte_stream.h"
 #include "syzygy/pdb/pdb_file.h"
@@ -196,6 +197,35 @@ TEST_F(DecomposerTest, DecomposeFailsWithNonexistentPdb) {
   EXPECT_FALSE(decomposer.Decompose(&image_layout));
 }
 
+TEST_F(DecomposerTest, DecomposeUsesInstructionCache) {
+  FilePath image_path(testing::GetExeRelativePath(kDllName));
+  PEFile image_file;
+
+  ASSERT_TRUE(image_file.Init(image_path));
+
+  core::DecodedInstructionCache instruction_cache;
+
+  // The instructions decoded while decomposing are cached.
+  Decomposer decomposer(image_file);
+  BlockGraph block_graph;
+  block_graph.set_instruction_cache(&instruction_cache);
+  ImageLayout image_layout(&block_graph);
+  ASSERT_TRUE(decomposer.Decompose(&image_layout));
+  size_t cached_instructions = instruction_cache.size();
+  EXPECT_NE(0U, cached_instructions);
+  EXPECT_GT(instruction_cache.max_size(), cached_instructions);
+
+  // The blocks refer to the data of the same image the second time around,
+  // so all of their instructions are found in the cache.
+  Decomposer decomposer2(image_file);
+  BlockGraph block_graph2;
+  block_graph2.set_instruction_cache(&instruction_cache);
+  ImageLayout image_layout2(&block_graph2);
+  ASSERT_TRUE(decomposer2.Decompose(&image_layout2));
+  EXPECT_EQ(cached_instructions, instruction_cache.size());
+  EXPECT_EQ(block_graph.blocks().size(), block_graph2.blocks().size());
+}
+
 TEST_F(DecomposerTest, LabelsAndAttributes) {
   FilePath image_path(testing::GetExeRelativePath(kDllName));
   PEFile image_file;
@@ -15,6 +15,7 @@
 #include "syzygy/pe/pe_relinker.h"
 
 #include "base/file_util.h"
+#include "base/time.h"
 #include "syzygy/block_graph/orderers/original_orderer.h"
 #include "syzygy/core/zstream.h"
 #include "syzygy/pdb/pdb_byte_stream.h"
@@ -427,11 +428,16 @@ bool WritePdbFile(const FilePath& output_pdb_path, const PdbFile& pdb_file) {
     return false;
   }
 
+  base::Time start_time = base::Time::Now();
   pdb::PdbWriter pdb_writer;
   if (!pdb_writer.Write(temp_pdb, pdb_file)) {
     LOG(ERROR) << "Failed to write temporary PDB file to \""
                << temp_pdb.value() << "\".";
+    file_util::Delete(temp_pdb, false);
+    return false;
   }
+  LOG(INFO) << "Wrote PDB file in "
+            << (base::Time::Now() - start_time).InMilliseconds() << " ms.";
 
   if (!file_util::ReplaceFile(temp_pdb, output_pdb_path)) {
     LOG(ERROR) << "Unable to move temporary PDB file to \""
@@ -718,7 +724,9 @@ bool PERelinker::Init() {
     return false;
   }
 
-  // Decompose the image.
+  // Decompose the image. The instructions decoded along the way are kept for
+  // the basic-block transforms, which disassemble the same code again.
+  block_graph_.set_instruction_cache(&instruction_cache_);
   if (!Decompose(input_pe_file_, input_pdb_path_, &input_image_layout_,
                  &dos_header_block_)) {
     return false;
@@ -64,6 +64,7 @@
 #include "base/file_path.h"
 #include "syzygy/block_graph/orderer.h"
 #include "syzygy/block_graph/transform.h"
+#include "syzygy/core/decoded_instruction_cache.h"
 #include "syzygy/pdb/pdb_mutator.h"
 #include "syzygy/pe/image_layout_builder.h"
 #include "syzygy/pe/pe_file.h"
@@ -285,6 +286,11 @@ class PERelinker {
   PEFile input_pe_file_;
   ImageLayout input_image_layout_;
 
+  // The instructions decoded while decomposing the original image, which the
+  // basic-block transforms reuse. block_graph_ refers to it, so it's declared
+  // first.
+  core::DecodedInstructionCache instruction_cache_;
+
   // These refer to the image the whole way through the process. They may
   // evolve.
   BlockGraph block_graph_;
@@ -176,7 +176,8 @@ bool BasicBlockLayoutTransform::OnBlock(
             &bb_layout_tx,
             block_graph,
             block,
-            &new_blocks)) {
+            &new_blocks,
+            &successor_statistics_)) {
       return false;
     }
   }
@@ -199,6 +200,16 @@ bool BasicBlockLayoutTransform::OnBlock(
   return true;
 }
 
+bool BasicBlockLayoutTransform::PostBlockGraphIteration(
+    BlockGraph* block_graph, BlockGraph::Block* header_block) {
+  DCHECK(block_graph != NULL);
+  DCHECK(header_block != NULL);
+
+  block_graph::LogSuccessorStatistics(kTransformName, successor_statistics_);
+
+  return true;
+}
+
 bool BasicBlockLayoutTransform::FindOrCreateSections(BlockGraph* block_graph) {
   DCHECK(block_graph != NULL);
   DCHECK(order_ != NULL);
@@ -22,6 +22,7 @@
 #ifndef SYZYGY_REORDER_TRANSFORMS_BASIC_BLOCK_LAYOUT_TRANSFORM_H_
 #define SYZYGY_REORDER_TRANSFORMS_BASIC_BLOCK_LAYOUT_TRANSFORM_H_
 
+#include "syzygy/block_graph/block_builder.h"
 #include "syzygy/block_graph/transforms/iterative_transform.h"
 #include "syzygy/reorder/reorderer.h"
 
@@ -72,6 +73,12 @@ class BasicBlockLayoutTransform
 
   virtual ~BasicBlockLayoutTransform();
 
+  // @returns the statistics on the successors of the laid out blocks.
+  const block_graph::BlockBuilder::SuccessorStatistics&
+      successor_statistics() const {
+    return successor_statistics_;
+  }
+
  private:
   // @name IterativeTransformImpl implementation.
   // @{
@@ -80,6 +87,8 @@ class BasicBlockLayoutTransform
   bool PreBlockGraphIteration(BlockGraph* block_graph,
                               BlockGraph::Block* header_block);
   bool OnBlock(BlockGraph* block_graph, BlockGraph::Block* block);
+  bool PostBlockGraphIteration(BlockGraph* block_graph,
+                               BlockGraph::Block* header_block);
   // @}
 
   // @name NamedBlockGraphTransformImpl implementation.
@@ -108,6 +117,9 @@ class BasicBlockLayoutTransform
   // information for a particular source block.
   BlockInfos block_infos_;
 
+  // The statistics on the successors of the laid out blocks.
+  block_graph::BlockBuilder::SuccessorStatistics successor_statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(BasicBlockLayoutTransform);
 };
 